@@ -423,6 +423,15 @@ MIRACLE_PARAMETER_FOR_INT(
     "ThreadCacheMinCachedMemoryForPurgingBytes",
     partition_alloc::kMinCachedMemoryForPurgingBytes)
 
+BASE_FEATURE(kPartitionAllocAdaptiveThreadCacheLimits,
+             "PartitionAllocAdaptiveThreadCacheLimits",
+             base::FEATURE_DISABLED_BY_DEFAULT);
+
+MIRACLE_PARAMETER_FOR_INT(GetAdaptiveThreadCacheMemoryBudgetBytes,
+                          kPartitionAllocAdaptiveThreadCacheLimits,
+                          "AdaptiveThreadCacheMemoryBudgetBytes",
+                          2 * 1024 * 1024)
+
 // An apparent quarantine leak in the buffer partition unacceptably
 // bloats memory when MiraclePtr is enabled in the renderer process.
 // We believe we have found and patched the leak, but out of an
@@ -218,6 +218,11 @@ BASE_EXPORT BASE_DECLARE_FEATURE(
     kEnableConfigurableThreadCacheMinCachedMemoryForPurging);
 BASE_EXPORT int GetThreadCacheMinCachedMemoryForPurgingBytes();
 
+// Lets each thread cache tune its per-bucket limits from its own allocation
+// pattern, within a process-wide memory budget.
+BASE_EXPORT BASE_DECLARE_FEATURE(kPartitionAllocAdaptiveThreadCacheLimits);
+BASE_EXPORT int GetAdaptiveThreadCacheMemoryBudgetBytes();
+
 BASE_EXPORT BASE_DECLARE_FEATURE(kPartitionAllocDisableBRPInBufferPartition);
 
 // This feature is additionally gated behind a buildflag because
@@ -1343,6 +1343,14 @@ void PartitionAllocSupport::ReconfigureAfterTaskRunnerInit(
 
     ::partition_alloc::ThreadCache::SetLargestCachedSize(largest_cached_size_);
   }
+
+  if (base::FeatureList::IsEnabled(
+          base::features::kPartitionAllocAdaptiveThreadCacheLimits)) {
+    ::partition_alloc::ThreadCacheRegistry::Instance()
+        .SetAdaptiveLimitsConfiguration(
+            true,
+            size_t(base::features::GetAdaptiveThreadCacheMemoryBudgetBytes()));
+  }
 #endif  // PA_CONFIG(THREAD_CACHE_SUPPORTED) &&
         // BUILDFLAG(USE_PARTITION_ALLOC_AS_MALLOC)
 
@@ -355,6 +355,20 @@ void DiscardSystemPages(void* address, size_t length) {
   DiscardSystemPages(reinterpret_cast<uintptr_t>(address), length);
 }
 
+#if PA_CONFIG(ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC)
+bool TryMoveSystemPages(uintptr_t source_address,
+                        uintptr_t dest_address,
+                        size_t length) {
+  PA_DCHECK(!(source_address & internal::SystemPageOffsetMask()));
+  PA_DCHECK(!(dest_address & internal::SystemPageOffsetMask()));
+  PA_DCHECK(!(length & internal::SystemPageOffsetMask()));
+  PA_DCHECK(source_address + length <= dest_address ||
+            dest_address + length <= source_address);
+  return internal::TryMoveSystemPagesInternal(source_address, dest_address,
+                                              length);
+}
+#endif  // PA_CONFIG(ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC)
+
 bool ReserveAddressSpace(size_t size) {
   // To avoid deadlock, call only SystemAllocPages.
   internal::ScopedGuard guard(GetReserveLock());
@@ -12,6 +12,7 @@
 #include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_base/compiler_specific.h"
 #include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_base/component_export.h"
 #include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_buildflags.h"
+#include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_config.h"
 #include "base/allocator/partition_allocator/src/partition_alloc/thread_isolation/thread_isolation.h"
 #include "build/build_config.h"
 
@@ -325,6 +326,21 @@ void DiscardSystemPages(uintptr_t address, size_t length);
 PA_COMPONENT_EXPORT(PARTITION_ALLOC)
 void DiscardSystemPages(void* address, size_t length);
 
+#if PA_CONFIG(ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC)
+// Moves the committed pages in [|source_address|, |source_address| + |length|)
+// to |dest_address|, without copying their content. Whatever was mapped at the
+// destination is replaced. The source range stays mapped with the same
+// accessibility, and reads as zeroes afterwards. Both addresses and |length|
+// must be multiples of |SystemPageSize()|, and the ranges must not overlap.
+//
+// Returns false, leaving both ranges untouched, if the kernel can't do it, e.g.
+// when the source range spans several mappings, or the kernel is too old.
+[[nodiscard]] PA_COMPONENT_EXPORT(PARTITION_ALLOC) bool TryMoveSystemPages(
+    uintptr_t source_address,
+    uintptr_t dest_address,
+    size_t length);
+#endif  // PA_CONFIG(ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC)
+
 // Rounds up |address| to the next multiple of |SystemPageSize()|. Returns
 // 0 for an |address| of 0.
 PA_ALWAYS_INLINE PAGE_ALLOCATOR_CONSTANTS_DECLARE_CONSTEXPR uintptr_t
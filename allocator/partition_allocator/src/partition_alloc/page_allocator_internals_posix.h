@@ -421,6 +421,39 @@ void DiscardSystemPagesInternal(uintptr_t address, size_t length) {
 #endif  // BUILDFLAG(IS_APPLE)
 }
 
+#if PA_CONFIG(ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC)
+bool TryMoveSystemPagesInternal(uintptr_t source_address,
+                                uintptr_t dest_address,
+                                size_t length) {
+  // Not in all libc headers yet, available since Linux 5.7.
+#if !defined(MREMAP_DONTUNMAP)
+  constexpr int MREMAP_DONTUNMAP = 4;
+#endif
+  // Set once the kernel has told us that it doesn't support MREMAP_DONTUNMAP,
+  // to avoid making a doomed system call on every large realloc().
+  static std::atomic<bool> s_unsupported{false};
+  if (s_unsupported.load(std::memory_order_relaxed)) {
+    return false;
+  }
+
+  // MREMAP_DONTUNMAP keeps the source range mapped, as empty anonymous
+  // memory. Without it, there would be a window during which the source range
+  // is a hole in the reservation, that a concurrent mmap() could land into.
+  void* source = reinterpret_cast<void*>(source_address);
+  void* dest = reinterpret_cast<void*>(dest_address);
+  void* ret = mremap(source, length, length,
+                     MREMAP_MAYMOVE | MREMAP_FIXED | MREMAP_DONTUNMAP, dest);
+  if (ret == MAP_FAILED) {
+    if (errno == EINVAL) {
+      s_unsupported.store(true, std::memory_order_relaxed);
+    }
+    return false;
+  }
+  PA_CHECK(ret == dest);
+  return true;
+}
+#endif  // PA_CONFIG(ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC)
+
 }  // namespace partition_alloc::internal
 
 #endif  // BASE_ALLOCATOR_PARTITION_ALLOCATOR_SRC_PARTITION_ALLOC_PAGE_ALLOCATOR_INTERNALS_POSIX_H_
@@ -320,6 +320,16 @@ constexpr bool kUseLazyCommit = false;
 #define PA_CONFIG_ENABLE_SHADOW_METADATA() 0
 #endif
 
+// Growing a large direct-mapped allocation through realloc() can move its
+// pages with mremap(2) instead of copying them. Not compatible with shadow
+// metadata, as the pools are then backed by a shared memory file, and moving
+// pages would break the mapping between addresses and file offsets.
+#if PA_CONFIG(HAS_LINUX_KERNEL) && !PA_CONFIG(ENABLE_SHADOW_METADATA)
+#define PA_CONFIG_ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC() 1
+#else
+#define PA_CONFIG_ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC() 0
+#endif
+
 // According to crbug.com/1349955#c24, macOS 11 has a bug where they asset that
 // malloc_size() of an allocation is equal to the requested size. This is
 // generally not true. The assert passed only because it happened to be true for
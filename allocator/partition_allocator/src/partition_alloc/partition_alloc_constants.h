@@ -423,6 +423,10 @@ constexpr size_t kMaxBucketed = (1 << (kMaxBucketedOrder - 1)) +
                                 ((kNumBucketsPerOrder - 1) * kMaxBucketSpacing);
 // Limit when downsizing a direct mapping using `realloc`:
 constexpr size_t kMinDirectMappedDownsize = kMaxBucketed + 1;
+// Minimum amount of data that `realloc` moves by remapping pages rather than
+// copying them, when growing a direct mapping that can't be grown in-place.
+// Below this, memcpy() is cheaper than the system calls and TLB shootdowns.
+constexpr size_t kMinDirectMapRemapSize = 1 << 20;  // 1 MiB
 // Intentionally set to less than 2GiB to make sure that a 2GiB allocation
 // fails. This is a security choice in Chrome, to help making size_t vs int bugs
 // harder to exploit.
@@ -12,6 +12,7 @@
 #include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc.h"
 #include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_base/logging.h"
 #include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_base/strings/stringprintf.h"
+#include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_base/threading/platform_thread.h"
 #include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_base/threading/platform_thread_for_testing.h"
 #include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_base/time/time.h"
 #include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_check.h"
@@ -515,6 +516,171 @@ TEST_P(PartitionAllocMemoryAllocationPerfTest,
 }
 #endif  // !defined(MEMORY_CONSTRAINED)
 
+#if !defined(MEMORY_CONSTRAINED)
+// Mixed workload for adaptive thread cache limits: some threads allocate and
+// free in bursts larger than the default bucket limits, thrashing against the
+// central allocator, while others only allocate and free one object at a
+// time, for which the default limits are too large.
+constexpr size_t kBurstAllocSize = 200;
+constexpr size_t kBurstLength = 256;
+constexpr size_t kSteadyAllocSize = 64;
+constexpr ::base::TimeDelta kMixedWorkloadPurgeInterval =
+    ::base::Milliseconds(100);
+
+float BurstyWorkload(Allocator* allocator) {
+  std::vector<void*> burst(kBurstLength);
+  ::base::LapTimer timer(0, kTimeLimit, 1);
+  do {
+    for (void*& ptr : burst) {
+      ptr = allocator->Alloc(kBurstAllocSize);
+      PA_CHECK(ptr != nullptr);
+    }
+    for (void* ptr : burst) {
+      allocator->Free(ptr);
+    }
+    timer.NextLap();
+  } while (!timer.HasTimeLimitExpired());
+
+  return timer.LapsPerSecond() * kBurstLength;
+}
+
+float SteadyWorkload(Allocator* allocator) {
+  ::base::LapTimer timer(kWarmupRuns, kTimeLimit, kTimeCheckInterval);
+  do {
+    void* ptr = allocator->Alloc(kSteadyAllocSize);
+    PA_CHECK(ptr != nullptr);
+    allocator->Free(ptr);
+    timer.NextLap();
+  } while (!timer.HasTimeLimitExpired());
+
+  return timer.LapsPerSecond();
+}
+
+class PartitionAllocAdaptiveThreadCachePerfTest
+    : public testing::TestWithParam<bool> {};
+
+INSTANTIATE_TEST_SUITE_P(,
+                         PartitionAllocAdaptiveThreadCachePerfTest,
+                         ::testing::Values(false, true));
+
+TEST_P(PartitionAllocAdaptiveThreadCachePerfTest, MixedWorkload) {
+  constexpr int kThreadsPerWorkload = 2;
+  const bool adaptive = GetParam();
+  auto& registry = ThreadCacheRegistry::Instance();
+  auto alloc = CreateAllocator(AllocatorType::kPartitionAllocWithThreadCache,
+                               /* use_alternate_bucket_dist= */ false);
+  registry.SetPurgingConfiguration(kMinPurgeInterval, kMaxPurgeInterval,
+                                   kDefaultPurgeInterval,
+                                   kMinCachedMemoryForPurgingBytes);
+  registry.SetAdaptiveLimitsConfiguration(adaptive, 1 << 20);
+
+  std::vector<std::unique_ptr<TestLoopThread>> bursty_threads;
+  std::vector<std::unique_ptr<TestLoopThread>> steady_threads;
+  for (int i = 0; i < kThreadsPerWorkload; ++i) {
+    bursty_threads.push_back(
+        std::make_unique<TestLoopThread>(BurstyWorkload, alloc.get()));
+    steady_threads.push_back(
+        std::make_unique<TestLoopThread>(SteadyWorkload, alloc.get()));
+  }
+
+  // Stand-in for the periodic purge task, which adapts the limits.
+  size_t max_cached_memory = 0;
+  ::base::TimeTicks end = ::base::TimeTicks::Now() + kTimeLimit;
+  while (::base::TimeTicks::Now() < end) {
+    base::PlatformThread::Sleep(
+        base::Microseconds(kMixedWorkloadPurgeInterval.InMicroseconds()));
+    ThreadCacheStats stats;
+    registry.DumpStats(false, &stats);
+    max_cached_memory =
+        std::max(max_cached_memory, size_t{stats.bucket_total_memory});
+    registry.RunPeriodicPurge();
+  }
+
+  float bursty_laps_per_second = 0;
+  float steady_laps_per_second = 0;
+  for (int i = 0; i < kThreadsPerWorkload; ++i) {
+    bursty_laps_per_second += bursty_threads[i]->Run();
+    steady_laps_per_second += steady_threads[i]->Run();
+  }
+  registry.SetAdaptiveLimitsConfiguration(false, 0);
+
+  std::string name = base::TruncatingStringPrintf(
+      "%sMixedWorkload_%s", kMetricPrefixMemoryAllocation,
+      adaptive ? "AdaptiveThreadCache" : "ThreadCache");
+  DisplayResults(name + "_bursty", bursty_laps_per_second);
+  DisplayResults(name + "_steady", steady_laps_per_second);
+  auto reporter = SetUpReporter(name);
+  reporter.RegisterImportantMetric("max_cached_memory", "bytes");
+  reporter.AddResult("max_cached_memory", max_cached_memory);
+}
+#endif  // !defined(MEMORY_CONSTRAINED)
+
+#if !defined(MEMORY_CONSTRAINED)
+// Grows a buffer by repeatedly doubling it with realloc(), the way growable
+// containers and string builders do. Past the direct map threshold, every
+// doubling relocates the allocation, and the data is either copied or moved
+// by remapping pages.
+constexpr size_t kReallocInitialSize = 1 << 16;
+constexpr size_t kReallocFinalSize = 1 << 26;
+
+template <typename ReallocFn, typename FreeFn>
+float RepeatedDoubling(ReallocFn realloc_fn, FreeFn free_fn) {
+  ::base::LapTimer timer(0, kTimeLimit, 1);
+  do {
+    void* ptr = nullptr;
+    size_t old_size = 0;
+    for (size_t size = kReallocInitialSize; size <= kReallocFinalSize;
+         size *= 2) {
+      ptr = realloc_fn(ptr, size);
+      PA_CHECK(ptr != nullptr);
+      // Touch each new page once, as filling the buffer would. This doesn't
+      // write the full buffer, to leave the relocation cost apparent.
+      for (size_t i = old_size; i < size; i += SystemPageSize()) {
+        static_cast<volatile char*>(ptr)[i] = 1;
+      }
+      old_size = size;
+    }
+    free_fn(ptr);
+    timer.NextLap();
+  } while (!timer.HasTimeLimitExpired());
+
+  return timer.LapsPerSecond();
+}
+
+class PartitionAllocReallocPerfTest
+    : public testing::TestWithParam<AllocatorType> {};
+
+INSTANTIATE_TEST_SUITE_P(,
+                         PartitionAllocReallocPerfTest,
+                         ::testing::Values(AllocatorType::kSystem,
+                                           AllocatorType::kPartitionAlloc));
+
+TEST_P(PartitionAllocReallocPerfTest, RepeatedDoubling) {
+  float laps_per_second = 0;
+  const char* alloc_type_str = nullptr;
+  if (GetParam() == AllocatorType::kSystem) {
+    alloc_type_str = "System";
+    laps_per_second = RepeatedDoubling(
+        [](void* ptr, size_t size) { return realloc(ptr, size); },
+        [](void* ptr) { free(ptr); });
+  } else {
+    alloc_type_str = "PartitionAlloc";
+    PartitionRoot root{PartitionOptions{}};
+    laps_per_second = RepeatedDoubling(
+        [&root](void* ptr, size_t size) {
+          return root.Realloc<AllocFlags::kNoHooks>(ptr, size, "");
+        },
+        [&root](void* ptr) { root.Free<FreeFlags::kNoHooks>(ptr); });
+    root.DestructForTesting();
+  }
+
+  std::string name = base::TruncatingStringPrintf(
+      "%sReallocRepeatedDoubling_%s", kMetricPrefixMemoryAllocation,
+      alloc_type_str);
+  DisplayResults(name, laps_per_second);
+}
+#endif  // !defined(MEMORY_CONSTRAINED)
+
 }  // namespace
 
 }  // namespace partition_alloc::internal
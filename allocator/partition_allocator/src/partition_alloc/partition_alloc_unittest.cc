@@ -1878,6 +1878,50 @@ TEST_P(PartitionAllocTest, ReallocDirectMapAlignedRelocate) {
   allocator.root()->Free(ptr2);
 }
 
+// Growing a direct map past its reservation relocates it. Large enough
+// allocations are moved by remapping their pages (where supported), which must
+// preserve the content, and leave both slots in a consistent state.
+TEST_P(PartitionAllocTest, ReallocDirectMapGrowRelocate) {
+  size_t size = 2 * kMinDirectMapRemapSize;
+  ASSERT_GT(size, kMaxBucketed);
+  size_t committed_before =
+      allocator.root()->get_total_size_of_committed_pages();
+  auto* ptr = static_cast<uint8_t*>(allocator.root()->Alloc(size, type_name));
+  for (size_t i = 0; i < size; ++i) {
+    ptr[i] = static_cast<uint8_t>(i * 7);
+  }
+
+  for (int iteration = 0; iteration < 4; ++iteration) {
+    size_t new_size = 2 * size;
+    auto* new_ptr = static_cast<uint8_t*>(
+        allocator.root()->Realloc(ptr, new_size, type_name));
+    ASSERT_TRUE(new_ptr);
+    EXPECT_NE(ptr, new_ptr);
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_EQ(static_cast<uint8_t>(i * 7), new_ptr[i]) << i;
+    }
+    // The part that wasn't moved is writable, and doesn't alias the rest.
+    for (size_t i = size; i < new_size; ++i) {
+      new_ptr[i] = static_cast<uint8_t>(i * 7);
+    }
+    EXPECT_GE(PartitionRoot::GetUsableSize(new_ptr), new_size);
+    ptr = new_ptr;
+    size = new_size;
+  }
+
+  // A fresh allocation of the previous size still works, even though its
+  // pages may have been handed over.
+  auto* other = static_cast<uint8_t*>(
+      allocator.root()->Alloc(kMinDirectMapRemapSize, type_name));
+  memset(other, 'A', kMinDirectMapRemapSize);
+  allocator.root()->Free(other);
+
+  allocator.root()->Free(ptr);
+  allocator.root()->PurgeMemory(PurgeFlags::kDecommitEmptySlotSpans);
+  EXPECT_EQ(committed_before,
+            allocator.root()->get_total_size_of_committed_pages());
+}
+
 // Tests the handing out of freelists for partial slot spans.
 TEST_P(PartitionAllocTest, PartialPageFreelists) {
   size_t big_size = SystemPageSize() - ExtraAllocSize(allocator);
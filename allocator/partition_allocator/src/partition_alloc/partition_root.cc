@@ -1296,6 +1296,64 @@ bool PartitionRoot::TryReallocInPlaceForDirectMap(
   return true;
 }
 
+#if PA_CONFIG(ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC)
+bool PartitionRoot::TryMoveDirectMapData(void* old_object,
+                                         void* new_object,
+                                         size_t size) {
+  // Direct map never uses tagging, as size is always >kMaxMemoryTaggingSize.
+  uintptr_t old_address = UntagPtr(old_object);
+  uintptr_t new_address = UntagPtr(new_object);
+  // Only the regular pool qualifies: BRP keeps per-slot state alongside the
+  // data, and pages of the thread-isolated pool carry a protection key that
+  // remapping wouldn't preserve. This also rules out |old_object| not having
+  // been allocated by PartitionAlloc, when hooks override realloc().
+  if (!IsManagedByPartitionAllocRegularPool(old_address) ||
+      !IsManagedByPartitionAllocRegularPool(new_address) ||
+      !internal::IsManagedByDirectMap(old_address) ||
+      !internal::IsManagedByDirectMap(new_address)) {
+    return false;
+  }
+
+  auto* old_slot_span = SlotSpan::FromObject(old_object);
+  auto* new_slot_span = SlotSpan::FromObject(new_object);
+  PA_DCHECK(FromSlotSpan(new_slot_span) == this);
+  if (FromSlotSpan(old_slot_span) != this) {
+    return false;
+  }
+
+  // Pages are moved as a whole, so the data has to sit at the same offset
+  // within the two slots. Since both are direct maps from the same root, this
+  // is always the case in practice.
+  uintptr_t old_slot_start = SlotSpan::ToSlotSpanStart(old_slot_span);
+  uintptr_t new_slot_start = SlotSpan::ToSlotSpanStart(new_slot_span);
+  size_t offset = old_address - old_slot_start;
+  if (new_address - new_slot_start != offset) {
+    return false;
+  }
+  size_t move_size = RoundUpToSystemPage(offset + size);
+  if (move_size > old_slot_span->bucket->slot_size ||
+      move_size > new_slot_span->bucket->slot_size) {
+    return false;
+  }
+
+  if (!TryMoveSystemPages(old_slot_start, new_slot_start, move_size)) {
+    return false;
+  }
+
+  // The trailing cookies may have been moved or cleared with the pages, put
+  // them back so that freeing either slot doesn't trip on them.
+  if (settings.use_cookie) {
+    internal::PartitionCookieWriteValue(
+        static_cast<unsigned char*>(old_object) +
+        GetSlotUsableSize(old_slot_span));
+    internal::PartitionCookieWriteValue(
+        static_cast<unsigned char*>(new_object) +
+        GetSlotUsableSize(new_slot_span));
+  }
+  return true;
+}
+#endif  // PA_CONFIG(ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC)
+
 bool PartitionRoot::TryReallocInPlaceForNormalBuckets(void* object,
                                                       SlotSpan* slot_span,
                                                       size_t new_size) {
@@ -960,6 +960,14 @@ struct PA_ALIGNAS(64) PA_COMPONENT_EXPORT(PARTITION_ALLOC) PartitionRoot {
   bool TryReallocInPlaceForDirectMap(internal::SlotSpanMetadata* slot_span,
                                      size_t requested_size)
       PA_EXCLUSIVE_LOCKS_REQUIRED(internal::PartitionRootLock(this));
+#if PA_CONFIG(ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC)
+  // Moves the first |size| bytes of |old_object| into |new_object| by
+  // remapping pages rather than copying them, when both are direct-mapped
+  // allocations from this root. Returns false if nothing was moved, in which
+  // case the caller has to copy the data itself.
+  bool TryMoveDirectMapData(void* old_object, void* new_object, size_t size)
+      PA_LOCKS_EXCLUDED(internal::PartitionRootLock(this));
+#endif
   void DecommitEmptySlotSpans()
       PA_EXCLUSIVE_LOCKS_REQUIRED(internal::PartitionRootLock(this));
   PA_ALWAYS_INLINE void RawFreeLocked(uintptr_t slot_start)
@@ -2394,7 +2402,17 @@ void* PartitionRoot::ReallocInline(void* ptr,
     internal::PartitionExcessiveAllocationSize(new_size);
   }
 
-  memcpy(ret, ptr, std::min(old_usable_size, new_size));
+  size_t copy_size = std::min(old_usable_size, new_size);
+#if PA_CONFIG(ENABLE_MREMAP_FOR_DIRECT_MAP_REALLOC)
+  // Large direct maps end up here when they can't grow within their
+  // reservation. Repeatedly doubling a buffer would then copy it every time,
+  // so hand the pages over to the new allocation instead.
+  if (PA_UNLIKELY(copy_size >= internal::kMinDirectMapRemapSize) &&
+      TryMoveDirectMapData(ptr, ret, copy_size)) {
+    copy_size = 0;
+  }
+#endif
+  memcpy(ret, ptr, copy_size);
   FreeInUnknownRoot<free_flags>(
       ptr);  // Implicitly protects the old ptr on MTE systems.
   return ret;
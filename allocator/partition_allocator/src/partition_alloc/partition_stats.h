@@ -33,6 +33,10 @@ struct ThreadCacheStats {
 
   uint64_t batch_fill_count;  // Number of central allocator requests.
 
+  // Adaptive limits, see ThreadCacheRegistry::SetAdaptiveLimitsConfiguration().
+  uint64_t adaptive_limit_increases;
+  uint64_t adaptive_limit_decreases;
+
   // Memory cost:
   uint32_t bucket_total_memory;
   uint32_t metadata_overhead;
@@ -133,6 +133,10 @@ void ThreadCacheRegistry::DumpStats(bool my_thread_only,
 }
 
 void ThreadCacheRegistry::PurgeAll() {
+  PurgeAllInternal(/*periodic=*/false);
+}
+
+void ThreadCacheRegistry::PurgeAllInternal(bool periodic) {
   auto* current_thread_tcache = ThreadCache::Get();
 
   // May take a while, don't hold the lock while purging.
@@ -148,7 +152,11 @@ void ThreadCacheRegistry::PurgeAll() {
   // per bucket. By purging the main thread first, we avoid these interferences
   // for this thread at least.
   if (ThreadCache::IsValid(current_thread_tcache)) {
-    current_thread_tcache->Purge();
+    if (periodic) {
+      current_thread_tcache->PeriodicPurge();
+    } else {
+      current_thread_tcache->Purge();
+    }
   }
 
   {
@@ -161,7 +169,11 @@ void ThreadCacheRegistry::PurgeAll() {
       // Note that this will not work if the other thread is sleeping forever.
       // TODO(lizeb): Handle sleeping threads.
       if (tcache != current_thread_tcache) {
-        tcache->SetShouldPurge();
+        if (periodic) {
+          tcache->SetShouldPurgePeriodically();
+        } else {
+          tcache->SetShouldPurge();
+        }
       }
       tcache = tcache->next_;
     }
@@ -241,6 +253,51 @@ void ThreadCacheRegistry::SetThreadCacheMultiplier(float multiplier) {
   }
 }
 
+void ThreadCacheRegistry::SetAdaptiveLimitsConfiguration(
+    bool enabled,
+    size_t memory_budget_bytes) {
+  adaptive_memory_budget_bytes_.store(memory_budget_bytes,
+                                      std::memory_order_relaxed);
+  adaptive_limits_enabled_.store(enabled, std::memory_order_relaxed);
+  if (enabled) {
+    return;
+  }
+
+  // Threads give back their share of the budget at their next periodic purge
+  // with adaptive limits enabled, see |ThreadCache::ReconcileAdaptiveMemory()|.
+  internal::ScopedGuard scoped_locker(GetLock());
+  ThreadCache* tcache = list_head_;
+  while (tcache) {
+    PA_DCHECK(ThreadCache::IsValid(tcache));
+    for (int index = 0; index < ThreadCache::kBucketCount; index++) {
+      // Racy, see |SetThreadCacheMultiplier()|.
+      tcache->buckets_[index].limit.store(ThreadCache::global_limits_[index],
+                                          std::memory_order_relaxed);
+    }
+    tcache = tcache->next_;
+  }
+}
+
+bool ThreadCacheRegistry::TryReserveAdaptiveMemory(size_t bytes) {
+  const size_t budget =
+      adaptive_memory_budget_bytes_.load(std::memory_order_relaxed);
+  size_t used = adaptive_memory_used_bytes_.load(std::memory_order_relaxed);
+  do {
+    if (used > budget || bytes > budget - used) {
+      return false;
+    }
+  } while (!adaptive_memory_used_bytes_.compare_exchange_weak(
+      used, used + bytes, std::memory_order_relaxed,
+      std::memory_order_relaxed));
+  return true;
+}
+
+void ThreadCacheRegistry::ReleaseAdaptiveMemory(size_t bytes) {
+  PA_DCHECK(adaptive_memory_used_bytes_.load(std::memory_order_relaxed) >=
+            bytes);
+  adaptive_memory_used_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
 void ThreadCacheRegistry::SetPurgingConfiguration(
     const internal::base::TimeDelta min_purge_interval,
     const internal::base::TimeDelta max_purge_interval,
@@ -319,7 +376,7 @@ void ThreadCacheRegistry::RunPeriodicPurge() {
   periodic_purge_next_interval_ = std::clamp(
       periodic_purge_next_interval_, min_purge_interval_, max_purge_interval_);
 
-  PurgeAll();
+  PurgeAllInternal(/*periodic=*/true);
 }
 
 int64_t ThreadCacheRegistry::GetPeriodicPurgeNextIntervalInMicroseconds()
@@ -499,6 +556,7 @@ ThreadCache* ThreadCache::Create(PartitionRoot* root) {
 
 ThreadCache::ThreadCache(PartitionRoot* root)
     : should_purge_(false),
+      should_purge_periodically_(false),
       root_(root),
       thread_id_(internal::base::PlatformThread::CurrentId()),
       next_(nullptr),
@@ -527,6 +585,10 @@ ThreadCache::ThreadCache(PartitionRoot* root)
 ThreadCache::~ThreadCache() {
   ThreadCacheRegistry::Instance().UnregisterThreadCache(this);
   Purge();
+  if (adaptive_memory_bytes_) {
+    ThreadCacheRegistry::Instance().ReleaseAdaptiveMemory(
+        adaptive_memory_bytes_);
+  }
 }
 
 // static
@@ -600,14 +662,18 @@ void ThreadCache::FillBucket(size_t bucket_index) {
   PA_INCREMENT_COUNTER(stats_.batch_fill_count);
 
   Bucket& bucket = buckets_[bucket_index];
-  // Some buckets may have a limit lower than |kBatchFillRatio|, but we still
+  AdaptiveBucketStats& adaptive_stats = adaptive_stats_[bucket_index];
+  adaptive_stats.misses++;
+  // Some buckets may have a limit lower than the batch fill ratio, but we still
   // want to at least allocate a single slot, otherwise we wrongly return
   // nullptr, which ends up deactivating the bucket.
   //
   // In these cases, we do not really batch bucket filling, but this is expected
   // to be used for the largest buckets, where over-allocating is not advised.
-  int count = std::max(
-      1, bucket.limit.load(std::memory_order_relaxed) / kBatchFillRatio);
+  //
+  // The ratio is |kBatchFillRatio| unless adaptive limits lowered it.
+  int count = std::max(1, bucket.limit.load(std::memory_order_relaxed) /
+                              adaptive_stats.batch_fill_ratio);
 
   size_t usable_size;
   bool is_already_zeroed;
@@ -732,12 +798,19 @@ void ThreadCache::ResetForTesting() {
 
   stats_.batch_fill_count = 0;
 
+  stats_.adaptive_limit_increases = 0;
+  stats_.adaptive_limit_decreases = 0;
+
   stats_.bucket_total_memory = 0;
   stats_.metadata_overhead = 0;
 
   Purge();
   PA_CHECK(cached_memory_ == 0u);
   should_purge_.store(false, std::memory_order_relaxed);
+
+  for (auto& adaptive_stats : adaptive_stats_) {
+    adaptive_stats = AdaptiveBucketStats();
+  }
 }
 
 size_t ThreadCache::CachedMemory() const {
@@ -763,6 +836,9 @@ void ThreadCache::AccumulateStats(ThreadCacheStats* stats) const {
 
   stats->batch_fill_count += stats_.batch_fill_count;
 
+  stats->adaptive_limit_increases += stats_.adaptive_limit_increases;
+  stats->adaptive_limit_decreases += stats_.adaptive_limit_decreases;
+
 #if PA_CONFIG(THREAD_CACHE_ALLOC_STATS)
   for (size_t i = 0; i < internal::kNumBuckets + 1; i++) {
     stats->allocs_per_bucket_[i] += stats_.allocs_per_bucket_[i];
@@ -778,17 +854,33 @@ void ThreadCache::AccumulateStats(ThreadCacheStats* stats) const {
 }
 
 void ThreadCache::SetShouldPurge() {
+  should_purge_periodically_.store(false, std::memory_order_relaxed);
+  should_purge_.store(true, std::memory_order_relaxed);
+}
+
+void ThreadCache::SetShouldPurgePeriodically() {
+  // Racy with |SetShouldPurge()|, at worst a full purge becomes a periodic one
+  // or the other way around.
+  if (should_purge_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  should_purge_periodically_.store(true, std::memory_order_relaxed);
   should_purge_.store(true, std::memory_order_relaxed);
 }
 
 void ThreadCache::Purge() {
   PA_REENTRANCY_GUARD(is_in_thread_cache_);
-  PurgeInternal();
+  PurgeInternalHelper<true>(/*periodic=*/false);
+}
+
+void ThreadCache::PeriodicPurge() {
+  PA_REENTRANCY_GUARD(is_in_thread_cache_);
+  PurgeInternalHelper<true>(/*periodic=*/true);
 }
 
 void ThreadCache::TryPurge() {
   PA_REENTRANCY_GUARD(is_in_thread_cache_);
-  PurgeInternalHelper<false>();
+  PurgeInternalHelper<false>(/*periodic=*/false);
 }
 
 // static
@@ -800,7 +892,8 @@ void ThreadCache::PurgeCurrentThread() {
 }
 
 void ThreadCache::PurgeInternal() {
-  PurgeInternalHelper<true>();
+  PurgeInternalHelper<true>(
+      should_purge_periodically_.load(std::memory_order_relaxed));
 }
 
 void ThreadCache::ResetPerThreadAllocationStatsForTesting() {
@@ -808,8 +901,16 @@ void ThreadCache::ResetPerThreadAllocationStatsForTesting() {
 }
 
 template <bool crash_on_corruption>
-void ThreadCache::PurgeInternalHelper() {
+void ThreadCache::PurgeInternalHelper(bool periodic) {
   should_purge_.store(false, std::memory_order_relaxed);
+  should_purge_periodically_.store(false, std::memory_order_relaxed);
+
+  const bool adaptive =
+      periodic && ThreadCacheRegistry::Instance().adaptive_limits_enabled();
+  if (adaptive) {
+    ReconcileAdaptiveMemory();
+  }
+
   // TODO(lizeb): Investigate whether lock acquisition should be less
   // frequent.
   //
@@ -817,9 +918,113 @@ void ThreadCache::PurgeInternalHelper() {
   // |largest_active_bucket_index_| can be lowered at runtime, there may be
   // memory already cached in the inactive buckets. They should still be
   // purged.
-  for (auto& bucket : buckets_) {
-    ClearBucketHelper<crash_on_corruption>(bucket, 0);
+  for (size_t index = 0; index < kBucketCount; index++) {
+    Bucket& bucket = buckets_[index];
+    size_t working_set = adaptive ? AdaptBucketAndGetWorkingSet(index) : 0;
+    if (bucket.count > working_set) {
+      adaptive_stats_[index].purged_slots = bucket.count - working_set;
+    } else {
+      adaptive_stats_[index].purged_slots = 0;
+    }
+    ClearBucketHelper<crash_on_corruption>(bucket, working_set);
+  }
+}
+
+void ThreadCache::ReconcileAdaptiveMemory() {
+  // Limits may have been reset to the global ones from another thread (see
+  // |ThreadCacheRegistry::SetThreadCacheMultiplier()|) since we last looked,
+  // in which case part of our share of the budget is no longer used.
+  size_t used = 0;
+  for (size_t index = 0; index < kBucketCount; index++) {
+    size_t limit = buckets_[index].limit.load(std::memory_order_relaxed);
+    if (limit > global_limits_[index]) {
+      used += (limit - global_limits_[index]) * buckets_[index].slot_size;
+    }
+  }
+
+  if (used < adaptive_memory_bytes_) {
+    ThreadCacheRegistry::Instance().ReleaseAdaptiveMemory(
+        adaptive_memory_bytes_ - used);
+    adaptive_memory_bytes_ = used;
+  }
+}
+
+size_t ThreadCache::AdaptBucketAndGetWorkingSet(size_t index) {
+  Bucket& bucket = buckets_[index];
+  AdaptiveBucketStats& adaptive_stats = adaptive_stats_[index];
+  const size_t global_limit = global_limits_[index];
+  const size_t limit = bucket.limit.load(std::memory_order_relaxed);
+  const uint32_t misses = adaptive_stats.misses;
+  const uint32_t overflows = adaptive_stats.overflows;
+  adaptive_stats.hits = 0;
+  adaptive_stats.misses = 0;
+  adaptive_stats.overflows = 0;
+
+  // Invalid or inactive bucket.
+  if (!global_limit || index > largest_active_bucket_index_) {
+    return 0;
+  }
+
+  // |PutInBucket()| is called on a full bucket, which should not overflow.
+  constexpr size_t kMaxLimit = std::numeric_limits<uint8_t>::max() - 1;
+  const size_t min_limit =
+      std::max<size_t>(1, global_limit / kAdaptiveMaxShrinkFactor);
+  size_t new_limit = limit;
+  if (misses + overflows >= kAdaptiveGrowThreshold) {
+    // Thrashing against the central allocator: cache more, and when running
+    // empty, fill larger batches.
+    adaptive_stats.quiet_intervals = 0;
+    new_limit = std::min(2 * limit, kMaxLimit);
+    if (misses >= kAdaptiveGrowThreshold) {
+      adaptive_stats.batch_fill_ratio =
+          std::max<uint8_t>(kAdaptiveMinBatchFillRatio,
+                            adaptive_stats.batch_fill_ratio / 2);
+    }
+  } else if (!misses && !overflows) {
+    // Either idle, or served from the cache without ever reaching its limits.
+    // Both ways, the limit is too large.
+    if (++adaptive_stats.quiet_intervals >= kAdaptiveShrinkAfterIntervals) {
+      adaptive_stats.quiet_intervals = 0;
+      new_limit = std::max(limit / 2, min_limit);
+      adaptive_stats.batch_fill_ratio = kBatchFillRatio;
+    }
+  } else {
+    adaptive_stats.quiet_intervals = 0;
+  }
+
+  // Only memory above the global limit counts against the budget.
+  const size_t slot_size = bucket.slot_size;
+  const size_t extra_before =
+      limit > global_limit ? (limit - global_limit) * slot_size : 0;
+  const size_t extra_after =
+      new_limit > global_limit ? (new_limit - global_limit) * slot_size : 0;
+  auto& registry = ThreadCacheRegistry::Instance();
+  if (extra_after > extra_before) {
+    if (registry.TryReserveAdaptiveMemory(extra_after - extra_before)) {
+      adaptive_memory_bytes_ += extra_after - extra_before;
+    } else {
+      new_limit = std::max(limit, global_limit);
+    }
+  } else if (extra_after < extra_before) {
+    registry.ReleaseAdaptiveMemory(extra_before - extra_after);
+    adaptive_memory_bytes_ -= extra_before - extra_after;
+  }
+
+  if (new_limit > limit) {
+    stats_.adaptive_limit_increases++;
+  } else if (new_limit < limit) {
+    stats_.adaptive_limit_decreases++;
+  }
+  bucket.limit.store(static_cast<uint8_t>(new_limit),
+                     std::memory_order_relaxed);
+
+  // The working set of a bucket which has been active in the last interval is
+  // a batch: enough to serve the next allocations without going back to the
+  // central allocator right away. Quiet buckets are emptied.
+  if (misses || overflows) {
+    return std::max<size_t>(1, new_limit / adaptive_stats.batch_fill_ratio);
   }
+  return 0;
 }
 
 }  // namespace partition_alloc
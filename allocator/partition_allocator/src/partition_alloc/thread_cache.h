@@ -142,6 +142,26 @@ class PA_COMPONENT_EXPORT(PARTITION_ALLOC) ThreadCacheRegistry {
   void SetThreadCacheMultiplier(float multiplier);
   void SetLargestActiveBucketIndex(uint8_t largest_active_bucket_index);
 
+  // Controls adaptive per-bucket limits. When enabled, each thread cache
+  // records how often its buckets run empty or overflow between two periodic
+  // purges, and tunes its own limits and batch fill sizes from that. Growth
+  // beyond the global limits (set by |SetThreadCacheMultiplier()|) is capped
+  // at |memory_budget_bytes| summed across all threads. Periodic purges then
+  // keep the learned working set of active buckets rather than emptying them.
+  //
+  // Disabling resets all thread caches to the global limits.
+  void SetAdaptiveLimitsConfiguration(bool enabled, size_t memory_budget_bytes);
+  bool adaptive_limits_enabled() const {
+    return adaptive_limits_enabled_.load(std::memory_order_relaxed);
+  }
+  size_t adaptive_memory_budget_bytes() const {
+    return adaptive_memory_budget_bytes_.load(std::memory_order_relaxed);
+  }
+  // Memory currently granted to thread caches above the global limits.
+  size_t adaptive_memory_used_bytes() const {
+    return adaptive_memory_used_bytes_.load(std::memory_order_relaxed);
+  }
+
   // Controls the thread cache purging configuration.
   void SetPurgingConfiguration(
       const internal::base::TimeDelta min_purge_interval,
@@ -172,6 +192,14 @@ class PA_COMPONENT_EXPORT(PARTITION_ALLOC) ThreadCacheRegistry {
  private:
   friend class tools::ThreadCacheInspector;
   friend class tools::HeapDumper;
+  friend class ThreadCache;
+
+  void PurgeAllInternal(bool periodic);
+
+  // Takes |bytes| from the adaptive memory budget. Returns false if this would
+  // exceed it, in which case nothing is taken.
+  bool TryReserveAdaptiveMemory(size_t bytes);
+  void ReleaseAdaptiveMemory(size_t bytes);
 
   // Not using base::Lock as the object's constructor must be constexpr.
   internal::Lock lock_;
@@ -184,6 +212,10 @@ class PA_COMPONENT_EXPORT(PARTITION_ALLOC) ThreadCacheRegistry {
   internal::base::TimeDelta periodic_purge_next_interval_;
   bool is_purging_configured_ = false;
 
+  std::atomic<bool> adaptive_limits_enabled_{false};
+  std::atomic<size_t> adaptive_memory_budget_bytes_{0};
+  std::atomic<size_t> adaptive_memory_used_bytes_{0};
+
   uint8_t largest_active_bucket_index_ = internal::BucketIndexLookup::GetIndex(
       ThreadCacheLimits::kDefaultSizeThreshold);
 };
@@ -249,6 +281,26 @@ class PA_COMPONENT_EXPORT(PARTITION_ALLOC) ThreadCache {
     Bucket();
   };
 
+  // Per-bucket data used by the adaptive limits policy, see
+  // |ThreadCacheRegistry::SetAdaptiveLimitsConfiguration()|. Only touched on
+  // slow paths, and by the owning thread. Event counts are reset at each
+  // periodic purge.
+  struct AdaptiveBucketStats {
+    // Allocations served from the bucket. Only recorded with
+    // PA_CONFIG(THREAD_CACHE_ENABLE_STATISTICS), not used by the policy.
+    uint32_t hits = 0;
+    // Bucket was empty on allocation, and filled from the central allocator.
+    uint32_t misses = 0;
+    // Bucket was full on deallocation, and partially cleared.
+    uint32_t overflows = 0;
+    // Slots released by the last periodic purge.
+    uint32_t purged_slots = 0;
+    // Consecutive purge intervals without misses or overflows.
+    uint8_t quiet_intervals = 0;
+    // Fill 1 / batch_fill_ratio * bucket.limit slots at a time.
+    uint8_t batch_fill_ratio = kBatchFillRatio;
+  };
+
   // Initializes the thread cache for |root|. May allocate, so should be called
   // with the thread cache disabled on the partition side, and without the
   // partition lock held.
@@ -324,10 +376,19 @@ class PA_COMPONENT_EXPORT(PARTITION_ALLOC) ThreadCache {
   // Asks this cache to trigger |Purge()| at a later point. Can be called from
   // any thread.
   void SetShouldPurge();
+  // Same as |SetShouldPurge()|, for a periodic purge: with adaptive limits,
+  // this one keeps the learned working set. Does not downgrade a pending full
+  // purge.
+  void SetShouldPurgePeriodically();
   // Empties the cache.
   // The Partition lock must *not* be held when calling this.
   // Must be called from the thread this cache is for.
   void Purge();
+  // Periodic flavor of |Purge()|. With adaptive limits enabled, first adapts
+  // the bucket limits, then only releases memory beyond the working set of
+  // buckets that were active since the last periodic purge. Otherwise the
+  // same as |Purge()|.
+  void PeriodicPurge();
   // |TryPurge| is the same as |Purge|, except that |TryPurge| will
   // not crash if the thread cache is inconsistent. Normally inconsistency
   // is a sign of a bug somewhere, so |Purge| should be preferred in most cases.
@@ -367,6 +428,17 @@ class PA_COMPONENT_EXPORT(PARTITION_ALLOC) ThreadCache {
   // Fill 1 / kBatchFillRatio * bucket.limit slots at a time.
   static constexpr uint16_t kBatchFillRatio = 8;
 
+  // Adaptive limits policy. A bucket which misses or overflows at least
+  // |kAdaptiveGrowThreshold| times during a purge interval gets its limit
+  // doubled, and larger batch fills if it misses, down to
+  // |kAdaptiveMinBatchFillRatio|. One which has been quiet for
+  // |kAdaptiveShrinkAfterIntervals| intervals gets its limit halved, down to
+  // 1 / |kAdaptiveMaxShrinkFactor| of the global limit.
+  static constexpr uint32_t kAdaptiveGrowThreshold = 16;
+  static constexpr uint8_t kAdaptiveShrinkAfterIntervals = 4;
+  static constexpr uint8_t kAdaptiveMaxShrinkFactor = 4;
+  static constexpr uint8_t kAdaptiveMinBatchFillRatio = 2;
+
   // Limit for the smallest bucket will be kDefaultMultiplier *
   // kSmallBucketBaseCount by default.
   static constexpr float kDefaultMultiplier = 2.;
@@ -395,6 +467,9 @@ class PA_COMPONENT_EXPORT(PARTITION_ALLOC) ThreadCache {
   ThreadCacheStats& stats_for_testing() { return stats_; }
 
   Bucket& bucket_for_testing(size_t index) { return buckets_[index]; }
+  const AdaptiveBucketStats& adaptive_stats_for_testing(size_t index) const {
+    return adaptive_stats_[index];
+  }
   void ClearBucketForTesting(Bucket& bucket, size_t limit) {
     ClearBucket(bucket, limit);
   }
@@ -410,7 +485,13 @@ class PA_COMPONENT_EXPORT(PARTITION_ALLOC) ThreadCache {
 
   void PurgeInternal();
   template <bool crash_on_corruption>
-  void PurgeInternalHelper();
+  void PurgeInternalHelper(bool periodic);
+  // Adapts the limit of bucket |index| to the events recorded since the last
+  // periodic purge, and returns how many slots it should keep cached.
+  size_t AdaptBucketAndGetWorkingSet(size_t index);
+  // Recomputes the memory cached above the global limits by this thread, and
+  // gives back to the registry what it no longer uses.
+  void ReconcileAdaptiveMemory();
 
   // Fills a bucket from the central allocator.
   void FillBucket(size_t bucket_index);
@@ -449,6 +530,8 @@ class PA_COMPONENT_EXPORT(PARTITION_ALLOC) ThreadCache {
   // These are at the beginning as they're accessed for each allocation.
   uint32_t cached_memory_ = 0;
   std::atomic<bool> should_purge_;
+  // Whether the pending purge, if any, is a periodic one.
+  std::atomic<bool> should_purge_periodically_;
   ThreadCacheStats stats_;
   ThreadAllocStats thread_alloc_stats_;
 
@@ -456,6 +539,11 @@ class PA_COMPONENT_EXPORT(PARTITION_ALLOC) ThreadCache {
   Bucket buckets_[kBucketCount];
 
   // Cold data below.
+  AdaptiveBucketStats adaptive_stats_[kBucketCount];
+  // Memory that the adaptive policy allows this thread to cache above the
+  // global limits, accounted in the registry.
+  size_t adaptive_memory_bytes_ = 0;
+
   PartitionRoot* const root_;
 
   const internal::base::PlatformThreadId thread_id_;
@@ -499,6 +587,7 @@ PA_ALWAYS_INLINE bool ThreadCache::MaybePutInCache(uintptr_t slot_start,
   uint8_t limit = bucket.limit.load(std::memory_order_relaxed);
   // Batched deallocation, amortizing lock acquisitions.
   if (PA_UNLIKELY(bucket.count > limit)) {
+    adaptive_stats_[bucket_index].overflows++;
     ClearBucket(bucket, limit / 2);
   }
 
@@ -528,6 +617,7 @@ PA_ALWAYS_INLINE uintptr_t ThreadCache::GetFromCache(size_t bucket_index,
   auto& bucket = buckets_[bucket_index];
   if (PA_LIKELY(bucket.freelist_head)) {
     PA_INCREMENT_COUNTER(stats_.alloc_hits);
+    PA_INCREMENT_COUNTER(adaptive_stats_[bucket_index].hits);
   } else {
     PA_DCHECK(bucket.count == 0);
     PA_INCREMENT_COUNTER(stats_.alloc_miss_empty);
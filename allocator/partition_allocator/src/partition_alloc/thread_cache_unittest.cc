@@ -1103,6 +1103,123 @@ TEST_P(PartitionAllocThreadCacheTest,
   internal::base::PlatformThreadForTesting::Join(thread_handle);
 }
 
+TEST_P(PartitionAllocThreadCacheTest, AdaptiveLimitsGrowWhenThrashing) {
+  auto& registry = ThreadCacheRegistry::Instance();
+  registry.SetAdaptiveLimitsConfiguration(true, 10 * 1024 * 1024);
+  auto* tcache = root()->thread_cache_for_testing();
+  size_t bucket_index = SizeToIndex(kMediumSize);
+  size_t global_limit =
+      tcache->bucket_for_testing(bucket_index).limit.load(
+          std::memory_order_relaxed);
+  EXPECT_EQ(kDefaultCountForMediumBucket, global_limit);
+
+  // Bursts larger than the limit miss on allocation and overflow on free.
+  FillThreadCacheAndReturnIndex(kMediumSize, 4 * global_limit);
+  EXPECT_GE(tcache->adaptive_stats_for_testing(bucket_index).misses +
+                tcache->adaptive_stats_for_testing(bucket_index).overflows,
+            ThreadCache::kAdaptiveGrowThreshold);
+
+  registry.RunPeriodicPurge();
+  EXPECT_EQ(2 * global_limit, tcache->bucket_for_testing(bucket_index).limit);
+  EXPECT_EQ(ThreadCache::kBatchFillRatio / 2,
+            tcache->adaptive_stats_for_testing(bucket_index).batch_fill_ratio);
+  EXPECT_GE(registry.adaptive_memory_used_bytes(),
+            global_limit * tcache->bucket_for_testing(bucket_index).slot_size);
+  EXPECT_EQ(0u, tcache->adaptive_stats_for_testing(bucket_index).misses);
+  EXPECT_EQ(0u, tcache->adaptive_stats_for_testing(bucket_index).overflows);
+  // The working set of the bucket is kept.
+  EXPECT_EQ(2 * global_limit / (ThreadCache::kBatchFillRatio / 2),
+            tcache->bucket_count_for_testing(bucket_index));
+
+  // A full purge still empties the bucket.
+  tcache->Purge();
+  EXPECT_EQ(0u, tcache->bucket_count_for_testing(bucket_index));
+
+  registry.SetAdaptiveLimitsConfiguration(false, 0);
+  EXPECT_EQ(global_limit, tcache->bucket_for_testing(bucket_index).limit);
+}
+
+TEST_P(PartitionAllocThreadCacheTest, AdaptiveLimitsRespectMemoryBudget) {
+  auto& registry = ThreadCacheRegistry::Instance();
+  registry.SetAdaptiveLimitsConfiguration(true, 0);
+  auto* tcache = root()->thread_cache_for_testing();
+  size_t bucket_index = SizeToIndex(kMediumSize);
+
+  FillThreadCacheAndReturnIndex(kMediumSize,
+                                4 * kDefaultCountForMediumBucket);
+  registry.RunPeriodicPurge();
+  EXPECT_EQ(kDefaultCountForMediumBucket,
+            tcache->bucket_for_testing(bucket_index).limit);
+  EXPECT_EQ(0u, registry.adaptive_memory_used_bytes());
+  // Batch fills still get larger, this is bounded by the limit.
+  EXPECT_EQ(ThreadCache::kBatchFillRatio / 2,
+            tcache->adaptive_stats_for_testing(bucket_index).batch_fill_ratio);
+
+  registry.SetAdaptiveLimitsConfiguration(false, 0);
+}
+
+TEST_P(PartitionAllocThreadCacheTest, AdaptiveLimitsShrinkWhenQuiet) {
+  auto& registry = ThreadCacheRegistry::Instance();
+  registry.SetAdaptiveLimitsConfiguration(true, 10 * 1024 * 1024);
+  auto* tcache = root()->thread_cache_for_testing();
+  size_t bucket_index = FillThreadCacheAndReturnIndex(kMediumSize);
+  EXPECT_GT(tcache->bucket_count_for_testing(bucket_index), 0u);
+
+  // One miss in the first interval, not enough to grow, but the bucket is
+  // active, so it is not emptied.
+  registry.RunPeriodicPurge();
+  EXPECT_EQ(kDefaultCountForMediumBucket,
+            tcache->bucket_for_testing(bucket_index).limit);
+  EXPECT_EQ(kFillCountForMediumBucket,
+            tcache->bucket_count_for_testing(bucket_index));
+
+  // Quiet intervals.
+  for (size_t i = 0; i < ThreadCache::kAdaptiveShrinkAfterIntervals - 1; i++) {
+    registry.RunPeriodicPurge();
+    EXPECT_EQ(0u, tcache->bucket_count_for_testing(bucket_index));
+    EXPECT_EQ(kDefaultCountForMediumBucket,
+              tcache->bucket_for_testing(bucket_index).limit);
+  }
+  registry.RunPeriodicPurge();
+  EXPECT_EQ(kDefaultCountForMediumBucket / 2,
+            tcache->bucket_for_testing(bucket_index).limit);
+
+  // Never below a fraction of the global limit.
+  for (size_t i = 0; i < 10 * ThreadCache::kAdaptiveShrinkAfterIntervals;
+       i++) {
+    registry.RunPeriodicPurge();
+  }
+  EXPECT_EQ(
+      kDefaultCountForMediumBucket / ThreadCache::kAdaptiveMaxShrinkFactor,
+      tcache->bucket_for_testing(bucket_index).limit);
+  EXPECT_EQ(0u, registry.adaptive_memory_used_bytes());
+
+  registry.SetAdaptiveLimitsConfiguration(false, 0);
+  EXPECT_EQ(kDefaultCountForMediumBucket,
+            tcache->bucket_for_testing(bucket_index).limit);
+}
+
+TEST_P(PartitionAllocThreadCacheTest, AdaptiveLimitsMultiplierReleasesBudget) {
+  auto& registry = ThreadCacheRegistry::Instance();
+  registry.SetAdaptiveLimitsConfiguration(true, 10 * 1024 * 1024);
+  auto* tcache = root()->thread_cache_for_testing();
+
+  FillThreadCacheAndReturnIndex(kMediumSize,
+                                4 * kDefaultCountForMediumBucket);
+  registry.RunPeriodicPurge();
+  EXPECT_GT(registry.adaptive_memory_used_bytes(), 0u);
+
+  // Resets the limits, the thread gives back its share of the budget at the
+  // next periodic purge.
+  registry.SetThreadCacheMultiplier(ThreadCache::kDefaultMultiplier);
+  registry.RunPeriodicPurge();
+  EXPECT_EQ(0u, registry.adaptive_memory_used_bytes());
+  EXPECT_EQ(kDefaultCountForMediumBucket,
+            tcache->bucket_for_testing(SizeToIndex(kMediumSize)).limit);
+
+  registry.SetAdaptiveLimitsConfiguration(false, 0);
+}
+
 TEST_P(PartitionAllocThreadCacheTest, DynamicSizeThreshold) {
   auto* tcache = root()->thread_cache_for_testing();
   DeltaCounter alloc_miss_counter{tcache->stats_for_testing().alloc_misses};
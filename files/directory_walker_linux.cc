@@ -0,0 +1,287 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/directory_walker_linux.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/stat.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "base/check.h"
+#include "base/files/dir_reader_linux.h"
+#include "base/files/file.h"
+#include "base/functional/bind.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/synchronization/lock.h"
+#include "base/task/post_job.h"
+#include "base/task/task_traits.h"
+#include "base/thread_annotations.h"
+#include "base/threading/scoped_blocking_call.h"
+#include "build/build_config.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+namespace base {
+
+namespace {
+
+// Large enough for a few hundred entries per getdents64() call.
+constexpr size_t kDirectoryBufferSize = 32 * 1024;
+
+// statx() is only used on Linux and ChromeOS: on Android before API 30, the
+// seccomp filter of apps kills the process on syscalls it doesn't allow,
+// rather than failing them.
+#if (BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS)) && defined(__NR_statx)
+#define USE_STATX 1
+#endif
+
+#if defined(USE_STATX)
+// Set once statx() failed with ENOSYS, on kernels older than 4.11, or EPERM,
+// in sandboxes which don't allow it.
+std::atomic<bool> g_statx_unavailable{false};
+#endif
+
+bool IsDotOrDotDot(const char* name) {
+  return name[0] == '.' &&
+         (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+class DirectoryTreeWalker {
+ public:
+  DirectoryTreeWalker(const DirectoryTreeWalkOptions& options,
+                      FunctionRef<void(const DirectoryTreeEntry&)> callback)
+      : options_(options), callback_(callback) {}
+
+  DirectoryTreeWalker(const DirectoryTreeWalker&) = delete;
+  DirectoryTreeWalker& operator=(const DirectoryTreeWalker&) = delete;
+
+  void Run(const FilePath& root_path) {
+    if (options_.follow_symlinks) {
+      stat_wrapper_t st;
+      if (File::Stat(root_path.value().c_str(), &st) == 0) {
+        visited_directories_.insert(st.st_ino);
+      }
+    }
+    pending_directories_.push_back(root_path.StripTrailingSeparators());
+
+    if (options_.max_concurrency <= 1) {
+      ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                              BlockingType::MAY_BLOCK);
+      while (absl::optional<FilePath> directory = PopDirectory()) {
+        WalkDirectory(*directory);
+      }
+      return;
+    }
+
+    // Join() raises the priority of the job to that of the calling thread.
+    JobHandle job_handle = PostJob(
+        FROM_HERE, {TaskPriority::BEST_EFFORT, MayBlock()},
+        BindRepeating(&DirectoryTreeWalker::WorkerTask, Unretained(this)),
+        BindRepeating(&DirectoryTreeWalker::GetMaxConcurrency,
+                      Unretained(this)));
+    job_handle.Join();
+  }
+
+ private:
+  void WorkerTask(JobDelegate* delegate) {
+    ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+    while (!delegate->ShouldYield()) {
+      absl::optional<FilePath> directory = PopDirectory();
+      if (!directory) {
+        return;
+      }
+      if (WalkDirectory(*directory)) {
+        delegate->NotifyConcurrencyIncrease();
+      }
+    }
+  }
+
+  size_t GetMaxConcurrency(size_t worker_count) const {
+    AutoLock lock(lock_);
+    return std::min(options_.max_concurrency,
+                    pending_directories_.size() + worker_count);
+  }
+
+  absl::optional<FilePath> PopDirectory() {
+    AutoLock lock(lock_);
+    if (pending_directories_.empty()) {
+      return absl::nullopt;
+    }
+    FilePath directory = std::move(pending_directories_.back());
+    pending_directories_.pop_back();
+    return directory;
+  }
+
+  // Reports the entries of |directory|, and queues its subdirectories. Returns
+  // whether any subdirectory was queued.
+  bool WalkDirectory(const FilePath& directory) {
+    internal::DirectoryEntryReader reader(directory);
+    if (!reader.IsValid()) {
+      return false;
+    }
+
+    std::vector<std::pair<FilePath, uint64_t>> subdirectories;
+    internal::DirectoryEntryReader::Entry entry;
+    while (reader.Next(&entry)) {
+      if (IsDotOrDotDot(entry.name)) {
+        continue;
+      }
+      DirectoryTreeEntry tree_entry;
+      tree_entry.path = directory.Append(entry.name);
+      uint64_t inode = entry.inode;
+      if (options_.read_metadata || entry.type == DT_UNKNOWN ||
+          (entry.type == DT_LNK && options_.follow_symlinks)) {
+        internal::DirectoryEntryStat stat;
+        // Like FileEnumerator, report entries which can't be stat'ed as files
+        // without metadata.
+        if (internal::StatDirectoryEntry(reader.fd(), entry.name,
+                                         options_.follow_symlinks,
+                                         options_.read_metadata, &stat)) {
+          tree_entry.is_directory = S_ISDIR(stat.mode);
+          tree_entry.size = stat.size;
+          tree_entry.last_modified = stat.last_modified;
+          inode = stat.inode;
+        }
+      } else {
+        tree_entry.is_directory = entry.type == DT_DIR;
+      }
+      callback_(tree_entry);
+      if (tree_entry.is_directory) {
+        subdirectories.emplace_back(std::move(tree_entry.path), inode);
+      }
+    }
+    if (subdirectories.empty()) {
+      return false;
+    }
+
+    AutoLock lock(lock_);
+    for (auto& [path, inode] : subdirectories) {
+      if (!options_.follow_symlinks ||
+          visited_directories_.insert(inode).second) {
+        pending_directories_.push_back(std::move(path));
+      }
+    }
+    return true;
+  }
+
+  const DirectoryTreeWalkOptions options_;
+  const FunctionRef<void(const DirectoryTreeEntry&)> callback_;
+
+  mutable Lock lock_;
+  // Directories left to read. Taking the most recently found ones first keeps
+  // this short.
+  std::vector<FilePath> pending_directories_ GUARDED_BY(lock_);
+  // Inodes of the directories found so far, when following symlinks.
+  std::unordered_set<uint64_t> visited_directories_ GUARDED_BY(lock_);
+};
+
+}  // namespace
+
+void WalkDirectoryTree(const FilePath& root_path,
+                       const DirectoryTreeWalkOptions& options,
+                       FunctionRef<void(const DirectoryTreeEntry&)> callback) {
+  DirectoryTreeWalker(options, callback).Run(root_path);
+}
+
+namespace internal {
+
+DirectoryEntryReader::DirectoryEntryReader(const FilePath& path)
+    : fd_(HANDLE_EINTR(
+          open(path.value().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC))) {
+  if (!fd_.is_valid()) {
+    error_ = errno;
+  }
+}
+
+DirectoryEntryReader::~DirectoryEntryReader() = default;
+
+bool DirectoryEntryReader::Next(Entry* entry) {
+  if (offset_ == size_) {
+    if (!fd_.is_valid()) {
+      return false;
+    }
+    if (!buffer_) {
+      buffer_ = std::make_unique<char[]>(kDirectoryBufferSize);
+    }
+    const long result = syscall(__NR_getdents64, fd_.get(), buffer_.get(),
+                                kDirectoryBufferSize);
+    if (result <= 0) {
+      if (result < 0) {
+        error_ = errno;
+      }
+      // Release the directory as soon as it has been read.
+      fd_.reset();
+      return false;
+    }
+    size_ = static_cast<size_t>(result);
+    offset_ = 0;
+  }
+  const linux_dirent* dirent =
+      reinterpret_cast<const linux_dirent*>(buffer_.get() + offset_);
+  offset_ += dirent->d_reclen;
+  entry->name = dirent->d_name;
+  entry->inode = dirent->d_ino;
+  entry->type = dirent->d_type;
+  return true;
+}
+
+bool StatDirectoryEntry(int dir_fd,
+                        const char* name,
+                        bool follow_symlinks,
+                        bool read_metadata,
+                        DirectoryEntryStat* stat) {
+  const int flags = follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW;
+#if defined(USE_STATX)
+  if (!g_statx_unavailable.load(std::memory_order_relaxed)) {
+    // Only ask for what is needed, which saves work on some file systems
+    // (e.g. network ones, which may not have to query the server).
+    unsigned int mask = STATX_TYPE | STATX_INO;
+    if (read_metadata) {
+      mask |= STATX_SIZE | STATX_MTIME;
+    }
+    struct statx stx;
+    if (syscall(__NR_statx, dir_fd, name, flags, mask, &stx) == 0) {
+      stat->mode = stx.stx_mode;
+      stat->inode = stx.stx_ino;
+      if (read_metadata) {
+        stat->size = static_cast<int64_t>(stx.stx_size);
+        stat->last_modified = Time::FromTimeSpec(
+            {static_cast<time_t>(stx.stx_mtime.tv_sec),
+             static_cast<long>(stx.stx_mtime.tv_nsec)});
+      }
+      return true;
+    }
+    if (errno != ENOSYS && errno != EPERM) {
+      return false;
+    }
+    g_statx_unavailable.store(true, std::memory_order_relaxed);
+  }
+#endif  // defined(USE_STATX)
+
+  stat_wrapper_t st;
+  if (fstatat(dir_fd, name, &st, flags) != 0) {
+    return false;
+  }
+  stat->mode = st.st_mode;
+  stat->inode = st.st_ino;
+  if (read_metadata) {
+    stat->size = st.st_size;
+    stat->last_modified = Time::FromTimeSpec(st.st_mtim);
+  }
+  return true;
+}
+
+}  // namespace internal
+
+}  // namespace base
@@ -0,0 +1,122 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_DIRECTORY_WALKER_LINUX_H_
+#define BASE_FILES_DIRECTORY_WALKER_LINUX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <memory>
+
+#include "base/base_export.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_file.h"
+#include "base/functional/function_ref.h"
+#include "base/time/time.h"
+
+namespace base {
+
+// An entry found by WalkDirectoryTree().
+struct BASE_EXPORT DirectoryTreeEntry {
+  // Path of the entry, which starts with the root path of the walk.
+  FilePath path;
+  bool is_directory = false;
+  // Only set with |DirectoryTreeWalkOptions::read_metadata|.
+  int64_t size = 0;
+  Time last_modified;
+};
+
+struct BASE_EXPORT DirectoryTreeWalkOptions {
+  // Whether to read the size and last modification time of entries, which
+  // takes a statx() call per entry. Otherwise, only the type of entries is
+  // read, which the directory listing usually provides.
+  bool read_metadata = false;
+  // Whether symlinks are reported, and traversed, as their target, like with
+  // a FileEnumerator without SHOW_SYM_LINKS. Each directory is then traversed
+  // once, which breaks symlink loops.
+  bool follow_symlinks = true;
+  // Maximum number of threads reading directories. Above one, directories are
+  // read in parallel from a job (see PostJob()), which requires a
+  // ThreadPoolInstance.
+  size_t max_concurrency = 1;
+};
+
+// Calls |callback| for each entry under |root_path|, recursively, in no
+// particular order, and returns once all of them were reported. With
+// |options.max_concurrency| above one, |callback| is called concurrently from
+// several threads. Directories which can't be read are skipped.
+//
+// This is what a recursive FileEnumerator does, without its iterator
+// interface: directories are read with getdents64() in large batches, and
+// entries are only stat'ed when their type is unknown, or when their metadata
+// is wanted, with statx() reading only the needed fields.
+BASE_EXPORT void WalkDirectoryTree(
+    const FilePath& root_path,
+    const DirectoryTreeWalkOptions& options,
+    FunctionRef<void(const DirectoryTreeEntry&)> callback);
+
+namespace internal {
+
+// Reads the entries of a directory with getdents64(), many at a time.
+class BASE_EXPORT DirectoryEntryReader {
+ public:
+  struct Entry {
+    // Points to the reader's buffer, until the next call to Next().
+    const char* name;
+    uint64_t inode;
+    // One of the DT_* values, which is DT_UNKNOWN on file systems which don't
+    // provide it.
+    unsigned char type;
+  };
+
+  explicit DirectoryEntryReader(const FilePath& path);
+  DirectoryEntryReader(const DirectoryEntryReader&) = delete;
+  DirectoryEntryReader& operator=(const DirectoryEntryReader&) = delete;
+  ~DirectoryEntryReader();
+
+  // Returns false if the directory couldn't be opened, in which case error()
+  // tells why.
+  bool IsValid() const { return fd_.is_valid(); }
+  int fd() const { return fd_.get(); }
+
+  // Reads the next entry into |entry|. Returns false at the end of the
+  // directory, or on error, in which case error() tells why.
+  bool Next(Entry* entry);
+
+  // The errno value of the last failure, or zero.
+  int error() const { return error_; }
+
+ private:
+  ScopedFD fd_;
+  std::unique_ptr<char[]> buffer_;
+  size_t offset_ = 0;
+  size_t size_ = 0;
+  int error_ = 0;
+};
+
+struct DirectoryEntryStat {
+  mode_t mode = 0;
+  uint64_t inode = 0;
+  // Only set when metadata is read.
+  int64_t size = 0;
+  Time last_modified;
+};
+
+// Stats |name| in the directory |dir_fd|, reading only its type and inode, and
+// its size and last modification time if |read_metadata| is true. Uses
+// statx(), or fstatat() where it isn't available. Returns false on failure,
+// with errno set.
+BASE_EXPORT bool StatDirectoryEntry(int dir_fd,
+                                    const char* name,
+                                    bool follow_symlinks,
+                                    bool read_metadata,
+                                    DirectoryEntryStat* stat);
+
+}  // namespace internal
+
+}  // namespace base
+
+#endif  // BASE_FILES_DIRECTORY_WALKER_LINUX_H_
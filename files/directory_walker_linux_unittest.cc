@@ -0,0 +1,248 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/directory_walker_linux.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_file.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/lock.h"
+#include "base/test/task_environment.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+class DirectoryWalkerTest : public testing::Test {
+ protected:
+  void SetUp() override { ASSERT_TRUE(temp_dir_.CreateUniqueTempDir()); }
+
+  const FilePath& root() const { return temp_dir_.GetPath(); }
+
+  // Creates |file_count| files of increasing sizes in each of |directories|
+  // under root(), and returns the sum of their sizes.
+  int64_t CreateTree(const std::vector<FilePath>& directories,
+                     int file_count) {
+    int64_t total_size = 0;
+    for (const FilePath& directory : directories) {
+      const FilePath path = root().Append(directory);
+      EXPECT_TRUE(CreateDirectory(path));
+      for (int i = 0; i < file_count; ++i) {
+        const std::string contents(static_cast<size_t>(i), 'a');
+        EXPECT_TRUE(
+            WriteFile(path.AppendASCII("file" + NumberToString(i)), contents));
+        total_size += i;
+      }
+    }
+    return total_size;
+  }
+
+  // Returns the paths WalkDirectoryTree() reports, with a "/" appended to
+  // directories.
+  std::set<FilePath::StringType> Walk(const DirectoryTreeWalkOptions& options) {
+    Lock lock;
+    std::set<FilePath::StringType> paths;
+    WalkDirectoryTree(root(), options, [&](const DirectoryTreeEntry& entry) {
+      AutoLock auto_lock(lock);
+      EXPECT_TRUE(
+          paths.insert(entry.path.value() + (entry.is_directory ? "/" : ""))
+              .second)
+          << "Got " << entry.path << " twice";
+    });
+    return paths;
+  }
+
+  // Returns the paths a recursive FileEnumerator reports, in the format of
+  // Walk().
+  std::set<FilePath::StringType> Enumerate(int file_type) {
+    std::set<FilePath::StringType> paths;
+    FileEnumerator enumerator(root(), /*recursive=*/true, file_type);
+    for (FilePath path = enumerator.Next(); !path.empty();
+         path = enumerator.Next()) {
+      paths.insert(path.value() +
+                   (enumerator.GetInfo().IsDirectory() ? "/" : ""));
+    }
+    return paths;
+  }
+
+  ScopedTempDir temp_dir_;
+};
+
+}  // namespace
+
+TEST_F(DirectoryWalkerTest, MatchesFileEnumerator) {
+  CreateTree({FilePath("a"), FilePath("a/b"), FilePath("a/b/c"), FilePath("d")},
+             10);
+  ASSERT_TRUE(CreateSymbolicLink(root().Append("a/b"), root().Append("link")));
+
+  const std::set<FilePath::StringType> paths =
+      Walk(DirectoryTreeWalkOptions());
+  // 4 directories with 10 files each, and the link.
+  EXPECT_EQ(45u, paths.size());
+  // The link is followed, but the directory it points to is only traversed
+  // once.
+  EXPECT_EQ(1u, paths.count(root().Append("link").value() + "/"));
+  EXPECT_EQ(paths, Enumerate(FileEnumerator::FILES |
+                             FileEnumerator::DIRECTORIES));
+}
+
+TEST_F(DirectoryWalkerTest, DoesNotFollowSymlinks) {
+  CreateTree({FilePath("a")}, 1);
+  ASSERT_TRUE(CreateSymbolicLink(root().Append("a"), root().Append("link")));
+
+  DirectoryTreeWalkOptions options;
+  options.follow_symlinks = false;
+  const std::set<FilePath::StringType> paths = Walk(options);
+  EXPECT_EQ((std::set<FilePath::StringType>{root().Append("a").value() + "/",
+                                            root().Append("a/file0").value(),
+                                            root().Append("link").value()}),
+            paths);
+  EXPECT_EQ(paths, Enumerate(FileEnumerator::FILES |
+                             FileEnumerator::DIRECTORIES |
+                             FileEnumerator::SHOW_SYM_LINKS));
+}
+
+TEST_F(DirectoryWalkerTest, BreaksSymlinkLoops) {
+  CreateTree({FilePath("a")}, 1);
+  ASSERT_TRUE(CreateSymbolicLink(root(), root().Append("a/loop")));
+
+  const std::set<FilePath::StringType> paths =
+      Walk(DirectoryTreeWalkOptions());
+  EXPECT_EQ((std::set<FilePath::StringType>{
+                root().Append("a").value() + "/",
+                root().Append("a/file0").value(),
+                root().Append("a/loop").value() + "/"}),
+            paths);
+}
+
+TEST_F(DirectoryWalkerTest, ReadsMetadata) {
+  CreateTree({FilePath("a")}, 3);
+  const Time last_modified = Time::FromTimeT(1234567890);
+  ASSERT_TRUE(
+      TouchFile(root().Append("a/file2"), last_modified, last_modified));
+
+  DirectoryTreeWalkOptions options;
+  options.read_metadata = true;
+  int file_count = 0;
+  WalkDirectoryTree(root(), options, [&](const DirectoryTreeEntry& entry) {
+    if (entry.is_directory) {
+      return;
+    }
+    ++file_count;
+    const FilePath::StringType name = entry.path.BaseName().value();
+    EXPECT_EQ(name, "file" + NumberToString(entry.size));
+    if (name == "file2") {
+      EXPECT_EQ(last_modified, entry.last_modified);
+    }
+  });
+  EXPECT_EQ(3, file_count);
+}
+
+TEST_F(DirectoryWalkerTest, SkipsMissingRoot) {
+  bool called = false;
+  WalkDirectoryTree(root().Append("missing"), DirectoryTreeWalkOptions(),
+                    [&](const DirectoryTreeEntry&) { called = true; });
+  EXPECT_FALSE(called);
+}
+
+TEST_F(DirectoryWalkerTest, WalksInParallel) {
+  test::TaskEnvironment task_environment;
+  std::vector<FilePath> directories;
+  for (int i = 0; i < 8; ++i) {
+    const FilePath directory = FilePath("d" + NumberToString(i));
+    directories.push_back(directory);
+    directories.push_back(directory.Append("sub"));
+  }
+  const int64_t total_size = CreateTree(directories, 20);
+
+  DirectoryTreeWalkOptions options;
+  options.max_concurrency = 4;
+  const std::set<FilePath::StringType> paths = Walk(options);
+  EXPECT_EQ(16u * 21, paths.size());
+  EXPECT_EQ(paths, Enumerate(FileEnumerator::FILES |
+                             FileEnumerator::DIRECTORIES));
+
+  EXPECT_EQ(total_size, ComputeDirectorySize(root()));
+}
+
+TEST_F(DirectoryWalkerTest, StatDirectoryEntry) {
+  CreateTree({FilePath("a")}, 4);
+  ASSERT_TRUE(CreateSymbolicLink(root().Append("a"), root().Append("link")));
+  ScopedFD dir_fd(open(root().value().c_str(), O_RDONLY | O_DIRECTORY));
+  ASSERT_TRUE(dir_fd.is_valid());
+
+  internal::DirectoryEntryStat stat;
+  ASSERT_TRUE(internal::StatDirectoryEntry(dir_fd.get(), "link",
+                                           /*follow_symlinks=*/false,
+                                           /*read_metadata=*/false, &stat));
+  EXPECT_TRUE(S_ISLNK(stat.mode));
+  ASSERT_TRUE(internal::StatDirectoryEntry(dir_fd.get(), "link",
+                                           /*follow_symlinks=*/true,
+                                           /*read_metadata=*/false, &stat));
+  EXPECT_TRUE(S_ISDIR(stat.mode));
+  ASSERT_TRUE(internal::StatDirectoryEntry(dir_fd.get(), "a/file3",
+                                           /*follow_symlinks=*/true,
+                                           /*read_metadata=*/true, &stat));
+  EXPECT_TRUE(S_ISREG(stat.mode));
+  EXPECT_EQ(3, stat.size);
+  EXPECT_FALSE(internal::StatDirectoryEntry(dir_fd.get(), "missing",
+                                            /*follow_symlinks=*/true,
+                                            /*read_metadata=*/false, &stat));
+}
+
+TEST_F(DirectoryWalkerTest, DirectoryEntryReader) {
+  CreateTree({FilePath("a")}, 1000);
+  // Large enough to take several reads.
+  internal::DirectoryEntryReader reader(root().Append("a"));
+  ASSERT_TRUE(reader.IsValid());
+  std::set<std::string> names;
+  internal::DirectoryEntryReader::Entry entry;
+  while (reader.Next(&entry)) {
+    EXPECT_TRUE(names.insert(entry.name).second);
+  }
+  EXPECT_EQ(0, reader.error());
+  // The entries, "." and "..".
+  EXPECT_EQ(1002u, names.size());
+
+  internal::DirectoryEntryReader missing(root().Append("missing"));
+  EXPECT_FALSE(missing.IsValid());
+  EXPECT_EQ(ENOENT, missing.error());
+  EXPECT_FALSE(missing.Next(&entry));
+}
+
+// FileEnumerator only stats entries in GetInfo(), and still reports the type
+// of the ones removed in between.
+TEST_F(DirectoryWalkerTest, FileEnumeratorReadsMetadataLazily) {
+  CreateTree({FilePath("a")}, 2);
+  ASSERT_TRUE(CreateDirectory(root().Append("b")));
+  FileEnumerator enumerator(
+      root(), /*recursive=*/true,
+      FileEnumerator::FILES | FileEnumerator::DIRECTORIES);
+  int64_t total_size = 0;
+  for (FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    if (path.BaseName().value() == "b") {
+      ASSERT_TRUE(DeleteFile(path));
+      EXPECT_TRUE(enumerator.GetInfo().IsDirectory());
+    } else if (!enumerator.GetInfo().IsDirectory()) {
+      total_size += enumerator.GetInfo().GetSize();
+    }
+  }
+  EXPECT_EQ(1, total_size);
+}
+
+}  // namespace base
@@ -247,6 +247,28 @@ class BASE_EXPORT File {
   // platforms. Returns the number of bytes written, or -1 on error.
   int WriteAtCurrentPosNoBestEffort(const char* data, int size);
 
+  // Reads into |buffers|, in order, starting with the given offset, as Read()
+  // would read into a single buffer of their total size, so that formats made
+  // of several records or fields don't need a read or a copy each. Returns the
+  // number of bytes read, or -1 on error. Like Read(), this makes a best effort
+  // to read all data, stopping only at EOF.
+  int ReadV(int64_t offset, span<const span<uint8_t>> buffers);
+
+  // Same as ReadV(), but only reads what can be read without blocking, e.g.
+  // from the page cache. Returns the number of bytes read, which is less than
+  // requested if the rest would block or is past EOF, or -1 on error, if none
+  // of the data could be read without blocking, or if the platform doesn't
+  // support such reads. This is meant for sequences which may not block, to
+  // only hop to one which may when the data isn't cached.
+  int ReadVNoWait(int64_t offset, span<const span<uint8_t>> buffers);
+
+  // Writes |buffers|, in order, starting with the given offset, as Write()
+  // would write a single buffer of their total size. Returns the number of
+  // bytes written, or -1 on error. Like Write(), this makes a best effort to
+  // write all data, and ignores the offset if the file was opened with
+  // FLAG_APPEND.
+  int WriteV(int64_t offset, span<const span<const uint8_t>> buffers);
+
   // Returns the current size of this file, or a negative number on failure.
   int64_t GetLength();
 
@@ -24,6 +24,8 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <unordered_set>
+
+#include "third_party/abseil-cpp/absl/types/optional.h"
 #endif
 
 namespace base {
@@ -227,6 +229,13 @@ class BASE_EXPORT FileEnumerator {
 
   // The next entry to use from the directory_entries_ vector
   size_t current_directory_entry_;
+
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+  // Next() only reads the type of entries, from the directory listing when
+  // possible. GetInfo() reads the rest of the metadata of the current entry,
+  // once.
+  mutable absl::optional<FileInfo> current_entry_info_;
+#endif
 #endif
   FilePath root_path_;
   const bool recursive_;
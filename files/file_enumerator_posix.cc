@@ -10,10 +10,17 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <memory>
+#include <utility>
+
 #include "base/logging.h"
 #include "base/threading/scoped_blocking_call.h"
 #include "build/build_config.h"
 
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+#include "base/files/directory_walker_linux.h"
+#endif
+
 namespace base {
 namespace {
 
@@ -50,6 +57,82 @@ bool ShouldTrackVisitedDirectories(int file_type) {
 }
 #endif  // BUILDFLAG(IS_FUCHSIA)
 
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+using DirectoryReader = internal::DirectoryEntryReader;
+
+// Reads the type and inode of |entry| into |st|. They come from the directory
+// listing, unless the file system doesn't provide the type, or the entry is a
+// symlink to follow, which are stat'ed. The rest of the metadata is read by
+// FileEnumerator::GetInfo(), only for the entries which are asked for.
+void GetEntryType(const DirectoryReader& reader,
+                  const DirectoryReader::Entry& entry,
+                  const FilePath& path,
+                  bool show_links,
+                  stat_wrapper_t* st) {
+  if (entry.type != DT_UNKNOWN && (entry.type != DT_LNK || show_links)) {
+    // DT_* values are the S_IF* file type bits, shifted right by 12 bits.
+    st->st_mode = static_cast<mode_t>(entry.type) << 12;
+    st->st_ino = entry.inode;
+    return;
+  }
+  internal::DirectoryEntryStat entry_stat;
+  if (!internal::StatDirectoryEntry(reader.fd(), entry.name, !show_links,
+                                    /*read_metadata=*/false, &entry_stat)) {
+    DPLOG_IF(ERROR, errno != ENOENT || show_links)
+        << "Cannot stat '" << path << "'";
+    return;
+  }
+  st->st_mode = entry_stat.mode;
+  st->st_ino = entry_stat.inode;
+}
+#else
+// Reads the entries of a directory with readdir(), with the interface of
+// internal::DirectoryEntryReader.
+class DirectoryReader {
+ public:
+  struct Entry {
+    const char* name;
+  };
+
+  explicit DirectoryReader(const FilePath& path)
+      : dir_(opendir(path.value().c_str())) {
+    if (!dir_) {
+      error_ = errno;
+    }
+  }
+  DirectoryReader(const DirectoryReader&) = delete;
+  DirectoryReader& operator=(const DirectoryReader&) = delete;
+  ~DirectoryReader() = default;
+
+  bool IsValid() const { return !!dir_; }
+
+  bool Next(Entry* entry) {
+    // NOTE: Per the readdir() documentation, when the end of the directory is
+    // reached with no errors, null is returned and errno is not changed.
+    // Therefore we must reset errno to zero before calling readdir() if we
+    // wish to know whether a null result indicates an error condition.
+    errno = 0;
+    struct dirent* dent = readdir(dir_.get());
+    if (!dent) {
+      error_ = errno;
+      return false;
+    }
+    entry->name = dent->d_name;
+    return true;
+  }
+
+  int error() const { return error_; }
+
+ private:
+  struct DIRClose {
+    void operator()(DIR* dir) const { closedir(dir); }
+  };
+  const std::unique_ptr<DIR, DIRClose> dir_;
+  int error_ = 0;
+};
+#endif  // BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) ||
+        // BUILDFLAG(IS_ANDROID)
+
 }  // namespace
 
 // FileEnumerator::FileInfo ----------------------------------------------------
@@ -145,6 +228,9 @@ FilePath FileEnumerator::Next() {
   ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
 
   ++current_directory_entry_;
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+  current_entry_info_.reset();
+#endif
 
   // While we've exhausted the entries in the current directory, do the next
   while (current_directory_entry_ >= directory_entries_.size()) {
@@ -155,11 +241,11 @@ FilePath FileEnumerator::Next() {
     root_path_ = root_path_.StripTrailingSeparators();
     pending_paths_.pop();
 
-    DIR* dir = opendir(root_path_.value().c_str());
-    if (!dir) {
-      if (errno == 0 || error_policy_ == ErrorPolicy::IGNORE_ERRORS)
+    DirectoryReader reader(root_path_);
+    if (!reader.IsValid()) {
+      if (reader.error() == 0 || error_policy_ == ErrorPolicy::IGNORE_ERRORS)
         continue;
-      error_ = File::OSErrorToFileError(errno);
+      error_ = File::OSErrorToFileError(reader.error());
       return FilePath();
     }
 
@@ -181,14 +267,10 @@ FilePath FileEnumerator::Next() {
 #endif  // BUILDFLAG(IS_FUCHSIA)
 
     current_directory_entry_ = 0;
-    struct dirent* dent;
-    // NOTE: Per the readdir() documentation, when the end of the directory is
-    // reached with no errors, null is returned and errno is not changed.
-    // Therefore we must reset errno to zero before calling readdir() if we
-    // wish to know whether a null result indicates an error condition.
-    while (errno = 0, dent = readdir(dir)) {
+    DirectoryReader::Entry entry;
+    while (reader.Next(&entry)) {
       FileInfo info;
-      info.filename_ = FilePath(dent->d_name);
+      info.filename_ = FilePath(entry.name);
 
       if (ShouldSkip(info.filename_))
         continue;
@@ -216,7 +298,12 @@ FilePath FileEnumerator::Next() {
       }
 
       const FilePath full_path = root_path_.Append(info.filename_);
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+      GetEntryType(reader, entry, full_path, ShouldShowSymLinks(file_type_),
+                   &info.stat_);
+#else
       GetStat(full_path, ShouldShowSymLinks(file_type_), &info.stat_);
+#endif
 
       const bool is_dir = info.IsDirectory();
 
@@ -231,10 +318,8 @@ FilePath FileEnumerator::Next() {
       if (is_pattern_matched && IsTypeMatched(is_dir))
         directory_entries_.push_back(std::move(info));
     }
-    int readdir_errno = errno;
-    closedir(dir);
-    if (readdir_errno != 0 && error_policy_ != ErrorPolicy::IGNORE_ERRORS) {
-      error_ = File::OSErrorToFileError(readdir_errno);
+    if (reader.error() != 0 && error_policy_ != ErrorPolicy::IGNORE_ERRORS) {
+      error_ = File::OSErrorToFileError(reader.error());
       return FilePath();
     }
 
@@ -250,7 +335,24 @@ FilePath FileEnumerator::Next() {
 
 FileEnumerator::FileInfo FileEnumerator::GetInfo() const {
   DCHECK(!(file_type_ & FileType::NAMES_ONLY));
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+  if (!current_entry_info_) {
+    ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                            BlockingType::MAY_BLOCK);
+    FileInfo info = directory_entries_[current_directory_entry_];
+    const stat_wrapper_t entry_stat = info.stat_;
+    GetStat(root_path_.Append(info.filename_), ShouldShowSymLinks(file_type_),
+            &info.stat_);
+    // Keep the type found by Next() if the entry is gone.
+    if (!info.stat_.st_mode) {
+      info.stat_ = entry_stat;
+    }
+    current_entry_info_ = std::move(info);
+  }
+  return *current_entry_info_;
+#else
   return directory_entries_[current_directory_entry_];
+#endif
 }
 
 bool FileEnumerator::IsPatternMatched(const FilePath& path) const {
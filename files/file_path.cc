@@ -100,7 +100,7 @@ bool IsPathAbsolute(StringPieceType path) {
 #endif  // FILE_PATH_USES_DRIVE_LETTERS
 }
 
-bool AreAllSeparators(const StringType& input) {
+bool AreAllSeparators(StringPieceType input) {
   for (auto it : input) {
     if (!FilePath::IsSeparator(it))
       return false;
@@ -112,7 +112,7 @@ bool AreAllSeparators(const StringType& input) {
 // Find the position of the '.' that separates the extension from the rest
 // of the file name. The position is relative to BaseName(), not value().
 // Returns npos if it can't find an extension.
-StringType::size_type FinalExtensionSeparatorPosition(const StringType& path) {
+StringType::size_type FinalExtensionSeparatorPosition(StringPieceType path) {
   // Special case "." and ".."
   if (path == FilePath::kCurrentDirectory || path == FilePath::kParentDirectory)
     return StringType::npos;
@@ -124,7 +124,7 @@ StringType::size_type FinalExtensionSeparatorPosition(const StringType& path) {
 // characters when the rightmost extension component is a common double
 // extension (gz, bz2, Z).  For example, foo.tar.gz or foo.tar.Z would have
 // extension components of '.tar.gz' and '.tar.Z' respectively.
-StringType::size_type ExtensionSeparatorPosition(const StringType& path) {
+StringType::size_type ExtensionSeparatorPosition(StringPieceType path) {
   const StringType::size_type last_dot = FinalExtensionSeparatorPosition(path);
 
   // No extension, or the extension is the whole filename.
@@ -144,12 +144,12 @@ StringType::size_type ExtensionSeparatorPosition(const StringType& path) {
   }
 
   for (auto* i : kCommonDoubleExtensions) {
-    StringType extension(path, penultimate_dot + 1);
+    StringPieceType extension = path.substr(penultimate_dot + 1);
     if (EqualsCaseInsensitiveASCII(extension, i))
       return penultimate_dot;
   }
 
-  StringType extension(path, last_dot + 1);
+  StringPieceType extension = path.substr(last_dot + 1);
   for (auto* i : kCommonDoubleExtensionSuffixes) {
     if (EqualsCaseInsensitiveASCII(extension, i)) {
       if ((last_dot - penultimate_dot) <= 5U &&
@@ -163,7 +163,7 @@ StringType::size_type ExtensionSeparatorPosition(const StringType& path) {
 }
 
 // Returns true if path is "", ".", or "..".
-bool IsEmptyOrSpecialCase(const StringType& path) {
+bool IsEmptyOrSpecialCase(StringPieceType path) {
   // Special cases "", ".", and ".."
   if (path.empty() || path == FilePath::kCurrentDirectory ||
       path == FilePath::kParentDirectory) {
@@ -173,6 +173,72 @@ bool IsEmptyOrSpecialCase(const StringType& path) {
   return false;
 }
 
+// Returns the length of |path| without its trailing separators.  If the path
+// is absolute, it will never be stripped any more than to refer to the
+// absolute root directory, so "////" will become "/", not "".  A leading pair
+// of separators is never stripped, to support alternate roots.
+StringType::size_type LengthWithoutTrailingSeparators(StringPieceType path) {
+  // If there is no drive letter, start will be 1, which will prevent stripping
+  // the leading separator if there is only one separator.  If there is a drive
+  // letter, start will be set appropriately to prevent stripping the first
+  // separator following the drive letter, if a separator immediately follows
+  // the drive letter.
+  StringType::size_type start = FindDriveLetter(path) + 2;
+
+  StringType::size_type length = path.length();
+  StringType::size_type last_stripped = StringType::npos;
+  for (StringType::size_type pos = path.length();
+       pos > start && FilePath::IsSeparator(path[pos - 1]);
+       --pos) {
+    // If the string only has two separators and they're at the beginning,
+    // don't strip them, unless the string began with more than two separators.
+    if (pos != start + 1 || last_stripped == start + 2 ||
+        !FilePath::IsSeparator(path[start - 1])) {
+      length = pos - 1;
+      last_stripped = pos;
+    }
+  }
+  return length;
+}
+
+// Appends |component| to |path| as FilePath::Append() does.
+void AppendComponent(StringPieceType component, StringType* path) {
+  StringPieceType appended =
+      component.substr(0, component.find(kStringTerminator));
+
+  DCHECK(!IsPathAbsolute(appended));
+
+  if (*path == FilePath::kCurrentDirectory && !appended.empty()) {
+    // Append normally doesn't do any normalization, but as a special case,
+    // when appending to kCurrentDirectory, just return a new path for the
+    // component argument.  Appending component to kCurrentDirectory would
+    // serve no purpose other than needlessly lengthening the path, and
+    // it's likely in practice to wind up with FilePath objects containing
+    // only kCurrentDirectory when calling DirName on a single relative path
+    // component.
+    path->assign(appended.data(), appended.size());
+    return;
+  }
+
+  path->resize(LengthWithoutTrailingSeparators(*path));
+
+  // Don't append a separator if the path is empty (indicating the current
+  // directory) or if the path component is empty (indicating nothing to
+  // append).
+  if (!appended.empty() && !path->empty()) {
+    // Don't append a separator if the path still ends with a trailing
+    // separator after stripping (indicating the root directory).
+    if (!FilePath::IsSeparator(path->back())) {
+      // Don't append a separator if the path is just a drive letter.
+      if (FindDriveLetter(*path) + 1 != path->length()) {
+        path->append(1, FilePath::kSeparators[0]);
+      }
+    }
+  }
+
+  path->append(appended.data(), appended.size());
+}
+
 }  // namespace
 
 FilePath::FilePath() = default;
@@ -228,27 +294,28 @@ std::vector<FilePath::StringType> FilePath::GetComponents() const {
   if (value().empty())
     return ret_val;
 
-  FilePath current = *this;
-  FilePath base;
+  // Views avoid allocating a FilePath for each DirName() and BaseName().
+  FilePathView current = *this;
+  FilePathView base;
 
   // Capture path components.
   while (current != current.DirName()) {
     base = current.BaseName();
     if (!AreAllSeparators(base.value()))
-      ret_val.push_back(base.value());
+      ret_val.emplace_back(base.value());
     current = current.DirName();
   }
 
   // Capture root, if any.
   base = current.BaseName();
   if (!base.value().empty() && base.value() != kCurrentDirectory)
-    ret_val.push_back(current.BaseName().value());
+    ret_val.emplace_back(base.value());
 
   // Capture drive letter, if any.
-  FilePath dir = current.DirName();
+  FilePathView dir = current.DirName();
   StringType::size_type letter = FindDriveLetter(dir.value());
   if (letter != StringType::npos)
-    ret_val.emplace_back(dir.value(), 0, letter + 1);
+    ret_val.emplace_back(dir.value().substr(0, letter + 1));
 
   ranges::reverse(ret_val);
   return ret_val;
@@ -310,121 +377,28 @@ bool FilePath::AppendRelativePath(const FilePath& child,
   return true;
 }
 
-// libgen's dirname and basename aren't guaranteed to be thread-safe and aren't
-// guaranteed to not modify their input strings, and in fact are implemented
-// differently in this regard on different platforms.  Don't use them, but
-// adhere to their behavior.
 FilePath FilePath::DirName() const {
-  FilePath new_path(path_);
-  new_path.StripTrailingSeparatorsInternal();
-
-  // The drive letter, if any, always needs to remain in the output.  If there
-  // is no drive letter, as will always be the case on platforms which do not
-  // support drive letters, letter will be npos, or -1, so the comparisons and
-  // resizes below using letter will still be valid.
-  StringType::size_type letter = FindDriveLetter(new_path.path_);
-
-  StringType::size_type last_separator =
-      new_path.path_.find_last_of(kSeparators, StringType::npos,
-                                  kSeparatorsLength - 1);
-  if (last_separator == StringType::npos) {
-    // path_ is in the current directory.
-    new_path.path_.resize(letter + 1);
-  } else if (last_separator == letter + 1) {
-    // path_ is in the root directory.
-    new_path.path_.resize(letter + 2);
-  } else if (last_separator == letter + 2 &&
-             IsSeparator(new_path.path_[letter + 1])) {
-    // path_ is in "//" (possibly with a drive letter); leave the double
-    // separator intact indicating alternate root.
-    new_path.path_.resize(letter + 3);
-  } else if (last_separator != 0) {
-    bool trim_to_basename = true;
-#if BUILDFLAG(IS_POSIX)
-    // On Posix, more than two leading separators are always collapsed to one.
-    // See
-    // https://pubs.opengroup.org/onlinepubs/9699919799/basedefs/V1_chap04.html#tag_04_13
-    // So, do not strip any of the separators, let
-    // StripTrailingSeparatorsInternal() take care of the extra.
-    if (AreAllSeparators(new_path.path_.substr(0, last_separator + 1))) {
-      new_path.path_.resize(last_separator + 1);
-      trim_to_basename = false;
-    }
-#endif  // BUILDFLAG(IS_POSIX)
-    if (trim_to_basename) {
-      // path_ is somewhere else, trim the basename.
-      new_path.path_.resize(last_separator);
-    }
-  }
-
-  new_path.StripTrailingSeparatorsInternal();
-  if (!new_path.path_.length())
-    new_path.path_ = kCurrentDirectory;
-
-  return new_path;
+  return FilePathView(*this).DirName().ToFilePath();
 }
 
 FilePath FilePath::BaseName() const {
-  FilePath new_path(path_);
-  new_path.StripTrailingSeparatorsInternal();
-
-  // The drive letter, if any, is always stripped.
-  StringType::size_type letter = FindDriveLetter(new_path.path_);
-  if (letter != StringType::npos) {
-    new_path.path_.erase(0, letter + 1);
-  }
-
-  // Keep everything after the final separator, but if the pathname is only
-  // one character and it's a separator, leave it alone.
-  StringType::size_type last_separator =
-      new_path.path_.find_last_of(kSeparators, StringType::npos,
-                                  kSeparatorsLength - 1);
-  if (last_separator != StringType::npos &&
-      last_separator < new_path.path_.length() - 1) {
-    new_path.path_.erase(0, last_separator + 1);
-  }
-
-  return new_path;
+  return FilePathView(*this).BaseName().ToFilePath();
 }
 
 StringType FilePath::Extension() const {
-  FilePath base(BaseName());
-  const StringType::size_type dot = ExtensionSeparatorPosition(base.path_);
-  if (dot == StringType::npos)
-    return StringType();
-
-  return base.path_.substr(dot, StringType::npos);
+  return StringType(FilePathView(*this).Extension());
 }
 
 StringType FilePath::FinalExtension() const {
-  FilePath base(BaseName());
-  const StringType::size_type dot = FinalExtensionSeparatorPosition(base.path_);
-  if (dot == StringType::npos)
-    return StringType();
-
-  return base.path_.substr(dot, StringType::npos);
+  return StringType(FilePathView(*this).FinalExtension());
 }
 
 FilePath FilePath::RemoveExtension() const {
-  if (Extension().empty())
-    return *this;
-
-  const StringType::size_type dot = ExtensionSeparatorPosition(path_);
-  if (dot == StringType::npos)
-    return *this;
-
-  return FilePath(path_.substr(0, dot));
+  return FilePathView(*this).RemoveExtension().ToFilePath();
 }
 
 FilePath FilePath::RemoveFinalExtension() const {
-  if (FinalExtension().empty())
-    return *this;
-
-  const StringType::size_type dot = FinalExtensionSeparatorPosition(path_);
-  if (dot == StringType::npos)
-    return *this;
-
-  return FilePath(path_.substr(0, dot));
+  return FilePathView(*this).RemoveFinalExtension().ToFilePath();
 }
 
 FilePath FilePath::InsertBeforeExtension(StringPieceType suffix) const {
@@ -493,68 +467,16 @@ FilePath FilePath::ReplaceExtension(StringPieceType extension) const {
 }
 
 bool FilePath::MatchesExtension(StringPieceType extension) const {
-  DCHECK(extension.empty() || extension[0] == kExtensionSeparator);
-
-  StringType current_extension = Extension();
-
-  if (current_extension.length() != extension.length())
-    return false;
-
-  return FilePath::CompareEqualIgnoreCase(extension, current_extension);
+  return FilePathView(*this).MatchesExtension(extension);
 }
 
 bool FilePath::MatchesFinalExtension(StringPieceType extension) const {
-  DCHECK(extension.empty() || extension[0] == kExtensionSeparator);
-
-  StringType current_final_extension = FinalExtension();
-
-  if (current_final_extension.length() != extension.length())
-    return false;
-
-  return FilePath::CompareEqualIgnoreCase(extension, current_final_extension);
+  return FilePathView(*this).MatchesFinalExtension(extension);
 }
 
 FilePath FilePath::Append(StringPieceType component) const {
-  StringPieceType appended = component;
-  StringType without_nuls;
-
-  StringType::size_type nul_pos = component.find(kStringTerminator);
-  if (nul_pos != StringPieceType::npos) {
-    without_nuls = StringType(component.substr(0, nul_pos));
-    appended = StringPieceType(without_nuls);
-  }
-
-  DCHECK(!IsPathAbsolute(appended));
-
-  if (path_.compare(kCurrentDirectory) == 0 && !appended.empty()) {
-    // Append normally doesn't do any normalization, but as a special case,
-    // when appending to kCurrentDirectory, just return a new path for the
-    // component argument.  Appending component to kCurrentDirectory would
-    // serve no purpose other than needlessly lengthening the path, and
-    // it's likely in practice to wind up with FilePath objects containing
-    // only kCurrentDirectory when calling DirName on a single relative path
-    // component.
-    return FilePath(appended);
-  }
-
-  FilePath new_path(path_);
-  new_path.StripTrailingSeparatorsInternal();
-
-  // Don't append a separator if the path is empty (indicating the current
-  // directory) or if the path component is empty (indicating nothing to
-  // append).
-  if (!appended.empty() && !new_path.path_.empty()) {
-    // Don't append a separator if the path still ends with a trailing
-    // separator after stripping (indicating the root directory).
-    if (!IsSeparator(new_path.path_.back())) {
-      // Don't append a separator if the path is just a drive letter.
-      if (FindDriveLetter(new_path.path_) + 1 != new_path.path_.length()) {
-        new_path.path_.append(1, kSeparators[0]);
-      }
-    }
-  }
-
-  new_path.path_.append(appended);
+  FilePath new_path(*this);
+  AppendComponent(component, &new_path.path_);
   return new_path;
 }
 
@@ -576,18 +498,15 @@ FilePath FilePath::AppendASCII(StringPiece component) const {
 }
 
 bool FilePath::IsAbsolute() const {
-  return IsPathAbsolute(path_);
+  return FilePathView(*this).IsAbsolute();
 }
 
 bool FilePath::IsNetwork() const {
-  return path_.length() > 1 && FilePath::IsSeparator(path_[0]) &&
-         FilePath::IsSeparator(path_[1]);
+  return FilePathView(*this).IsNetwork();
 }
 
 bool FilePath::EndsWithSeparator() const {
-  if (empty())
-    return false;
-  return IsSeparator(path_.back());
+  return FilePathView(*this).EndsWithSeparator();
 }
 
 FilePath FilePath::AsEndingWithSeparator() const {
@@ -603,10 +522,7 @@ FilePath FilePath::AsEndingWithSeparator() const {
 }
 
 FilePath FilePath::StripTrailingSeparators() const {
-  FilePath new_path(path_);
-  new_path.StripTrailingSeparatorsInternal();
-
-  return new_path;
+  return FilePathView(*this).StripTrailingSeparators().ToFilePath();
 }
 
 bool FilePath::ReferencesParent() const {
@@ -1356,28 +1272,6 @@ int FilePath::CompareIgnoreCase(StringPieceType string1,
 #endif  // OS versions of CompareIgnoreCase()
 
 
-void FilePath::StripTrailingSeparatorsInternal() {
-  // If there is no drive letter, start will be 1, which will prevent stripping
-  // the leading separator if there is only one separator.  If there is a drive
-  // letter, start will be set appropriately to prevent stripping the first
-  // separator following the drive letter, if a separator immediately follows
-  // the drive letter.
-  StringType::size_type start = FindDriveLetter(path_) + 2;
-
-  StringType::size_type last_stripped = StringType::npos;
-  for (StringType::size_type pos = path_.length();
-       pos > start && IsSeparator(path_[pos - 1]);
-       --pos) {
-    // If the string only has two separators and they're at the beginning,
-    // don't strip them, unless the string began with more than two separators.
-    if (pos != start + 1 || last_stripped == start + 2 ||
-        !IsSeparator(path_[start - 1])) {
-      path_.resize(pos - 1);
-      last_stripped = pos;
-    }
-  }
-}
-
 FilePath FilePath::NormalizePathSeparators() const {
   return NormalizePathSeparatorsTo(kSeparators[0]);
 }
@@ -1406,4 +1300,222 @@ bool FilePath::IsContentUri() const {
 }
 #endif
 
+FilePathView::FilePathView(StringPieceType path)
+    : path_(path.substr(0, path.find(kStringTerminator))) {}
+
+bool FilePathView::operator==(FilePathView that) const {
+#if defined(FILE_PATH_USES_DRIVE_LETTERS)
+  return EqualDriveLetterCaseInsensitive(path_, that.path_);
+#else  // defined(FILE_PATH_USES_DRIVE_LETTERS)
+  return path_ == that.path_;
+#endif  // defined(FILE_PATH_USES_DRIVE_LETTERS)
+}
+
+bool FilePathView::operator!=(FilePathView that) const {
+  return !(*this == that);
+}
+
+FilePath FilePathView::ToFilePath() const {
+  return FilePath(path_);
+}
+
+// libgen's dirname and basename aren't guaranteed to be thread-safe and aren't
+// guaranteed to not modify their input strings, and in fact are implemented
+// differently in this regard on different platforms.  Don't use them, but
+// adhere to their behavior.
+FilePathView FilePathView::DirName() const {
+  StringPieceType path = StripTrailingSeparators().path_;
+
+  // The drive letter, if any, always needs to remain in the output.  If there
+  // is no drive letter, as will always be the case on platforms which do not
+  // support drive letters, letter will be npos, or -1, so the comparisons and
+  // truncations below using letter will still be valid.
+  StringType::size_type letter = FindDriveLetter(path);
+
+  StringType::size_type last_separator = path.find_last_of(
+      FilePath::kSeparators, StringType::npos, FilePath::kSeparatorsLength - 1);
+  if (last_separator == StringType::npos) {
+    // path is in the current directory.
+    path = path.substr(0, letter + 1);
+  } else if (last_separator == letter + 1) {
+    // path is in the root directory.
+    path = path.substr(0, letter + 2);
+  } else if (last_separator == letter + 2 &&
+             FilePath::IsSeparator(path[letter + 1])) {
+    // path is in "//" (possibly with a drive letter); leave the double
+    // separator intact indicating alternate root.
+    path = path.substr(0, letter + 3);
+  } else if (last_separator != 0) {
+    bool trim_to_basename = true;
+#if BUILDFLAG(IS_POSIX)
+    // On Posix, more than two leading separators are always collapsed to one.
+    // See
+    // https://pubs.opengroup.org/onlinepubs/9699919799/basedefs/V1_chap04.html#tag_04_13
+    // So, do not strip any of the separators, let
+    // LengthWithoutTrailingSeparators() take care of the extra.
+    if (AreAllSeparators(path.substr(0, last_separator + 1))) {
+      path = path.substr(0, last_separator + 1);
+      trim_to_basename = false;
+    }
+#endif  // BUILDFLAG(IS_POSIX)
+    if (trim_to_basename) {
+      // path is somewhere else, trim the basename.
+      path = path.substr(0, last_separator);
+    }
+  }
+
+  path = path.substr(0, LengthWithoutTrailingSeparators(path));
+  if (path.empty())
+    return FilePathView(FilePath::kCurrentDirectory);
+
+  return FilePathView(path);
+}
+
+FilePathView FilePathView::BaseName() const {
+  StringPieceType path = StripTrailingSeparators().path_;
+
+  // The drive letter, if any, is always stripped.
+  StringType::size_type letter = FindDriveLetter(path);
+  if (letter != StringType::npos) {
+    path.remove_prefix(letter + 1);
+  }
+
+  // Keep everything after the final separator, but if the pathname is only
+  // one character and it's a separator, leave it alone.
+  StringType::size_type last_separator = path.find_last_of(
+      FilePath::kSeparators, StringType::npos, FilePath::kSeparatorsLength - 1);
+  if (last_separator != StringType::npos &&
+      last_separator < path.length() - 1) {
+    path.remove_prefix(last_separator + 1);
+  }
+
+  return FilePathView(path);
+}
+
+StringPieceType FilePathView::Extension() const {
+  StringPieceType base = BaseName().path_;
+  const StringType::size_type dot = ExtensionSeparatorPosition(base);
+  if (dot == StringType::npos)
+    return StringPieceType();
+
+  return base.substr(dot);
+}
+
+StringPieceType FilePathView::FinalExtension() const {
+  StringPieceType base = BaseName().path_;
+  const StringType::size_type dot = FinalExtensionSeparatorPosition(base);
+  if (dot == StringType::npos)
+    return StringPieceType();
+
+  return base.substr(dot);
+}
+
+FilePathView FilePathView::RemoveExtension() const {
+  if (Extension().empty())
+    return *this;
+
+  const StringType::size_type dot = ExtensionSeparatorPosition(path_);
+  if (dot == StringType::npos)
+    return *this;
+
+  return FilePathView(path_.substr(0, dot));
+}
+
+FilePathView FilePathView::RemoveFinalExtension() const {
+  if (FinalExtension().empty())
+    return *this;
+
+  const StringType::size_type dot = FinalExtensionSeparatorPosition(path_);
+  if (dot == StringType::npos)
+    return *this;
+
+  return FilePathView(path_.substr(0, dot));
+}
+
+bool FilePathView::MatchesExtension(StringPieceType extension) const {
+  DCHECK(extension.empty() || extension[0] == FilePath::kExtensionSeparator);
+
+  StringPieceType current_extension = Extension();
+
+  if (current_extension.length() != extension.length())
+    return false;
+
+  return FilePath::CompareEqualIgnoreCase(extension, current_extension);
+}
+
+bool FilePathView::MatchesFinalExtension(StringPieceType extension) const {
+  DCHECK(extension.empty() || extension[0] == FilePath::kExtensionSeparator);
+
+  StringPieceType current_final_extension = FinalExtension();
+
+  if (current_final_extension.length() != extension.length())
+    return false;
+
+  return FilePath::CompareEqualIgnoreCase(extension, current_final_extension);
+}
+
+bool FilePathView::IsAbsolute() const {
+  return IsPathAbsolute(path_);
+}
+
+bool FilePathView::IsNetwork() const {
+  return path_.length() > 1 && FilePath::IsSeparator(path_[0]) &&
+         FilePath::IsSeparator(path_[1]);
+}
+
+bool FilePathView::EndsWithSeparator() const {
+  if (empty())
+    return false;
+  return FilePath::IsSeparator(path_.back());
+}
+
+FilePathView FilePathView::StripTrailingSeparators() const {
+  return FilePathView(path_.substr(0, LengthWithoutTrailingSeparators(path_)));
+}
+
+FilePathBuilder::FilePathBuilder() = default;
+
+FilePathBuilder::FilePathBuilder(FilePathView path) : path_(path.value()) {}
+
+FilePathBuilder::~FilePathBuilder() = default;
+
+FilePathView FilePathBuilder::view() const {
+  return FilePathView(path_);
+}
+
+FilePath FilePathBuilder::ToFilePath() const {
+  return FilePath(path_);
+}
+
+void FilePathBuilder::Assign(FilePathView path) {
+  path_.assign(path.value().data(), path.value().size());
+}
+
+void FilePathBuilder::Append(StringPieceType component) {
+  AppendComponent(component, &path_);
+}
+
+void FilePathBuilder::AppendASCII(StringPiece component) {
+  DCHECK(base::IsStringASCII(component));
+#if BUILDFLAG(IS_WIN)
+  Append(UTF8ToWide(component));
+#elif BUILDFLAG(IS_POSIX) || BUILDFLAG(IS_FUCHSIA)
+  Append(component);
+#endif
+}
+
+void FilePathBuilder::Truncate(size_t length) {
+  DCHECK_LE(length, path_.length());
+  path_.resize(length);
+}
+
+void FilePathBuilder::NormalizePathSeparators() {
+#if defined(FILE_PATH_USES_WIN_SEPARATORS)
+  for (size_t i = 1; i < FilePath::kSeparatorsLength - 1; ++i) {
+    std::replace(path_.begin(), path_.end(), FilePath::kSeparators[i],
+                 FilePath::kSeparators[0]);
+  }
+#endif
+}
+
 }  // namespace base
@@ -497,19 +497,118 @@ class BASE_EXPORT FilePath {
   // file_path_fuzzer.cc as well.
 
  private:
-  // Remove trailing separators from this object.  If the path is absolute, it
-  // will never be stripped any more than to refer to the absolute root
-  // directory, so "////" will become "/", not "".  A leading pair of
-  // separators is never stripped, to support alternate roots.  This is used to
-  // support UNC paths on Windows.
-  void StripTrailingSeparatorsInternal();
-
   StringType path_;
 };
 
 BASE_EXPORT std::ostream& operator<<(std::ostream& out,
                                      const FilePath& file_path);
 
+// A non-owning view of a pathname, with the query operations of FilePath.
+// These return views of the same characters instead of new FilePath objects,
+// so that code which only inspects paths, e.g. to filter enumerated files by
+// extension or to build cache keys, doesn't allocate. Their results are those
+// of the FilePath methods of the same name, e.g.
+//   FilePathView(path).DirName().value() == path.DirName().value()
+// holds for any |path|. As with StringPiece, the characters must outlive the
+// view.
+class BASE_EXPORT FilePathView {
+ public:
+  using StringPieceType = FilePath::StringPieceType;
+
+  constexpr FilePathView() = default;
+  // As with FilePath, |path| is truncated at its first NUL, if any.
+  explicit FilePathView(StringPieceType path);
+  // Implicit so that FilePaths can be passed where FilePathViews are expected,
+  // as std::strings can be where StringPieces are.
+  FilePathView(const FilePath& path)  // NOLINT(google-explicit-constructor)
+      : path_(path.value()) {}
+  FilePathView(const FilePathView&) = default;
+  FilePathView& operator=(const FilePathView&) = default;
+
+  bool operator==(FilePathView that) const;
+  bool operator!=(FilePathView that) const;
+  bool operator<(FilePathView that) const { return path_ < that.path_; }
+
+  StringPieceType value() const { return path_; }
+
+  [[nodiscard]] bool empty() const { return path_.empty(); }
+
+  // Returns a FilePath holding a copy of the viewed path.
+  FilePath ToFilePath() const;
+
+  // See the FilePath methods of the same names. DirName() of a path without a
+  // directory is a view of FilePath::kCurrentDirectory.
+  [[nodiscard]] FilePathView DirName() const;
+  [[nodiscard]] FilePathView BaseName() const;
+  [[nodiscard]] StringPieceType Extension() const;
+  [[nodiscard]] StringPieceType FinalExtension() const;
+  [[nodiscard]] FilePathView RemoveExtension() const;
+  [[nodiscard]] FilePathView RemoveFinalExtension() const;
+  bool MatchesExtension(StringPieceType extension) const;
+  bool MatchesFinalExtension(StringPieceType extension) const;
+  bool IsAbsolute() const;
+  bool IsNetwork() const;
+  [[nodiscard]] bool EndsWithSeparator() const;
+  [[nodiscard]] FilePathView StripTrailingSeparators() const;
+
+ private:
+  StringPieceType path_;
+};
+
+// Composes pathnames in a buffer which is reused from one path to the next,
+// with the semantics of the FilePath methods of the same names. This suits
+// forming many related paths, e.g. those of the entries of a directory tree:
+//
+// | FilePathBuilder builder(root);
+// | const size_t root_length = builder.length();
+// | for (const FilePath::StringType& name : names) {
+// |   builder.Truncate(root_length);
+// |   builder.Append(name);
+// |   Process(builder.view());
+// | }
+class BASE_EXPORT FilePathBuilder {
+ public:
+  FilePathBuilder();
+  explicit FilePathBuilder(FilePathView path);
+  FilePathBuilder(const FilePathBuilder&) = delete;
+  FilePathBuilder& operator=(const FilePathBuilder&) = delete;
+  ~FilePathBuilder();
+
+  const FilePath::StringType& value() const { return path_; }
+
+  // The returned view is invalidated by the next modification of the builder.
+  FilePathView view() const;
+
+  size_t length() const { return path_.length(); }
+
+  [[nodiscard]] bool empty() const { return path_.empty(); }
+
+  // Returns a FilePath holding a copy of the built path.
+  FilePath ToFilePath() const;
+
+  // Replaces the built path with |path|.
+  void Assign(FilePathView path);
+
+  // Appends |component| as FilePath::Append() does. |component| must not view
+  // the characters of this builder.
+  void Append(FilePath::StringPieceType component);
+  void AppendASCII(StringPiece component);
+
+  // Shrinks the built path back to |length|, typically a value of length()
+  // taken before appending, e.g. to append the siblings of a component in
+  // turn.
+  void Truncate(size_t length);
+
+  // Normalizes the separators in place, as FilePath::NormalizePathSeparators()
+  // does.
+  void NormalizePathSeparators();
+
+  void clear() { path_.clear(); }
+
+ private:
+  FilePath::StringType path_;
+};
+
 }  // namespace base
 
 namespace std {
@@ -90,8 +90,15 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
   // Smoke-test operations against a second path.
   FilePath second_path(GenerateNativeString(provider));
   std::ignore = path.IsParent(second_path);
-  if (!second_path.IsAbsolute())
-    std::ignore = path.Append(second_path);
+  if (!second_path.IsAbsolute()) {
+    const FilePath appended = path.Append(second_path);
+    // Check that FilePathBuilder composes the same path.
+    FilePathBuilder builder(path);
+    builder.Append(second_path.value());
+    CHECK_EQ(builder.ToFilePath(), appended);
+    builder.NormalizePathSeparators();
+    CHECK_EQ(builder.ToFilePath(), appended.NormalizePathSeparators());
+  }
   FilePath relative_path;
   std::ignore = path.AppendRelativePath(second_path, &relative_path);
 
@@ -0,0 +1,135 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/file_path.h"
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/time/time.h"
+#include "base/timer/lap_timer.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace base {
+
+namespace {
+
+constexpr char kMetricPrefixFilePath[] = "FilePath.";
+constexpr char kMetricNsPerPath[] = "ns_per_path";
+
+// The directory of the enumerated entries, and their names, e.g. those of the
+// files of a cache.
+constexpr FilePath::CharType kRoot[] =
+    FILE_PATH_LITERAL("/home/user/.cache/browser/Default/Cache/Cache_Data");
+constexpr size_t kEntryCount = 1000;
+
+class FilePathPerfTest : public testing::Test {
+ protected:
+  FilePathPerfTest()
+      : timer_(/*warmup_laps=*/10, Seconds(1), /*check_interval=*/10) {}
+
+  void SetUp() override {
+    for (size_t i = 0; i < kEntryCount; ++i) {
+#if BUILDFLAG(IS_WIN)
+      names_.push_back(NumberToWString(i * 7919) + L".data.gz");
+#else
+      names_.push_back(NumberToString(i * 7919) + ".data.gz");
+#endif
+      paths_.push_back(FilePath(kRoot).Append(names_.back()));
+    }
+  }
+
+  void ReportResult(const std::string& story) {
+    perf_test::PerfResultReporter reporter(kMetricPrefixFilePath, story);
+    reporter.RegisterImportantMetric(kMetricNsPerPath, "ns");
+    reporter.AddResult(
+        kMetricNsPerPath,
+        timer_.TimePerLap().InMicrosecondsF() * 1000 / kEntryCount);
+  }
+
+  LapTimer timer_;
+  std::vector<FilePath::StringType> names_;
+  std::vector<FilePath> paths_;
+  // Keeps the compiler from dropping the measured work.
+  size_t checksum_ = 0;
+};
+
+}  // namespace
+
+// Queries the directory, name and extension of each path.
+TEST_F(FilePathPerfTest, QueryFilePath) {
+  do {
+    for (const FilePath& path : paths_) {
+      checksum_ += path.DirName().value().size();
+      checksum_ += path.BaseName().value().size();
+      checksum_ += path.Extension().size();
+    }
+    timer_.NextLap();
+  } while (!timer_.HasTimeLimitExpired());
+  EXPECT_NE(0u, checksum_);
+  ReportResult("query_file_path");
+}
+
+TEST_F(FilePathPerfTest, QueryFilePathView) {
+  do {
+    for (const FilePath& path : paths_) {
+      const FilePathView view(path);
+      checksum_ += view.DirName().value().size();
+      checksum_ += view.BaseName().value().size();
+      checksum_ += view.Extension().size();
+    }
+    timer_.NextLap();
+  } while (!timer_.HasTimeLimitExpired());
+  EXPECT_NE(0u, checksum_);
+  ReportResult("query_file_path_view");
+}
+
+// Forms the path of each entry, and strips its extension, as when building
+// cache keys.
+TEST_F(FilePathPerfTest, BuildFilePath) {
+  const FilePath root(kRoot);
+  do {
+    for (const FilePath::StringType& name : names_) {
+      checksum_ += root.Append(name).RemoveExtension().value().size();
+    }
+    timer_.NextLap();
+  } while (!timer_.HasTimeLimitExpired());
+  EXPECT_NE(0u, checksum_);
+  ReportResult("build_file_path");
+}
+
+TEST_F(FilePathPerfTest, BuildFilePathBuilder) {
+  FilePathBuilder builder{FilePathView(kRoot)};
+  const size_t root_length = builder.length();
+  do {
+    for (const FilePath::StringType& name : names_) {
+      builder.Truncate(root_length);
+      builder.Append(name);
+      checksum_ += builder.view().RemoveExtension().value().size();
+    }
+    timer_.NextLap();
+  } while (!timer_.HasTimeLimitExpired());
+  EXPECT_NE(0u, checksum_);
+  ReportResult("build_file_path_builder");
+}
+
+// Splits each path in components, which IsParent() and AppendRelativePath()
+// do for both of their paths.
+TEST_F(FilePathPerfTest, GetComponents) {
+  do {
+    for (const FilePath& path : paths_) {
+      checksum_ += path.GetComponents().size();
+    }
+    timer_.NextLap();
+  } while (!timer_.HasTimeLimitExpired());
+  EXPECT_NE(0u, checksum_);
+  ReportResult("get_components");
+}
+
+}  // namespace base
@@ -162,6 +162,8 @@ TEST_F(FilePathTest, DirName) {
     FilePath observed = input.DirName();
     EXPECT_EQ(FilePath::StringType(cases[i].expected), observed.value()) <<
               "i: " << i << ", input: " << input.value();
+    EXPECT_EQ(cases[i].expected, FilePathView(input).DirName().value())
+        << "i: " << i << ", input: " << input.value();
   }
 }
 
@@ -249,6 +251,8 @@ TEST_F(FilePathTest, BaseName) {
     FilePath observed = input.BaseName();
     EXPECT_EQ(FilePath::StringType(cases[i].expected), observed.value()) <<
               "i: " << i << ", input: " << input.value();
+    EXPECT_EQ(cases[i].expected, FilePathView(input).BaseName().value())
+        << "i: " << i << ", input: " << input.value();
   }
 }
 
@@ -342,6 +346,15 @@ TEST_F(FilePathTest, Append) {
     observed_str = root.AppendASCII(ascii);
     EXPECT_EQ(FilePath::StringType(cases[i].expected), observed_str.value()) <<
               "i: " << i << ", root: " << root.value() << ", leaf: " << leaf;
+
+    FilePathBuilder builder(root);
+    builder.Append(leaf);
+    EXPECT_EQ(cases[i].expected, builder.value())
+        << "i: " << i << ", root: " << root.value() << ", leaf: " << leaf;
+    builder.Assign(root);
+    builder.AppendASCII(ascii);
+    EXPECT_EQ(cases[i].expected, builder.value())
+        << "i: " << i << ", root: " << root.value() << ", leaf: " << leaf;
   }
 }
 
@@ -1324,6 +1337,74 @@ TEST_F(FilePathTest, AppendWithNUL) {
 #endif
 }
 
+TEST_F(FilePathTest, FilePathViewWithNUL) {
+  // Like FilePath, FilePathView stops at the first '\0'.
+  const FilePath::StringType input = FPS("a\0b");
+  FilePathView view(input);
+  EXPECT_EQ(FPL("a"), view.value());
+  EXPECT_EQ(FilePath(input), view.ToFilePath());
+
+  FilePathBuilder builder(FilePathView(FPL("a")));
+  builder.Append(FPS("b\0b"));
+#if defined(FILE_PATH_USES_WIN_SEPARATORS)
+  EXPECT_EQ(FPL("a\\b"), builder.value());
+#else
+  EXPECT_EQ(FPL("a/b"), builder.value());
+#endif
+}
+
+TEST_F(FilePathTest, FilePathViewQueries) {
+  const FilePath path(FPL("/aa/bb/foo.tar.gz/"));
+  const FilePathView view(path);
+  EXPECT_EQ(path.value(), view.value());
+  EXPECT_EQ(path, view.ToFilePath());
+  EXPECT_EQ(path.StripTrailingSeparators().value(),
+            view.StripTrailingSeparators().value());
+  EXPECT_EQ(path.Extension(), view.Extension());
+  EXPECT_EQ(path.FinalExtension(), view.FinalExtension());
+  EXPECT_EQ(path.RemoveExtension().value(), view.RemoveExtension().value());
+  EXPECT_EQ(path.RemoveFinalExtension().value(),
+            view.RemoveFinalExtension().value());
+  EXPECT_TRUE(view.MatchesExtension(FPL(".TAR.GZ")));
+  EXPECT_TRUE(view.MatchesFinalExtension(FPL(".gz")));
+  EXPECT_FALSE(view.MatchesExtension(FPL(".gz")));
+  EXPECT_TRUE(view.IsAbsolute());
+  EXPECT_FALSE(view.IsNetwork());
+  EXPECT_TRUE(view.EndsWithSeparator());
+
+  // The results view the characters of |path|.
+  EXPECT_EQ(path.value().data(), view.DirName().value().data());
+  EXPECT_EQ(path.value().data() + 7, view.BaseName().value().data());
+
+  EXPECT_EQ(FilePathView(FPL("aa")).DirName(),
+            FilePathView(FilePath::kCurrentDirectory));
+  EXPECT_NE(FilePathView(FPL("aa")), FilePathView(FPL("bb")));
+  EXPECT_LT(FilePathView(FPL("aa")), FilePathView(FPL("bb")));
+}
+
+TEST_F(FilePathTest, FilePathBuilder) {
+  FilePathBuilder builder;
+  EXPECT_TRUE(builder.empty());
+
+  builder.Assign(FilePath(FPL("foo")));
+  const size_t root_length = builder.length();
+  for (const FilePath::StringPieceType name : {FPL("a.txt"), FPL("bb")}) {
+    builder.Truncate(root_length);
+    builder.Append(name);
+    EXPECT_EQ(FilePath(FPL("foo")).Append(name), builder.ToFilePath());
+    EXPECT_EQ(name, builder.view().BaseName().value());
+  }
+
+  builder.Append(FPL("cc"));
+  EXPECT_EQ(FilePath(FPL("foo")).Append(FPL("bb")).Append(FPL("cc")),
+            builder.ToFilePath());
+
+  builder.clear();
+  EXPECT_TRUE(builder.empty());
+  builder.Append(FPL("dd"));
+  EXPECT_EQ(FPL("dd"), builder.value());
+}
+
 TEST_F(FilePathTest, AppendBaseName) {
   FilePath dir(FPL("foo"));
   auto file(SafeBaseName::Create(FPL("bar.txt")));
@@ -1385,6 +1466,10 @@ TEST_F(FilePathTest, NormalizePathSeparators) {
     FilePath observed = input.NormalizePathSeparators();
     EXPECT_EQ(FilePath::StringType(cases[i].expected), observed.value()) <<
               "i: " << i << ", input: " << input.value();
+    FilePathBuilder builder(input);
+    builder.NormalizePathSeparators();
+    EXPECT_EQ(cases[i].expected, builder.value())
+        << "i: " << i << ", input: " << input.value();
   }
 }
 #endif
@@ -8,14 +8,87 @@
 #include "base/files/file_path_watcher.h"
 
 #include <memory>
+#include <set>
 #include <utility>
 
 #include "base/check.h"
+#include "base/check_op.h"
 #include "base/files/file_path.h"
+#include "base/functional/bind.h"
+#include "base/location.h"
+#include "base/timer/timer.h"
 #include "build/build_config.h"
 
 namespace base {
 
+// Accumulates the changes reported for a watch, and reports them once
+// BatchOptions::latency passed since the first of them.
+class FilePathWatcher::ChangeBatcher {
+ public:
+  ChangeBatcher(const FilePath& watched_path,
+                const BatchOptions& options,
+                const BatchCallback& callback)
+      : watched_path_(watched_path), options_(options), callback_(callback) {
+    DCHECK_GT(options_.max_batch_size, 0u);
+  }
+  ChangeBatcher(const ChangeBatcher&) = delete;
+  ChangeBatcher& operator=(const ChangeBatcher&) = delete;
+  ~ChangeBatcher() = default;
+
+  void OnChange(const FilePath& path, bool error) {
+    DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+    if (error) {
+      timer_.Stop();
+      Flush(/*error=*/true);
+      return;
+    }
+    if (!overflowed_) {
+      paths_.insert(path);
+      if (paths_.size() > options_.max_batch_size) {
+        overflowed_ = true;
+        paths_.clear();
+      }
+    }
+    // The timer isn't restarted by later changes, so that a steady stream of
+    // changes is still reported.
+    if (!timer_.IsRunning()) {
+      timer_.Start(FROM_HERE, options_.latency,
+                   BindOnce(&ChangeBatcher::Flush, Unretained(this),
+                            /*error=*/false));
+    }
+  }
+
+ private:
+  void Flush(bool error) {
+    ChangeBatch batch;
+    if (overflowed_) {
+      batch.paths.push_back(watched_path_);
+    } else {
+      batch.paths.assign(paths_.begin(), paths_.end());
+    }
+    batch.overflowed = overflowed_;
+    paths_.clear();
+    overflowed_ = false;
+    // May delete |this|.
+    callback_.Run(batch, error);
+  }
+
+  const FilePath watched_path_;
+  const BatchOptions options_;
+  const BatchCallback callback_;
+  std::set<FilePath> paths_;
+  bool overflowed_ = false;
+  OneShotTimer timer_;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+};
+
+FilePathWatcher::ChangeBatch::ChangeBatch() = default;
+FilePathWatcher::ChangeBatch::ChangeBatch(const ChangeBatch&) = default;
+FilePathWatcher::ChangeBatch& FilePathWatcher::ChangeBatch::operator=(
+    const ChangeBatch&) = default;
+FilePathWatcher::ChangeBatch::~ChangeBatch() = default;
+
 FilePathWatcher::~FilePathWatcher() {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
   impl_->Cancel();
@@ -64,6 +137,30 @@ bool FilePathWatcher::WatchWithChangeInfo(
   return impl_->WatchWithChangeInfo(path, options, callback);
 }
 
+bool FilePathWatcher::WatchWithBatches(const FilePath& path,
+                                       const WatchOptions& options,
+                                       const BatchOptions& batch_options,
+                                       const BatchCallback& callback) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  DCHECK(path.IsAbsolute());
+  DCHECK(!batcher_);
+  WatchOptions batch_watch_options = options;
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID) || \
+    BUILDFLAG(IS_FUCHSIA)
+  batch_watch_options.report_modified_path = true;
+#endif
+  batcher_ = std::make_unique<ChangeBatcher>(path, batch_options, callback);
+  // |impl_| is cancelled before |batcher_| is destroyed, so it never runs the
+  // callback once |batcher_| is gone.
+  if (!impl_->WatchWithOptions(path, batch_watch_options,
+                               BindRepeating(&ChangeBatcher::OnChange,
+                                             Unretained(batcher_.get())))) {
+    batcher_.reset();
+    return false;
+  }
+  return true;
+}
+
 bool FilePathWatcher::PlatformDelegate::WatchWithOptions(
     const FilePath& path,
     const WatchOptions& options,
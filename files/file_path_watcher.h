@@ -10,6 +10,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "base/base_export.h"
 #include "base/containers/enum_set.h"
@@ -18,6 +19,7 @@
 #include "base/memory/scoped_refptr.h"
 #include "base/sequence_checker.h"
 #include "base/task/sequenced_task_runner.h"
+#include "base/time/time.h"
 #include "build/build_config.h"
 #include "third_party/abseil-cpp/absl/types/optional.h"
 
@@ -115,6 +117,34 @@ class BASE_EXPORT FilePathWatcher {
         // BUILDFLAG(IS_ANDROID) || BUILDFLAG(IS_FUCHSIA)
   };
 
+  // Options for WatchWithBatches().
+  struct BatchOptions {
+    // How long changes are accumulated before being reported together. This
+    // bounds how late a change is reported.
+    TimeDelta latency = Milliseconds(100);
+    // Number of distinct paths a batch may hold. Beyond it, the batch only
+    // reports that it overflowed, so that bursts of changes (e.g. checking out
+    // a source tree) take bounded memory and a single rescan to handle.
+    size_t max_batch_size = 1000;
+  };
+
+  // The changes reported at once by WatchWithBatches().
+  struct BASE_EXPORT ChangeBatch {
+    ChangeBatch();
+    ChangeBatch(const ChangeBatch&);
+    ChangeBatch& operator=(const ChangeBatch&);
+    ~ChangeBatch();
+
+    // The changed paths, sorted and without duplicates. These are the full
+    // paths of the changed files on platforms which support
+    // WatchOptions::report_modified_path, and the watched path elsewhere.
+    // Only holds the watched path if |overflowed|.
+    std::vector<FilePath> paths;
+    // Whether more paths changed than BatchOptions::max_batch_size, in which
+    // case the caller should rescan the watched path.
+    bool overflowed = false;
+  };
+
   // Callback type for Watch(). |path| points to the file that was updated,
   // and |error| is true if the platform specific code detected an error. In
   // that case, the callback won't be invoked again.
@@ -123,6 +153,11 @@ class BASE_EXPORT FilePathWatcher {
   // Same as above, but includes more information about the change, if known.
   using CallbackWithChangeInfo = RepeatingCallback<
       void(const ChangeInfo&, const FilePath& path, bool error)>;
+  // Callback type for WatchWithBatches(). |error| is true if the platform
+  // specific code detected an error, in which case |batch| holds the changes
+  // pending until then, and the callback won't be invoked again.
+  using BatchCallback =
+      RepeatingCallback<void(const ChangeBatch& batch, bool error)>;
 
   // Used internally to encapsulate different members on different platforms.
   class PlatformDelegate {
@@ -213,11 +248,26 @@ class BASE_EXPORT FilePathWatcher {
                            const WatchOptions& options,
                            const CallbackWithChangeInfo& callback);
 
+  // Same as WatchWithOptions(), but coalesces the changes which happen within
+  // |batch_options.latency| of each other, and reports them in a single call
+  // of |callback|. This suits watching large trees, where a single operation
+  // may change many files at once.
+  bool WatchWithBatches(const FilePath& path,
+                        const WatchOptions& options,
+                        const BatchOptions& batch_options,
+                        const BatchCallback& callback);
+
  private:
+  class ChangeBatcher;
+
   explicit FilePathWatcher(std::unique_ptr<PlatformDelegate> delegate);
 
   std::unique_ptr<PlatformDelegate> impl_;
 
+  // Accumulates the changes reported by |impl_| for WatchWithBatches().
+  // Declared after |impl_|, which is cancelled before it is destroyed.
+  std::unique_ptr<ChangeBatcher> batcher_;
+
   SEQUENCE_CHECKER(sequence_checker_);
 };
 
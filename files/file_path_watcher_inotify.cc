@@ -24,6 +24,7 @@
 #include <vector>
 
 #include "base/containers/contains.h"
+#include "base/containers/span.h"
 #include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
 #include "base/files/file_path_watcher_inotify.h"
@@ -37,6 +38,7 @@
 #include "base/memory/scoped_refptr.h"
 #include "base/memory/weak_ptr.h"
 #include "base/posix/eintr_wrapper.h"
+#include "base/strings/string_util.h"
 #include "base/synchronization/lock.h"
 #include "base/task/sequenced_task_runner.h"
 #include "base/task/single_thread_task_runner.h"
@@ -134,8 +136,22 @@ class InotifyReader {
   // Remove |watch| if it's valid.
   void RemoveWatch(Watch watch, FilePathWatcherImpl* watcher);
 
-  // Invoked on "inotify_reader" thread to notify relevant watchers.
-  void OnInotifyEvent(const inotify_event* event);
+  // A change reported by inotify, as passed to the watchers.
+  struct Event {
+    Watch watch;
+    FilePath::StringType child;
+    FilePathWatcher::ChangeInfo change_info;
+    // Whether the object appeared.
+    bool created;
+    // Whether the object disappeared.
+    bool deleted;
+  };
+
+  // Invoked on "inotify_reader" thread to notify relevant watchers of the
+  // events read at once, in |buffer|. Each watcher is posted a single task for
+  // all of its events, which keeps bursts of changes from flooding its
+  // sequence.
+  void OnInotifyEvents(span<const char> buffer);
 
   // Returns true if any paths are actively being watched.
   bool HasWatches();
@@ -176,6 +192,10 @@ class FilePathWatcherImpl : public FilePathWatcher::PlatformDelegate {
   FilePathWatcherImpl& operator=(const FilePathWatcherImpl&) = delete;
   ~FilePathWatcherImpl() override;
 
+  // Called on the original sequence with the events read at once from
+  // inotify, which are passed to OnFilePathChanged() in order.
+  void OnFilePathsChanged(std::vector<InotifyReader::Event> events);
+
   // Called for each event coming from the watch on the original thread.
   // |fired_watch| identifies the watch that fired, |child| indicates what has
   // changed, and is relative to the currently watched path for |fired_watch|.
@@ -242,16 +262,30 @@ class FilePathWatcherImpl : public FilePathWatcher::PlatformDelegate {
   // - If |target_| does not exist, then clear all the recursive watches.
   // - Assuming |target_| exists, passing kInvalidWatch as |fired_watch| forces
   //   addition of recursive watches for |target_|.
-  // - Otherwise, only the directory associated with |fired_watch| and its
-  //   sub-directories will be reconfigured.
+  // - Otherwise, only the watches of |child| of the directory associated with
+  //   |fired_watch| and of its sub-directories are reconfigured, if |child|
+  //   is a directory which was |created_or_deleted|. Other changes don't
+  //   change which directories are watched, so the rest of the tree isn't
+  //   enumerated again.
   // Returns true if watch limit is not hit. Otherwise, returns false.
-  [[nodiscard]] bool UpdateRecursiveWatches(InotifyReader::Watch fired_watch,
-                                            bool is_dir);
+  [[nodiscard]] bool UpdateRecursiveWatches(
+      InotifyReader::Watch fired_watch,
+      const FilePath::StringType& child,
+      bool is_dir,
+      bool created_or_deleted);
 
   // Enumerate recursively through |path| and add / update watches.
   // Returns true if watch limit is not hit. Otherwise, returns false.
   [[nodiscard]] bool UpdateRecursiveWatchesForPath(const FilePath& path);
 
+  // Adds or updates the watch of the directory |path|, which is under
+  // |target_|. Returns true if watch limit is not hit. Otherwise, returns
+  // false.
+  [[nodiscard]] bool UpdateRecursiveWatch(const FilePath& path);
+
+  // Remove the recursive watches of |path| and of its sub-directories.
+  void RemoveRecursiveWatchesForPath(const FilePath& path);
+
   // Do internal bookkeeping to update mappings between |watch| and its
   // associated full path |path|.
   void TrackWatchForRecursion(InotifyReader::Watch watch, const FilePath& path);
@@ -321,13 +355,8 @@ void InotifyReaderThreadDelegate::ThreadMain() {
       return;
     }
 
-    for (size_t i = 0; i < static_cast<size_t>(bytes_read);) {
-      inotify_event* event = reinterpret_cast<inotify_event*>(&buffer[i]);
-      size_t event_size = sizeof(inotify_event) + event->len;
-      DUMP_WILL_BE_CHECK_LE(i + event_size, static_cast<size_t>(bytes_read));
-      g_inotify_reader.Get().OnInotifyEvent(event);
-      i += event_size;
-    }
+    g_inotify_reader.Get().OnInotifyEvents(
+        make_span(buffer.data(), static_cast<size_t>(bytes_read)));
   }
 }
 
@@ -396,38 +425,60 @@ void InotifyReader::RemoveWatch(Watch watch, FilePathWatcherImpl* watcher) {
   }
 }
 
-void InotifyReader::OnInotifyEvent(const inotify_event* event) {
-  if (event->mask & IN_IGNORED)
-    return;
+void InotifyReader::OnInotifyEvents(span<const char> buffer) {
+  std::map<FilePathWatcherImpl*, std::pair<WatcherEntry, std::vector<Event>>>
+      events_by_watcher;
+  {
+    AutoLock auto_lock(lock_);
+    for (size_t i = 0; i < buffer.size();) {
+      const inotify_event* event =
+          reinterpret_cast<const inotify_event*>(&buffer[i]);
+      size_t event_size = sizeof(inotify_event) + event->len;
+      DUMP_WILL_BE_CHECK_LE(i + event_size, buffer.size());
+      i += event_size;
 
-  FilePath::StringType child(event->len ? event->name : FILE_PATH_LITERAL(""));
-  AutoLock auto_lock(lock_);
+      if (event->mask & IN_IGNORED) {
+        continue;
+      }
 
-  // In racing conditions, RemoveWatch() could grab `lock_` first and remove
-  // the entry for `event->wd`.
-  auto watchers_it = watchers_.find(static_cast<Watch>(event->wd));
-  if (watchers_it == watchers_.end())
-    return;
+      // In racing conditions, RemoveWatch() could grab `lock_` first and
+      // remove the entry for `event->wd`.
+      auto watchers_it = watchers_.find(static_cast<Watch>(event->wd));
+      if (watchers_it == watchers_.end()) {
+        continue;
+      }
 
-  auto& watcher_map = watchers_it->second;
-  for (const auto& entry : watcher_map) {
-    auto& watcher_entry = entry.second;
-
-    FilePathWatcher::ChangeInfo change_info{
-        .file_path_type = event->mask & IN_ISDIR
-                              ? FilePathWatcher::FilePathType::kDirectory
-                              : FilePathWatcher::FilePathType::kFile,
-        .change_type = ToChangeType(event),
-        .cookie =
-            event->cookie ? absl::make_optional(event->cookie) : absl::nullopt,
-    };
-    bool created = event->mask & (IN_CREATE | IN_MOVED_TO);
-    bool deleted = event->mask & (IN_DELETE | IN_MOVED_FROM);
+      Event watcher_event{
+          .watch = static_cast<Watch>(event->wd),
+          .child = event->len ? event->name : FILE_PATH_LITERAL(""),
+          .change_info =
+              {
+                  .file_path_type =
+                      event->mask & IN_ISDIR
+                          ? FilePathWatcher::FilePathType::kDirectory
+                          : FilePathWatcher::FilePathType::kFile,
+                  .change_type = ToChangeType(event),
+                  .cookie = event->cookie ? absl::make_optional(event->cookie)
+                                          : absl::nullopt,
+              },
+          .created = (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0,
+          .deleted = (event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0,
+      };
+      for (const auto& [watcher, watcher_entry] : watchers_it->second) {
+        auto& [entry, events] = events_by_watcher[watcher];
+        if (events.empty()) {
+          entry = watcher_entry;
+        }
+        events.push_back(watcher_event);
+      }
+    }
+  }
+
+  for (auto& [watcher, entry_and_events] : events_by_watcher) {
+    auto& [watcher_entry, events] = entry_and_events;
     watcher_entry.task_runner->PostTask(
-        FROM_HERE,
-        BindOnce(&FilePathWatcherImpl::OnFilePathChanged, watcher_entry.watcher,
-                 static_cast<Watch>(event->wd), child, std::move(change_info),
-                 created, deleted));
+        FROM_HERE, BindOnce(&FilePathWatcherImpl::OnFilePathsChanged,
+                            watcher_entry.watcher, std::move(events)));
   }
 }
 
@@ -444,6 +495,19 @@ FilePathWatcherImpl::~FilePathWatcherImpl() {
                      task_runner()->RunsTasksInCurrentSequence());
 }
 
+void FilePathWatcherImpl::OnFilePathsChanged(
+    std::vector<InotifyReader::Event> events) {
+  WeakPtr<FilePathWatcherImpl> weak_this = weak_factory_.GetWeakPtr();
+  for (InotifyReader::Event& event : events) {
+    OnFilePathChanged(event.watch, event.child, std::move(event.change_info),
+                      event.created, event.deleted);
+    // The callback may have deleted or cancelled `this`.
+    if (!weak_this || !callback_) {
+      return;
+    }
+  }
+}
+
 void FilePathWatcherImpl::OnFilePathChanged(
     InotifyReader::Watch fired_watch,
     const FilePath::StringType& child,
@@ -522,8 +586,10 @@ void FilePathWatcherImpl::OnFilePathChanged(
         (change_on_target_path && created && PathExists(target_))) {
       if (!did_update) {
         if (!UpdateRecursiveWatches(
-                fired_watch, change_info.file_path_type ==
-                                 FilePathWatcher::FilePathType::kDirectory)) {
+                fired_watch, child,
+                change_info.file_path_type ==
+                    FilePathWatcher::FilePathType::kDirectory,
+                created || deleted)) {
           exceeded_limit = true;
           break;
         }
@@ -541,8 +607,10 @@ void FilePathWatcherImpl::OnFilePathChanged(
   if (!exceeded_limit && Contains(recursive_paths_by_watch_, fired_watch)) {
     if (!did_update) {
       if (!UpdateRecursiveWatches(
-              fired_watch, change_info.file_path_type ==
-                               FilePathWatcher::FilePathType::kDirectory)) {
+              fired_watch, child,
+              change_info.file_path_type ==
+                  FilePathWatcher::FilePathType::kDirectory,
+              created || deleted)) {
         exceeded_limit = true;
       }
     }
@@ -687,12 +755,16 @@ bool FilePathWatcherImpl::UpdateWatches() {
     path = path.Append(watch_entry.subdir);
   }
 
-  return UpdateRecursiveWatches(InotifyReader::kInvalidWatch, /*is_dir=*/false);
+  return UpdateRecursiveWatches(InotifyReader::kInvalidWatch,
+                                FilePath::StringType(), /*is_dir=*/false,
+                                /*created_or_deleted=*/false);
 }
 
 bool FilePathWatcherImpl::UpdateRecursiveWatches(
     InotifyReader::Watch fired_watch,
-    bool is_dir) {
+    const FilePath::StringType& child,
+    bool is_dir,
+    bool created_or_deleted) {
   DUMP_WILL_BE_CHECK(HasValidWatchVector());
 
   if (type_ != Type::kRecursive)
@@ -705,46 +777,42 @@ bool FilePathWatcherImpl::UpdateRecursiveWatches(
 
   // Check to see if this is a forced update or if some component of |target_|
   // has changed. For these cases, redo the watches for |target_| and below.
-  if (!Contains(recursive_paths_by_watch_, fired_watch) &&
-      fired_watch != watches_.back().watch) {
+  // This is also the case when |target_| is a symlink whose target changed.
+  auto it = recursive_paths_by_watch_.find(fired_watch);
+  if (it == recursive_paths_by_watch_.end() &&
+      (fired_watch != watches_.back().watch ||
+       !watches_.back().linkname.empty())) {
     return UpdateRecursiveWatchesForPath(target_);
   }
 
-  // Underneath |target_|, only directory changes trigger watch updates.
-  if (!is_dir)
+  // Underneath |target_|, only directories appearing or disappearing trigger
+  // watch updates. Changes to a watched directory itself have an empty
+  // |child|.
+  if (!is_dir || !created_or_deleted || child.empty())
     return true;
 
-  const FilePath& changed_dir = Contains(recursive_paths_by_watch_, fired_watch)
-                                    ? recursive_paths_by_watch_[fired_watch]
-                                    : target_;
-
-  auto start_it = recursive_watches_by_path_.upper_bound(changed_dir);
-  auto end_it = start_it;
-  for (; end_it != recursive_watches_by_path_.end(); ++end_it) {
-    const FilePath& cur_path = end_it->first;
-    if (!changed_dir.IsParent(cur_path))
-      break;
-
-    // There could be a race when another process is changing contents under
-    // `changed_dir` while chrome is watching (e.g. an Android app updating
-    // a dir with Chrome OS file manager open for the dir). In such case,
-    // `cur_dir` under `changed_dir` could exist in this loop but not in
-    // the FileEnumerator loop in the upcoming UpdateRecursiveWatchesForPath(),
-    // As a result, `g_inotify_reader` would have an entry in its `watchers_`
-    // pointing to `this` but `this` is no longer aware of that. Crash in
-    // http://crbug/990004 could happen later.
-    //
-    // Remove the watcher of `cur_path` regardless of whether it exists
-    // or not to keep `this` and `g_inotify_reader` consistent even when the
-    // race happens. The watcher will be added back if `cur_path` exists in
-    // the FileEnumerator loop in UpdateRecursiveWatchesForPath().
-    g_inotify_reader.Get().RemoveWatch(end_it->second, this);
-
-    // Keep it in sync with |recursive_watches_by_path_| crbug.com/995196.
-    recursive_paths_by_watch_.erase(end_it->second);
-  }
-  recursive_watches_by_path_.erase(start_it, end_it);
-  return UpdateRecursiveWatchesForPath(changed_dir);
+  const FilePath changed_dir =
+      (it != recursive_paths_by_watch_.end() ? it->second : target_)
+          .Append(child);
+
+  // There could be a race when another process is changing contents under
+  // `changed_dir` while chrome is watching (e.g. an Android app updating
+  // a dir with Chrome OS file manager open for the dir). In such case,
+  // a directory under `changed_dir` could still be tracked but no longer
+  // exist, or exist without being tracked yet. As a result,
+  // `g_inotify_reader` would have an entry in its `watchers_` pointing to
+  // `this` but `this` is no longer aware of that. Crash in
+  // http://crbug/990004 could happen later.
+  //
+  // Remove the watches of `changed_dir` and below regardless of whether they
+  // exist or not to keep `this` and `g_inotify_reader` consistent even when
+  // the race happens. The watches are added back for the directories which
+  // exist.
+  RemoveRecursiveWatchesForPath(changed_dir);
+  if (!DirectoryExists(changed_dir) || IsLink(changed_dir))
+    return true;
+  return UpdateRecursiveWatch(changed_dir) &&
+         UpdateRecursiveWatchesForPath(changed_dir);
 }
 
 bool FilePathWatcherImpl::UpdateRecursiveWatchesForPath(const FilePath& path) {
@@ -761,43 +829,65 @@ bool FilePathWatcherImpl::UpdateRecursiveWatchesForPath(const FilePath& path) {
   for (FilePath current = enumerator.Next(); !current.empty();
        current = enumerator.Next()) {
     DUMP_WILL_BE_CHECK(enumerator.GetInfo().IsDirectory());
+    if (!UpdateRecursiveWatch(current))
+      return false;
+  }
+  return true;
+}
 
-    // Check `recursive_watches_by_path_` as a heuristic to determine if this
-    // needs to be an add or update operation.
-    if (!Contains(recursive_watches_by_path_, current)) {
-      // Try to add new watches.
-      InotifyReader::Watch watch =
-          g_inotify_reader.Get().AddWatch(current, this);
-      if (watch == InotifyReader::kWatchLimitExceeded)
-        return false;
-
-      // The `watch` returned by inotify already exists. This is actually an
-      // update operation.
-      auto it = recursive_paths_by_watch_.find(watch);
-      if (it != recursive_paths_by_watch_.end()) {
-        recursive_watches_by_path_.erase(it->second);
-        recursive_paths_by_watch_.erase(it);
-      }
-      TrackWatchForRecursion(watch, current);
-    } else {
-      // Update existing watches.
-      InotifyReader::Watch old_watch = recursive_watches_by_path_[current];
-      DUMP_WILL_BE_CHECK_NE(InotifyReader::kInvalidWatch, old_watch);
-      InotifyReader::Watch watch =
-          g_inotify_reader.Get().AddWatch(current, this);
-      if (watch == InotifyReader::kWatchLimitExceeded)
-        return false;
-      if (watch != old_watch) {
-        g_inotify_reader.Get().RemoveWatch(old_watch, this);
-        recursive_paths_by_watch_.erase(old_watch);
-        recursive_watches_by_path_.erase(current);
-        TrackWatchForRecursion(watch, current);
-      }
+bool FilePathWatcherImpl::UpdateRecursiveWatch(const FilePath& path) {
+  // Check `recursive_watches_by_path_` as a heuristic to determine if this
+  // needs to be an add or update operation.
+  if (!Contains(recursive_watches_by_path_, path)) {
+    // Try to add new watches.
+    InotifyReader::Watch watch = g_inotify_reader.Get().AddWatch(path, this);
+    if (watch == InotifyReader::kWatchLimitExceeded)
+      return false;
+
+    // The `watch` returned by inotify already exists. This is actually an
+    // update operation.
+    auto it = recursive_paths_by_watch_.find(watch);
+    if (it != recursive_paths_by_watch_.end()) {
+      recursive_watches_by_path_.erase(it->second);
+      recursive_paths_by_watch_.erase(it);
+    }
+    TrackWatchForRecursion(watch, path);
+  } else {
+    // Update existing watches.
+    InotifyReader::Watch old_watch = recursive_watches_by_path_[path];
+    DUMP_WILL_BE_CHECK_NE(InotifyReader::kInvalidWatch, old_watch);
+    InotifyReader::Watch watch = g_inotify_reader.Get().AddWatch(path, this);
+    if (watch == InotifyReader::kWatchLimitExceeded)
+      return false;
+    if (watch != old_watch) {
+      g_inotify_reader.Get().RemoveWatch(old_watch, this);
+      recursive_paths_by_watch_.erase(old_watch);
+      recursive_watches_by_path_.erase(path);
+      TrackWatchForRecursion(watch, path);
     }
   }
   return true;
 }
 
+void FilePathWatcherImpl::RemoveRecursiveWatchesForPath(const FilePath& path) {
+  // The paths under |path| all start with it, so they follow it in
+  // |recursive_watches_by_path_|, but may be interleaved with siblings which
+  // also start with it (e.g. "dir" < "dir 2" < "dir/sub").
+  auto it = recursive_watches_by_path_.lower_bound(path);
+  while (it != recursive_watches_by_path_.end() &&
+         StartsWith(it->first.value(), path.value())) {
+    if (it->first != path && !path.IsParent(it->first)) {
+      ++it;
+      continue;
+    }
+    g_inotify_reader.Get().RemoveWatch(it->second, this);
+
+    // Keep it in sync with |recursive_watches_by_path_| crbug.com/995196.
+    recursive_paths_by_watch_.erase(it->second);
+    it = recursive_watches_by_path_.erase(it);
+  }
+}
+
 void FilePathWatcherImpl::TrackWatchForRecursion(InotifyReader::Watch watch,
                                                  const FilePath& path) {
   DUMP_WILL_BE_CHECK_EQ(type_, Type::kRecursive);
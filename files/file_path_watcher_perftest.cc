@@ -0,0 +1,198 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/file_path_watcher.h"
+
+#include <stddef.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/containers/contains.h"
+#include "base/files/file_path.h"
+#include "base/files/file_path_watcher_inotify.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/bind.h"
+#include "base/test/run_until.h"
+#include "base/test/task_environment.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+namespace base {
+
+namespace {
+
+constexpr char kMetricPrefixWatcher[] = "FilePathWatcher.";
+constexpr char kMetricWatchSetupTime[] = "watch_setup_time";
+constexpr char kMetricTimeToSettle[] = "time_to_settle";
+constexpr char kMetricCallbackCount[] = "callback_count";
+
+// The watched tree has kFanOut^1 + ... + kFanOut^kDepth directories.
+constexpr int kFanOut = 10;
+constexpr int kDepth = 5;
+constexpr size_t kDirectoryCount = 111110;
+
+// Files written to existing leaves of the tree, which must stay below the
+// inotify event queue size (/proc/sys/fs/inotify/max_queued_events).
+constexpr size_t kChurnLeafCount = 500;
+constexpr size_t kFilesPerLeaf = 4;
+// Directories created at the top of the tree, each with a file.
+constexpr int kNewDirectoryCount = 20;
+
+class FilePathWatcherPerfTest : public testing::Test {
+ protected:
+  FilePathWatcherPerfTest()
+      : task_environment_(test::TaskEnvironment::MainThreadType::IO) {}
+
+  void SetUp() override {
+    // All the watchers of the user share this limit, which must fit the tree.
+    std::string max_user_watches_string;
+    size_t max_user_watches = 0;
+    if (!ReadFileToString(FilePath("/proc/sys/fs/inotify/max_user_watches"),
+                          &max_user_watches_string) ||
+        !StringToSizeT(TrimWhitespaceASCII(max_user_watches_string, TRIM_ALL),
+                       &max_user_watches) ||
+        max_user_watches < 2 * kDirectoryCount) {
+      GTEST_SKIP() << "max_user_watches is too small";
+    }
+    max_watches_override_.emplace(2 * kDirectoryCount);
+
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    root_ = temp_dir_.GetPath().AppendASCII("tree");
+    ASSERT_TRUE(CreateDirectory(root_));
+    CreateTree(root_, kDepth);
+    ASSERT_EQ(kDirectoryCount, directory_count_);
+  }
+
+  void CreateTree(const FilePath& dir, int depth) {
+    if (depth == 0) {
+      if (leaves_.size() < kChurnLeafCount) {
+        leaves_.push_back(dir);
+      }
+      return;
+    }
+    for (int i = 0; i < kFanOut; ++i) {
+      const FilePath child = dir.AppendASCII(NumberToString(i));
+      ASSERT_TRUE(CreateDirectory(child));
+      ++directory_count_;
+      CreateTree(child, depth - 1);
+    }
+  }
+
+  // Changes the tree, and returns the paths of the files it writes.
+  std::set<FilePath> ChurnTree() {
+    std::set<FilePath> files;
+    for (const FilePath& leaf : leaves_) {
+      for (size_t i = 0; i < kFilesPerLeaf; ++i) {
+        const FilePath file = leaf.AppendASCII("file" + NumberToString(i));
+        EXPECT_TRUE(WriteFile(file, "test"));
+        files.insert(file);
+      }
+    }
+    for (int i = 0; i < kNewDirectoryCount; ++i) {
+      const FilePath dir = root_.AppendASCII(StringPrintf("new%d", i));
+      EXPECT_TRUE(CreateDirectory(dir));
+      // Wait for the directory to be watched, as inotify can't report what
+      // happens in it before.
+      EXPECT_TRUE(
+          test::RunUntil([&]() { return Contains(changed_paths_, dir); }));
+      const FilePath file = dir.AppendASCII("file");
+      EXPECT_TRUE(WriteFile(file, "test"));
+      files.insert(file);
+    }
+    return files;
+  }
+
+  bool HasSettled(const std::set<FilePath>& files) const {
+    for (const FilePath& file : files) {
+      if (!Contains(changed_paths_, file)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void ReportResults(const std::string& story,
+                     TimeDelta watch_setup_time,
+                     TimeDelta time_to_settle) {
+    perf_test::PerfResultReporter reporter(kMetricPrefixWatcher, story);
+    reporter.RegisterImportantMetric(kMetricWatchSetupTime, "ms");
+    reporter.RegisterImportantMetric(kMetricTimeToSettle, "ms");
+    reporter.RegisterImportantMetric(kMetricCallbackCount, "count");
+    reporter.AddResult(kMetricWatchSetupTime,
+                       watch_setup_time.InMillisecondsF());
+    reporter.AddResult(kMetricTimeToSettle, time_to_settle.InMillisecondsF());
+    reporter.AddResult(kMetricCallbackCount, callback_count_);
+  }
+
+  test::TaskEnvironment task_environment_;
+  absl::optional<ScopedMaxNumberOfInotifyWatchesOverrideForTest>
+      max_watches_override_;
+  ScopedTempDir temp_dir_;
+  FilePath root_;
+  size_t directory_count_ = 0;
+  std::vector<FilePath> leaves_;
+
+  std::set<FilePath> changed_paths_;
+  size_t callback_count_ = 0;
+};
+
+}  // namespace
+
+// Reports each change in its own callback.
+TEST_F(FilePathWatcherPerfTest, PerChange) {
+  FilePathWatcher watcher;
+  TimeTicks start = TimeTicks::Now();
+  ASSERT_TRUE(watcher.WatchWithOptions(
+      root_,
+      {.type = FilePathWatcher::Type::kRecursive,
+       .report_modified_path = true},
+      BindLambdaForTesting([&](const FilePath& path, bool error) {
+        ASSERT_FALSE(error);
+        ++callback_count_;
+        changed_paths_.insert(path);
+      })));
+  const TimeDelta watch_setup_time = TimeTicks::Now() - start;
+
+  start = TimeTicks::Now();
+  const std::set<FilePath> files = ChurnTree();
+  ASSERT_TRUE(test::RunUntil([&]() { return HasSettled(files); }));
+  ReportResults("per_change", watch_setup_time, TimeTicks::Now() - start);
+}
+
+// Reports the changes in batches.
+TEST_F(FilePathWatcherPerfTest, Batched) {
+  FilePathWatcher watcher;
+  TimeTicks start = TimeTicks::Now();
+  FilePathWatcher::BatchOptions batch_options;
+  // The new directories are waited for one by one, which the default latency
+  // would make dominate the time to settle.
+  batch_options.latency = Milliseconds(10);
+  // Large enough for the whole churn, which is checked path by path.
+  batch_options.max_batch_size = 2 * kChurnLeafCount * kFilesPerLeaf;
+  ASSERT_TRUE(watcher.WatchWithBatches(
+      root_, {.type = FilePathWatcher::Type::kRecursive}, batch_options,
+      BindLambdaForTesting(
+          [&](const FilePathWatcher::ChangeBatch& batch, bool error) {
+            ASSERT_FALSE(error);
+            ASSERT_FALSE(batch.overflowed);
+            ++callback_count_;
+            changed_paths_.insert(batch.paths.begin(), batch.paths.end());
+          })));
+  const TimeDelta watch_setup_time = TimeTicks::Now() - start;
+
+  start = TimeTicks::Now();
+  const std::set<FilePath> files = ChurnTree();
+  ASSERT_TRUE(test::RunUntil([&]() { return HasSettled(files); }));
+  ReportResults("batched", watch_setup_time, TimeTicks::Now() - start);
+}
+
+}  // namespace base
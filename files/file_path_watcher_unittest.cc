@@ -6,10 +6,12 @@
 
 #include <list>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "base/atomic_sequence_num.h"
+#include "base/containers/contains.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/files/scoped_temp_dir.h"
@@ -1765,6 +1767,124 @@ TEST_F(FilePathWatcherTest, ReturnWatchedPath_NonRecursiveInRootFolder) {
   delegate.RunUntilEventsMatch(event_expecter);
 }
 
+// Verify that changes within the latency are reported together, without
+// duplicates.
+TEST_F(FilePathWatcherTest, WatchWithBatches) {
+  FilePathWatcher watcher;
+  FilePath watched_folder(temp_dir_.GetPath().AppendASCII("watched_folder"));
+  FilePath file1(watched_folder.AppendASCII("file1"));
+  FilePath file2(watched_folder.AppendASCII("file2"));
+  ASSERT_TRUE(CreateDirectory(watched_folder));
+
+  std::vector<FilePathWatcher::ChangeBatch> batches;
+  ASSERT_TRUE(watcher.WatchWithBatches(
+      watched_folder, {.type = FilePathWatcher::Type::kRecursive},
+      {.latency = TestTimeouts::tiny_timeout()},
+      BindLambdaForTesting(
+          [&](const FilePathWatcher::ChangeBatch& batch, bool error) {
+            EXPECT_FALSE(error);
+            batches.push_back(batch);
+          })));
+
+  // Each write fires several events.
+  ASSERT_TRUE(WriteFile(file2, "test"));
+  ASSERT_TRUE(WriteFile(file1, "test"));
+  ASSERT_TRUE(WriteFile(file1, "test123"));
+  ASSERT_TRUE(test::RunUntil([&]() { return !batches.empty(); }));
+  ASSERT_EQ(1u, batches.size());
+  EXPECT_THAT(batches[0].paths, testing::ElementsAre(file1, file2));
+  EXPECT_FALSE(batches[0].overflowed);
+
+  ASSERT_TRUE(DeleteFile(file2));
+  ASSERT_TRUE(test::RunUntil([&]() { return batches.size() == 2u; }));
+  EXPECT_THAT(batches[1].paths, testing::ElementsAre(file2));
+}
+
+// Verify that a batch of more paths than the maximum only reports that it
+// overflowed, and that the next batch starts over.
+TEST_F(FilePathWatcherTest, WatchWithBatchesOverflow) {
+  FilePathWatcher watcher;
+  FilePath watched_folder(temp_dir_.GetPath().AppendASCII("watched_folder"));
+  ASSERT_TRUE(CreateDirectory(watched_folder));
+
+  std::vector<FilePathWatcher::ChangeBatch> batches;
+  ASSERT_TRUE(watcher.WatchWithBatches(
+      watched_folder, {.type = FilePathWatcher::Type::kRecursive},
+      {.latency = TestTimeouts::tiny_timeout(), .max_batch_size = 2},
+      BindLambdaForTesting(
+          [&](const FilePathWatcher::ChangeBatch& batch, bool error) {
+            EXPECT_FALSE(error);
+            batches.push_back(batch);
+          })));
+
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(
+        WriteFile(watched_folder.AppendASCII(StringPrintf("file%d", i)), ""));
+  }
+  ASSERT_TRUE(test::RunUntil([&]() { return !batches.empty(); }));
+  EXPECT_THAT(batches[0].paths, testing::ElementsAre(watched_folder));
+  EXPECT_TRUE(batches[0].overflowed);
+
+  FilePath file(watched_folder.AppendASCII("file0"));
+  ASSERT_TRUE(DeleteFile(file));
+  ASSERT_TRUE(test::RunUntil([&]() { return batches.size() == 2u; }));
+  EXPECT_THAT(batches[1].paths, testing::ElementsAre(file));
+  EXPECT_FALSE(batches[1].overflowed);
+}
+
+// Verify that directories created or deleted under a recursive watch are
+// watched or unwatched along with their sub-directories, without affecting
+// their siblings.
+TEST_F(FilePathWatcherTest, RecursiveWatchOfNewAndDeletedSubtrees) {
+  FilePathWatcher watcher;
+  FilePath watched_folder(temp_dir_.GetPath().AppendASCII("watched_folder"));
+  // "a b" sorts between "a" and "a/b".
+  FilePath dir(watched_folder.AppendASCII("a"));
+  FilePath nested_dir(dir.AppendASCII("b").AppendASCII("c"));
+  FilePath sibling_dir(watched_folder.AppendASCII("a b").AppendASCII("d"));
+  ASSERT_TRUE(CreateDirectory(watched_folder));
+
+  std::set<FilePath> changed_paths;
+  ASSERT_TRUE(watcher.WatchWithOptions(
+      watched_folder,
+      {.type = FilePathWatcher::Type::kRecursive,
+       .report_modified_path = true},
+      BindLambdaForTesting([&](const FilePath& path, bool error) {
+        EXPECT_FALSE(error);
+        changed_paths.insert(path);
+      })));
+
+  // The nested directories may be created before the watch of their parent
+  // is added, but are watched as well.
+  ASSERT_TRUE(CreateDirectory(nested_dir));
+  ASSERT_TRUE(CreateDirectory(sibling_dir));
+  ASSERT_TRUE(test::RunUntil([&]() {
+    return Contains(changed_paths, dir) &&
+           Contains(changed_paths, sibling_dir.DirName());
+  }));
+  FilePath file(nested_dir.AppendASCII("file"));
+  ASSERT_TRUE(WriteFile(file, "test"));
+  ASSERT_TRUE(test::RunUntil([&]() { return Contains(changed_paths, file); }));
+
+  changed_paths.clear();
+  ASSERT_TRUE(DeletePathRecursively(dir));
+  ASSERT_TRUE(test::RunUntil([&]() { return Contains(changed_paths, dir); }));
+
+  // The sibling directory is still watched.
+  FilePath sibling_file(sibling_dir.AppendASCII("file"));
+  ASSERT_TRUE(WriteFile(sibling_file, "test"));
+  ASSERT_TRUE(test::RunUntil(
+      [&]() { return Contains(changed_paths, sibling_file); }));
+
+  // The deleted directory is watched again once recreated.
+  changed_paths.clear();
+  ASSERT_TRUE(CreateDirectory(dir));
+  ASSERT_TRUE(test::RunUntil([&]() { return Contains(changed_paths, dir); }));
+  file = dir.AppendASCII("file");
+  ASSERT_TRUE(WriteFile(file, "test"));
+  ASSERT_TRUE(test::RunUntil([&]() { return Contains(changed_paths, file); }));
+}
+
 #endif  // BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) ||
         // BUILDFLAG(IS_ANDROID)
 
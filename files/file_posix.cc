@@ -12,14 +12,20 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdint.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <vector>
+
 static_assert(sizeof(base::stat_wrapper_t::st_size) >= 8);
 
 #include "base/check_op.h"
 #include "base/notreached.h"
+#include "base/numerics/checked_math.h"
 #include "base/numerics/safe_conversions.h"
 #include "base/posix/eintr_wrapper.h"
 #include "base/strings/utf_string_conversions.h"
@@ -126,6 +132,72 @@ File::Error CallFcntlFlock(PlatformFile file,
 }
 #endif  // BUILDFLAG(IS_NACL)
 
+#if (BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS)) && !defined(RWF_NOWAIT)
+// Defined by Linux 4.14 and later headers.
+#define RWF_NOWAIT 0x00000008
+#endif
+
+// Returns the total size of |buffers|, or nullopt if it doesn't fit in an int,
+// which the read and write functions return.
+template <typename T>
+absl::optional<int> GetTotalSize(span<const span<T>> buffers) {
+  CheckedNumeric<int> size = 0;
+  for (span<T> buffer : buffers) {
+    size += buffer.size();
+  }
+  return size.IsValid() ? absl::make_optional(size.ValueOrDie())
+                        : absl::nullopt;
+}
+
+// preadv(2) and pwritev(2) are only available since macOS 11.
+#if !BUILDFLAG(IS_NACL) && !BUILDFLAG(IS_APPLE)
+template <typename T>
+std::vector<iovec> ToIovecs(span<const span<T>> buffers) {
+  std::vector<iovec> iovecs;
+  iovecs.reserve(buffers.size());
+  for (span<T> buffer : buffers) {
+    if (!buffer.empty()) {
+      iovecs.push_back({const_cast<uint8_t*>(buffer.data()), buffer.size()});
+    }
+  }
+  return iovecs;
+}
+
+// Runs |transfer| with the parts of |buffers| which weren't transferred yet,
+// as at most IOV_MAX iovecs, and the number of bytes transferred so far, until
+// all |size| bytes are transferred or |transfer| returns 0 or an error.
+// Returns the number of bytes transferred if any, or what |transfer| returned.
+template <typename T, typename Transfer>
+int TransferBuffers(span<const span<T>> buffers, int size, Transfer transfer) {
+  std::vector<iovec> iovecs = ToIovecs(buffers);
+  size_t first = 0;
+  int bytes_transferred = 0;
+  ssize_t rv = 0;
+  while (bytes_transferred < size) {
+    const int count =
+        static_cast<int>(std::min<size_t>(iovecs.size() - first, IOV_MAX));
+    rv = transfer(iovecs.data() + first, count, bytes_transferred);
+    if (rv <= 0) {
+      break;
+    }
+    bytes_transferred += rv;
+
+    // Skip what was transferred.
+    size_t remaining = static_cast<size_t>(rv);
+    while (remaining > 0 && remaining >= iovecs[first].iov_len) {
+      remaining -= iovecs[first].iov_len;
+      ++first;
+    }
+    if (remaining > 0) {
+      iovecs[first].iov_base =
+          static_cast<uint8_t*>(iovecs[first].iov_base) + remaining;
+      iovecs[first].iov_len -= remaining;
+    }
+  }
+  return bytes_transferred ? bytes_transferred : checked_cast<int>(rv);
+}
+#endif  // !BUILDFLAG(IS_NACL) && !BUILDFLAG(IS_APPLE)
+
 }  // namespace
 
 void File::Info::FromStat(const stat_wrapper_t& stat_info) {
@@ -366,6 +438,112 @@ int File::WriteAtCurrentPosNoBestEffort(const char* data, int size) {
       HANDLE_EINTR(write(file_.get(), data, static_cast<size_t>(size))));
 }
 
+int File::ReadV(int64_t offset, span<const span<uint8_t>> buffers) {
+  ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+  DCHECK(IsValid());
+  const absl::optional<int> size = GetTotalSize(buffers);
+  if (!size || offset < 0 ||
+      !IsValueInRangeForNumericType<off_t>(offset + *size)) {
+    return -1;
+  }
+
+  SCOPED_FILE_TRACE_WITH_SIZE("ReadV", *size);
+
+#if BUILDFLAG(IS_NACL) || BUILDFLAG(IS_APPLE)
+  int bytes_read = 0;
+  for (span<uint8_t> buffer : buffers) {
+    const int buffer_size = static_cast<int>(buffer.size());
+    const int rv = Read(offset + bytes_read,
+                        reinterpret_cast<char*>(buffer.data()), buffer_size);
+    if (rv < 0) {
+      return bytes_read ? bytes_read : rv;
+    }
+    bytes_read += rv;
+    if (rv < buffer_size) {
+      break;
+    }
+  }
+  return bytes_read;
+#else
+  return TransferBuffers(
+      buffers, *size, [&](const iovec* iovecs, int count, int bytes_read) {
+        return HANDLE_EINTR(preadv(file_.get(), iovecs, count,
+                                   static_cast<off_t>(offset + bytes_read)));
+      });
+#endif  // BUILDFLAG(IS_NACL) || BUILDFLAG(IS_APPLE)
+}
+
+int File::ReadVNoWait(int64_t offset, span<const span<uint8_t>> buffers) {
+  // Deliberately no ScopedBlockingCall, as this doesn't block.
+  DCHECK(IsValid());
+  const absl::optional<int> size = GetTotalSize(buffers);
+  if (!size || offset < 0 ||
+      !IsValueInRangeForNumericType<off_t>(offset + *size)) {
+    return -1;
+  }
+  if (*size == 0) {
+    return 0;
+  }
+
+  SCOPED_FILE_TRACE_WITH_SIZE("ReadVNoWait", *size);
+
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS)
+  // A single call, as a short read means that the rest would block. This fails
+  // with EAGAIN if nothing can be read without blocking, and with EOPNOTSUPP
+  // or ENOSYS on kernels or file systems which don't support RWF_NOWAIT.
+  std::vector<iovec> iovecs = ToIovecs(buffers);
+  return checked_cast<int>(HANDLE_EINTR(
+      preadv2(file_.get(), iovecs.data(),
+              static_cast<int>(std::min<size_t>(iovecs.size(), IOV_MAX)),
+              static_cast<off_t>(offset), RWF_NOWAIT)));
+#else
+  return -1;
+#endif  // BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS)
+}
+
+int File::WriteV(int64_t offset, span<const span<const uint8_t>> buffers) {
+  ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+  DCHECK(IsValid());
+  const absl::optional<int> size = GetTotalSize(buffers);
+  if (!size || offset < 0 ||
+      !IsValueInRangeForNumericType<off_t>(offset + *size)) {
+    return -1;
+  }
+
+  SCOPED_FILE_TRACE_WITH_SIZE("WriteV", *size);
+
+#if BUILDFLAG(IS_NACL) || BUILDFLAG(IS_APPLE)
+  int bytes_written = 0;
+  for (span<const uint8_t> buffer : buffers) {
+    const int buffer_size = static_cast<int>(buffer.size());
+    // Write() writes at the end of files opened with FLAG_APPEND.
+    const int rv =
+        Write(offset + bytes_written,
+              reinterpret_cast<const char*>(buffer.data()), buffer_size);
+    if (rv < 0) {
+      return bytes_written ? bytes_written : rv;
+    }
+    bytes_written += rv;
+    if (rv < buffer_size) {
+      break;
+    }
+  }
+  return bytes_written;
+#else
+  if (IsOpenAppend(file_.get())) {
+    return TransferBuffers(
+        buffers, *size, [&](const iovec* iovecs, int count, int) {
+          return HANDLE_EINTR(writev(file_.get(), iovecs, count));
+        });
+  }
+  return TransferBuffers(
+      buffers, *size, [&](const iovec* iovecs, int count, int bytes_written) {
+        const off_t write_offset = static_cast<off_t>(offset + bytes_written);
+        return HANDLE_EINTR(pwritev(file_.get(), iovecs, count, write_offset));
+      });
+#endif  // BUILDFLAG(IS_NACL) || BUILDFLAG(IS_APPLE)
+}
+
 int64_t File::GetLength() {
   DCHECK(IsValid());
 
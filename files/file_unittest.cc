@@ -6,8 +6,11 @@
 
 #include <stdint.h>
 
+#include <string>
 #include <utility>
+#include <vector>
 
+#include "base/containers/span.h"
 #include "base/files/file_util.h"
 #include "base/files/memory_mapped_file.h"
 #include "base/files/scoped_temp_dir.h"
@@ -321,6 +324,118 @@ TEST(FileTest, Append) {
     EXPECT_EQ(append_data_to_write[i], data_read_1[kTestDataSize + i]);
 }
 
+TEST(FileTest, ReadVWriteV) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath file_path = temp_dir.GetPath().AppendASCII("vectored_file");
+  File file(file_path, base::File::FLAG_CREATE | base::File::FLAG_READ |
+                           base::File::FLAG_WRITE);
+  ASSERT_TRUE(file.IsValid());
+
+  // Write nothing.
+  EXPECT_EQ(0, file.WriteV(0, {}));
+
+  // Write "header" and "body", with an empty buffer in between.
+  const std::string kHeader = "header";
+  const std::string kBody = "body";
+  const base::span<const uint8_t> write_buffers[] = {
+      base::as_bytes(base::make_span(kHeader)),
+      base::span<const uint8_t>(),
+      base::as_bytes(base::make_span(kBody)),
+  };
+  EXPECT_EQ(10, file.WriteV(0, write_buffers));
+  EXPECT_EQ(10, file.GetLength());
+
+  // Read it back into buffers of other sizes.
+  uint8_t first[4];
+  uint8_t second[8];
+  const base::span<uint8_t> read_buffers[] = {first, second};
+  EXPECT_EQ(10, file.ReadV(0, read_buffers));
+  EXPECT_EQ("head", std::string(first, first + 4));
+  EXPECT_EQ("erbody", std::string(second, second + 6));
+
+  // Read past the end of the file.
+  EXPECT_EQ(6, file.ReadV(4, read_buffers));
+  EXPECT_EQ("erbo", std::string(first, first + 4));
+  EXPECT_EQ("dy", std::string(second, second + 2));
+  EXPECT_EQ(0, file.ReadV(10, read_buffers));
+
+  // Negative offsets fail.
+  EXPECT_EQ(-1, file.ReadV(-1, read_buffers));
+  EXPECT_EQ(-1, file.WriteV(-1, write_buffers));
+}
+
+TEST(FileTest, ReadVWriteVManyBuffers) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath file_path = temp_dir.GetPath().AppendASCII("vectored_file");
+  File file(file_path, base::File::FLAG_CREATE | base::File::FLAG_READ |
+                           base::File::FLAG_WRITE);
+  ASSERT_TRUE(file.IsValid());
+
+  // More buffers than a single system call takes on POSIX (IOV_MAX).
+  const size_t kBufferCount = 3000;
+  std::vector<uint8_t> data(kBufferCount * 2);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<uint8_t>(i);
+  std::vector<base::span<const uint8_t>> write_buffers;
+  for (size_t i = 0; i < kBufferCount; ++i)
+    write_buffers.push_back(base::make_span(data).subspan(i * 2, 2));
+  EXPECT_EQ(static_cast<int>(data.size()), file.WriteV(0, write_buffers));
+
+  std::vector<uint8_t> data_read(data.size());
+  std::vector<base::span<uint8_t>> read_buffers;
+  for (size_t i = 0; i < kBufferCount; ++i)
+    read_buffers.push_back(base::make_span(data_read).subspan(i * 2, 2));
+  EXPECT_EQ(static_cast<int>(data.size()), file.ReadV(0, read_buffers));
+  EXPECT_EQ(data, data_read);
+}
+
+TEST(FileTest, WriteVAppend) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath file_path = temp_dir.GetPath().AppendASCII("append_file");
+  ASSERT_TRUE(base::WriteFile(file_path, "test"));
+  File file(file_path, base::File::FLAG_OPEN | base::File::FLAG_READ |
+                           base::File::FLAG_APPEND);
+  ASSERT_TRUE(file.IsValid());
+
+  // The offset is ignored.
+  const std::string kData[] = {"7", "8"};
+  const base::span<const uint8_t> buffers[] = {
+      base::as_bytes(base::make_span(kData[0])),
+      base::as_bytes(base::make_span(kData[1])),
+  };
+  EXPECT_EQ(2, file.WriteV(0, buffers));
+
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(file_path, &contents));
+  EXPECT_EQ("test78", contents);
+}
+
+TEST(FileTest, ReadVNoWait) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath file_path = temp_dir.GetPath().AppendASCII("cached_file");
+  ASSERT_TRUE(base::WriteFile(file_path, "cached"));
+  File file(file_path, base::File::FLAG_OPEN | base::File::FLAG_READ);
+  ASSERT_TRUE(file.IsValid());
+
+  uint8_t data[6];
+  const base::span<uint8_t> buffers[] = {data};
+  const int bytes_read = file.ReadVNoWait(0, buffers);
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS)
+  // The data was just written, so it is in the page cache, unless the kernel
+  // or the file system doesn't support non-blocking reads.
+  if (bytes_read < 0)
+    GTEST_SKIP() << "RWF_NOWAIT isn't supported";
+  EXPECT_EQ(6, bytes_read);
+  EXPECT_EQ("cached", std::string(data, data + 6));
+#else
+  EXPECT_EQ(-1, bytes_read);
+#endif
+}
+
 
 TEST(FileTest, Length) {
   base::ScopedTempDir temp_dir;
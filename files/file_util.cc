@@ -12,6 +12,8 @@
 #endif
 #include <stdio.h>
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <limits>
 #include <memory>
@@ -23,7 +25,9 @@
 #include "base/containers/span.h"
 #include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
 #include "base/functional/function_ref.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/notreached.h"
 #include "base/posix/eintr_wrapper.h"
 #include "base/strings/string_piece.h"
@@ -37,10 +41,28 @@
 #include <windows.h>
 #endif
 
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "base/files/directory_walker_linux.h"
+#include "base/system/sys_info.h"
+#include "base/task/thread_pool/thread_pool_instance.h"
+#endif
+
 namespace base {
 
 namespace {
 
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+// Maximum number of threads ComputeDirectorySize() reads directories from.
+constexpr int kMaxDirectorySizeConcurrency = 8;
+
+// See internal::SetMaxReadSizeForTesting().
+size_t g_max_read_size_for_testing = 0;
+#endif
+
 #if !BUILDFLAG(IS_WIN)
 
 void RunAndReply(OnceCallback<bool()> action_callback,
@@ -132,6 +154,103 @@ bool ReadStreamToSpanWithMaxSize(
   return read_status;
 }
 
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+
+// Same as ReadStreamToSpanWithMaxSize(), but reads the file at |path| with
+// pread(2) straight into the container, which is sized from a single
+// fstat(2). Reading a regular file of the size it reports then takes a
+// single read, instead of the several reads and copies of stdio, and the
+// container is resized at most twice.
+//
+// Files which grow while being read are read until EOF. Files which report a
+// size of 0, or aren't regular files (e.g. proc files, pipes), are read in
+// chunks until EOF, as their size can't be trusted.
+bool ReadFileToSpanWithMaxSize(const FilePath& path,
+                               size_t max_size,
+                               FunctionRef<span<uint8_t>(size_t)> resize_span) {
+  ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+  ScopedFD fd(HANDLE_EINTR(open(path.value().c_str(), O_RDONLY | O_CLOEXEC)));
+  if (!fd.is_valid()) {
+    return false;
+  }
+
+  constexpr size_t kDefaultChunkSize = 1 << 16;
+  constexpr size_t kSmallChunkSize = 4096;
+  size_t chunk_size = kSmallChunkSize;
+  // Whether the file has a size which can be trusted. Then a read shorter than
+  // requested, once that size was read, means EOF, which saves the read
+  // returning 0 otherwise needed to find it. Other files are read
+  // sequentially, as some of them (e.g. pipes, or some proc files) don't
+  // support pread(2).
+  bool is_sized_regular_file = false;
+  size_t file_size = 0;
+  stat_wrapper_t file_info = {};
+  if (!File::Fstat(fd.get(), &file_info) && file_info.st_size > 0) {
+    file_size = static_cast<size_t>(file_info.st_size);
+    chunk_size = file_size;
+    is_sized_regular_file = S_ISREG(file_info.st_mode);
+  }
+
+  // Ask for a byte more than expected, so that a file which grew is noticed.
+  chunk_size = std::min(chunk_size, max_size) + 1;
+  size_t bytes_read_so_far = 0;
+  bool read_status = true;
+  for (;;) {
+    span<uint8_t> bytes_span = resize_span(bytes_read_so_far + chunk_size);
+    DCHECK_EQ(bytes_span.size(), bytes_read_so_far + chunk_size);
+    uint8_t* buffer = bytes_span.data() + bytes_read_so_far;
+    const size_t read_size =
+        g_max_read_size_for_testing
+            ? std::min(chunk_size, g_max_read_size_for_testing)
+            : chunk_size;
+    const ssize_t bytes_read_this_pass =
+        is_sized_regular_file
+            ? HANDLE_EINTR(pread(fd.get(), buffer, read_size,
+                                 static_cast<off_t>(bytes_read_so_far)))
+            : HANDLE_EINTR(read(fd.get(), buffer, read_size));
+    if (bytes_read_this_pass <= 0) {
+      read_status = bytes_read_this_pass == 0;
+      break;
+    }
+    const size_t bytes_read = static_cast<size_t>(bytes_read_this_pass);
+    if (max_size - bytes_read_so_far < bytes_read) {
+      // Read more than max_size bytes, bail out.
+      bytes_read_so_far = max_size;
+      read_status = false;
+      break;
+    }
+    bytes_read_so_far += bytes_read;
+    if (is_sized_regular_file && bytes_read < chunk_size) {
+      if (bytes_read_so_far == file_size) {
+        break;
+      }
+      // Reads may be short before EOF: Linux reads at most 0x7ffff000 bytes
+      // at once, and some file systems (e.g. FUSE, NFS) return less than
+      // asked for. Read the rest of the chunk. Past the size, the file grew,
+      // and is read until EOF.
+      if (bytes_read_so_far < file_size) {
+        chunk_size -= bytes_read;
+        continue;
+      }
+    }
+    // Grow geometrically, so that large files of unknown size aren't copied
+    // over and over by the resizes.
+    chunk_size = std::max(kDefaultChunkSize, bytes_read_so_far);
+    if (max_size - bytes_read_so_far < chunk_size) {
+      chunk_size = max_size - bytes_read_so_far + 1;
+    }
+  }
+
+  // Trim the container down to the number of bytes that were actually read.
+  span<uint8_t> bytes_span = resize_span(bytes_read_so_far);
+  DCHECK_EQ(bytes_span.size(), bytes_read_so_far);
+
+  return read_status;
+}
+
+#endif  // BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) ||
+        // BUILDFLAG(IS_ANDROID)
+
 }  // namespace
 
 #if !BUILDFLAG(IS_WIN)
@@ -158,11 +277,28 @@ OnceClosure GetDeletePathRecursivelyCallback(
 #endif  // !BUILDFLAG(IS_WIN)
 
 int64_t ComputeDirectorySize(const FilePath& root_path) {
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+  DirectoryTreeWalkOptions options;
+  options.read_metadata = true;
+  // Reading large trees in parallel hides the latency of the file system.
+  if (ThreadPoolInstance::Get()) {
+    options.max_concurrency = static_cast<size_t>(
+        std::min(kMaxDirectorySizeConcurrency, SysInfo::NumberOfProcessors()));
+  }
+  std::atomic<int64_t> running_size{0};
+  WalkDirectoryTree(root_path, options, [&](const DirectoryTreeEntry& entry) {
+    if (!entry.is_directory) {
+      running_size.fetch_add(entry.size, std::memory_order_relaxed);
+    }
+  });
+  return running_size.load(std::memory_order_relaxed);
+#else
   int64_t running_size = 0;
   FileEnumerator file_iter(root_path, true, FileEnumerator::FILES);
   while (!file_iter.Next().empty())
     running_size += file_iter.GetInfo().GetSize();
   return running_size;
+#endif
 }
 
 bool Move(const FilePath& from_path, const FilePath& to_path) {
@@ -173,14 +309,22 @@ bool Move(const FilePath& from_path, const FilePath& to_path) {
 
 bool CopyFileContents(File& infile, File& outfile) {
 #if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+  // Try the ways of copying within the kernel, from the cheapest. Any failures
+  // which allow retrying another way will not have modified either file offset
+  // or size.
+  if (internal::CopyFileContentsWithReflink(infile, outfile)) {
+    return true;
+  }
   bool retry_slow = false;
   bool res =
-      internal::CopyFileContentsWithSendfile(infile, outfile, retry_slow);
+      internal::CopyFileContentsWithCopyFileRange(infile, outfile, retry_slow);
+  if (res || !retry_slow) {
+    return res;
+  }
+  res = internal::CopyFileContentsWithSendfile(infile, outfile, retry_slow);
   if (res || !retry_slow) {
     return res;
   }
-  // Any failures which allow retrying using read/write will not have modified
-  // either file offset or size.
 #endif
 
   static constexpr size_t kBufferSize = 32768;
@@ -327,23 +471,56 @@ absl::optional<std::vector<uint8_t>> ReadFileToBytes(const FilePath& path) {
     return absl::nullopt;
   }
 
+  std::vector<uint8_t> bytes;
+  auto resize_span = [&bytes](size_t size) {
+    bytes.resize(size);
+    return make_span(bytes);
+  };
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+  if (!ReadFileToSpanWithMaxSize(path, std::numeric_limits<size_t>::max(),
+                                 resize_span)) {
+    return absl::nullopt;
+  }
+#else
   ScopedFILE file_stream(OpenFile(path, "rb"));
   if (!file_stream) {
     return absl::nullopt;
   }
 
-  std::vector<uint8_t> bytes;
   if (!ReadStreamToSpanWithMaxSize(file_stream.get(),
                                    std::numeric_limits<size_t>::max(),
-                                   [&bytes](size_t size) {
-                                     bytes.resize(size);
-                                     return make_span(bytes);
-                                   })) {
+                                   resize_span)) {
     return absl::nullopt;
   }
+#endif  // BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) ||
+        // BUILDFLAG(IS_ANDROID)
   return bytes;
 }
 
+scoped_refptr<RefCountedMemory> ReadFileToRefCountedMemory(
+    const FilePath& path,
+    size_t min_size_to_map) {
+  if (path.ReferencesParent()) {
+    return nullptr;
+  }
+
+  File::Info info;
+  if (GetFileInfo(path, &info) && !info.is_directory && info.size > 0 &&
+      static_cast<uint64_t>(info.size) >= min_size_to_map) {
+    auto mapped_file = std::make_unique<MemoryMappedFile>();
+    if (mapped_file->Initialize(path)) {
+      return MakeRefCounted<RefCountedMemoryMappedFile>(std::move(mapped_file));
+    }
+    // Fall back to reading files which can't be mapped.
+  }
+
+  absl::optional<std::vector<uint8_t>> bytes = ReadFileToBytes(path);
+  if (!bytes) {
+    return nullptr;
+  }
+  return RefCountedBytes::TakeVector(&bytes.value());
+}
+
 bool ReadFileToString(const FilePath& path, std::string* contents) {
   return ReadFileToStringWithMaxSize(path, contents,
                                      std::numeric_limits<size_t>::max());
@@ -356,10 +533,24 @@ bool ReadFileToStringWithMaxSize(const FilePath& path,
     contents->clear();
   if (path.ReferencesParent())
     return false;
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+  std::string content_string;
+  bool read_success = ReadFileToSpanWithMaxSize(
+      path, max_size, [&content_string](size_t size) {
+        content_string.resize(size);
+        return as_writable_bytes(make_span(content_string));
+      });
+  if (contents) {
+    contents->swap(content_string);
+  }
+  return read_success;
+#else
   ScopedFILE file_stream(OpenFile(path, "rb"));
   if (!file_stream)
     return false;
   return ReadStreamToStringWithMaxSize(file_stream.get(), max_size, contents);
+#endif  // BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) ||
+        // BUILDFLAG(IS_ANDROID)
 }
 
 bool IsDirectoryEmpty(const FilePath& dir_path) {
@@ -478,6 +669,13 @@ FilePath GetUniquePath(const FilePath& path) {
 
 namespace internal {
 
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+void SetMaxReadSizeForTesting(size_t max_read_size) {
+  g_max_read_size_for_testing = max_read_size;
+}
+#endif  // BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) ||
+        // BUILDFLAG(IS_ANDROID)
+
 bool PreReadFileSlow(const FilePath& file_path, int64_t max_bytes) {
   DCHECK_GE(max_bytes, 0);
 
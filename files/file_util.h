@@ -22,6 +22,7 @@
 #include "base/files/file_path.h"
 #include "base/files/scoped_file.h"
 #include "base/functional/callback.h"
+#include "base/memory/scoped_refptr.h"
 #include "build/build_config.h"
 #include "third_party/abseil-cpp/absl/types/optional.h"
 
@@ -36,6 +37,7 @@
 namespace base {
 
 class Environment;
+class RefCountedMemory;
 class Time;
 
 //-----------------------------------------------------------------------------
@@ -68,7 +70,9 @@ MakeAbsoluteFilePathNoResolveSymbolicLinks(const FilePath& input);
 // If the path does not exist the function returns 0.
 //
 // This function is implemented using the FileEnumerator class so it is not
-// particularly speedy on any platform.
+// particularly speedy on most platforms. On Linux, ChromeOS and Android, it
+// reads directories in parallel when a ThreadPoolInstance exists (see
+// WalkDirectoryTree()).
 BASE_EXPORT int64_t ComputeDirectorySize(const FilePath& root_path);
 
 // Deletes the given path, whether it's a file or a directory.
@@ -178,6 +182,9 @@ BASE_EXPORT bool CopyFile(const FilePath& from_path, const FilePath& to_path);
 // The files are taken as is: the copy is done starting from the current offset
 // of |infile| until the end of |infile| is reached, into the current offset of
 // |outfile|.
+// On Linux, ChromeOS and Android, the copy is done within the kernel when
+// possible: by sharing extents (reflink), with copy_file_range(2), or with
+// sendfile(2), before falling back to reading and writing through a buffer.
 BASE_EXPORT bool CopyFileContents(File& infile, File& outfile);
 
 // Copies the given path, and optionally all subdirectories and their contents
@@ -228,6 +235,15 @@ BASE_EXPORT bool TextContentsEqual(const FilePath& filename1,
 BASE_EXPORT absl::optional<std::vector<uint8_t>> ReadFileToBytes(
     const FilePath& path);
 
+// Reads the file at |path| like ReadFileToBytes(), and returns its contents as
+// read-only RefCountedMemory, or null on error. A file of at least
+// |min_size_to_map| bytes is memory-mapped instead of copied, so that only the
+// parts which are accessed are read. The contents then reflect later changes
+// to the file, which must not be truncated while they are alive.
+BASE_EXPORT scoped_refptr<RefCountedMemory> ReadFileToRefCountedMemory(
+    const FilePath& path,
+    size_t min_size_to_map);
+
 // Reads the file at |path| into |contents| and returns true on success and
 // false on error.  For security reasons, a |path| containing path traversal
 // components ('..') is treated as a read error and |contents| is set to empty.
@@ -712,6 +728,24 @@ BASE_EXPORT bool CopyAndDeleteDirectory(const FilePath& from_path,
 #endif  // BUILDFLAG(IS_WIN)
 
 #if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+// CopyFileContentsWithReflink will use the FICLONE ioctl(2) to make |outfile|
+// share the data of |infile| on file systems supporting it (e.g. btrfs, xfs),
+// which copies nothing until either file is modified. This is only done when
+// both file offsets are at the start and |outfile| is empty, in which case the
+// file offsets are left at the end. Returns false, without changing either
+// file, when it can't be used.
+BASE_EXPORT bool CopyFileContentsWithReflink(File& infile, File& outfile);
+
+// CopyFileContentsWithCopyFileRange will use the copy_file_range(2) syscall to
+// copy a file within the kernel, which lets file systems copy on the storage
+// side or share extents. It honors the file offsets like
+// CopyFileContentsWithSendfile, and sets |retry_slow| in the same way when
+// the kernel or file system doesn't support the copy, including across file
+// systems before Linux 5.3.
+BASE_EXPORT bool CopyFileContentsWithCopyFileRange(File& infile,
+                                                   File& outfile,
+                                                   bool& retry_slow);
+
 // CopyFileContentsWithSendfile will use the sendfile(2) syscall to perform a
 // file copy without moving the data between kernel and userspace. This is much
 // more efficient than sequences of read(2)/write(2) calls. The |retry_slow|
@@ -723,6 +757,11 @@ BASE_EXPORT bool CopyAndDeleteDirectory(const FilePath& from_path,
 BASE_EXPORT bool CopyFileContentsWithSendfile(File& infile,
                                               File& outfile,
                                               bool& retry_slow);
+
+// Caps each read of ReadFileToString() and the like at |max_read_size| bytes,
+// or lifts the cap if 0, to simulate the short reads of large files, or of
+// some file systems.
+BASE_EXPORT void SetMaxReadSizeForTesting(size_t max_read_size);
 #endif  // BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) ||
         // BUILDFLAG(IS_ANDROID)
 
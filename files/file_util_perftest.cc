@@ -0,0 +1,287 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/file_util.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/page_size.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/rand_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+namespace base {
+
+namespace {
+
+constexpr char kMetricPrefixCopyFile[] = "CopyFileContents.";
+constexpr char kMetricThroughput[] = "throughput";
+constexpr char kMetricCpuTime[] = "cpu_time_per_copy";
+
+constexpr size_t kFileSize = 64 * 1024 * 1024;
+constexpr int kCopyCount = 10;
+
+enum class CopyMethod {
+  // CopyFileContents(), which picks the fastest method available.
+  kDefault,
+  kCopyFileRange,
+  kSendfile,
+  // The read(2)/write(2) loop CopyFileContents() falls back to.
+  kReadWrite,
+};
+
+const char* GetStoryName(CopyMethod method) {
+  switch (method) {
+    case CopyMethod::kDefault:
+      return "default";
+    case CopyMethod::kCopyFileRange:
+      return "copy_file_range";
+    case CopyMethod::kSendfile:
+      return "sendfile";
+    case CopyMethod::kReadWrite:
+      return "read_write";
+  }
+}
+
+bool CopyWithReadWrite(File& infile, File& outfile) {
+  std::vector<char> buffer(32768);
+  for (;;) {
+    const int bytes_read =
+        infile.ReadAtCurrentPos(buffer.data(), static_cast<int>(buffer.size()));
+    if (bytes_read <= 0) {
+      return bytes_read == 0;
+    }
+    if (outfile.WriteAtCurrentPos(buffer.data(), bytes_read) != bytes_read) {
+      return false;
+    }
+  }
+}
+
+bool Copy(CopyMethod method, File& infile, File& outfile) {
+  bool retry_slow = false;
+  switch (method) {
+    case CopyMethod::kDefault:
+      return CopyFileContents(infile, outfile);
+    case CopyMethod::kCopyFileRange:
+      return internal::CopyFileContentsWithCopyFileRange(infile, outfile,
+                                                         retry_slow);
+    case CopyMethod::kSendfile:
+      return internal::CopyFileContentsWithSendfile(infile, outfile,
+                                                    retry_slow);
+    case CopyMethod::kReadWrite:
+      return CopyWithReadWrite(infile, outfile);
+  }
+}
+
+enum class ReadMethod {
+  // ReadStreamToString() of an OpenFile() stream, which reads with stdio.
+  kStdio,
+  kReadFileToString,
+  // ReadFileToRefCountedMemory(), which maps the file.
+  kMapped,
+};
+
+struct ReadParams {
+  ReadMethod method;
+  size_t file_size;
+};
+
+std::string GetStoryName(const ReadParams& params) {
+  std::string story;
+  switch (params.method) {
+    case ReadMethod::kStdio:
+      story = "stdio_";
+      break;
+    case ReadMethod::kReadFileToString:
+      story = "read_file_to_string_";
+      break;
+    case ReadMethod::kMapped:
+      story = "mapped_";
+      break;
+  }
+  return story + NumberToString(params.file_size);
+}
+
+constexpr char kMetricPrefixReadFile[] = "ReadFile.";
+constexpr char kMetricTimePerRead[] = "time_per_read";
+
+// Bytes read for each file size, which makes small files read many times.
+constexpr size_t kBytesReadPerStory = 1024 * 1024 * 1024;
+constexpr size_t kMaxReadCount = 10000;
+constexpr size_t kMinReadCount = 3;
+
+// Reads a byte of each page of |bytes|, as a caller of ReadFileToString()
+// would read the whole contents, which only makes a mapped file read from the
+// page cache.
+uint32_t TouchPages(span<const uint8_t> bytes) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < bytes.size(); i += GetPageSize()) {
+    sum += bytes[i];
+  }
+  return sum;
+}
+
+// Reads the file at |path| with |method|, and returns TouchPages() of its
+// contents.
+absl::optional<uint32_t> ReadWith(ReadMethod method, const FilePath& path) {
+  switch (method) {
+    case ReadMethod::kStdio: {
+      ScopedFILE stream(OpenFile(path, "rb"));
+      std::string contents;
+      if (!ReadStreamToString(stream.get(), &contents)) {
+        return absl::nullopt;
+      }
+      return TouchPages(as_bytes(make_span(contents)));
+    }
+    case ReadMethod::kReadFileToString: {
+      std::string contents;
+      if (!ReadFileToString(path, &contents)) {
+        return absl::nullopt;
+      }
+      return TouchPages(as_bytes(make_span(contents)));
+    }
+    case ReadMethod::kMapped: {
+      scoped_refptr<RefCountedMemory> contents =
+          ReadFileToRefCountedMemory(path, /*min_size_to_map=*/0);
+      if (!contents) {
+        return absl::nullopt;
+      }
+      return TouchPages(make_span(contents->front(), contents->size()));
+    }
+  }
+}
+
+class ReadFilePerfTest : public testing::TestWithParam<ReadParams> {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.GetPath().AppendASCII("file");
+    File file(path_, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE);
+    ASSERT_TRUE(file.IsValid());
+    const std::string chunk =
+        RandBytesAsString(std::min<size_t>(GetParam().file_size, 1024 * 1024));
+    for (size_t offset = 0; offset < GetParam().file_size;
+         offset += chunk.size()) {
+      ASSERT_TRUE(file.WriteAtCurrentPosAndCheck(as_bytes(make_span(chunk))));
+    }
+  }
+
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+};
+
+INSTANTIATE_TEST_SUITE_P(
+    All,
+    ReadFilePerfTest,
+    testing::ValuesIn([]() {
+      std::vector<ReadParams> params;
+      for (size_t file_size :
+           {1024u, 64u * 1024, 1024u * 1024, 64u * 1024 * 1024,
+            1024u * 1024 * 1024}) {
+        for (ReadMethod method : {ReadMethod::kStdio,
+                                  ReadMethod::kReadFileToString,
+                                  ReadMethod::kMapped}) {
+          params.push_back({method, file_size});
+        }
+      }
+      return params;
+    }()));
+
+class CopyFileContentsPerfTest : public testing::TestWithParam<CopyMethod> {
+ protected:
+  void SetUp() override {
+    if (!ThreadTicks::IsSupported()) {
+      GTEST_SKIP() << "ThreadTicks is not supported";
+    }
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    from_path_ = temp_dir_.GetPath().AppendASCII("from");
+    ASSERT_TRUE(WriteFile(from_path_, RandBytesAsString(kFileSize)));
+  }
+
+  ScopedTempDir temp_dir_;
+  FilePath from_path_;
+};
+
+INSTANTIATE_TEST_SUITE_P(All,
+                         CopyFileContentsPerfTest,
+                         testing::Values(CopyMethod::kDefault,
+                                         CopyMethod::kCopyFileRange,
+                                         CopyMethod::kSendfile,
+                                         CopyMethod::kReadWrite));
+
+}  // namespace
+
+// Copies a file, within the same file system, which lets CopyFileContents()
+// share extents on file systems supporting it. The source stays in the page
+// cache, so this measures the cost of the copy rather than of the storage.
+TEST_P(CopyFileContentsPerfTest, Copy) {
+  TimeDelta wall_time;
+  TimeDelta cpu_time;
+  for (int i = 0; i < kCopyCount; ++i) {
+    const FilePath to_path = temp_dir_.GetPath().AppendASCII("to");
+    File infile(from_path_, File::FLAG_OPEN | File::FLAG_READ);
+    File outfile(to_path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE);
+    ASSERT_TRUE(infile.IsValid());
+    ASSERT_TRUE(outfile.IsValid());
+
+    const TimeTicks start = TimeTicks::Now();
+    const ThreadTicks start_cpu = ThreadTicks::Now();
+    ASSERT_TRUE(Copy(GetParam(), infile, outfile));
+    cpu_time += ThreadTicks::Now() - start_cpu;
+    wall_time += TimeTicks::Now() - start;
+
+    ASSERT_EQ(static_cast<int64_t>(kFileSize), outfile.GetLength());
+    outfile.Close();
+    ASSERT_TRUE(DeleteFile(to_path));
+  }
+
+  perf_test::PerfResultReporter reporter(kMetricPrefixCopyFile,
+                                         GetStoryName(GetParam()));
+  reporter.RegisterImportantMetric(kMetricThroughput, "bytesPerSecond");
+  reporter.RegisterImportantMetric(kMetricCpuTime, "us");
+  reporter.AddResult(kMetricThroughput,
+                     kFileSize * kCopyCount / wall_time.InSecondsF());
+  reporter.AddResult(kMetricCpuTime, cpu_time.InMicrosecondsF() / kCopyCount);
+}
+
+// Reads a file which is in the page cache, and touches each page of the
+// contents.
+TEST_P(ReadFilePerfTest, Read) {
+  const ReadParams& params = GetParam();
+  const size_t read_count = std::clamp(kBytesReadPerStory / params.file_size,
+                                       kMinReadCount, kMaxReadCount);
+  TimeDelta elapsed;
+  for (size_t i = 0; i < read_count; ++i) {
+    const TimeTicks start = TimeTicks::Now();
+    const absl::optional<uint32_t> sum = ReadWith(params.method, path_);
+    elapsed += TimeTicks::Now() - start;
+    ASSERT_TRUE(sum);
+    // Keeps the reads from being optimized out.
+    EXPECT_NE(std::numeric_limits<uint32_t>::max(), *sum);
+  }
+
+  perf_test::PerfResultReporter reporter(kMetricPrefixReadFile,
+                                         GetStoryName(params));
+  reporter.RegisterImportantMetric(kMetricThroughput, "bytesPerSecond");
+  reporter.RegisterImportantMetric(kMetricTimePerRead, "us");
+  reporter.AddResult(kMetricThroughput,
+                     params.file_size * read_count / elapsed.InSecondsF());
+  reporter.AddResult(kMetricTimePerRead,
+                     elapsed.InMicrosecondsF() / read_count);
+}
+
+}  // namespace base
@@ -55,7 +55,10 @@
 #endif
 
 #if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/sendfile.h>
+#include <sys/syscall.h>
 #endif
 
 #if BUILDFLAG(IS_ANDROID)
@@ -1300,6 +1303,102 @@ bool MoveUnsafe(const FilePath& from_path, const FilePath& to_path) {
 }
 
 #if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+bool CopyFileContentsWithReflink(File& infile, File& outfile) {
+#if defined(FICLONE)
+  DCHECK(infile.IsValid());
+  DCHECK(outfile.IsValid());
+  stat_wrapper_t in_file_info;
+  stat_wrapper_t out_file_info;
+  if (File::Fstat(infile.GetPlatformFile(), &in_file_info) ||
+      File::Fstat(outfile.GetPlatformFile(), &out_file_info)) {
+    return false;
+  }
+
+  // FICLONE replaces all of |outfile| with all of |infile|, which is only what
+  // copying from the current file offsets does when both are at the start, and
+  // |outfile| is empty. Empty and non-regular files are left to the other
+  // methods, see CopyFileContentsWithSendfile().
+  if (!S_ISREG(in_file_info.st_mode) || !S_ISREG(out_file_info.st_mode) ||
+      in_file_info.st_size == 0 || out_file_info.st_size != 0 ||
+      infile.Seek(File::Whence::FROM_CURRENT, 0) != 0 ||
+      outfile.Seek(File::Whence::FROM_CURRENT, 0) != 0) {
+    return false;
+  }
+
+  // This fails without side effects when the files are on different file
+  // systems (EXDEV), or when the file system doesn't support sharing extents
+  // (EOPNOTSUPP, EINVAL).
+  if (ioctl(outfile.GetPlatformFile(), FICLONE, infile.GetPlatformFile()) !=
+      0) {
+    return false;
+  }
+
+  // Leave the file offsets where copying would have. |infile| may have grown
+  // since it was stat'ed, but the clone has the size of |outfile|.
+  const int64_t cloned_size = outfile.Seek(File::Whence::FROM_END, 0);
+  return cloned_size >= 0 &&
+         infile.Seek(File::Whence::FROM_BEGIN, cloned_size) == cloned_size;
+#else
+  return false;
+#endif  // defined(FICLONE)
+}
+
+bool CopyFileContentsWithCopyFileRange(File& infile,
+                                       File& outfile,
+                                       bool& retry_slow) {
+  DCHECK(infile.IsValid());
+  retry_slow = true;
+#if defined(__NR_copy_file_range)
+  stat_wrapper_t in_file_info;
+  if (File::Fstat(infile.GetPlatformFile(), &in_file_info)) {
+    retry_slow = false;
+    return false;
+  }
+
+  // As with sendfile(2), files reporting a size of zero may still have
+  // contents, see CopyFileContentsWithSendfile().
+  if (in_file_info.st_size <= 0) {
+    return false;
+  }
+
+  const size_t file_size = static_cast<size_t>(in_file_info.st_size);
+  size_t copied = 0;
+  ssize_t res = 0;
+  do {
+    // Null offsets read and write at, and update, the current file offsets.
+    // The glibc wrapper isn't available everywhere, and Android's libc only
+    // has one in recent API levels.
+    res = HANDLE_EINTR(syscall(__NR_copy_file_range, infile.GetPlatformFile(),
+                               /*off_in=*/nullptr, outfile.GetPlatformFile(),
+                               /*off_out=*/nullptr, file_size - copied,
+                               /*flags=*/0u));
+    if (res <= 0) {
+      break;
+    }
+    copied += static_cast<size_t>(res);
+  } while (copied < file_size);
+
+  if (copied == 0) {
+    // Before Linux 5.3, copies across file systems fail with EXDEV. Between
+    // 5.3 and 5.19 they are allowed, but copying from some special files
+    // (e.g. in procfs or sysfs) copies nothing, and returns zero. Other
+    // errors mean that the kernel, the file system or the file types don't
+    // support the copy. None of these changed the files, so the caller can
+    // try another way.
+    if (res == 0 ||
+        (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+         errno == EOPNOTSUPP || errno == EPERM || errno == EBADF)) {
+      return false;
+    }
+  }
+  // Like sendfile(2), stop at the end of the file if it shrunk.
+  retry_slow = false;
+  return res >= 0;
+#else
+  return false;
+#endif  // defined(__NR_copy_file_range)
+}
+
 bool CopyFileContentsWithSendfile(File& infile,
                                   File& outfile,
                                   bool& retry_slow) {
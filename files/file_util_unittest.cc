@@ -11,6 +11,7 @@
 #include <algorithm>
 #include <fstream>
 #include <initializer_list>
+#include <limits>
 #include <memory>
 #include <set>
 #include <utility>
@@ -29,6 +30,7 @@
 #include "base/functional/bind.h"
 #include "base/functional/callback_helpers.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/path_service.h"
 #include "base/rand_util.h"
 #include "base/scoped_environment_variable_override.h"
@@ -3466,6 +3468,44 @@ TEST_F(FileUtilTest, ReadFileToBytes) {
   ASSERT_FALSE(ReadFileToBytes(file_path_dangerous));
 }
 
+TEST_F(FileUtilTest, ReadFileToRefCountedMemory) {
+  const std::string data(kLargeFileSize, 'c');
+
+  FilePath file_path = temp_dir_.GetPath().Append(
+      FILE_PATH_LITERAL("ReadFileToRefCountedMemoryTest"));
+  FilePath file_path_dangerous =
+      temp_dir_.GetPath()
+          .Append(FILE_PATH_LITERAL(".."))
+          .Append(temp_dir_.GetPath().BaseName())
+          .Append(FILE_PATH_LITERAL("ReadFileToRefCountedMemoryTest"));
+
+  ASSERT_TRUE(WriteFile(file_path, data));
+
+  // Copied.
+  scoped_refptr<RefCountedMemory> copied = ReadFileToRefCountedMemory(
+      file_path, std::numeric_limits<size_t>::max());
+  ASSERT_TRUE(copied);
+  EXPECT_EQ(data, std::string(copied->front_as<char>(), copied->size()));
+
+  // Mapped.
+  scoped_refptr<RefCountedMemory> mapped =
+      ReadFileToRefCountedMemory(file_path, kLargeFileSize);
+  ASSERT_TRUE(mapped);
+  EXPECT_TRUE(mapped->Equals(copied));
+  mapped.reset();
+
+  // Empty files aren't mapped.
+  ASSERT_TRUE(WriteFile(file_path, ""));
+  scoped_refptr<RefCountedMemory> empty =
+      ReadFileToRefCountedMemory(file_path, 0);
+  ASSERT_TRUE(empty);
+  EXPECT_EQ(0u, empty->size());
+
+  EXPECT_FALSE(ReadFileToRefCountedMemory(file_path_dangerous, 0));
+  ASSERT_TRUE(DeleteFile(file_path));
+  EXPECT_FALSE(ReadFileToRefCountedMemory(file_path, 0));
+}
+
 TEST_F(FileUtilTest, ReadFileToString) {
   const char kTestData[] = "0123";
   std::string data;
@@ -3922,6 +3962,35 @@ TEST_F(FileUtilTest, ReadFileToStringWithLargeFile) {
   EXPECT_EQ(std::string(kLargeFileSize - 1, 'c'), actual_data);
 }
 
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+// Reads shorter than asked for, as of files of 2 GiB or more, or on some file
+// systems, don't stop reading before EOF.
+TEST_F(FileUtilTest, ReadFileToStringWithShortReads) {
+  std::string data(kLargeFileSize, 'c');
+  data[kLargeFileSize - 1] = 'd';
+
+  FilePath file_path = temp_dir_.GetPath().Append(
+      FILE_PATH_LITERAL("ReadFileToStringWithShortReadsTest"));
+  ASSERT_TRUE(WriteFile(file_path, data));
+
+  for (size_t max_read_size : {1u, 1000u, 4096u}) {
+    SCOPED_TRACE(max_read_size);
+    internal::SetMaxReadSizeForTesting(max_read_size);
+
+    std::string actual_data = "temp";
+    EXPECT_TRUE(ReadFileToString(file_path, &actual_data));
+    EXPECT_EQ(data, actual_data);
+
+    actual_data = "temp";
+    EXPECT_FALSE(ReadFileToStringWithMaxSize(file_path, &actual_data,
+                                             kLargeFileSize - 1));
+    EXPECT_EQ(std::string(kLargeFileSize - 1, 'c'), actual_data);
+  }
+  internal::SetMaxReadSizeForTesting(0);
+}
+#endif  // BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) ||
+        // BUILDFLAG(IS_ANDROID)
+
 TEST_F(FileUtilTest, ReadStreamToString) {
   ScopedFILE stream(
       OpenFile(temp_dir_.GetPath().Append(FPL("hello.txt")), "wb+"));
@@ -4830,6 +4899,144 @@ TEST_F(FileUtilTest, CopyFileContentsWithSendfileSeqFile) {
   }
 }
 
+TEST_F(FileUtilTest, CopyFileContentsWithCopyFileRange) {
+  // This test validates that copy_file_range(2) honors the file offsets as
+  // CopyFileContents does.
+  FilePath file_name_from = temp_dir_.GetPath().Append(
+      FILE_PATH_LITERAL("copy_contents_file_in.txt"));
+  FilePath file_name_to = temp_dir_.GetPath().Append(
+      FILE_PATH_LITERAL("copy_contents_file_out.txt"));
+  CreateTextFile(file_name_from, L"0123456789ABCDEF");
+  CreateTextFile(file_name_to, L"GHIJKL");
+
+  File from(file_name_from, File::FLAG_OPEN | File::FLAG_READ);
+  ASSERT_TRUE(from.IsValid());
+  File to(file_name_to, File::FLAG_OPEN | File::FLAG_WRITE);
+  ASSERT_TRUE(to.IsValid());
+  ASSERT_EQ(from.Seek(File::Whence::FROM_BEGIN, 1), 1);
+  ASSERT_EQ(to.Seek(File::Whence::FROM_BEGIN, 1), 1);
+
+  bool retry_slow = false;
+  if (!internal::CopyFileContentsWithCopyFileRange(from, to, retry_slow)) {
+    // Only kernels older than 4.5 don't support copy_file_range(2) at all.
+    ASSERT_TRUE(retry_slow);
+    GTEST_SKIP() << "copy_file_range(2) is not supported";
+  }
+  EXPECT_EQ(from.Seek(File::Whence::FROM_CURRENT, 0), 16);
+  EXPECT_EQ(to.Seek(File::Whence::FROM_CURRENT, 0), 16);
+  from.Close();
+  to.Close();
+
+  EXPECT_EQ(L"G123456789ABCDEF", ReadTextFile(file_name_to));
+}
+
+TEST_F(FileUtilTest, CopyFileContentsWithCopyFileRangeEmpty) {
+  FilePath file_name_from = temp_dir_.GetPath().Append(
+      FILE_PATH_LITERAL("copy_contents_file_in.txt"));
+  FilePath file_name_to = temp_dir_.GetPath().Append(
+      FILE_PATH_LITERAL("copy_contents_file_out.txt"));
+  CreateTextFile(file_name_from, L"");
+  CreateTextFile(file_name_to, L"");
+
+  File from(file_name_from, File::FLAG_OPEN | File::FLAG_READ);
+  ASSERT_TRUE(from.IsValid());
+  File to(file_name_to, File::FLAG_OPEN | File::FLAG_WRITE);
+  ASSERT_TRUE(to.IsValid());
+
+  // Empty files may be seq_files, which are left to the slow copy.
+  bool retry_slow = false;
+  ASSERT_FALSE(
+      internal::CopyFileContentsWithCopyFileRange(from, to, retry_slow));
+  ASSERT_TRUE(retry_slow);
+}
+
+TEST_F(FileUtilTest, CopyFileContentsWithCopyFileRangePipe) {
+  FilePath file_name_from = temp_dir_.GetPath().Append(
+      FILE_PATH_LITERAL("copy_contents_file_in.txt"));
+  CreateTextFile(file_name_from, L"0123456789ABCDEF");
+  File from(file_name_from, File::FLAG_OPEN | File::FLAG_READ);
+  ASSERT_TRUE(from.IsValid());
+
+  int fd[2];
+  ASSERT_EQ(pipe2(fd, O_CLOEXEC), 0);
+  File pipe_read(fd[0]);
+  File pipe_write(fd[1]);
+
+  // copy_file_range(2) only copies between regular files, and fails without
+  // side effects otherwise.
+  bool retry_slow = false;
+  ASSERT_FALSE(internal::CopyFileContentsWithCopyFileRange(from, pipe_write,
+                                                           retry_slow));
+  ASSERT_TRUE(retry_slow);
+  EXPECT_EQ(from.Seek(File::Whence::FROM_CURRENT, 0), 0);
+
+  // CopyFileContents() then falls back to sendfile(2).
+  ASSERT_TRUE(CopyFileContents(from, pipe_write));
+  char buffer[16];
+  ASSERT_EQ(pipe_read.ReadAtCurrentPos(buffer, sizeof(buffer)), 16);
+  EXPECT_EQ(std::string(buffer, sizeof(buffer)), "0123456789ABCDEF");
+}
+
+TEST_F(FileUtilTest, CopyFileContentsWithReflink) {
+  FilePath file_name_from = temp_dir_.GetPath().Append(
+      FILE_PATH_LITERAL("copy_contents_file_in.txt"));
+  FilePath file_name_to = temp_dir_.GetPath().Append(
+      FILE_PATH_LITERAL("copy_contents_file_out.txt"));
+  CreateTextFile(file_name_from, L"0123456789ABCDEF");
+  CreateTextFile(file_name_to, L"GHIJKL");
+
+  File from(file_name_from, File::FLAG_OPEN | File::FLAG_READ);
+  ASSERT_TRUE(from.IsValid());
+  {
+    // Cloning into a non-empty file would lose its contents.
+    File to(file_name_to, File::FLAG_OPEN | File::FLAG_WRITE);
+    ASSERT_TRUE(to.IsValid());
+    EXPECT_FALSE(internal::CopyFileContentsWithReflink(from, to));
+  }
+  EXPECT_EQ(L"GHIJKL", ReadTextFile(file_name_to));
+
+  File to(file_name_to,
+          File::FLAG_OPEN | File::FLAG_WRITE | File::FLAG_CREATE_ALWAYS);
+  ASSERT_TRUE(to.IsValid());
+  {
+    // Cloning from an offset would copy too much.
+    ASSERT_EQ(from.Seek(File::Whence::FROM_BEGIN, 1), 1);
+    EXPECT_FALSE(internal::CopyFileContentsWithReflink(from, to));
+    ASSERT_EQ(from.Seek(File::Whence::FROM_BEGIN, 0), 0);
+  }
+
+  // Whether this works depends on the file system of the temp directory.
+  if (internal::CopyFileContentsWithReflink(from, to)) {
+    EXPECT_EQ(from.Seek(File::Whence::FROM_CURRENT, 0), 16);
+    EXPECT_EQ(to.Seek(File::Whence::FROM_CURRENT, 0), 16);
+    EXPECT_EQ(L"0123456789ABCDEF", ReadTextFile(file_name_to));
+  } else {
+    EXPECT_EQ(from.Seek(File::Whence::FROM_CURRENT, 0), 0);
+    EXPECT_EQ(to.Seek(File::Whence::FROM_CURRENT, 0), 0);
+    EXPECT_EQ(L"", ReadTextFile(file_name_to));
+  }
+}
+
+TEST_F(FileUtilTest, CopyFileLarge) {
+  // Large enough for copy_file_range(2) and sendfile(2) to take several calls
+  // on some file systems.
+  std::string contents(8 * 1024 * 1024 + 123, '\0');
+  for (size_t i = 0; i < contents.size(); ++i) {
+    contents[i] = static_cast<char>(i * 7 + i / 4096);
+  }
+  FilePath file_name_from =
+      temp_dir_.GetPath().Append(FILE_PATH_LITERAL("copy_large_in"));
+  FilePath file_name_to =
+      temp_dir_.GetPath().Append(FILE_PATH_LITERAL("copy_large_out"));
+  ASSERT_TRUE(WriteFile(file_name_from, contents));
+  ASSERT_TRUE(WriteFile(file_name_to, "previous contents"));
+
+  ASSERT_TRUE(CopyFile(file_name_from, file_name_to));
+  std::string copied;
+  ASSERT_TRUE(ReadFileToString(file_name_to, &copied));
+  EXPECT_EQ(contents, copied);
+}
+
 #endif  // BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) ||
         // BUILDFLAG(IS_ANDROID)
 
@@ -14,8 +14,10 @@
 #include "base/immediate_crash.h"
 #include "base/metrics/histogram_functions.h"
 #include "base/notreached.h"
+#include "base/numerics/checked_math.h"
 #include "base/strings/string_util.h"
 #include "base/threading/scoped_blocking_call.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
 
 #include <windows.h>
 
@@ -168,6 +170,75 @@ int File::WriteAtCurrentPosNoBestEffort(const char* data, int size) {
   return WriteAtCurrentPos(data, size);
 }
 
+namespace {
+
+// Returns the total size of |buffers|, or nullopt if it doesn't fit in an int,
+// which the read and write functions return.
+template <typename T>
+absl::optional<int> GetTotalSize(span<const span<T>> buffers) {
+  CheckedNumeric<int> size = 0;
+  for (span<T> buffer : buffers) {
+    size += buffer.size();
+  }
+  return size.IsValid() ? absl::make_optional(size.ValueOrDie())
+                        : absl::nullopt;
+}
+
+}  // namespace
+
+// Windows has no vectored I/O on buffered files, so the buffers are read and
+// written one by one.
+int File::ReadV(int64_t offset, span<const span<uint8_t>> buffers) {
+  ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+  DCHECK(IsValid());
+  const absl::optional<int> size = GetTotalSize(buffers);
+  if (!size || offset < 0)
+    return -1;
+
+  SCOPED_FILE_TRACE_WITH_SIZE("ReadV", *size);
+
+  int bytes_read = 0;
+  for (span<uint8_t> buffer : buffers) {
+    const int buffer_size = static_cast<int>(buffer.size());
+    const int rv = Read(offset + bytes_read,
+                        reinterpret_cast<char*>(buffer.data()), buffer_size);
+    if (rv < 0)
+      return bytes_read ? bytes_read : rv;
+    bytes_read += rv;
+    if (rv < buffer_size)
+      break;
+  }
+  return bytes_read;
+}
+
+int File::ReadVNoWait(int64_t offset, span<const span<uint8_t>> buffers) {
+  return -1;
+}
+
+int File::WriteV(int64_t offset, span<const span<const uint8_t>> buffers) {
+  ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+  DCHECK(IsValid());
+  const absl::optional<int> size = GetTotalSize(buffers);
+  if (!size || offset < 0)
+    return -1;
+
+  SCOPED_FILE_TRACE_WITH_SIZE("WriteV", *size);
+
+  int bytes_written = 0;
+  for (span<const uint8_t> buffer : buffers) {
+    const int buffer_size = static_cast<int>(buffer.size());
+    const int rv =
+        Write(offset + bytes_written,
+              reinterpret_cast<const char*>(buffer.data()), buffer_size);
+    if (rv < 0)
+      return bytes_written ? bytes_written : rv;
+    bytes_written += rv;
+    if (rv < buffer_size)
+      break;
+  }
+  return bytes_written;
+}
+
 int64_t File::GetLength() {
   ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
   DCHECK(IsValid());
@@ -11,8 +11,10 @@
 #include <algorithm>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "base/check.h"
+#include "base/containers/flat_set.h"
 #include "base/critical_closure.h"
 #include "base/debug/alias.h"
 #include "base/files/file.h"
@@ -36,6 +38,12 @@
 #include "build/build_config.h"
 #include "build/chromeos_buildflags.h"
 
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS)
+#include <unistd.h>
+
+#include "base/posix/eintr_wrapper.h"
+#endif
+
 namespace base {
 
 namespace {
@@ -103,10 +111,155 @@ void DeleteTmpFileWithRetry(File tmp_file,
 
 }  // namespace
 
+// A write waiting to be committed by a CommitCoordinator.
+struct ImportantFileWriter::CommitCoordinator::PendingWrite {
+  FilePath path;
+  DataProducerCallback data_producer;
+  OnceClosure before_write_callback;
+  OnceCallback<void(bool success)> after_write_callback;
+  std::string histogram_suffix;
+
+  // Set while committing.
+  bool produced = false;
+  FilePath tmp_file_path;
+  File tmp_file;
+};
+
+ImportantFileWriter::CommitCoordinator::CommitCoordinator(
+    scoped_refptr<SequencedTaskRunner> task_runner)
+    : CommitCoordinator(std::move(task_runner), Options()) {}
+
+ImportantFileWriter::CommitCoordinator::CommitCoordinator(
+    scoped_refptr<SequencedTaskRunner> task_runner,
+    const Options& options)
+    : task_runner_(std::move(task_runner)), options_(options) {
+  DCHECK(task_runner_);
+}
+
+ImportantFileWriter::CommitCoordinator::~CommitCoordinator() = default;
+
+TimeDelta ImportantFileWriter::CommitCoordinator::GetScheduledWriteDelay(
+    TimeDelta interval) const {
+  if (!options_.commit_window.is_positive()) {
+    return interval;
+  }
+  const TimeTicks now = TimeTicks::Now();
+  return (now + interval).SnappedToNextTick(TimeTicks(),
+                                            options_.commit_window) -
+         now;
+}
+
+void ImportantFileWriter::CommitCoordinator::AddWrite(PendingWrite write) {
+  {
+    AutoLock lock(lock_);
+    pending_writes_.push_back(std::move(write));
+    if (commit_posted_) {
+      return;
+    }
+    commit_posted_ = true;
+  }
+  // Writes queued until this runs are committed with this one.
+  task_runner_->PostTask(
+      FROM_HERE,
+      MakeCriticalClosure(
+          "ImportantFileWriter::CommitCoordinator::CommitPendingWrites",
+          BindOnce(&CommitCoordinator::CommitPendingWrites,
+                   WrapRefCounted(this)),
+          /*is_immediate=*/true));
+}
+
+void ImportantFileWriter::CommitCoordinator::CommitPendingWrites() {
+  std::vector<PendingWrite> writes;
+  {
+    AutoLock lock(lock_);
+    writes.swap(pending_writes_);
+    commit_posted_ = false;
+  }
+  const TimeTicks commit_start = TimeTicks::Now();
+
+  // Write all the temp files, so that they are flushed together.
+  for (PendingWrite& write : writes) {
+    absl::optional<SerializedData> data =
+        std::move(write.data_producer).Run();
+    if (!data) {
+      DLOG(WARNING) << "Failed to serialize data to be saved in "
+                    << write.path.value();
+      continue;
+    }
+    write.produced = true;
+    if (!write.before_write_callback.is_null()) {
+      std::move(write.before_write_callback).Run();
+    }
+    write.tmp_file = CreateAndWriteTempFile(write.path, GetBytes(*data),
+                                            &write.tmp_file_path);
+  }
+
+  FlushTempFiles(writes);
+
+  // Writes to the same path are replaced in order, so the last one wins.
+  size_t commit_size = 0;
+  for (PendingWrite& write : writes) {
+    if (!write.produced) {
+      continue;
+    }
+    ++commit_size;
+    const bool result =
+        write.tmp_file.IsValid() &&
+        ReplaceWithTempFile(std::move(write.tmp_file), write.tmp_file_path,
+                            write.path);
+    UmaHistogramTimesWithSuffix("ImportantFile.WriteDuration",
+                                write.histogram_suffix,
+                                TimeTicks::Now() - commit_start);
+    if (!write.after_write_callback.is_null()) {
+      std::move(write.after_write_callback).Run(result);
+    }
+  }
+  UmaHistogramCounts100("ImportantFile.GroupCommitSize",
+                        static_cast<int>(commit_size));
+}
+
+void ImportantFileWriter::CommitCoordinator::FlushTempFiles(
+    std::vector<PendingWrite>& writes) {
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS)
+  const size_t tmp_file_count = static_cast<size_t>(std::count_if(
+      writes.begin(), writes.end(),
+      [](const PendingWrite& write) { return write.tmp_file.IsValid(); }));
+  if (options_.use_syncfs && tmp_file_count > 1 &&
+      tmp_file_count >= options_.min_syncfs_batch_size) {
+    // Flush each file system once. Errors are reported by the fdatasync()
+    // calls below.
+    flat_set<dev_t> synced_devices;
+    for (PendingWrite& write : writes) {
+      stat_wrapper_t file_info;
+      if (write.tmp_file.IsValid() &&
+          File::Fstat(write.tmp_file.GetPlatformFile(), &file_info) == 0 &&
+          synced_devices.insert(file_info.st_dev).second) {
+        HANDLE_EINTR(syncfs(write.tmp_file.GetPlatformFile()));
+      }
+    }
+  }
+#endif  // BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS)
+
+  for (PendingWrite& write : writes) {
+    if (write.tmp_file.IsValid() && !write.tmp_file.Flush()) {
+      DPLOG(WARNING) << "Failed to flush temp file to update " << write.path;
+      DeleteTmpFileWithRetry(std::move(write.tmp_file), write.tmp_file_path);
+    }
+  }
+}
+
 // static
 bool ImportantFileWriter::WriteFileAtomically(const FilePath& path,
                                               StringPiece data,
                                               StringPiece histogram_suffix) {
+  return WriteFileAtomically(path, as_bytes(make_span(data)),
+                             histogram_suffix);
+}
+
+// static
+bool ImportantFileWriter::WriteFileAtomically(const FilePath& path,
+                                              span<const uint8_t> data,
+                                              StringPiece histogram_suffix) {
   // Calling the impl by way of the public WriteFileAtomically, so
   // |from_instance| is false.
   return WriteFileAtomicallyImpl(path, data, histogram_suffix,
@@ -114,14 +267,14 @@ bool ImportantFileWriter::WriteFileAtomically(const FilePath& path,
 }
 
 // static
-void ImportantFileWriter::ProduceAndWriteStringToFileAtomically(
+void ImportantFileWriter::ProduceAndWriteToFileAtomically(
     const FilePath& path,
-    BackgroundDataProducerCallback data_producer_for_background_sequence,
+    DataProducerCallback data_producer_for_background_sequence,
     OnceClosure before_write_callback,
     OnceCallback<void(bool success)> after_write_callback,
     const std::string& histogram_suffix) {
-  // Produce the actual data string on the background sequence.
-  absl::optional<std::string> data =
+  // Produce the actual data on the background sequence.
+  absl::optional<SerializedData> data =
       std::move(data_producer_for_background_sequence).Run();
   if (!data) {
     DLOG(WARNING) << "Failed to serialize data to be saved in " << path.value();
@@ -131,11 +284,11 @@ void ImportantFileWriter::ProduceAndWriteStringToFileAtomically(
   if (!before_write_callback.is_null())
     std::move(before_write_callback).Run();
 
-  // Calling the impl by way of the private
-  // ProduceAndWriteStringToFileAtomically, which originated from an
-  // ImportantFileWriter instance, so |from_instance| is true.
-  const bool result = WriteFileAtomicallyImpl(path, *data, histogram_suffix,
-                                              /*from_instance=*/true);
+  // Calling the impl by way of the private ProduceAndWriteToFileAtomically,
+  // which originated from an ImportantFileWriter instance, so |from_instance|
+  // is true.
+  const bool result = WriteFileAtomicallyImpl(
+      path, GetBytes(*data), histogram_suffix, /*from_instance=*/true);
 
   if (!after_write_callback.is_null())
     std::move(after_write_callback).Run(result);
@@ -143,7 +296,7 @@ void ImportantFileWriter::ProduceAndWriteStringToFileAtomically(
 
 // static
 bool ImportantFileWriter::WriteFileAtomicallyImpl(const FilePath& path,
-                                                  StringPiece data,
+                                                  span<const uint8_t> data,
                                                   StringPiece histogram_suffix,
                                                   bool from_instance) {
   const TimeTicks write_start = TimeTicks::Now();
@@ -174,42 +327,78 @@ bool ImportantFileWriter::WriteFileAtomicallyImpl(const FilePath& path,
 #endif
 
   // Write the data to a temp file then rename to avoid data loss if we crash
-  // while writing the file. Ensure that the temp file is on the same volume
-  // as target file, so it can be moved in one step, and that the temp file
-  // is securely created.
+  // while writing the file.
   FilePath tmp_file_path;
+  File tmp_file = CreateAndWriteTempFile(path, data, &tmp_file_path);
+  if (!tmp_file.IsValid()) {
+    return false;
+  }
+
+  if (!tmp_file.Flush()) {
+    DPLOG(WARNING) << "Failed to flush temp file to update " << path;
+    DeleteTmpFileWithRetry(std::move(tmp_file), tmp_file_path);
+    return false;
+  }
+
+  const bool result =
+      ReplaceWithTempFile(std::move(tmp_file), tmp_file_path, path);
+
+  const TimeDelta write_duration = TimeTicks::Now() - write_start;
+  UmaHistogramTimesWithSuffix("ImportantFile.WriteDuration", histogram_suffix,
+                              write_duration);
+
+  return result;
+}
+
+// static
+span<const uint8_t> ImportantFileWriter::GetBytes(const SerializedData& data) {
+  if (const std::string* string = absl::get_if<std::string>(&data)) {
+    return as_bytes(make_span(*string));
+  }
+  const RefCountedMemory& memory =
+      *absl::get<scoped_refptr<RefCountedMemory>>(data);
+  return make_span(memory.front(), memory.size());
+}
+
+// static
+File ImportantFileWriter::CreateAndWriteTempFile(const FilePath& path,
+                                                 span<const uint8_t> data,
+                                                 FilePath* tmp_file_path) {
+  // Ensure that the temp file is on the same volume as target file, so it can
+  // be moved in one step, and that the temp file is securely created.
   File tmp_file =
-      CreateAndOpenTemporaryFileInDir(path.DirName(), &tmp_file_path);
+      CreateAndOpenTemporaryFileInDir(path.DirName(), tmp_file_path);
   if (!tmp_file.IsValid()) {
     DPLOG(WARNING) << "Failed to create temporary file to update " << path;
-    return false;
+    return File();
   }
 
   // Don't write all of the data at once because this can lead to kernel
   // address-space exhaustion on 32-bit Windows (see https://crbug.com/1001022
   // for details).
-  constexpr ptrdiff_t kMaxWriteAmount = 8 * 1024 * 1024;
+  constexpr size_t kMaxWriteAmount = 8 * 1024 * 1024;
   int bytes_written = 0;
-  for (const char *scan = data.data(), *const end = scan + data.length();
-       scan < end; scan += bytes_written) {
+  for (size_t offset = 0; offset < data.size();
+       offset += static_cast<size_t>(bytes_written)) {
     const int write_amount =
-        static_cast<int>(std::min(kMaxWriteAmount, end - scan));
-    bytes_written = tmp_file.WriteAtCurrentPos(scan, write_amount);
+        static_cast<int>(std::min(kMaxWriteAmount, data.size() - offset));
+    bytes_written = tmp_file.WriteAtCurrentPos(
+        reinterpret_cast<const char*>(data.data() + offset), write_amount);
     if (bytes_written != write_amount) {
       DPLOG(WARNING) << "Failed to write " << write_amount << " bytes to temp "
                      << "file to update " << path
                      << " (bytes_written=" << bytes_written << ")";
-      DeleteTmpFileWithRetry(std::move(tmp_file), tmp_file_path);
-      return false;
+      DeleteTmpFileWithRetry(std::move(tmp_file), *tmp_file_path);
+      return File();
     }
   }
+  return tmp_file;
+}
 
-  if (!tmp_file.Flush()) {
-    DPLOG(WARNING) << "Failed to flush temp file to update " << path;
-    DeleteTmpFileWithRetry(std::move(tmp_file), tmp_file_path);
-    return false;
-  }
-
+// static
+bool ImportantFileWriter::ReplaceWithTempFile(File tmp_file,
+                                              const FilePath& tmp_file_path,
+                                              const FilePath& path) {
   File::Error replace_file_error = File::FILE_OK;
   bool result;
 
@@ -260,10 +449,6 @@ bool ImportantFileWriter::WriteFileAtomicallyImpl(const FilePath& path,
     DeleteTmpFileWithRetry(File(), tmp_file_path);
   }
 
-  const TimeDelta write_duration = TimeTicks::Now() - write_start;
-  UmaHistogramTimesWithSuffix("ImportantFile.WriteDuration", histogram_suffix,
-                              write_duration);
-
   return result;
 }
 
@@ -309,18 +494,62 @@ void ImportantFileWriter::WriteNow(std::string data) {
     return;
   }
 
-  WriteNowWithBackgroundDataProducer(base::BindOnce(
-      [](std::string data) { return absl::make_optional(std::move(data)); },
+  WriteNowWithDataProducer(BindOnce(
+      [](std::string data) {
+        return absl::make_optional<SerializedData>(std::move(data));
+      },
+      std::move(data)));
+}
+
+void ImportantFileWriter::WriteNow(scoped_refptr<RefCountedMemory> data) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  DCHECK(data);
+  if (!IsValueInRangeForNumericType<int32_t>(data->size())) {
+    NOTREACHED();
+    return;
+  }
+
+  WriteNowWithDataProducer(BindOnce(
+      [](scoped_refptr<RefCountedMemory> data) {
+        return absl::make_optional<SerializedData>(std::move(data));
+      },
       std::move(data)));
 }
 
 void ImportantFileWriter::WriteNowWithBackgroundDataProducer(
     BackgroundDataProducerCallback background_data_producer) {
+  WriteNowWithDataProducer(BindOnce(
+      [](BackgroundDataProducerCallback background_data_producer)
+          -> absl::optional<SerializedData> {
+        absl::optional<std::string> data =
+            std::move(background_data_producer).Run();
+        if (!data) {
+          return absl::nullopt;
+        }
+        return std::move(*data);
+      },
+      std::move(background_data_producer)));
+}
+
+void ImportantFileWriter::WriteNowWithDataProducer(
+    DataProducerCallback data_producer) {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
 
+  if (commit_coordinator_) {
+    CommitCoordinator::PendingWrite write;
+    write.path = path_;
+    write.data_producer = std::move(data_producer);
+    write.before_write_callback = std::move(before_next_write_callback_);
+    write.after_write_callback = std::move(after_next_write_callback_);
+    write.histogram_suffix = histogram_suffix_;
+    commit_coordinator_->AddWrite(std::move(write));
+    ClearPendingWrite();
+    return;
+  }
+
   auto split_task = SplitOnceCallback(
-      BindOnce(&ProduceAndWriteStringToFileAtomically, path_,
-               std::move(background_data_producer),
+      BindOnce(&ProduceAndWriteToFileAtomically, path_,
+               std::move(data_producer),
                std::move(before_next_write_callback_),
                std::move(after_next_write_callback_), histogram_suffix_));
 
@@ -346,7 +575,7 @@ void ImportantFileWriter::ScheduleWrite(DataSerializer* serializer) {
 
   if (!timer().IsRunning()) {
     timer().Start(
-        FROM_HERE, commit_interval_,
+        FROM_HERE, GetScheduledWriteDelay(),
         BindOnce(&ImportantFileWriter::DoScheduledWrite, Unretained(this)));
   }
 }
@@ -360,7 +589,7 @@ void ImportantFileWriter::ScheduleWriteWithBackgroundDataSerializer(
 
   if (!timer().IsRunning()) {
     timer().Start(
-        FROM_HERE, commit_interval_,
+        FROM_HERE, GetScheduledWriteDelay(),
         BindOnce(&ImportantFileWriter::DoScheduledWrite, Unretained(this)));
   }
 }
@@ -417,6 +646,18 @@ void ImportantFileWriter::ClearPendingWrite() {
   serializer_.emplace<absl::monostate>();
 }
 
+void ImportantFileWriter::SetCommitCoordinator(
+    scoped_refptr<CommitCoordinator> commit_coordinator) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  commit_coordinator_ = std::move(commit_coordinator);
+}
+
+TimeDelta ImportantFileWriter::GetScheduledWriteDelay() const {
+  return commit_coordinator_
+             ? commit_coordinator_->GetScheduledWriteDelay(commit_interval_)
+             : commit_interval_;
+}
+
 void ImportantFileWriter::SetTimerForTesting(OneShotTimer* timer_override) {
   timer_override_ = timer_override;
 }
@@ -5,15 +5,24 @@
 #ifndef BASE_FILES_IMPORTANT_FILE_WRITER_H_
 #define BASE_FILES_IMPORTANT_FILE_WRITER_H_
 
+#include <stdint.h>
+
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "base/base_export.h"
+#include "base/containers/span.h"
+#include "base/files/file.h"
 #include "base/files/file_path.h"
 #include "base/functional/callback.h"
 #include "base/memory/raw_ptr.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/sequence_checker.h"
 #include "base/strings/string_piece.h"
+#include "base/synchronization/lock.h"
+#include "base/thread_annotations.h"
 #include "base/time/time.h"
 #include "base/timer/timer.h"
 #include "third_party/abseil-cpp/absl/types/optional.h"
@@ -37,6 +46,8 @@ class SequencedTaskRunner;
 //
 // Also note that ImportantFileWriter can be *really* slow (cf. File::Flush()
 // for details) and thus please don't block shutdown on ImportantFileWriter.
+// Many writers on the same volume can share a CommitCoordinator, which makes
+// them flush their files together.
 class BASE_EXPORT ImportantFileWriter {
  public:
   // Promise-like callback that returns (via output parameter) the serialized
@@ -73,12 +84,84 @@ class BASE_EXPORT ImportantFileWriter {
     virtual ~BackgroundDataSerializer() = default;
   };
 
+  // Commits the writes of several ImportantFileWriters together ("group
+  // commit"): the temp files of all the writes pending when a commit starts
+  // are written, then flushed together, then renamed. On Linux and ChromeOS,
+  // |Options::use_syncfs| flushes each file system with a single syncfs() call
+  // instead of an fdatasync() per file, which would each commit the file
+  // system journal.
+  // Each file is still replaced atomically, and only once its data is flushed,
+  // so this doesn't weaken the guarantees of ImportantFileWriter.
+  //
+  // Writers sharing a coordinator also align their scheduled writes on a
+  // common grid of |Options::commit_window|, so that writes scheduled around
+  // the same time are committed together.
+  //
+  // This class is thread-safe.
+  class BASE_EXPORT CommitCoordinator
+      : public RefCountedThreadSafe<CommitCoordinator> {
+   public:
+    struct BASE_EXPORT Options {
+      // Scheduled writes of the writers sharing this coordinator happen on a
+      // grid of this period. Zero disables the alignment.
+      TimeDelta commit_window = Seconds(1);
+      // Linux and ChromeOS only: whether to flush file systems with syncfs()
+      // when at least |min_syncfs_batch_size| files are flushed together.
+      // Each file is then fdatasync()'ed anyway, which is cheap once its data
+      // is flushed, to detect write-back errors, which syncfs() only reports
+      // from Linux 5.8. Off by default, since syncfs() also flushes the dirty
+      // data of unrelated files on the same file system.
+      bool use_syncfs = false;
+      size_t min_syncfs_batch_size = 4;
+    };
+
+    // |task_runner| is where the writes are done, instead of the task runners
+    // of the writers.
+    explicit CommitCoordinator(scoped_refptr<SequencedTaskRunner> task_runner);
+    CommitCoordinator(scoped_refptr<SequencedTaskRunner> task_runner,
+                      const Options& options);
+
+    CommitCoordinator(const CommitCoordinator&) = delete;
+    CommitCoordinator& operator=(const CommitCoordinator&) = delete;
+
+    // Returns the delay after which a write, scheduled now to be done after
+    // |interval|, should be done to be committed with others.
+    TimeDelta GetScheduledWriteDelay(TimeDelta interval) const;
+
+   private:
+    friend class ImportantFileWriter;
+    friend class RefCountedThreadSafe<CommitCoordinator>;
+
+    struct PendingWrite;
+
+    ~CommitCoordinator();
+
+    // Queues |write|, and posts a commit if none is pending.
+    void AddWrite(PendingWrite write);
+
+    // Commits all the writes queued so far.
+    void CommitPendingWrites();
+
+    // Flushes the temp files of |writes|, deleting those which fail.
+    void FlushTempFiles(std::vector<PendingWrite>& writes);
+
+    const scoped_refptr<SequencedTaskRunner> task_runner_;
+    const Options options_;
+
+    Lock lock_;
+    std::vector<PendingWrite> pending_writes_ GUARDED_BY(lock_);
+    bool commit_posted_ GUARDED_BY(lock_) = false;
+  };
+
   // Save |data| to |path| in an atomic manner. Blocks and writes data on the
   // current thread. Does not guarantee file integrity across system crash (see
   // the class comment above).
   static bool WriteFileAtomically(const FilePath& path,
                                   StringPiece data,
                                   StringPiece histogram_suffix = StringPiece());
+  static bool WriteFileAtomically(const FilePath& path,
+                                  span<const uint8_t> data,
+                                  StringPiece histogram_suffix = StringPiece());
 
   // Initialize the writer.
   // |path| is the name of file to write.
@@ -111,6 +194,9 @@ class BASE_EXPORT ImportantFileWriter {
   // Save |data| to target filename. Does not block. If there is a pending write
   // scheduled by ScheduleWrite(), it is cancelled.
   void WriteNow(std::string data);
+  // Same as above, for data which is already serialized in a buffer, which is
+  // written from without being copied.
+  void WriteNow(scoped_refptr<RefCountedMemory> data);
 
   // Schedule a save to target filename. Data will be serialized and saved
   // to disk after the commit interval. If another ScheduleWrite is issued
@@ -143,6 +229,11 @@ class BASE_EXPORT ImportantFileWriter {
     return commit_interval_;
   }
 
+  // Makes the writes of this writer go through |commit_coordinator|, which may
+  // be shared with other writers. Must be called before any write.
+  void SetCommitCoordinator(
+      scoped_refptr<CommitCoordinator> commit_coordinator);
+
   // Overrides the timer to use for scheduling writes with |timer_override|.
   void SetTimerForTesting(OneShotTimer* timer_override);
 
@@ -154,6 +245,15 @@ class BASE_EXPORT ImportantFileWriter {
   }
 
  private:
+  // Data to write: either a string, or a buffer which is written from without
+  // being copied.
+  using SerializedData =
+      absl::variant<std::string, scoped_refptr<RefCountedMemory>>;
+  // Produces the data to write on the sequence where it is written, like a
+  // BackgroundDataProducerCallback.
+  using DataProducerCallback =
+      OnceCallback<absl::optional<SerializedData>()>;
+
   const OneShotTimer& timer() const {
     return timer_override_ ? *timer_override_ : timer_;
   }
@@ -163,12 +263,13 @@ class BASE_EXPORT ImportantFileWriter {
   // custom logic in the background sequence.
   void WriteNowWithBackgroundDataProducer(
       BackgroundDataProducerCallback background_producer);
+  void WriteNowWithDataProducer(DataProducerCallback data_producer);
 
   // Helper function to call WriteFileAtomically() with a promise-like callback
-  // producing a std::string.
-  static void ProduceAndWriteStringToFileAtomically(
+  // producing the data.
+  static void ProduceAndWriteToFileAtomically(
       const FilePath& path,
-      BackgroundDataProducerCallback data_producer_for_background_sequence,
+      DataProducerCallback data_producer_for_background_sequence,
       OnceClosure before_write_callback,
       OnceCallback<void(bool success)> after_write_callback,
       const std::string& histogram_suffix);
@@ -179,12 +280,29 @@ class BASE_EXPORT ImportantFileWriter {
   // WriteFileAtomically. When false, the directory containing |path| is added
   // to the set cleaned by the ImportantFileWriterCleaner (Windows only).
   static bool WriteFileAtomicallyImpl(const FilePath& path,
-                                      StringPiece data,
+                                      span<const uint8_t> data,
                                       StringPiece histogram_suffix,
                                       bool from_instance);
 
+  static span<const uint8_t> GetBytes(const SerializedData& data);
+
+  // Creates a temp file next to |path|, into which |data| is written, without
+  // flushing it. Returns an invalid File, having deleted the temp file, on
+  // failure.
+  static File CreateAndWriteTempFile(const FilePath& path,
+                                     span<const uint8_t> data,
+                                     FilePath* tmp_file_path);
+
+  // Replaces |path| with the flushed |tmp_file|, deleting it on failure.
+  static bool ReplaceWithTempFile(File tmp_file,
+                                  const FilePath& tmp_file_path,
+                                  const FilePath& path);
+
   void ClearPendingWrite();
 
+  // Returns the delay after which a scheduled write is done.
+  TimeDelta GetScheduledWriteDelay() const;
+
   // Invoked synchronously on the next write event.
   OnceClosure before_next_write_callback_;
   OnceCallback<void(bool success)> after_next_write_callback_;
@@ -195,6 +313,9 @@ class BASE_EXPORT ImportantFileWriter {
   // TaskRunner for the thread on which file I/O can be done.
   const scoped_refptr<SequencedTaskRunner> task_runner_;
 
+  // Where writes go instead of |task_runner_|, if set.
+  scoped_refptr<CommitCoordinator> commit_coordinator_;
+
   // Timer used to schedule commit after ScheduleWrite.
   OneShotTimer timer_;
 
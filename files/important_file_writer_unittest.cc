@@ -4,15 +4,24 @@
 
 #include "base/files/important_file_writer.h"
 
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "base/compiler_specific.h"
+#include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/functional/bind.h"
 #include "base/location.h"
 #include "base/memory/ptr_util.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/notreached.h"
 #include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/sequence_checker.h"
 #include "base/task/single_thread_task_runner.h"
 #include "base/test/bind.h"
@@ -477,4 +486,128 @@ TEST_F(ImportantFileWriterTest, SerializationDurationWithCustomSuffix) {
   histogram_tester.ExpectTotalCount("ImportantFile.WriteDuration.Foo", 1);
 }
 
+TEST_F(ImportantFileWriterTest, WriteNowRefCountedMemory) {
+  ImportantFileWriter writer(file_,
+                             SingleThreadTaskRunner::GetCurrentDefault());
+  write_callback_observer_.ObserveNextWriteCallbacks(&writer);
+  writer.WriteNow(MakeRefCounted<RefCountedString>(std::string("foo")));
+  RunLoop().RunUntilIdle();
+
+  EXPECT_EQ(CALLED_WITH_SUCCESS,
+            write_callback_observer_.GetAndResetObservationState());
+  EXPECT_EQ("foo", GetFileContent(writer.path()));
+}
+
+TEST_F(ImportantFileWriterTest, WriteFileAtomicallySpan) {
+  const uint8_t data[] = {'b', 'a', 'r'};
+  EXPECT_TRUE(ImportantFileWriter::WriteFileAtomically(file_, data));
+  EXPECT_EQ("bar", GetFileContent(file_));
+}
+
+// Writes queued before the coordinator runs are committed together.
+TEST_F(ImportantFileWriterTest, CommitCoordinatorGroupsWrites) {
+  HistogramTester histogram_tester;
+  ImportantFileWriter::CommitCoordinator::Options options;
+  options.use_syncfs = true;
+  auto coordinator = MakeRefCounted<ImportantFileWriter::CommitCoordinator>(
+      SingleThreadTaskRunner::GetCurrentDefault(), options);
+  constexpr int kWriterCount = 5;
+  std::vector<std::unique_ptr<ImportantFileWriter>> writers;
+  std::vector<WriteCallbacksObserver> observers(kWriterCount);
+  for (int i = 0; i < kWriterCount; ++i) {
+    writers.push_back(std::make_unique<ImportantFileWriter>(
+        file_.AddExtensionASCII(NumberToString(i)),
+        SingleThreadTaskRunner::GetCurrentDefault()));
+    writers[i]->SetCommitCoordinator(coordinator);
+    observers[i].ObserveNextWriteCallbacks(writers[i].get());
+  }
+  for (int i = 0; i < kWriterCount; ++i) {
+    if (i % 2) {
+      writers[i]->WriteNow(NumberToString(i));
+    } else {
+      writers[i]->WriteNow(
+          MakeRefCounted<RefCountedString>(NumberToString(i)));
+    }
+  }
+  RunLoop().RunUntilIdle();
+
+  for (int i = 0; i < kWriterCount; ++i) {
+    EXPECT_EQ(CALLED_WITH_SUCCESS, observers[i].GetAndResetObservationState());
+    EXPECT_EQ(NumberToString(i), GetFileContent(writers[i]->path()));
+  }
+  histogram_tester.ExpectUniqueSample("ImportantFile.GroupCommitSize",
+                                      kWriterCount, 1);
+  histogram_tester.ExpectTotalCount("ImportantFile.WriteDuration",
+                                    kWriterCount);
+}
+
+TEST_F(ImportantFileWriterTest, CommitCoordinatorKeepsLastWrite) {
+  auto coordinator = MakeRefCounted<ImportantFileWriter::CommitCoordinator>(
+      SingleThreadTaskRunner::GetCurrentDefault());
+  ImportantFileWriter writer(file_,
+                             SingleThreadTaskRunner::GetCurrentDefault());
+  writer.SetCommitCoordinator(coordinator);
+  writer.WriteNow("foo");
+  writer.WriteNow("bar");
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("bar", GetFileContent(writer.path()));
+
+  // No temp file is left behind.
+  int file_count = 0;
+  FileEnumerator enumerator(file_.DirName(), /*recursive=*/false,
+                            FileEnumerator::FILES);
+  for (FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    ++file_count;
+  }
+  EXPECT_EQ(1, file_count);
+}
+
+TEST_F(ImportantFileWriterTest, CommitCoordinatorIsolatesFailures) {
+  auto coordinator = MakeRefCounted<ImportantFileWriter::CommitCoordinator>(
+      SingleThreadTaskRunner::GetCurrentDefault());
+  ImportantFileWriter writer(file_,
+                             SingleThreadTaskRunner::GetCurrentDefault());
+  ImportantFileWriter failing_writer(
+      FilePath().AppendASCII("bad/../path"),
+      SingleThreadTaskRunner::GetCurrentDefault());
+  writer.SetCommitCoordinator(coordinator);
+  failing_writer.SetCommitCoordinator(coordinator);
+  WriteCallbacksObserver failing_observer;
+  write_callback_observer_.ObserveNextWriteCallbacks(&writer);
+  failing_observer.ObserveNextWriteCallbacks(&failing_writer);
+
+  failing_writer.WriteNow("foo");
+  writer.WriteNow("foo");
+  RunLoop().RunUntilIdle();
+
+  EXPECT_EQ(CALLED_WITH_ERROR, failing_observer.GetAndResetObservationState());
+  EXPECT_EQ(CALLED_WITH_SUCCESS,
+            write_callback_observer_.GetAndResetObservationState());
+  EXPECT_EQ("foo", GetFileContent(writer.path()));
+}
+
+TEST_F(ImportantFileWriterTest, CommitCoordinatorAlignsScheduledWrites) {
+  constexpr TimeDelta kCommitInterval = Seconds(10);
+  ImportantFileWriter::CommitCoordinator::Options options;
+  options.commit_window = Seconds(2);
+  auto coordinator = MakeRefCounted<ImportantFileWriter::CommitCoordinator>(
+      SingleThreadTaskRunner::GetCurrentDefault(), options);
+  MockOneShotTimer timer;
+  ImportantFileWriter writer(file_, SingleThreadTaskRunner::GetCurrentDefault(),
+                             kCommitInterval);
+  writer.SetTimerForTesting(&timer);
+  writer.SetCommitCoordinator(coordinator);
+
+  DataSerializer serializer("foo");
+  writer.ScheduleWrite(&serializer);
+  ASSERT_TRUE(timer.IsRunning());
+  EXPECT_GE(timer.GetCurrentDelay(), kCommitInterval);
+  EXPECT_LE(timer.GetCurrentDelay(), kCommitInterval + options.commit_window);
+
+  timer.Fire();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("foo", GetFileContent(writer.path()));
+}
+
 }  // namespace base
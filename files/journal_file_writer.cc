@@ -0,0 +1,336 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/journal_file_writer.h"
+
+#include <string.h>
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "base/check_op.h"
+#include "base/files/important_file_writer.h"
+#include "base/memory/ptr_util.h"
+#include "base/metrics/crc32.h"
+#include "base/threading/scoped_blocking_call.h"
+
+namespace base {
+
+namespace {
+
+constexpr uint32_t kSnapshotMagic = 0x504e534a;  // "JSNP"
+constexpr uint32_t kJournalMagic = 0x4c4e524a;   // "JRNL"
+constexpr uint32_t kFormatVersion = 1;
+
+constexpr int64_t kSnapshotHeaderSize = sizeof(internal::SnapshotHeader);
+constexpr int64_t kJournalHeaderSize = sizeof(internal::JournalHeader);
+constexpr int64_t kRecordHeaderSize = sizeof(internal::JournalRecordHeader);
+
+template <typename T>
+bool ReadStruct(File& file, int64_t offset, T* value) {
+  return file.Read(offset, reinterpret_cast<char*>(value), sizeof(T)) ==
+         static_cast<int>(sizeof(T));
+}
+
+// Reads the header of the journal in |file|, and returns whether it is a
+// journal of the snapshot of |generation|.
+bool ReadJournalHeader(File& file, uint64_t generation) {
+  internal::JournalHeader header;
+  return ReadStruct(file, 0, &header) && header.magic == kJournalMagic &&
+         header.version == kFormatVersion && header.generation == generation;
+}
+
+// Reads the record at |offset| of the journal in |file|, of |length| bytes,
+// into |payload|, and returns the offset of the next record. Returns -1 at the
+// end of the journal, or if the record is corrupted or partially written.
+int64_t ReadRecord(File& file,
+                   int64_t offset,
+                   int64_t length,
+                   std::string* payload) {
+  internal::JournalRecordHeader header;
+  if (length - offset < kRecordHeaderSize ||
+      !ReadStruct(file, offset, &header) ||
+      header.size > JournalFileWriter::kMaxRecordSize ||
+      length - offset - kRecordHeaderSize < header.size) {
+    return -1;
+  }
+  payload->resize(header.size);
+  if (header.size > 0 &&
+      file.Read(offset + kRecordHeaderSize, payload->data(),
+                static_cast<int>(header.size)) !=
+          static_cast<int>(header.size)) {
+    return -1;
+  }
+  if (internal::GetJournalRecordCrc(as_bytes(make_span(*payload))) !=
+      header.crc) {
+    return -1;
+  }
+  return offset + kRecordHeaderSize + header.size;
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<JournalFileWriter> JournalFileWriter::Open(
+    const FilePath& path,
+    SnapshotCallback snapshot_callback,
+    const Options& options) {
+  ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+  auto writer = WrapUnique(
+      new JournalFileWriter(path, std::move(snapshot_callback), options));
+  if (!writer->ReadSnapshotHeader() || !writer->OpenJournal()) {
+    return nullptr;
+  }
+  return writer;
+}
+
+JournalFileWriter::JournalFileWriter(const FilePath& path,
+                                     SnapshotCallback snapshot_callback,
+                                     const Options& options)
+    : path_(path),
+      journal_path_(GetJournalPath(path)),
+      snapshot_callback_(std::move(snapshot_callback)),
+      options_(options) {}
+
+JournalFileWriter::~JournalFileWriter() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (journal_.IsValid()) {
+    ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                            BlockingType::MAY_BLOCK);
+    journal_.Close();
+  }
+}
+
+// static
+FilePath JournalFileWriter::GetJournalPath(const FilePath& path) {
+  return path.AddExtension(FILE_PATH_LITERAL("journal"));
+}
+
+bool JournalFileWriter::Append(span<const uint8_t> record) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (record.size() > kMaxRecordSize) {
+    return false;
+  }
+  ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+
+  // A compaction may have replaced the snapshot, then failed to start its
+  // journal.
+  if (!journal_.IsValid() && !StartJournal()) {
+    return false;
+  }
+
+  // Write the header and the payload at once, so that the record is at most
+  // torn by a crash, rather than interleaved with a later one.
+  internal::JournalRecordHeader header;
+  header.size = static_cast<uint32_t>(record.size());
+  header.crc = internal::GetJournalRecordCrc(record);
+  std::vector<uint8_t> buffer(kRecordHeaderSize + record.size());
+  memcpy(buffer.data(), &header, kRecordHeaderSize);
+  if (!record.empty()) {
+    memcpy(buffer.data() + kRecordHeaderSize, record.data(), record.size());
+  }
+
+  const int size = static_cast<int>(buffer.size());
+  if (journal_.Write(journal_size_,
+                     reinterpret_cast<const char*>(buffer.data()),
+                     size) != size ||
+      (options_.flush_records && !journal_.Flush())) {
+    // Don't leave part of the record for the next one to be appended after.
+    journal_.SetLength(journal_size_);
+    return false;
+  }
+  journal_size_ += size;
+  bytes_written_ += size;
+
+  if (ShouldCompact()) {
+    Compact();
+  }
+  return true;
+}
+
+bool JournalFileWriter::Compact() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  absl::optional<std::string> state = snapshot_callback_.Run();
+  if (!state || state->size() > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+
+  internal::SnapshotHeader header;
+  header.magic = kSnapshotMagic;
+  header.version = kFormatVersion;
+  header.generation = generation_ + 1;
+  header.payload_crc = Crc32(0, state->data(), state->size());
+  header.payload_size = static_cast<uint32_t>(state->size());
+  std::vector<uint8_t> buffer(kSnapshotHeaderSize + state->size());
+  memcpy(buffer.data(), &header, kSnapshotHeaderSize);
+  if (!state->empty()) {
+    memcpy(buffer.data() + kSnapshotHeaderSize, state->data(), state->size());
+  }
+
+  // Once the snapshot is replaced, the current journal no longer applies to
+  // it, so a crash before the journal is started over loses nothing.
+  if (!ImportantFileWriter::WriteFileAtomically(path_, make_span(buffer))) {
+    return false;
+  }
+  ++generation_;
+  snapshot_size_ = static_cast<int64_t>(buffer.size());
+  bytes_written_ += snapshot_size_;
+  return StartJournal();
+}
+
+bool JournalFileWriter::ReadSnapshotHeader() {
+  File snapshot(path_, File::FLAG_OPEN | File::FLAG_READ);
+  if (!snapshot.IsValid()) {
+    // Nothing was saved yet, which is like an empty snapshot.
+    return snapshot.error_details() == File::FILE_ERROR_NOT_FOUND;
+  }
+  internal::SnapshotHeader header;
+  if (!ReadStruct(snapshot, 0, &header) || header.magic != kSnapshotMagic ||
+      header.version != kFormatVersion) {
+    return false;
+  }
+  generation_ = header.generation;
+  snapshot_size_ = snapshot.GetLength();
+  return snapshot_size_ >= 0;
+}
+
+bool JournalFileWriter::OpenJournal() {
+  journal_ = File(journal_path_,
+                  File::FLAG_OPEN | File::FLAG_READ | File::FLAG_WRITE);
+  if (!journal_.IsValid() || !ReadJournalHeader(journal_, generation_)) {
+    return StartJournal();
+  }
+
+  const int64_t length = journal_.GetLength();
+  int64_t offset = kJournalHeaderSize;
+  std::string payload;
+  for (int64_t next = offset; next >= 0;
+       next = ReadRecord(journal_, offset, length, &payload)) {
+    offset = next;
+  }
+  // Drop what a crash left after the last complete record, so that the next
+  // record can be read back.
+  if (offset < length &&
+      (!journal_.SetLength(offset) ||
+       (options_.flush_records && !journal_.Flush()))) {
+    return false;
+  }
+  journal_size_ = offset;
+  return true;
+}
+
+bool JournalFileWriter::StartJournal() {
+  journal_ = File(journal_path_, File::FLAG_CREATE_ALWAYS | File::FLAG_READ |
+                                     File::FLAG_WRITE);
+  if (!journal_.IsValid()) {
+    return false;
+  }
+  internal::JournalHeader header;
+  header.magic = kJournalMagic;
+  header.version = kFormatVersion;
+  header.generation = generation_;
+  if (journal_.Write(0, reinterpret_cast<const char*>(&header),
+                     kJournalHeaderSize) != kJournalHeaderSize ||
+      (options_.flush_records && !journal_.Flush())) {
+    journal_.Close();
+    return false;
+  }
+  journal_size_ = kJournalHeaderSize;
+  bytes_written_ += kJournalHeaderSize;
+  return true;
+}
+
+bool JournalFileWriter::ShouldCompact() const {
+  return journal_size_ >= options_.min_journal_size_to_compact &&
+         journal_size_ > snapshot_size_ * options_.max_journal_ratio;
+}
+
+JournalFileReader::JournalFileReader(const FilePath& path) : path_(path) {}
+
+JournalFileReader::~JournalFileReader() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (journal_.IsValid()) {
+    ScopedBlockingCall scoped_blocking_call(FROM_HERE,
+                                            BlockingType::MAY_BLOCK);
+    journal_.Close();
+  }
+}
+
+bool JournalFileReader::ReadSnapshot(std::string* snapshot) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+  snapshot->clear();
+
+  uint64_t generation = 0;
+  File file(path_, File::FLAG_OPEN | File::FLAG_READ);
+  if (file.IsValid()) {
+    internal::SnapshotHeader header;
+    if (!ReadStruct(file, 0, &header) || header.magic != kSnapshotMagic ||
+        header.version != kFormatVersion ||
+        file.GetLength() != kSnapshotHeaderSize + header.payload_size) {
+      return false;
+    }
+    snapshot->resize(header.payload_size);
+    if (header.payload_size > 0 &&
+        file.Read(kSnapshotHeaderSize, snapshot->data(),
+                  static_cast<int>(header.payload_size)) !=
+            static_cast<int>(header.payload_size)) {
+      snapshot->clear();
+      return false;
+    }
+    if (Crc32(0, snapshot->data(), snapshot->size()) != header.payload_crc) {
+      snapshot->clear();
+      return false;
+    }
+    generation = header.generation;
+  } else if (file.error_details() != File::FILE_ERROR_NOT_FOUND) {
+    return false;
+  }
+
+  // Ignore a journal of a previous snapshot, which a crash during compaction
+  // may leave behind.
+  journal_ = File(JournalFileWriter::GetJournalPath(path_),
+                  File::FLAG_OPEN | File::FLAG_READ);
+  if (journal_.IsValid() && !ReadJournalHeader(journal_, generation)) {
+    journal_.Close();
+  }
+  journal_offset_ = kJournalHeaderSize;
+  journal_length_ = journal_.IsValid() ? journal_.GetLength() : 0;
+  return true;
+}
+
+bool JournalFileReader::ReadNextRecord(std::string* record) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (!journal_.IsValid()) {
+    return false;
+  }
+  ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+  const int64_t next =
+      ReadRecord(journal_, journal_offset_, journal_length_, record);
+  if (next < 0) {
+    found_corrupted_record_ = journal_offset_ != journal_length_;
+    record->clear();
+    journal_.Close();
+    return false;
+  }
+  journal_offset_ = next;
+  return true;
+}
+
+namespace internal {
+
+uint32_t GetJournalRecordCrc(span<const uint8_t> record) {
+  // Crc32() has no initial value nor final inversion, so zeroes checksum to
+  // zero. Seed and invert it, so that the zero-filled tail a system crash may
+  // leave doesn't read as a run of valid empty records.
+  const uint32_t size = static_cast<uint32_t>(record.size());
+  const uint32_t crc = Crc32(~0u, &size, sizeof(size));
+  return ~Crc32(crc, record.data(), record.size());
+}
+
+}  // namespace internal
+
+}  // namespace base
@@ -0,0 +1,192 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_JOURNAL_FILE_WRITER_H_
+#define BASE_FILES_JOURNAL_FILE_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "base/base_export.h"
+#include "base/containers/span.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/functional/callback.h"
+#include "base/sequence_checker.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+namespace base {
+
+// Saves a state as a snapshot and a journal of changes ("records") to apply on
+// top of it, so that saving a small change to a large state only appends the
+// change, instead of rewriting the whole state as ImportantFileWriter does.
+// Once the journal grows too large compared to the snapshot, the state is
+// compacted into a new snapshot, written with ImportantFileWriter, and the
+// journal starts over.
+//
+// The snapshot is stored at the path of the state, and the journal next to
+// it (see GetJournalPath()). Records are checksummed, and a record which was
+// only partially written when the process or the system crashed is dropped,
+// along with anything after it. The journal is tagged with the generation of
+// the snapshot it applies to, so that a journal which couldn't be reset after
+// a compaction is ignored rather than applied twice. The files are in host
+// byte order, and not meant to be moved between devices.
+//
+// Like File, this class does blocking I/O, and must be used on a sequence
+// which allows it.
+class BASE_EXPORT JournalFileWriter {
+ public:
+  struct BASE_EXPORT Options {
+    // Compact once the journal is larger than this ratio of the snapshot...
+    double max_journal_ratio = 1.0;
+    // ... and than this size, so that small states aren't compacted too often.
+    int64_t min_journal_size_to_compact = 64 * 1024;
+    // Whether to flush each record to the storage device when appended, which
+    // makes it survive system crashes. Otherwise records only survive process
+    // crashes until the next compaction, or until the system flushes them.
+    bool flush_records = true;
+  };
+
+  // Largest record a journal may hold, which bounds what a corrupted record
+  // makes JournalFileReader allocate.
+  static constexpr size_t kMaxRecordSize = 16 * 1024 * 1024;
+
+  // Returns the whole state, to compact into a new snapshot, or nullopt on
+  // failure.
+  using SnapshotCallback = RepeatingCallback<absl::optional<std::string>()>;
+
+  // Opens the journal of the state saved at |path|, to append records to what
+  // JournalFileReader reads. Drops any partially written record at the end of
+  // the journal, and starts a new journal if there is none for the current
+  // snapshot. Returns null on failure.
+  static std::unique_ptr<JournalFileWriter> Open(
+      const FilePath& path,
+      SnapshotCallback snapshot_callback,
+      const Options& options);
+
+  JournalFileWriter(const JournalFileWriter&) = delete;
+  JournalFileWriter& operator=(const JournalFileWriter&) = delete;
+  ~JournalFileWriter();
+
+  // Returns where the journal of the state saved at |path| is.
+  static FilePath GetJournalPath(const FilePath& path);
+
+  // Appends |record| to the journal, then compacts the state if the journal
+  // grew too large. Returns false if |record| couldn't be appended, in which
+  // case the journal is left as it was, or is larger than kMaxRecordSize.
+  // Failing to compact is not an error: the journal then keeps growing until
+  // the next attempt.
+  bool Append(span<const uint8_t> record);
+
+  // Writes the state returned by the snapshot callback as the new snapshot,
+  // and starts a new journal. Returns false on failure, in which case the
+  // state is left as it was. If only starting the new journal failed, the next
+  // Append() tries again.
+  bool Compact();
+
+  int64_t journal_size() const { return journal_size_; }
+  int64_t snapshot_size() const { return snapshot_size_; }
+
+  // Number of bytes written to the snapshot and the journal so far.
+  int64_t bytes_written() const { return bytes_written_; }
+
+ private:
+  JournalFileWriter(const FilePath& path,
+                    SnapshotCallback snapshot_callback,
+                    const Options& options);
+
+  // Reads the generation and size of the snapshot.
+  bool ReadSnapshotHeader();
+
+  // Opens the journal of the current snapshot, keeping its valid records, or
+  // starts a new one.
+  bool OpenJournal();
+
+  // Starts a new journal for the current snapshot.
+  bool StartJournal();
+
+  bool ShouldCompact() const;
+
+  const FilePath path_;
+  const FilePath journal_path_;
+  const SnapshotCallback snapshot_callback_;
+  const Options options_;
+
+  File journal_;
+  uint64_t generation_ = 0;
+  int64_t snapshot_size_ = 0;
+  int64_t journal_size_ = 0;
+  int64_t bytes_written_ = 0;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+};
+
+// Reads the state saved by JournalFileWriter: its snapshot, then the records
+// of its journal, in the order they were appended.
+class BASE_EXPORT JournalFileReader {
+ public:
+  explicit JournalFileReader(const FilePath& path);
+  JournalFileReader(const JournalFileReader&) = delete;
+  JournalFileReader& operator=(const JournalFileReader&) = delete;
+  ~JournalFileReader();
+
+  // Reads the snapshot into |snapshot|, which is empty if none was saved yet.
+  // Returns false if it can't be read, or is corrupted. Must be called first.
+  bool ReadSnapshot(std::string* snapshot);
+
+  // Reads the next record into |record|. Returns false once all the valid
+  // records were read.
+  bool ReadNextRecord(std::string* record);
+
+  // Whether reading records stopped at a corrupted or partially written
+  // record, rather than at the end of the journal.
+  bool found_corrupted_record() const { return found_corrupted_record_; }
+
+ private:
+  const FilePath path_;
+  File journal_;
+  int64_t journal_offset_ = 0;
+  int64_t journal_length_ = 0;
+  bool found_corrupted_record_ = false;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+};
+
+namespace internal {
+
+// The formats of the files, which JournalFileWriter and JournalFileReader
+// share.
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t generation;
+  uint32_t payload_crc;
+  uint32_t payload_size;
+};
+
+struct JournalHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t generation;
+};
+
+// Followed by |size| bytes of payload.
+struct JournalRecordHeader {
+  uint32_t size;
+  // CRC-32 of |size| then of the payload, seeded with and inverted by ~0u.
+  uint32_t crc;
+};
+
+// Returns JournalRecordHeader::crc for |record|.
+BASE_EXPORT uint32_t GetJournalRecordCrc(span<const uint8_t> record);
+
+}  // namespace internal
+
+}  // namespace base
+
+#endif  // BASE_FILES_JOURNAL_FILE_WRITER_H_
@@ -0,0 +1,112 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/journal_file_writer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/files/important_file_writer.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/functional/bind.h"
+#include "base/rand_util.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+namespace base {
+
+namespace {
+
+constexpr char kMetricPrefixSave[] = "SaveState.";
+constexpr char kMetricWriteAmplification[] = "write_amplification";
+constexpr char kMetricTimePerSave[] = "time_per_save";
+
+constexpr size_t kStateSize = 1024 * 1024;
+constexpr size_t kChangeSize = 4096;
+// Enough for the journal to be compacted twice.
+constexpr int kSaveCount = 600;
+
+class SaveStatePerfTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.GetPath().AppendASCII("state");
+    state_ = RandBytesAsString(kStateSize);
+  }
+
+  // Overwrites a random part of the state, and returns the new contents.
+  std::string ChangeState() {
+    std::string change = RandBytesAsString(kChangeSize);
+    state_.replace(RandGenerator(kStateSize - kChangeSize), kChangeSize,
+                   change);
+    return change;
+  }
+
+  JournalFileWriter::SnapshotCallback GetStateCallback() {
+    return BindRepeating(&SaveStatePerfTest::GetState, Unretained(this));
+  }
+
+  void ReportResults(const std::string& story,
+                     int64_t bytes_written,
+                     TimeDelta elapsed) {
+    perf_test::PerfResultReporter reporter(kMetricPrefixSave, story);
+    reporter.RegisterImportantMetric(kMetricWriteAmplification, "ratio");
+    reporter.RegisterImportantMetric(kMetricTimePerSave, "us");
+    reporter.AddResult(
+        kMetricWriteAmplification,
+        static_cast<double>(bytes_written) / (kChangeSize * kSaveCount));
+    reporter.AddResult(kMetricTimePerSave,
+                       elapsed.InMicrosecondsF() / kSaveCount);
+  }
+
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+  std::string state_;
+
+ private:
+  absl::optional<std::string> GetState() { return state_; }
+};
+
+}  // namespace
+
+// Saves each change by appending it to a journal, with the default options,
+// which flush each record and compact once the journal outgrows the snapshot.
+TEST_F(SaveStatePerfTest, Journal) {
+  std::unique_ptr<JournalFileWriter> writer = JournalFileWriter::Open(
+      path_, GetStateCallback(), JournalFileWriter::Options());
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(writer->Compact());
+  const int64_t initial_bytes_written = writer->bytes_written();
+
+  const TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kSaveCount; ++i) {
+    // A real record would also hold where the change goes.
+    const std::string change = ChangeState();
+    ASSERT_TRUE(writer->Append(as_bytes(make_span(change))));
+  }
+  const TimeDelta elapsed = TimeTicks::Now() - start;
+  ReportResults("journal", writer->bytes_written() - initial_bytes_written,
+                elapsed);
+}
+
+// Saves each change by rewriting the whole state, as ImportantFileWriter
+// does.
+TEST_F(SaveStatePerfTest, Rewrite) {
+  const TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kSaveCount; ++i) {
+    ChangeState();
+    ASSERT_TRUE(ImportantFileWriter::WriteFileAtomically(path_, state_));
+  }
+  const TimeDelta elapsed = TimeTicks::Now() - start;
+  ReportResults("rewrite", static_cast<int64_t>(kStateSize) * kSaveCount,
+                elapsed);
+}
+
+}  // namespace base
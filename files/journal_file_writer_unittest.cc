@@ -0,0 +1,313 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/journal_file_writer.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/functional/bind.h"
+#include "base/strings/string_piece.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+namespace base {
+
+namespace {
+
+// Saves a state of lines, by appending each new line to the journal.
+class JournalFileWriterTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.GetPath().AppendASCII("state");
+  }
+
+  std::unique_ptr<JournalFileWriter> OpenWriter(
+      const JournalFileWriter::Options& options =
+          JournalFileWriter::Options()) {
+    return JournalFileWriter::Open(
+        path_,
+        BindRepeating(&JournalFileWriterTest::GetState, Unretained(this)),
+        options);
+  }
+
+  bool AppendLine(JournalFileWriter& writer, const std::string& line) {
+    if (!writer.Append(as_bytes(make_span(line)))) {
+      return false;
+    }
+    state_ += line + "\n";
+    return true;
+  }
+
+  // Returns the snapshot and the records JournalFileReader reads, as the lines
+  // AppendLine() appended.
+  std::string ReadState(bool* found_corrupted_record = nullptr) {
+    JournalFileReader reader(path_);
+    std::string state;
+    EXPECT_TRUE(reader.ReadSnapshot(&state));
+    std::string record;
+    while (reader.ReadNextRecord(&record)) {
+      state += record + "\n";
+    }
+    if (found_corrupted_record) {
+      *found_corrupted_record = reader.found_corrupted_record();
+    }
+    return state;
+  }
+
+  absl::optional<std::string> GetState() { return state_; }
+
+  FilePath journal_path() const {
+    return JournalFileWriter::GetJournalPath(path_);
+  }
+
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+  std::string state_;
+};
+
+}  // namespace
+
+TEST_F(JournalFileWriterTest, AppendAndRead) {
+  EXPECT_EQ("", ReadState());
+
+  std::unique_ptr<JournalFileWriter> writer = OpenWriter();
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(AppendLine(*writer, "a"));
+  ASSERT_TRUE(AppendLine(*writer, ""));
+  ASSERT_TRUE(AppendLine(*writer, "bc"));
+  EXPECT_EQ("a\n\nbc\n", ReadState());
+
+  // Records are appended after the ones of a previous writer.
+  writer = OpenWriter();
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(AppendLine(*writer, "d"));
+  EXPECT_EQ("a\n\nbc\nd\n", ReadState());
+}
+
+TEST_F(JournalFileWriterTest, Compact) {
+  std::unique_ptr<JournalFileWriter> writer = OpenWriter();
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(AppendLine(*writer, "a"));
+  ASSERT_TRUE(writer->Compact());
+  int64_t snapshot_size = 0;
+  ASSERT_TRUE(GetFileSize(path_, &snapshot_size));
+  EXPECT_EQ(snapshot_size, writer->snapshot_size());
+  const int64_t empty_journal_size = writer->journal_size();
+  ASSERT_TRUE(AppendLine(*writer, "b"));
+  EXPECT_EQ("a\nb\n", ReadState());
+
+  // Compacting again only keeps what the callback returns.
+  state_ = "c\n";
+  ASSERT_TRUE(writer->Compact());
+  EXPECT_EQ(empty_journal_size, writer->journal_size());
+  EXPECT_EQ("c\n", ReadState());
+}
+
+TEST_F(JournalFileWriterTest, CompactsOnceJournalGrowsTooLarge) {
+  JournalFileWriter::Options options;
+  options.max_journal_ratio = 2.0;
+  options.min_journal_size_to_compact = 1024;
+  options.flush_records = false;
+  std::unique_ptr<JournalFileWriter> writer = OpenWriter(options);
+  ASSERT_TRUE(writer);
+
+  const std::string line(100, 'x');
+  int compaction_count = 0;
+  for (int i = 0; i < 100; ++i) {
+    const int64_t snapshot_size = writer->snapshot_size();
+    ASSERT_TRUE(AppendLine(*writer, line));
+    if (writer->snapshot_size() != snapshot_size) {
+      ++compaction_count;
+      // The journal no longer holds anything the snapshot does.
+      EXPECT_LT(writer->journal_size(), 100);
+    }
+    EXPECT_LE(writer->journal_size(),
+              std::max<int64_t>(1024, writer->snapshot_size() * 2) + 200);
+  }
+  // Each compaction at least doubles what the journal may hold.
+  EXPECT_GT(compaction_count, 1);
+  EXPECT_LT(compaction_count, 10);
+  EXPECT_EQ(state_, ReadState());
+}
+
+TEST_F(JournalFileWriterTest, FailsToCompactWithoutState) {
+  std::unique_ptr<JournalFileWriter> writer = JournalFileWriter::Open(
+      path_, BindRepeating([]() -> absl::optional<std::string> {
+        return absl::nullopt;
+      }),
+      JournalFileWriter::Options());
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(writer->Append(as_bytes(make_span("a", 1u))));
+  EXPECT_FALSE(writer->Compact());
+  // The journal is kept.
+  EXPECT_EQ("a\n", ReadState());
+}
+
+#if BUILDFLAG(IS_POSIX)
+// Only POSIX allows deleting the journal while it is open.
+TEST_F(JournalFileWriterTest, StartsJournalAfterFailedCompaction) {
+  std::unique_ptr<JournalFileWriter> writer = OpenWriter();
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(AppendLine(*writer, "a"));
+
+  // The journal of the new snapshot can't be started while a directory is in
+  // its way.
+  ASSERT_TRUE(DeleteFile(journal_path()));
+  ASSERT_TRUE(CreateDirectory(journal_path()));
+  EXPECT_FALSE(writer->Compact());
+  EXPECT_FALSE(AppendLine(*writer, "b"));
+  EXPECT_EQ("a\n", ReadState());
+
+  ASSERT_TRUE(DeletePathRecursively(journal_path()));
+  ASSERT_TRUE(AppendLine(*writer, "c"));
+  EXPECT_EQ("a\nc\n", ReadState());
+}
+#endif  // BUILDFLAG(IS_POSIX)
+
+// Simulates a crash at each point of writing the last record, by cutting the
+// journal there.
+TEST_F(JournalFileWriterTest, DropsPartiallyWrittenRecord) {
+  std::unique_ptr<JournalFileWriter> writer = OpenWriter();
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(AppendLine(*writer, "first"));
+  ASSERT_TRUE(writer->Compact());
+  ASSERT_TRUE(AppendLine(*writer, "second"));
+  const std::string expected_state = state_;
+  const int64_t length_before_last = writer->journal_size();
+  ASSERT_TRUE(AppendLine(*writer, "last"));
+  const int64_t length = writer->journal_size();
+  writer.reset();
+  std::string journal;
+  ASSERT_TRUE(ReadFileToString(journal_path(), &journal));
+
+  for (int64_t cut = length_before_last; cut < length; ++cut) {
+    SCOPED_TRACE(cut);
+    ASSERT_TRUE(WriteFile(
+        journal_path(),
+        StringPiece(journal).substr(0, static_cast<size_t>(cut))));
+    bool found_corrupted_record = false;
+    EXPECT_EQ(expected_state, ReadState(&found_corrupted_record));
+    EXPECT_EQ(cut != length_before_last, found_corrupted_record);
+
+    // A new writer drops what is left of the record, and appends after the
+    // ones before it.
+    writer = OpenWriter();
+    ASSERT_TRUE(writer);
+    EXPECT_EQ(length_before_last, writer->journal_size());
+    ASSERT_TRUE(writer->Append(as_bytes(make_span("next", 4u))));
+    writer.reset();
+    EXPECT_EQ(expected_state + "next\n", ReadState(&found_corrupted_record));
+    EXPECT_FALSE(found_corrupted_record);
+  }
+}
+
+TEST_F(JournalFileWriterTest, StopsAtCorruptedRecord) {
+  std::unique_ptr<JournalFileWriter> writer = OpenWriter();
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(AppendLine(*writer, "a"));
+  const int64_t offset = writer->journal_size();
+  ASSERT_TRUE(AppendLine(*writer, "corrupted"));
+  ASSERT_TRUE(AppendLine(*writer, "c"));
+  writer.reset();
+
+  File journal(journal_path(), File::FLAG_OPEN | File::FLAG_WRITE);
+  ASSERT_TRUE(journal.IsValid());
+  // Flip a byte of the payload of the second record.
+  const char byte = 'X';
+  ASSERT_EQ(1, journal.Write(offset + 12, &byte, 1));
+  journal.Close();
+
+  bool found_corrupted_record = false;
+  EXPECT_EQ("a\n", ReadState(&found_corrupted_record));
+  EXPECT_TRUE(found_corrupted_record);
+}
+
+// Simulates a crash during compaction, after the snapshot was replaced but
+// before the journal was started over.
+TEST_F(JournalFileWriterTest, IgnoresJournalOfPreviousSnapshot) {
+  std::unique_ptr<JournalFileWriter> writer = OpenWriter();
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(AppendLine(*writer, "a"));
+  ASSERT_TRUE(AppendLine(*writer, "b"));
+  std::string old_journal;
+  ASSERT_TRUE(ReadFileToString(journal_path(), &old_journal));
+  ASSERT_TRUE(writer->Compact());
+  writer.reset();
+  ASSERT_TRUE(WriteFile(journal_path(), old_journal));
+
+  // The records are in the snapshot, and aren't applied twice.
+  EXPECT_EQ("a\nb\n", ReadState());
+
+  writer = OpenWriter();
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(AppendLine(*writer, "c"));
+  EXPECT_EQ("a\nb\nc\n", ReadState());
+}
+
+TEST_F(JournalFileWriterTest, RejectsCorruptedSnapshot) {
+  std::unique_ptr<JournalFileWriter> writer = OpenWriter();
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(AppendLine(*writer, "a"));
+  ASSERT_TRUE(writer->Compact());
+  writer.reset();
+  std::string snapshot;
+  ASSERT_TRUE(ReadFileToString(path_, &snapshot));
+  snapshot.back() ^= 1;
+  ASSERT_TRUE(WriteFile(path_, snapshot));
+
+  JournalFileReader reader(path_);
+  std::string state;
+  EXPECT_FALSE(reader.ReadSnapshot(&state));
+  EXPECT_TRUE(state.empty());
+
+  ASSERT_TRUE(WriteFile(path_, "not a snapshot"));
+  EXPECT_FALSE(OpenWriter());
+}
+
+// Simulates a system crash after the journal was extended but before its new
+// blocks were written, which leaves it with a zero-filled tail.
+TEST_F(JournalFileWriterTest, StopsAtZeroFilledTail) {
+  std::unique_ptr<JournalFileWriter> writer = OpenWriter();
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(AppendLine(*writer, "a"));
+  ASSERT_TRUE(AppendLine(*writer, "b"));
+  const int64_t length = writer->journal_size();
+  writer.reset();
+  ASSERT_TRUE(AppendToFile(journal_path(), std::string(64, '\0')));
+
+  bool found_corrupted_record = false;
+  EXPECT_EQ("a\nb\n", ReadState(&found_corrupted_record));
+  EXPECT_TRUE(found_corrupted_record);
+
+  // A new writer drops the tail, and appends after the valid records.
+  writer = OpenWriter();
+  ASSERT_TRUE(writer);
+  EXPECT_EQ(length, writer->journal_size());
+  ASSERT_TRUE(AppendLine(*writer, "c"));
+  writer.reset();
+  EXPECT_EQ("a\nb\nc\n", ReadState(&found_corrupted_record));
+  EXPECT_FALSE(found_corrupted_record);
+}
+
+TEST_F(JournalFileWriterTest, RecordCrcCoversSize) {
+  const uint8_t bytes[] = {0, 0, 0, 0};
+  EXPECT_NE(internal::GetJournalRecordCrc(make_span(bytes, 2u)),
+            internal::GetJournalRecordCrc(make_span(bytes, 4u)));
+}
+
+TEST_F(JournalFileWriterTest, EmptyRecordCrcIsNotZero) {
+  EXPECT_NE(0u, internal::GetJournalRecordCrc(span<const uint8_t>()));
+}
+
+}  // namespace base
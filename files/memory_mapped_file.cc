@@ -4,17 +4,90 @@
 
 #include "base/files/memory_mapped_file.h"
 
+#include <inttypes.h>
+#include <stdint.h>
+
+#include <map>
 #include <utility>
 
+#include "base/bits.h"
 #include "base/files/file_path.h"
 #include "base/logging.h"
+#include "base/memory/page_size.h"
 #include "base/notreached.h"
 #include "base/numerics/safe_math.h"
 #include "base/system/sys_info.h"
+#include "base/tracing_buildflags.h"
 #include "build/build_config.h"
 
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+#include "base/no_destructor.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/thread_annotations.h"
+#include "base/trace_event/memory_allocator_dump.h"  // no-presubmit-check
+#include "base/trace_event/memory_dump_manager.h"    // no-presubmit-check
+#include "base/trace_event/memory_dump_provider.h"   // no-presubmit-check
+#include "base/trace_event/process_memory_dump.h"    // no-presubmit-check
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+
 namespace base {
 
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+namespace {
+
+// Reports the mappings mapped with a MapOptions::memory_dump_name.
+class MappedFileDumpProvider : public trace_event::MemoryDumpProvider {
+ public:
+  static MappedFileDumpProvider* GetInstance() {
+    static NoDestructor<MappedFileDumpProvider> instance;
+    return instance.get();
+  }
+
+  MappedFileDumpProvider(const MappedFileDumpProvider&) = delete;
+  MappedFileDumpProvider& operator=(const MappedFileDumpProvider&) = delete;
+
+  void AddMapping(const MemoryMappedFile* file, const char* name) {
+    AutoLock hold(lock_);
+    DCHECK(mappings_.find(file) == mappings_.end());
+    mappings_.emplace(file, name);
+  }
+
+  // Once this returns, the mapping isn't being dumped, and may be unmapped.
+  void RemoveMapping(const MemoryMappedFile* file) {
+    AutoLock hold(lock_);
+    DCHECK(mappings_.find(file) != mappings_.end());
+    mappings_.erase(file);
+  }
+
+  // trace_event::MemoryDumpProvider:
+  bool OnMemoryDump(const trace_event::MemoryDumpArgs& args,
+                    trace_event::ProcessMemoryDump* pmd) override {
+    AutoLock hold(lock_);
+    for (const auto& [file, name] : mappings_) {
+      file->AddMemoryDump(
+          pmd, StringPrintf("mapped_files/%s/0x%" PRIXPTR, name,
+                            reinterpret_cast<uintptr_t>(file->data())));
+    }
+    return true;
+  }
+
+ private:
+  friend class NoDestructor<MappedFileDumpProvider>;
+
+  MappedFileDumpProvider() {
+    trace_event::MemoryDumpManager::GetInstance()->RegisterDumpProvider(
+        this, "MemoryMappedFile", nullptr);
+  }
+  ~MappedFileDumpProvider() override = default;
+
+  Lock lock_;
+  std::map<const MemoryMappedFile*, const char*> mappings_ GUARDED_BY(lock_);
+};
+
+}  // namespace
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+
 const MemoryMappedFile::Region MemoryMappedFile::Region::kWholeFile = {0, 0};
 
 bool MemoryMappedFile::Region::operator==(
@@ -28,6 +101,11 @@ bool MemoryMappedFile::Region::operator!=(
 }
 
 MemoryMappedFile::~MemoryMappedFile() {
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+  if (is_dumped_) {
+    MappedFileDumpProvider::GetInstance()->RemoveMapping(this);
+  }
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
   CloseHandles();
 }
 
@@ -70,10 +148,12 @@ bool MemoryMappedFile::Initialize(const FilePath& file_name, Access access) {
     return false;
   }
 
-  if (!MapFileRegionToMemory(Region::kWholeFile, access)) {
+  if (!MapFileRegionToMemory(Region::kWholeFile, access, /*populate=*/false)) {
     CloseHandles();
     return false;
   }
+  access_ = access;
+  file_offset_ = 0;
 
   return true;
 }
@@ -86,6 +166,13 @@ bool MemoryMappedFile::Initialize(File file, Access access) {
 bool MemoryMappedFile::Initialize(File file,
                                   const Region& region,
                                   Access access) {
+  return Initialize(std::move(file), region, access, MapOptions());
+}
+
+bool MemoryMappedFile::Initialize(File file,
+                                  const Region& region,
+                                  Access access,
+                                  const MapOptions& options) {
   switch (access) {
     case READ_WRITE_EXTEND:
       DCHECK(Region::kWholeFile != region);
@@ -124,11 +211,23 @@ bool MemoryMappedFile::Initialize(File file,
 
   file_ = std::move(file);
 
-  if (!MapFileRegionToMemory(region, access)) {
+  if (!MapFileRegionToMemory(region, access, options.populate)) {
     CloseHandles();
     return false;
   }
+  access_ = access;
+  file_offset_ = region == Region::kWholeFile ? 0 : region.offset;
 
+  if (options.access_hint != AccessHint::kNormal) {
+    Advise(options.access_hint);
+  }
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+  if (options.memory_dump_name) {
+    MappedFileDumpProvider::GetInstance()->AddMapping(this,
+                                                      options.memory_dump_name);
+    is_dumped_ = true;
+  }
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
   return true;
 }
 
@@ -136,6 +235,45 @@ bool MemoryMappedFile::IsValid() const {
   return data_ != nullptr;
 }
 
+void MemoryMappedFile::AddMemoryDump(trace_event::ProcessMemoryDump* pmd,
+                                     const std::string& dump_name) const {
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+  DCHECK(IsValid());
+  trace_event::MemoryAllocatorDump* dump = pmd->CreateAllocatorDump(dump_name);
+  // Like for shared memory, fall back to the virtual size.
+  dump->AddScalar(trace_event::MemoryAllocatorDump::kNameSize,
+                  trace_event::MemoryAllocatorDump::kUnitsBytes,
+                  GetResidentSize().value_or(length_));
+  dump->AddScalar("virtual_size", trace_event::MemoryAllocatorDump::kUnitsBytes,
+                  length_);
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+}
+
+bool MemoryMappedFile::GetPageRange(const Region& region,
+                                    uint8_t** start,
+                                    size_t* size) const {
+  if (!IsValid()) {
+    return false;
+  }
+  size_t offset = 0;
+  size_t region_size = length_;
+  if (region != Region::kWholeFile) {
+    if (region.offset < 0 ||
+        static_cast<uint64_t>(region.offset) > length_ ||
+        region.size > length_ - static_cast<size_t>(region.offset)) {
+      return false;
+    }
+    offset = static_cast<size_t>(region.offset);
+    region_size = region.size;
+  }
+  // data() itself may not be page-aligned, but the mapping starts at or
+  // before the page it is in.
+  uint8_t* region_start = data_ + offset;
+  *start = bits::AlignDown(region_start, GetPageSize());
+  *size = region_size + static_cast<size_t>(region_start - *start);
+  return true;
+}
+
 // static
 void MemoryMappedFile::CalculateVMAlignedBoundaries(int64_t start,
                                                     size_t size,
@@ -8,13 +8,17 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <string>
 #include <utility>
 
 #include "base/base_export.h"
 #include "base/containers/span.h"
 #include "base/files/file.h"
+#include "base/functional/callback.h"
 #include "base/memory/raw_ptr_exclusion.h"
+#include "base/tracing_buildflags.h"
 #include "build/build_config.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
 
 #if BUILDFLAG(IS_WIN)
 #include "base/win/scoped_handle.h"
@@ -24,6 +28,10 @@ namespace base {
 
 class FilePath;
 
+namespace trace_event {
+class ProcessMemoryDump;
+}  // namespace trace_event
+
 class BASE_EXPORT MemoryMappedFile {
  public:
   enum Access {
@@ -62,6 +70,43 @@ class BASE_EXPORT MemoryMappedFile {
 #endif
   };
 
+  // How the mapping is about to be accessed, which lets the OS page it in and
+  // out more efficiently. See Advise().
+  enum class AccessHint {
+    // Undoes kSequential and kRandom.
+    kNormal,
+    // Pages are accessed in order, so can be read ahead aggressively, and
+    // dropped soon after they are accessed.
+    kSequential,
+    // Pages are accessed in no particular order, so reading ahead of them is
+    // wasted.
+    kRandom,
+    // Pages will be accessed soon, so start reading them in.
+    kWillNeed,
+    // Pages won't be accessed soon, so may be dropped from memory. They are
+    // read back from the file when accessed again, which loses what was
+    // written to a READ_WRITE_COPY mapping.
+    kDontNeed,
+    // Back the mapping with huge pages, which reduces TLB misses when
+    // accessing it at random. Only supported by some file systems.
+    kHugePage,
+  };
+
+  // Options to map a region of a file with.
+  struct BASE_EXPORT MapOptions {
+    // Passed to Advise() once the file is mapped, unless kNormal.
+    AccessHint access_hint = AccessHint::kNormal;
+    // Whether to read the whole region into memory when mapping it, rather
+    // than when it is accessed. This blocks for as long as reading the region
+    // takes, and is only supported on Linux, ChromeOS and Android (elsewhere,
+    // this is like |access_hint| being kWillNeed).
+    bool populate = false;
+    // If set, memory-infra dumps report the mapping with AddMemoryDump(),
+    // under "mapped_files/<memory_dump_name>/<address>". Must outlive the
+    // mapping, e.g. be a string literal.
+    const char* memory_dump_name = nullptr;
+  };
+
   // The default constructor sets all members to invalid/null values.
   MemoryMappedFile();
   MemoryMappedFile(const MemoryMappedFile&) = delete;
@@ -111,6 +156,12 @@ class BASE_EXPORT MemoryMappedFile {
     return Initialize(std::move(file), region, READ_ONLY);
   }
 
+  // As above, but with |options|.
+  [[nodiscard]] bool Initialize(File file,
+                                const Region& region,
+                                Access access,
+                                const MapOptions& options);
+
   const uint8_t* data() const { return data_; }
   uint8_t* data() { return data_; }
   size_t length() const { return length_; }
@@ -122,6 +173,38 @@ class BASE_EXPORT MemoryMappedFile {
   // Is file_ a valid file handle that points to an open, memory mapped file?
   bool IsValid() const;
 
+  // In the methods below, |region| is relative to data() rather than to the
+  // start of the file, and must be within bytes(). kWholeFile stands for all
+  // of bytes().
+
+  // Tells the OS how |region| is about to be accessed. Returns false if |hint|
+  // isn't supported for this mapping, or if the OS rejected it; the mapping
+  // works the same either way. On Windows, only kWillNeed is supported.
+  bool Advise(AccessHint hint, const Region& region = Region::kWholeFile);
+
+  // Starts reading |region| into memory without waiting for it, so that it
+  // doesn't have to be read when accessed. On Linux, ChromeOS and Android,
+  // this reads the file ahead into the page cache from the thread pool, and
+  // runs |on_done| on the current sequence once the reads were issued.
+  // Elsewhere, this is Advise(AccessHint::kWillNeed), and |on_done| is posted
+  // right away.
+  // Must be called on a sequence, with a ThreadPoolInstance. The mapping may
+  // be closed before |on_done| runs.
+  void Prefetch(const Region& region, OnceClosure on_done = OnceClosure());
+
+  // Returns how many bytes of the pages spanning |region| are in memory, or
+  // nullopt if this isn't supported (it is only on Linux, ChromeOS and
+  // Android) or fails.
+  absl::optional<size_t> GetResidentSize(
+      const Region& region = Region::kWholeFile) const;
+
+  // Adds a memory-infra dump named |dump_name| to |pmd|, with the resident
+  // size of the mapping as its size (or its length where that isn't
+  // available), and its length as its "virtual_size". Does nothing in builds
+  // without tracing. See also MapOptions::memory_dump_name.
+  void AddMemoryDump(trace_event::ProcessMemoryDump* pmd,
+                     const std::string& dump_name) const;
+
  private:
   // Given the arbitrarily aligned memory region [start, size], returns the
   // boundaries of the region aligned to the granularity specified by the OS,
@@ -143,7 +226,15 @@ class BASE_EXPORT MemoryMappedFile {
 
   // Map the file to memory, set data_ to that memory address. Return true on
   // success, false on any kind of failure. This is a helper for Initialize().
-  bool MapFileRegionToMemory(const Region& region, Access access);
+  bool MapFileRegionToMemory(const Region& region,
+                             Access access,
+                             bool populate);
+
+  // Returns the range of the mapping spanning |region| of data(), with a
+  // page-aligned start, or false if |region| isn't within bytes().
+  bool GetPageRange(const Region& region,
+                    uint8_t** start,
+                    size_t* size) const;
 
   // Closes all open handles.
   void CloseHandles();
@@ -154,6 +245,13 @@ class BASE_EXPORT MemoryMappedFile {
   // using a raw_ptr.
   RAW_PTR_EXCLUSION uint8_t* data_ = nullptr;
   size_t length_ = 0;
+  // Offset in the file at which data() starts.
+  int64_t file_offset_ = 0;
+  Access access_ = READ_ONLY;
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+  // Whether the mapping was mapped with a MapOptions::memory_dump_name.
+  bool is_dumped_ = false;
+#endif
 
 #if BUILDFLAG(IS_WIN)
   win::ScopedHandle file_mapping_;
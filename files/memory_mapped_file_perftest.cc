@@ -0,0 +1,173 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/memory_mapped_file.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <limits>
+#include <string>
+
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/page_size.h"
+#include "base/rand_util.h"
+#include "base/test/task_environment.h"
+#include "base/test/test_future.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace base {
+
+namespace {
+
+constexpr char kMetricPrefixScan[] = "MemoryMappedFileScan.";
+constexpr char kMetricTimePerScan[] = "time_per_scan";
+constexpr char kMetricResidentSize[] = "resident_size";
+
+constexpr size_t kFileSize = 256 * 1024 * 1024;
+constexpr int kScanCount = 3;
+// Pages read by a random scan, out of the 65536 4 KiB pages of the file.
+constexpr size_t kRandomReadCount = 8192;
+
+enum class ScanType {
+  // Reads a byte of each page, in order.
+  kSequential,
+  // Reads a byte of kRandomReadCount pages at random.
+  kRandom,
+};
+
+enum class PagingMode {
+  // Maps the file without any hint.
+  kDefault,
+  // Maps the file with the AccessHint matching the scan.
+  kAccessHint,
+  // Maps the file with MapOptions::populate.
+  kPopulate,
+  // Waits for Prefetch() of the whole file before scanning it.
+  kPrefetch,
+};
+
+struct ScanParams {
+  ScanType scan_type;
+  PagingMode paging_mode;
+};
+
+std::string GetStoryName(const ScanParams& params) {
+  std::string story =
+      params.scan_type == ScanType::kSequential ? "sequential" : "random";
+  switch (params.paging_mode) {
+    case PagingMode::kDefault:
+      return story + "_default";
+    case PagingMode::kAccessHint:
+      return story + "_access_hint";
+    case PagingMode::kPopulate:
+      return story + "_populate";
+    case PagingMode::kPrefetch:
+      return story + "_prefetch";
+  }
+}
+
+class MemoryMappedFilePerfTest : public testing::TestWithParam<ScanParams> {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.GetPath().AppendASCII("file");
+    File file(path_, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE);
+    ASSERT_TRUE(file.IsValid());
+    const std::string chunk = RandBytesAsString(1024 * 1024);
+    for (size_t offset = 0; offset < kFileSize; offset += chunk.size()) {
+      ASSERT_TRUE(file.WriteAtCurrentPosAndCheck(as_bytes(make_span(chunk))));
+    }
+    ASSERT_TRUE(file.Flush());
+  }
+
+  // Drops the file from the page cache, so that scans read it from the
+  // storage device. This has no effect on file systems which only live in
+  // memory, like tmpfs.
+  void EvictFile() {
+    File file(path_, File::FLAG_OPEN | File::FLAG_READ);
+    ASSERT_TRUE(file.IsValid());
+    ASSERT_EQ(0, posix_fadvise(file.GetPlatformFile(), 0, 0,
+                               POSIX_FADV_DONTNEED));
+  }
+
+  test::TaskEnvironment task_environment_;
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+};
+
+INSTANTIATE_TEST_SUITE_P(
+    All,
+    MemoryMappedFilePerfTest,
+    testing::Values(
+        ScanParams{ScanType::kSequential, PagingMode::kDefault},
+        ScanParams{ScanType::kSequential, PagingMode::kAccessHint},
+        ScanParams{ScanType::kSequential, PagingMode::kPopulate},
+        ScanParams{ScanType::kSequential, PagingMode::kPrefetch},
+        ScanParams{ScanType::kRandom, PagingMode::kDefault},
+        ScanParams{ScanType::kRandom, PagingMode::kAccessHint}));
+
+}  // namespace
+
+// Maps a file which isn't in the page cache, and scans it.
+TEST_P(MemoryMappedFilePerfTest, ColdScan) {
+  const ScanParams& params = GetParam();
+  const size_t page_size = GetPageSize();
+  const size_t page_count = kFileSize / page_size;
+
+  TimeDelta elapsed;
+  size_t resident_size = 0;
+  for (int i = 0; i < kScanCount; ++i) {
+    EvictFile();
+    MemoryMappedFile::MapOptions options;
+    if (params.paging_mode == PagingMode::kAccessHint) {
+      options.access_hint = params.scan_type == ScanType::kSequential
+                                ? MemoryMappedFile::AccessHint::kSequential
+                                : MemoryMappedFile::AccessHint::kRandom;
+    }
+    options.populate = params.paging_mode == PagingMode::kPopulate;
+
+    const TimeTicks start = TimeTicks::Now();
+    MemoryMappedFile map;
+    ASSERT_TRUE(
+        map.Initialize(File(path_, File::FLAG_OPEN | File::FLAG_READ),
+                       MemoryMappedFile::Region::kWholeFile,
+                       MemoryMappedFile::READ_ONLY, options));
+    if (params.paging_mode == PagingMode::kPrefetch) {
+      test::TestFuture<void> done;
+      map.Prefetch(MemoryMappedFile::Region::kWholeFile, done.GetCallback());
+      ASSERT_TRUE(done.Wait());
+    }
+    uint32_t sum = 0;
+    if (params.scan_type == ScanType::kSequential) {
+      for (size_t page = 0; page < page_count; ++page) {
+        sum += map.data()[page * page_size];
+      }
+    } else {
+      for (size_t j = 0; j < kRandomReadCount; ++j) {
+        sum += map.data()[RandGenerator(page_count) * page_size];
+      }
+    }
+    elapsed += TimeTicks::Now() - start;
+    // Keeps the reads from being optimized out.
+    EXPECT_NE(std::numeric_limits<uint32_t>::max(), sum);
+    resident_size += map.GetResidentSize().value_or(0);
+  }
+
+  perf_test::PerfResultReporter reporter(kMetricPrefixScan,
+                                         GetStoryName(params));
+  reporter.RegisterImportantMetric(kMetricTimePerScan, "ms");
+  reporter.RegisterImportantMetric(kMetricResidentSize, "bytes");
+  reporter.AddResult(kMetricTimePerScan,
+                     elapsed.InMillisecondsF() / kScanCount);
+  reporter.AddResult(kMetricResidentSize, resident_size / kScanCount);
+}
+
+}  // namespace base
@@ -11,20 +11,42 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "base/files/file_util.h"
+#include "base/functional/bind.h"
+#include "base/functional/callback_helpers.h"
 #include "base/logging.h"
+#include "base/memory/page_size.h"
 #include "base/numerics/safe_conversions.h"
+#include "base/task/sequenced_task_runner.h"
+#include "base/task/thread_pool.h"
 #include "base/threading/scoped_blocking_call.h"
 #include "build/build_config.h"
 
 namespace base {
 
+namespace {
+
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+void ReadAheadFile(File file, int64_t offset, size_t size) {
+  ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
+  if (readahead(file.GetPlatformFile(), offset, size) != 0) {
+    DPLOG(ERROR) << "readahead " << file.GetPlatformFile();
+  }
+}
+#endif
+
+}  // namespace
+
 MemoryMappedFile::MemoryMappedFile() = default;
 
 #if !BUILDFLAG(IS_NACL)
 bool MemoryMappedFile::MapFileRegionToMemory(
     const MemoryMappedFile::Region& region,
-    Access access) {
+    Access access,
+    bool populate) {
   ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
 
   off_t map_start = 0;
@@ -90,6 +112,11 @@ bool MemoryMappedFile::MapFileRegionToMemory(
 
       break;
   }
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+  if (populate) {
+    flags |= MAP_POPULATE;
+  }
+#endif
 
   data_ = static_cast<uint8_t*>(
       mmap(nullptr, map_size, prot, flags, file_.GetPlatformFile(), map_start));
@@ -97,11 +124,115 @@ bool MemoryMappedFile::MapFileRegionToMemory(
     DPLOG(ERROR) << "mmap " << file_.GetPlatformFile();
     return false;
   }
+#if !(BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID))
+  if (populate) {
+    madvise(data_, map_size, MADV_WILLNEED);
+  }
+#endif
 
   data_ += data_offset;
   return true;
 }
+
+bool MemoryMappedFile::Advise(AccessHint hint, const Region& region) {
+  int advice = MADV_NORMAL;
+  switch (hint) {
+    case AccessHint::kNormal:
+      advice = MADV_NORMAL;
+      break;
+    case AccessHint::kSequential:
+      advice = MADV_SEQUENTIAL;
+      break;
+    case AccessHint::kRandom:
+      advice = MADV_RANDOM;
+      break;
+    case AccessHint::kWillNeed:
+      advice = MADV_WILLNEED;
+      break;
+    case AccessHint::kDontNeed:
+      // This would drop what was written to the private copy of the pages.
+      if (access_ == READ_WRITE_COPY) {
+        return false;
+      }
+      advice = MADV_DONTNEED;
+      break;
+    case AccessHint::kHugePage:
+#if defined(MADV_HUGEPAGE)
+      advice = MADV_HUGEPAGE;
+      break;
+#else
+      return false;
 #endif
+  }
+
+  uint8_t* start = nullptr;
+  size_t size = 0;
+  if (!GetPageRange(region, &start, &size)) {
+    return false;
+  }
+  return size == 0 || madvise(start, size, advice) == 0;
+}
+
+void MemoryMappedFile::Prefetch(const Region& region, OnceClosure on_done) {
+  if (!on_done) {
+    on_done = DoNothing();
+  }
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+  // Read ahead from a duplicate of the file, which stays valid if the mapping
+  // is closed in the meantime, unlike the mapping itself.
+  uint8_t* start = nullptr;
+  size_t size = 0;
+  if (GetPageRange(region, &start, &size)) {
+    File file = file_.Duplicate();
+    if (file.IsValid()) {
+      ThreadPool::PostTaskAndReply(
+          FROM_HERE,
+          {MayBlock(), TaskPriority::USER_VISIBLE,
+           TaskShutdownBehavior::CONTINUE_ON_SHUTDOWN},
+          BindOnce(&ReadAheadFile, std::move(file),
+                   file_offset_ + (start - data_), size),
+          std::move(on_done));
+      return;
+    }
+  }
+#endif
+  Advise(AccessHint::kWillNeed, region);
+  SequencedTaskRunner::GetCurrentDefault()->PostTask(FROM_HERE,
+                                                     std::move(on_done));
+}
+
+absl::optional<size_t> MemoryMappedFile::GetResidentSize(
+    const Region& region) const {
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+  uint8_t* start = nullptr;
+  size_t size = 0;
+  if (!GetPageRange(region, &start, &size)) {
+    return absl::nullopt;
+  }
+  // Query a chunk of pages at a time, to bound the size of the vector.
+  constexpr size_t kMaxPagesPerQuery = 4096;
+  const size_t page_size = GetPageSize();
+  const size_t max_chunk_size = kMaxPagesPerQuery * page_size;
+  std::vector<unsigned char> vec(
+      std::min(kMaxPagesPerQuery, (size + page_size - 1) / page_size));
+  size_t resident_pages = 0;
+  for (size_t offset = 0; offset < size; offset += max_chunk_size) {
+    const size_t chunk_size = std::min(size - offset, max_chunk_size);
+    if (mincore(start + offset, chunk_size, vec.data()) != 0) {
+      DPLOG(ERROR) << "mincore";
+      return absl::nullopt;
+    }
+    const size_t page_count = (chunk_size + page_size - 1) / page_size;
+    for (size_t i = 0; i < page_count; ++i) {
+      resident_pages += vec[i] & 1;
+    }
+  }
+  return resident_pages * page_size;
+#else
+  return absl::nullopt;
+#endif
+}
+#endif  // !BUILDFLAG(IS_NACL)
 
 void MemoryMappedFile::CloseHandles() {
   ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
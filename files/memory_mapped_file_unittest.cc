@@ -7,10 +7,15 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <memory>
 #include <utility>
 
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
+#include "base/memory/page_size.h"
+#include "base/test/task_environment.h"
+#include "base/test/test_future.h"
+#include "build/build_config.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
@@ -274,6 +279,97 @@ TEST_F(MemoryMappedFileTest, ExtendableFile) {
   EXPECT_EQ("BAZ", contents.substr(kFileSize, 3));
 }
 
+TEST_F(MemoryMappedFileTest, MapWithOptions) {
+  const size_t kFileSize = 256 * 1024;
+  const size_t kOffset = 4 * 1024 + 17;
+  CreateTemporaryTestFile(kFileSize);
+  MemoryMappedFile::MapOptions options;
+  options.access_hint = MemoryMappedFile::AccessHint::kSequential;
+  options.populate = true;
+  MemoryMappedFile map;
+  ASSERT_TRUE(
+      map.Initialize(File(temp_file_path(), File::FLAG_OPEN | File::FLAG_READ),
+                     {kOffset, kFileSize - kOffset},
+                     MemoryMappedFile::READ_ONLY, options));
+  EXPECT_EQ(kFileSize - kOffset, map.length());
+  EXPECT_TRUE(CheckBufferContents(map.bytes(), kOffset));
+}
+
+TEST_F(MemoryMappedFileTest, Advise) {
+  const size_t kFileSize = 64 * 1024;
+  CreateTemporaryTestFile(kFileSize);
+  MemoryMappedFile map;
+  ASSERT_TRUE(map.Initialize(temp_file_path()));
+
+  EXPECT_TRUE(map.Advise(MemoryMappedFile::AccessHint::kWillNeed));
+  EXPECT_TRUE(map.Advise(MemoryMappedFile::AccessHint::kWillNeed,
+                         {1000, kFileSize - 1000}));
+  // The region must be within the mapping.
+  EXPECT_FALSE(map.Advise(MemoryMappedFile::AccessHint::kWillNeed,
+                          {1000, kFileSize}));
+  EXPECT_FALSE(
+      map.Advise(MemoryMappedFile::AccessHint::kWillNeed, {-1, kFileSize}));
+#if BUILDFLAG(IS_POSIX)
+  EXPECT_TRUE(map.Advise(MemoryMappedFile::AccessHint::kRandom));
+  EXPECT_TRUE(map.Advise(MemoryMappedFile::AccessHint::kSequential));
+  EXPECT_TRUE(map.Advise(MemoryMappedFile::AccessHint::kNormal));
+  EXPECT_TRUE(map.Advise(MemoryMappedFile::AccessHint::kDontNeed));
+#endif
+  // The contents are read back as needed.
+  EXPECT_TRUE(CheckBufferContents(map.bytes(), 0));
+}
+
+TEST_F(MemoryMappedFileTest, AdviseDontNeedKeepsCopyOnWriteChanges) {
+  const size_t kFileSize = 64 * 1024;
+  CreateTemporaryTestFile(kFileSize);
+  MemoryMappedFile map;
+  ASSERT_TRUE(
+      map.Initialize(temp_file_path(), MemoryMappedFile::READ_WRITE_COPY));
+  map.mutable_bytes()[0] = 'B';
+  EXPECT_FALSE(map.Advise(MemoryMappedFile::AccessHint::kDontNeed));
+  EXPECT_EQ('B', map.bytes()[0]);
+}
+
+TEST_F(MemoryMappedFileTest, Prefetch) {
+  test::TaskEnvironment task_environment;
+  const size_t kFileSize = 1024 * 1024;
+  CreateTemporaryTestFile(kFileSize);
+  auto map = std::make_unique<MemoryMappedFile>();
+  ASSERT_TRUE(map->Initialize(temp_file_path()));
+
+  test::TestFuture<void> done;
+  map->Prefetch(MemoryMappedFile::Region::kWholeFile, done.GetCallback());
+  EXPECT_TRUE(done.Wait());
+  EXPECT_TRUE(CheckBufferContents(map->bytes(), 0));
+
+  // The mapping may be closed before the prefetch is done.
+  test::TestFuture<void> closed_done;
+  map->Prefetch({4096, 8192}, closed_done.GetCallback());
+  map.reset();
+  EXPECT_TRUE(closed_done.Wait());
+}
+
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+TEST_F(MemoryMappedFileTest, GetResidentSize) {
+  const size_t kFileSize = 1024 * 1024 + 100;
+  CreateTemporaryTestFile(kFileSize);
+  MemoryMappedFile map;
+  ASSERT_TRUE(map.Initialize(temp_file_path()));
+  // Reading the file makes all of it resident.
+  ASSERT_TRUE(CheckBufferContents(map.bytes(), 0));
+
+  const size_t page_size = GetPageSize();
+  EXPECT_EQ((kFileSize + page_size - 1) / page_size * page_size,
+            map.GetResidentSize());
+  // Regions span the pages they touch.
+  EXPECT_EQ(page_size, map.GetResidentSize({1, 10}));
+  EXPECT_EQ(2 * page_size,
+            map.GetResidentSize({static_cast<int64_t>(page_size) - 1, 2}));
+  EXPECT_EQ(0u, map.GetResidentSize({static_cast<int64_t>(page_size), 0}));
+  EXPECT_FALSE(map.GetResidentSize({0, kFileSize + 1}));
+}
+#endif
+
 }  // namespace
 
 }  // namespace base
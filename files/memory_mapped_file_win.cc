@@ -11,8 +11,10 @@
 #include <string>
 
 #include "base/files/file_path.h"
+#include "base/functional/callback_helpers.h"
 #include "base/logging.h"
 #include "base/numerics/checked_math.h"
+#include "base/task/sequenced_task_runner.h"
 #include "base/threading/scoped_blocking_call.h"
 #include "base/win/pe_image.h"
 
@@ -54,7 +56,8 @@ bool MemoryMappedFile::MapImageToMemory(Access access) {
 
 bool MemoryMappedFile::MapFileRegionToMemory(
     const MemoryMappedFile::Region& region,
-    Access access) {
+    Access access,
+    bool populate) {
   ScopedBlockingCall scoped_blocking_call(FROM_HERE, BlockingType::MAY_BLOCK);
 
   DCHECK(access != READ_CODE_IMAGE || region == Region::kWholeFile);
@@ -133,9 +136,44 @@ bool MemoryMappedFile::MapFileRegionToMemory(
   if (data_ == nullptr)
     return false;
   data_ += data_offset;
+  if (populate) {
+    Advise(AccessHint::kWillNeed);
+  }
   return true;
 }
 
+bool MemoryMappedFile::Advise(AccessHint hint, const Region& region) {
+  if (hint != AccessHint::kWillNeed) {
+    return false;
+  }
+  uint8_t* start = nullptr;
+  size_t size = 0;
+  if (!GetPageRange(region, &start, &size)) {
+    return false;
+  }
+  if (size == 0) {
+    // ::PrefetchVirtualMemory() fails when asked to read zero bytes.
+    return true;
+  }
+  // ::PrefetchVirtualMemory() fails if the file is opened with write access.
+  ::_WIN32_MEMORY_RANGE_ENTRY address_range = {start, size};
+  return ::PrefetchVirtualMemory(::GetCurrentProcess(),
+                                 /*NumberOfEntries=*/1, &address_range,
+                                 /*Flags=*/0);
+}
+
+void MemoryMappedFile::Prefetch(const Region& region, OnceClosure on_done) {
+  // ::PrefetchVirtualMemory() only issues the reads, without waiting for them.
+  Advise(AccessHint::kWillNeed, region);
+  SequencedTaskRunner::GetCurrentDefault()->PostTask(
+      FROM_HERE, on_done ? std::move(on_done) : DoNothing());
+}
+
+absl::optional<size_t> MemoryMappedFile::GetResidentSize(
+    const Region& region) const {
+  return absl::nullopt;
+}
+
 void MemoryMappedFile::CloseHandles() {
   if (data_)
     ::UnmapViewOfFile(data_);
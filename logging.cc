@@ -34,6 +34,8 @@
 #include "base/debug/task_trace.h"
 #include "base/functional/callback.h"
 #include "base/immediate_crash.h"
+#include "base/logging_async_writer.h"
+#include "base/logging_binary.h"
 #include "base/no_destructor.h"
 #include "base/path_service.h"
 #include "base/pending_task.h"
@@ -97,6 +99,8 @@ typedef HANDLE FileHandle;
 
 #if BUILDFLAG(IS_NACL)
 #include <sys/time.h>  // timespec doesn't seem to be in <time.h>
+#else
+#include <sys/uio.h>
 #endif
 
 #define MAX_PATH PATH_MAX
@@ -157,11 +161,16 @@ VlogInfo* GetVlogInfo() {
 // overwriting values set via ScopedVmoduleSwitches.
 bool InitializeVlogInfo(VlogInfo* vlog_info) {
   VlogInfo* previous_vlog_info = nullptr;
-  return g_vlog_info.compare_exchange_strong(previous_vlog_info, vlog_info);
+  if (!g_vlog_info.compare_exchange_strong(previous_vlog_info, vlog_info))
+    return false;
+  InvalidateCachedVlogLevels();
+  return true;
 }
 
 VlogInfo* ExchangeVlogInfo(VlogInfo* vlog_info) {
-  return g_vlog_info.exchange(vlog_info);
+  VlogInfo* previous_vlog_info = g_vlog_info.exchange(vlog_info);
+  InvalidateCachedVlogLevels();
+  return previous_vlog_info;
 }
 
 // Creates a VlogInfo from the commandline if it has been initialized and if it
@@ -456,6 +465,78 @@ void WriteToFd(int fd, const char* data, size_t length) {
   }
 }
 
+#if (BUILDFLAG(IS_POSIX) || BUILDFLAG(IS_FUCHSIA)) && !BUILDFLAG(IS_NACL)
+
+// Writes |messages| to the log file, for |g_async_log_writer|.
+void WriteMessagesToLogFile(base::span<const std::string> messages) {
+  base::AutoLock guard(GetLoggingLock());
+  if ((g_logging_destination & LOG_TO_FILE) == 0 || !InitializeLogFileHandle())
+    return;
+
+  const int fd = fileno(g_log_file);
+  size_t index = 0;
+  while (index < messages.size()) {
+    iovec iovecs[AsyncLogWriter::kMaxBatchSize];
+    size_t count = 0;
+    for (; count < std::size(iovecs) && index + count < messages.size();
+         ++count) {
+      const std::string& message = messages[index + count];
+      iovecs[count].iov_base = const_cast<char*>(message.data());
+      iovecs[count].iov_len = message.size();
+    }
+    const ssize_t rv =
+        HANDLE_EINTR(writev(fd, iovecs, static_cast<int>(count)));
+    if (rv <= 0) {
+      // Give up, nothing we can do now.
+      return;
+    }
+    // Skip the messages which were written, and finish writing the one which
+    // was written in part, if any.
+    size_t bytes_written = static_cast<size_t>(rv);
+    while (index < messages.size() &&
+           bytes_written >= messages[index].size()) {
+      bytes_written -= messages[index].size();
+      ++index;
+    }
+    if (bytes_written > 0) {
+      WriteToFd(fd, messages[index].data() + bytes_written,
+                messages[index].size() - bytes_written);
+      ++index;
+    }
+  }
+}
+
+// Writes the log file when |LoggingSettings::log_file_write_mode| isn't
+// WRITE_SYNCHRONOUSLY, and is null otherwise. It is never destroyed, so that
+// it can be used until the process exits or crashes.
+std::atomic<AsyncLogWriter*> g_async_log_writer{nullptr};
+
+void SetLogFileWriteMode(LogFileWriteMode mode) {
+  // Write the messages logged with the previous settings.
+  FlushLogFile();
+
+  if (mode == LogFileWriteMode::WRITE_SYNCHRONOUSLY) {
+    g_async_log_writer.store(nullptr, std::memory_order_release);
+    return;
+  }
+
+  static base::NoDestructor<AsyncLogWriter> async_log_writer(
+      &WriteMessagesToLogFile, AsyncLogWriter::Options());
+  static const bool started = async_log_writer->Start();
+  if (!started) {
+    // Write synchronously instead.
+    return;
+  }
+  async_log_writer->set_full_queue_policy(
+      mode == LogFileWriteMode::WRITE_ASYNC_BLOCK_WHEN_FULL
+          ? AsyncLogWriter::FullQueuePolicy::kBlock
+          : AsyncLogWriter::FullQueuePolicy::kDrop);
+  g_async_log_writer.store(async_log_writer.get(), std::memory_order_release);
+}
+
+#endif  // (BUILDFLAG(IS_POSIX) || BUILDFLAG(IS_FUCHSIA)) &&
+        // !BUILDFLAG(IS_NACL)
+
 void SetLogFatalCrashKey(LogMessage* log_message) {
 #if !BUILDFLAG(IS_NACL)
   // In case of an out-of-memory condition, this code could be reentered when
@@ -534,6 +615,13 @@ bool BaseInitLoggingImpl(const LoggingSettings& settings) {
 
   MaybeInitializeVlogInfo();
 
+#if (BUILDFLAG(IS_POSIX) || BUILDFLAG(IS_FUCHSIA)) && !BUILDFLAG(IS_NACL)
+  // Write the queued messages before their destinations change.
+  SetLogFileWriteMode((settings.logging_dest & LOG_TO_FILE)
+                          ? settings.log_file_write_mode
+                          : LogFileWriteMode::WRITE_SYNCHRONOUSLY);
+#endif
+
   g_logging_destination = settings.logging_dest;
 
 #if BUILDFLAG(IS_FUCHSIA)
@@ -575,6 +663,7 @@ bool BaseInitLoggingImpl(const LoggingSettings& settings) {
 
 void SetMinLogLevel(int level) {
   g_min_log_level = std::min(LOGGING_FATAL, level);
+  InvalidateCachedVlogLevels();
 }
 
 int GetMinLogLevel() {
@@ -624,6 +713,24 @@ int GetVlogLevelHelper(const char* file, size_t N) {
       GetVlogVerbosity();
 }
 
+std::atomic<uint32_t> g_vlog_level_generation{1};
+
+void InvalidateCachedVlogLevels() {
+  g_vlog_level_generation.fetch_add(1, std::memory_order_release);
+}
+
+int CacheVlogLevel(const char* file, size_t N, std::atomic<uint64_t>& cache) {
+  // Get the generation first, so that the level is cached as stale if the
+  // vlog levels change while it is computed.
+  const uint32_t generation =
+      g_vlog_level_generation.load(std::memory_order_acquire);
+  const int level = GetVlogLevelHelper(file, N);
+  cache.store((uint64_t{generation} << 32) |
+                  static_cast<uint32_t>(static_cast<int32_t>(level)),
+              std::memory_order_relaxed);
+  return level;
+}
+
 void SetLogItems(bool enable_process_id, bool enable_thread_id,
                  bool enable_timestamp, bool enable_tickcount) {
   g_log_process_id = enable_process_id;
@@ -885,7 +992,25 @@ LogMessage::~LogMessage() {
     WriteToFd(STDERR_FILENO, str_newline.data(), str_newline.size());
   }
 
-  if ((g_logging_destination & LOG_TO_FILE) != 0) {
+  bool write_to_log_file = (g_logging_destination & LOG_TO_FILE) != 0;
+#if (BUILDFLAG(IS_POSIX) || BUILDFLAG(IS_FUCHSIA)) && !BUILDFLAG(IS_NACL)
+  AsyncLogWriter* const async_log_writer =
+      g_async_log_writer.load(std::memory_order_acquire);
+  if (write_to_log_file && async_log_writer) {
+    if (severity_ == LOGGING_FATAL) {
+      // The process is about to crash, so write the queued messages now, and
+      // this one synchronously below.
+      async_log_writer->Flush();
+    } else {
+      // |str_newline| is only used below for FATAL messages.
+      async_log_writer->Enqueue(std::move(str_newline));
+      write_to_log_file = false;
+    }
+  }
+#endif  // (BUILDFLAG(IS_POSIX) || BUILDFLAG(IS_FUCHSIA)) &&
+        // !BUILDFLAG(IS_NACL)
+
+  if (write_to_log_file) {
 #if BUILDFLAG(IS_POSIX) || BUILDFLAG(IS_FUCHSIA)
     // If the client app did not call InitLogging() and the lock has not
     // been created it will be done now on calling GetLoggingLock(). We do this
@@ -950,6 +1075,9 @@ LogMessage::~LogMessage() {
       __llvm_profile_write_file();
 #endif
 
+      // Keep the messages which BINARY_LOG() recorded.
+      internal::WriteBinaryLogForCrash();
+
       // Crash the process to generate a dump.
       base::ImmediateCrash();
     }
@@ -1098,11 +1226,21 @@ ErrnoLogMessage::~ErrnoLogMessage() {
 
 void CloseLogFile() {
 #if BUILDFLAG(IS_POSIX) || BUILDFLAG(IS_FUCHSIA)
+  FlushLogFile();
   base::AutoLock guard(GetLoggingLock());
 #endif
   CloseLogFileUnlocked();
 }
 
+void FlushLogFile() {
+#if (BUILDFLAG(IS_POSIX) || BUILDFLAG(IS_FUCHSIA)) && !BUILDFLAG(IS_NACL)
+  if (AsyncLogWriter* async_log_writer =
+          g_async_log_writer.load(std::memory_order_acquire)) {
+    async_log_writer->Flush();
+  }
+#endif
+}
+
 #if BUILDFLAG(IS_CHROMEOS_ASH)
 FILE* DuplicateLogFILE() {
   if ((g_logging_destination & LOG_TO_FILE) == 0 || !InitializeLogFileHandle())
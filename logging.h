@@ -7,6 +7,7 @@
 
 #include <stddef.h>
 
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <sstream>
@@ -221,6 +222,26 @@ enum LogLockingState { LOCK_LOG_FILE, DONT_LOCK_LOG_FILE };
 // Defaults to APPEND_TO_OLD_LOG_FILE.
 enum OldFileDeletionState { DELETE_OLD_LOG_FILE, APPEND_TO_OLD_LOG_FILE };
 
+// Should messages be written to the log file by the threads logging them, or
+// by a background thread? Writing from a background thread keeps bursts of
+// messages from many threads from contending on the log file, at the cost of
+// messages being written up to 100ms late. FATAL messages, and the messages
+// queued before them, are always written before the process crashes. Crashes
+// which don't go through LOG(FATAL), e.g. on a signal, lose the messages still
+// queued: writing them isn't async-signal-safe, so the signal handlers of
+// base::debug don't, and other crash handlers may only call FlushLogFile()
+// outside of a signal handler. Background writes are only supported on POSIX
+// and Fuchsia, and are synchronous elsewhere. Defaults to WRITE_SYNCHRONOUSLY.
+enum class LogFileWriteMode {
+  WRITE_SYNCHRONOUSLY,
+  // Drops the messages logged while the queue of the background thread is
+  // full, and writes how many were dropped.
+  WRITE_ASYNC_DROP_WHEN_FULL,
+  // Makes logging threads wait while the queue of the background thread is
+  // full.
+  WRITE_ASYNC_BLOCK_WHEN_FULL,
+};
+
 #if BUILDFLAG(IS_CHROMEOS)
 // Defines the log message prefix format to use.
 // LOG_FORMAT_SYSLOG indicates syslog-like message prefixes.
@@ -233,11 +254,12 @@ struct BASE_EXPORT LoggingSettings {
   // destinations.
   uint32_t logging_dest = LOG_DEFAULT;
 
-  // The four settings below have an effect only when LOG_TO_FILE is
-  // set in |logging_dest|.
+  // The settings below have an effect only when LOG_TO_FILE is set in
+  // |logging_dest|.
   const PathChar* log_file_path = nullptr;
   LogLockingState lock_log = LOCK_LOG_FILE;
   OldFileDeletionState delete_old = APPEND_TO_OLD_LOG_FILE;
+  LogFileWriteMode log_file_write_mode = LogFileWriteMode::WRITE_SYNCHRONOUSLY;
 #if BUILDFLAG(IS_CHROMEOS)
   // Contains an optional file that logs should be written to. If present,
   // |log_file_path| will be ignored, and the logging system will take ownership
@@ -310,6 +332,33 @@ int GetVlogLevel(const char (&file)[N]) {
   return GetVlogLevelHelper(file, N);
 }
 
+// Changes whenever the vlog levels may have changed, which invalidates the
+// levels cached by VLOG_IS_ON() call sites. It starts at 1, so that a zeroed
+// cache is invalid.
+BASE_EXPORT extern std::atomic<uint32_t> g_vlog_level_generation;
+
+// Makes VLOG_IS_ON() call sites get their vlog level again.
+BASE_EXPORT void InvalidateCachedVlogLevels();
+
+// Gets the vlog level of |file| into |cache|, and returns it. Note that |N| is
+// the size *with* the null terminator.
+BASE_EXPORT int CacheVlogLevel(const char* file_start,
+                               size_t N,
+                               std::atomic<uint64_t>& cache);
+
+// Gets the current vlog level for the given file like GetVlogLevel(), from
+// |cache| unless the vlog levels changed since it was filled. |cache| holds the
+// generation in its upper half, and the level in its lower half.
+template <size_t N>
+int GetCachedVlogLevel(const char (&file)[N], std::atomic<uint64_t>& cache) {
+  const uint64_t cached = cache.load(std::memory_order_relaxed);
+  if (static_cast<uint32_t>(cached >> 32) ==
+      g_vlog_level_generation.load(std::memory_order_relaxed)) {
+    return static_cast<int32_t>(static_cast<uint32_t>(cached));
+  }
+  return CacheVlogLevel(file, N, cache);
+}
+
 // Sets the common items you want to be prepended to each log message.
 // process and thread IDs default to off, the timestamp defaults to on.
 // If this function is not called, logging defaults to writing the timestamp
@@ -442,13 +491,15 @@ constexpr LogSeverity LOGGING_0 = LOGGING_ERROR;
 #define ENABLED_VLOG_LEVEL -1
 #endif  // !defined(ENABLED_VLOG_LEVEL)
 
-// We don't do any caching tricks with VLOG_IS_ON() like the
-// google-glog version since it increases binary size.  This means
-// that using the v-logging functions in conjunction with --vmodule
-// may be slow.
-#define VLOG_IS_ON(verboselevel)             \
-  ((verboselevel) <= (ENABLED_VLOG_LEVEL) || \
-   (verboselevel) <= ::logging::GetVlogLevel(__FILE__))
+// Each VLOG_IS_ON() call site caches the vlog level of its file, so that
+// matching the file against the --vmodule patterns only happens again once
+// the vlog levels changed, and a disabled VLOG() costs a couple of loads.
+#define VLOG_IS_ON(verboselevel)                                             \
+  ((verboselevel) <= (ENABLED_VLOG_LEVEL) ||                                 \
+   (verboselevel) <= []() {                                                  \
+     static std::atomic<uint64_t> vlog_level_cache{0};                       \
+     return ::logging::GetCachedVlogLevel(__FILE__, vlog_level_cache);       \
+   }())
 
 // Helper macro which avoids evaluating the arguments to a stream if
 // the condition doesn't hold. Condition is evaluated once and only once.
@@ -705,6 +756,11 @@ class BASE_EXPORT ErrnoLogMessage : public LogMessage {
 //       after this call.
 BASE_EXPORT void CloseLogFile();
 
+// Writes the messages which background writes queued to the log file, e.g.
+// from a crash handler. Takes locks and allocates, so must not be called from
+// a signal handler. See LogFileWriteMode.
+BASE_EXPORT void FlushLogFile();
+
 #if BUILDFLAG(IS_CHROMEOS_ASH)
 // Returns a new file handle that will write to the same destination as the
 // currently open log file. Returns nullptr if logging to a file is disabled,
@@ -0,0 +1,219 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/logging_async_writer.h"
+
+#include <utility>
+
+#include "base/bits.h"
+#include "base/check.h"
+#include "base/strings/string_number_conversions.h"
+
+namespace logging {
+
+namespace {
+
+// How long Flush() waits for the writer thread to finish writing a batch.
+constexpr base::TimeDelta kFlushTimeout = base::Seconds(1);
+
+}  // namespace
+
+AsyncLogWriter::AsyncLogWriter(WriteFunction write_function,
+                               const Options& options)
+    : write_function_(write_function),
+      options_(options),
+      full_queue_policy_(options.full_queue_policy),
+      slots_(new Slot[options.capacity]),
+      wake_up_event_(base::WaitableEvent::ResetPolicy::AUTOMATIC,
+                     base::WaitableEvent::InitialState::NOT_SIGNALED) {
+  CHECK(base::bits::IsPowerOfTwo(options_.capacity));
+  for (size_t i = 0; i < options_.capacity; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  batch_.reserve(kMaxBatchSize);
+}
+
+AsyncLogWriter::~AsyncLogWriter() {
+  if (!thread_handle_.is_null()) {
+    stopping_.store(true, std::memory_order_release);
+    wake_up_event_.Signal();
+    base::PlatformThread::Join(thread_handle_);
+  }
+  Flush();
+}
+
+bool AsyncLogWriter::Start() {
+  return base::PlatformThread::Create(0, this, &thread_handle_);
+}
+
+bool AsyncLogWriter::Enqueue(std::string message) {
+  if (TryEnqueue(message)) {
+    return true;
+  }
+
+  if (full_queue_policy_.load(std::memory_order_relaxed) ==
+      FullQueuePolicy::kDrop) {
+    const size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    size_t last_position =
+        last_dropped_position_.load(std::memory_order_relaxed);
+    while (last_position < position &&
+           !last_dropped_position_.compare_exchange_weak(
+               last_position, position, std::memory_order_relaxed)) {
+    }
+    dropped_message_count_.fetch_add(1, std::memory_order_relaxed);
+    unreported_dropped_count_.fetch_add(1, std::memory_order_release);
+    return false;
+  }
+
+  waiting_for_room_count_.fetch_add(1, std::memory_order_seq_cst);
+  wake_up_event_.Signal();
+  {
+    base::AutoLock hold(room_lock_);
+    while (!TryEnqueue(message)) {
+      // The timeout only guards against a signal being missed, as the queue
+      // is checked without |room_lock_| when dequeuing.
+      room_condition_.TimedWait(options_.flush_interval);
+    }
+  }
+  waiting_for_room_count_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool AsyncLogWriter::Flush() {
+  const base::TimeTicks deadline = base::TimeTicks::Now() + kFlushTimeout;
+  while (!TryAcquireConsumer()) {
+    if (base::TimeTicks::Now() > deadline) {
+      return false;
+    }
+    base::PlatformThread::YieldCurrentThread();
+  }
+  WriteQueuedMessages();
+  ReleaseConsumer();
+  return true;
+}
+
+void AsyncLogWriter::ThreadMain() {
+  base::PlatformThread::SetName("AsyncLogWriter");
+  while (!stopping_.load(std::memory_order_acquire)) {
+    wake_up_event_.TimedWait(options_.flush_interval);
+    // A thread which flushes writes the queued messages itself.
+    if (TryAcquireConsumer()) {
+      WriteQueuedMessages();
+      ReleaseConsumer();
+    }
+  }
+}
+
+bool AsyncLogWriter::TryEnqueue(std::string& message) {
+  const size_t size = message.size();
+  const size_t previous_bytes =
+      queued_bytes_.fetch_add(size, std::memory_order_relaxed);
+  if (previous_bytes != 0 && previous_bytes + size > options_.max_bytes) {
+    queued_bytes_.fetch_sub(size, std::memory_order_relaxed);
+    return false;
+  }
+
+  const size_t mask = options_.capacity - 1;
+  size_t position = enqueue_position_.load(std::memory_order_relaxed);
+  Slot* slot;
+  for (;;) {
+    slot = &slots_[position & mask];
+    const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence == position) {
+      // The slot is free. Claim it, unless another thread did.
+      if (enqueue_position_.compare_exchange_weak(position, position + 1,
+                                                  std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (sequence < position) {
+      // The slot still holds the message queued |capacity| messages earlier.
+      queued_bytes_.fetch_sub(size, std::memory_order_relaxed);
+      return false;
+    } else {
+      // Another thread claimed the slot.
+      position = enqueue_position_.load(std::memory_order_relaxed);
+    }
+  }
+  // Wake the writer thread up when half of the queue is used, rather than for
+  // each message.
+  const bool half_full =
+      queued_count_.fetch_add(1, std::memory_order_relaxed) + 1 ==
+      options_.capacity / 2;
+  slot->message = std::move(message);
+  slot->sequence.store(position + 1, std::memory_order_release);
+  if (half_full) {
+    wake_up_event_.Signal();
+  }
+  return true;
+}
+
+bool AsyncLogWriter::TryDequeue(std::string* message) {
+  Slot& slot = slots_[dequeue_position_ & (options_.capacity - 1)];
+  if (slot.sequence.load(std::memory_order_acquire) != dequeue_position_ + 1) {
+    return false;
+  }
+  *message = std::move(slot.message);
+  slot.message = std::string();
+  slot.sequence.store(dequeue_position_ + options_.capacity,
+                      std::memory_order_release);
+  ++dequeue_position_;
+  queued_count_.fetch_sub(1, std::memory_order_relaxed);
+  queued_bytes_.fetch_sub(message->size(), std::memory_order_relaxed);
+  return true;
+}
+
+bool AsyncLogWriter::AddDroppedMessageCountToBatch() {
+  const uint64_t dropped_count =
+      unreported_dropped_count_.exchange(0, std::memory_order_acquire);
+  if (!dropped_count) {
+    return false;
+  }
+  batch_.push_back(base::NumberToString(dropped_count) +
+                   " log messages were dropped, as the queue was full.\n");
+  return true;
+}
+
+void AsyncLogWriter::WriteQueuedMessages() {
+  for (;;) {
+    batch_.clear();
+    std::string message;
+    while (batch_.size() < kMaxBatchSize) {
+      if (dequeue_position_ >=
+              last_dropped_position_.load(std::memory_order_relaxed) &&
+          AddDroppedMessageCountToBatch()) {
+        continue;
+      }
+      if (!TryDequeue(&message)) {
+        break;
+      }
+      batch_.push_back(std::move(message));
+    }
+    // Messages queued before the last dropped one may not be in the queue
+    // yet, but the dropped ones are written now anyway.
+    if (batch_.size() < kMaxBatchSize) {
+      AddDroppedMessageCountToBatch();
+    }
+    if (batch_.empty()) {
+      return;
+    }
+    if (waiting_for_room_count_.load(std::memory_order_seq_cst)) {
+      base::AutoLock hold(room_lock_);
+      room_condition_.Broadcast();
+    }
+    write_function_(batch_);
+    if (batch_.size() < kMaxBatchSize) {
+      return;
+    }
+  }
+}
+
+bool AsyncLogWriter::TryAcquireConsumer() {
+  return !consuming_.exchange(true, std::memory_order_acquire);
+}
+
+void AsyncLogWriter::ReleaseConsumer() {
+  consuming_.store(false, std::memory_order_release);
+}
+
+}  // namespace logging
@@ -0,0 +1,152 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_LOGGING_ASYNC_WRITER_H_
+#define BASE_LOGGING_ASYNC_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/containers/span.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+
+namespace logging {
+
+// Hands formatted log messages over to a background thread, which writes them
+// in batches. Logging threads only move their message into a bounded lock-free
+// queue, so that bursts of messages from many threads contend neither on a
+// lock nor on the I/O.
+//
+// This backs LoggingSettings::log_file_write_mode, and is only exposed for
+// tests.
+class BASE_EXPORT AsyncLogWriter : public base::PlatformThread::Delegate {
+ public:
+  // The most messages written at once.
+  static constexpr size_t kMaxBatchSize = 64;
+
+  // Writes |messages|, in order. Called on the writer thread, or on the thread
+  // which calls Flush().
+  using WriteFunction = void (*)(base::span<const std::string> messages);
+
+  // What Enqueue() does when the queue is full.
+  enum class FullQueuePolicy {
+    // Drops the message. The number of dropped messages is then written,
+    // after the messages queued before them.
+    kDrop,
+    // Waits for the writer thread, or a thread which flushes, to make room.
+    kBlock,
+  };
+
+  struct Options {
+    FullQueuePolicy full_queue_policy = FullQueuePolicy::kDrop;
+    // The number of messages the queue holds. Must be a power of two.
+    size_t capacity = 4096;
+    // The total size of the messages the queue holds, which bounds its memory.
+    // A message larger than this is only queued when the queue is empty.
+    size_t max_bytes = 4 * 1024 * 1024;
+    // How long messages may wait before being written. The writer thread is
+    // woken up earlier when half of the queue is used.
+    base::TimeDelta flush_interval = base::Milliseconds(100);
+  };
+
+  AsyncLogWriter(WriteFunction write_function, const Options& options);
+  AsyncLogWriter(const AsyncLogWriter&) = delete;
+  AsyncLogWriter& operator=(const AsyncLogWriter&) = delete;
+  // Stops the writer thread, and writes the remaining messages.
+  ~AsyncLogWriter() override;
+
+  // Starts the writer thread. Returns false if it couldn't be started, in
+  // which case messages must be written synchronously instead.
+  bool Start();
+
+  // Queues |message| for writing. Returns false if it was dropped.
+  bool Enqueue(std::string message);
+
+  // Writes the queued messages from the calling thread, e.g. before crashing.
+  // This waits for a batch being written by the writer thread, but not for
+  // long, as that thread may be stuck in a crashing process. Returns false if
+  // the messages couldn't be written for that reason.
+  bool Flush();
+
+  void set_full_queue_policy(FullQueuePolicy policy) {
+    full_queue_policy_.store(policy, std::memory_order_relaxed);
+  }
+
+  // Returns the number of messages dropped so far.
+  uint64_t dropped_message_count() const {
+    return dropped_message_count_.load(std::memory_order_relaxed);
+  }
+
+  // base::PlatformThread::Delegate:
+  void ThreadMain() override;
+
+ private:
+  // A slot of the queue, which is a bounded multi-producer single-consumer
+  // ring of slots, as described at
+  // https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+  struct Slot {
+    // Tells whether |message| is free to be written (when it is equal to the
+    // position of the slot) or to be read (when it is one more than that).
+    std::atomic<size_t> sequence;
+    std::string message;
+  };
+
+  bool TryEnqueue(std::string& message);
+
+  // Must only be called by the consumer, i.e. while |consuming_| is held.
+  bool TryDequeue(std::string* message);
+  // Adds the number of dropped messages to |batch_|, if any were dropped
+  // since it was last added. Returns whether it did.
+  bool AddDroppedMessageCountToBatch();
+  void WriteQueuedMessages();
+
+  bool TryAcquireConsumer();
+  void ReleaseConsumer();
+
+  const WriteFunction write_function_;
+  const Options options_;
+  std::atomic<FullQueuePolicy> full_queue_policy_;
+
+  const std::unique_ptr<Slot[]> slots_;
+  std::atomic<size_t> enqueue_position_{0};
+  std::atomic<size_t> queued_count_{0};
+  std::atomic<size_t> queued_bytes_{0};
+
+  // Set by the thread which dequeues, i.e. the writer thread, or a thread
+  // which flushes. Guards the members below.
+  std::atomic<bool> consuming_{false};
+  size_t dequeue_position_ = 0;
+  std::vector<std::string> batch_;
+
+  std::atomic<uint64_t> dropped_message_count_{0};
+  // The messages dropped since the last write.
+  std::atomic<uint64_t> unreported_dropped_count_{0};
+  // The position in the queue of the last dropped message: its count is
+  // written once the messages before that position were.
+  std::atomic<size_t> last_dropped_position_{0};
+
+  // Signaled when messages are dequeued while logging threads wait for room,
+  // with the kBlock policy.
+  base::Lock room_lock_;
+  base::ConditionVariable room_condition_{&room_lock_};
+  std::atomic<size_t> waiting_for_room_count_{0};
+
+  base::WaitableEvent wake_up_event_;
+  std::atomic<bool> stopping_{false};
+  base::PlatformThreadHandle thread_handle_;
+};
+
+}  // namespace logging
+
+#endif  // BASE_LOGGING_ASYNC_WRITER_H_
@@ -0,0 +1,220 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/logging_async_writer.h"
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/memory/raw_ptr.h"
+#include "base/no_destructor.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/lock.h"
+#include "base/test/test_timeouts.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace logging {
+
+namespace {
+
+using ::testing::ElementsAre;
+
+base::Lock& GetWrittenLock() {
+  static base::NoDestructor<base::Lock> lock;
+  return *lock;
+}
+
+std::vector<std::string>& GetWrittenMessages() {
+  static base::NoDestructor<std::vector<std::string>> messages;
+  return *messages;
+}
+
+std::vector<size_t>& GetBatchSizes() {
+  static base::NoDestructor<std::vector<size_t>> batch_sizes;
+  return *batch_sizes;
+}
+
+void RecordMessages(base::span<const std::string> messages) {
+  base::AutoLock guard(GetWrittenLock());
+  GetWrittenMessages().insert(GetWrittenMessages().end(), messages.begin(),
+                              messages.end());
+  GetBatchSizes().push_back(messages.size());
+}
+
+class AsyncLogWriterTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    base::AutoLock guard(GetWrittenLock());
+    GetWrittenMessages().clear();
+    GetBatchSizes().clear();
+  }
+
+  std::vector<std::string> written_messages() const {
+    base::AutoLock guard(GetWrittenLock());
+    return GetWrittenMessages();
+  }
+
+  std::vector<size_t> batch_sizes() const {
+    base::AutoLock guard(GetWrittenLock());
+    return GetBatchSizes();
+  }
+};
+
+// Logs |count| messages, which are prefixed with |name|.
+class LoggingThread : public base::DelegateSimpleThread::Delegate {
+ public:
+  LoggingThread(AsyncLogWriter* writer, const std::string& name, size_t count)
+      : writer_(writer), name_(name), count_(count) {}
+
+  void Run() override {
+    for (size_t i = 0; i < count_; ++i) {
+      EXPECT_TRUE(writer_->Enqueue(name_ + base::NumberToString(i)));
+    }
+  }
+
+ private:
+  const raw_ptr<AsyncLogWriter> writer_;
+  const std::string name_;
+  const size_t count_;
+};
+
+}  // namespace
+
+TEST_F(AsyncLogWriterTest, FlushWritesInOrderAndInBatches) {
+  AsyncLogWriter writer(&RecordMessages, AsyncLogWriter::Options());
+  std::vector<std::string> expected_messages;
+  for (size_t i = 0; i < 200; ++i) {
+    expected_messages.push_back(base::NumberToString(i));
+    EXPECT_TRUE(writer.Enqueue(expected_messages.back()));
+  }
+  EXPECT_TRUE(writer.Flush());
+
+  EXPECT_EQ(expected_messages, written_messages());
+  EXPECT_THAT(batch_sizes(), ElementsAre(64u, 64u, 64u, 8u));
+  EXPECT_EQ(0u, writer.dropped_message_count());
+}
+
+TEST_F(AsyncLogWriterTest, DestructorWritesQueuedMessages) {
+  {
+    AsyncLogWriter writer(&RecordMessages, AsyncLogWriter::Options());
+    EXPECT_TRUE(writer.Enqueue("a"));
+    EXPECT_TRUE(writer.Enqueue("b"));
+  }
+  EXPECT_THAT(written_messages(), ElementsAre("a", "b"));
+}
+
+TEST_F(AsyncLogWriterTest, DropsWhenFull) {
+  AsyncLogWriter::Options options;
+  options.capacity = 4;
+  AsyncLogWriter writer(&RecordMessages, options);
+  for (size_t i = 0; i < 4; ++i) {
+    EXPECT_TRUE(writer.Enqueue(base::NumberToString(i)));
+  }
+  EXPECT_FALSE(writer.Enqueue("4"));
+  EXPECT_FALSE(writer.Enqueue("5"));
+  EXPECT_EQ(2u, writer.dropped_message_count());
+  EXPECT_TRUE(writer.Flush());
+
+  // The queue has room again.
+  EXPECT_TRUE(writer.Enqueue("6"));
+  EXPECT_TRUE(writer.Flush());
+
+  EXPECT_THAT(
+      written_messages(),
+      ElementsAre("0", "1", "2", "3",
+                  "2 log messages were dropped, as the queue was full.\n",
+                  "6"));
+  EXPECT_EQ(2u, writer.dropped_message_count());
+}
+
+TEST_F(AsyncLogWriterTest, DropsWhenOverMaxBytes) {
+  AsyncLogWriter::Options options;
+  options.max_bytes = 8;
+  AsyncLogWriter writer(&RecordMessages, options);
+  // A message larger than |max_bytes| is queued in an empty queue.
+  EXPECT_TRUE(writer.Enqueue("0123456789"));
+  EXPECT_FALSE(writer.Enqueue("a"));
+  EXPECT_TRUE(writer.Flush());
+
+  EXPECT_TRUE(writer.Enqueue("0123"));
+  EXPECT_TRUE(writer.Enqueue("4567"));
+  EXPECT_FALSE(writer.Enqueue("8"));
+  EXPECT_TRUE(writer.Flush());
+
+  EXPECT_THAT(
+      written_messages(),
+      ElementsAre("0123456789",
+                  "1 log messages were dropped, as the queue was full.\n",
+                  "0123", "4567",
+                  "1 log messages were dropped, as the queue was full.\n"));
+}
+
+TEST_F(AsyncLogWriterTest, WriterThreadWritesQueuedMessages) {
+  AsyncLogWriter::Options options;
+  options.flush_interval = base::Milliseconds(1);
+  AsyncLogWriter writer(&RecordMessages, options);
+  ASSERT_TRUE(writer.Start());
+  EXPECT_TRUE(writer.Enqueue("a"));
+
+  const base::TimeTicks deadline =
+      base::TimeTicks::Now() + TestTimeouts::action_timeout();
+  while (written_messages().empty() && base::TimeTicks::Now() < deadline) {
+    base::PlatformThread::Sleep(base::Milliseconds(1));
+  }
+  EXPECT_THAT(written_messages(), ElementsAre("a"));
+}
+
+// Logging threads wait for room in the queue, and no message is lost.
+TEST_F(AsyncLogWriterTest, BlocksWhenFull) {
+  constexpr size_t kThreadCount = 4;
+  constexpr size_t kMessagesPerThread = 1000;
+
+  AsyncLogWriter::Options options;
+  options.full_queue_policy = AsyncLogWriter::FullQueuePolicy::kBlock;
+  options.capacity = 16;
+  {
+    AsyncLogWriter writer(&RecordMessages, options);
+    ASSERT_TRUE(writer.Start());
+
+    std::vector<std::unique_ptr<LoggingThread>> delegates;
+    std::vector<std::unique_ptr<base::DelegateSimpleThread>> threads;
+    for (size_t i = 0; i < kThreadCount; ++i) {
+      const std::string name = base::NumberToString(i) + ":";
+      delegates.push_back(
+          std::make_unique<LoggingThread>(&writer, name, kMessagesPerThread));
+      threads.push_back(std::make_unique<base::DelegateSimpleThread>(
+          delegates.back().get(), name));
+      threads.back()->Start();
+    }
+    for (auto& thread : threads) {
+      thread->Join();
+    }
+    EXPECT_EQ(0u, writer.dropped_message_count());
+  }
+
+  // The messages of each thread are written in the order they were logged.
+  std::vector<size_t> next_index(kThreadCount);
+  const std::vector<std::string> messages = written_messages();
+  ASSERT_EQ(kThreadCount * kMessagesPerThread, messages.size());
+  for (const std::string& message : messages) {
+    const size_t separator = message.find(':');
+    ASSERT_NE(std::string::npos, separator);
+    size_t thread_index;
+    size_t index;
+    ASSERT_TRUE(
+        base::StringToSizeT(message.substr(0, separator), &thread_index));
+    ASSERT_TRUE(base::StringToSizeT(message.substr(separator + 1), &index));
+    ASSERT_LT(thread_index, kThreadCount);
+    EXPECT_EQ(next_index[thread_index]++, index);
+  }
+}
+
+}  // namespace logging
@@ -0,0 +1,547 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/logging_binary.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "base/big_endian.h"
+#include "base/check_op.h"
+#include "base/no_destructor.h"
+#include "base/process/process_handle.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/thread_annotations.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "build/build_config.h"
+
+namespace logging {
+
+namespace {
+
+// The largest record, which holds its header and its arguments.
+constexpr size_t kMaxRecordSize = 256;
+// The site ID, the timestamp, the thread ID and the number of arguments.
+constexpr size_t kRecordHeaderSize = 4 + 8 + 8 + 1;
+// The type, and the value or the length of a string.
+constexpr size_t kNumberArgSize = 1 + 8;
+constexpr size_t kStringArgHeaderSize = 1 + 2;
+static_assert(kRecordHeaderSize +
+                      internal::kMaxBinaryLogArgs * kNumberArgSize <=
+                  kMaxRecordSize,
+              "A record must fit all of its arguments");
+
+// Starts the output of GetBinaryLog(), which is then followed by the process
+// ID, and by entries. Each entry is either a site or a record.
+constexpr char kMagic[] = {'C', 'r', 'B', 'i', 'n', 'L', 'o', 'g'};
+constexpr uint8_t kSiteEntry = 'S';
+constexpr uint8_t kRecordEntry = 'R';
+
+// The BINARY_LOG() call sites which were recorded. The ID of a site is its
+// index plus one.
+class SiteRegistry {
+ public:
+  uint32_t GetId(BinaryLogSite& site) {
+    uint32_t id = site.id.load(std::memory_order_acquire);
+    if (id) {
+      return id;
+    }
+    base::AutoLock guard(lock_);
+    id = site.id.load(std::memory_order_relaxed);
+    if (!id) {
+      sites_.push_back(&site);
+      id = static_cast<uint32_t>(sites_.size());
+      site.id.store(id, std::memory_order_release);
+    }
+    return id;
+  }
+
+  std::vector<const BinaryLogSite*> GetSites() {
+    base::AutoLock guard(lock_);
+    return sites_;
+  }
+
+ private:
+  base::Lock lock_;
+  std::vector<const BinaryLogSite*> sites_ GUARDED_BY(lock_);
+};
+
+SiteRegistry& GetSiteRegistry() {
+  static base::NoDestructor<SiteRegistry> registry;
+  return *registry;
+}
+
+// Keeps the last records. There is a single one, which is never destroyed, as
+// BINARY_LOG() may use it while the binary log is stopped.
+class RecordRing {
+ public:
+  RecordRing() = default;
+
+  // Drops the records, and keeps the last |record_count| ones from now on.
+  // Frees the records if |record_count| is 0, in which case Add() does
+  // nothing.
+  void Reset(size_t record_count, const base::FilePath& crash_dump_path) {
+    base::AutoLock guard(lock_);
+    crash_dump_path_ = crash_dump_path;
+    if (slots_.size() != record_count) {
+      slots_ = std::vector<Slot>(record_count);
+    }
+    next_record_ = 0;
+  }
+
+  base::FilePath crash_dump_path() {
+    base::AutoLock guard(lock_);
+    return crash_dump_path_;
+  }
+
+  void Add(base::span<const char> record) {
+    base::AutoLock guard(lock_);
+    if (slots_.empty()) {
+      return;
+    }
+    Slot& slot = slots_[next_record_ % slots_.size()];
+    memcpy(slot.data, record.data(), record.size());
+    slot.size = static_cast<uint16_t>(record.size());
+    ++next_record_;
+  }
+
+  // Appends the records, oldest first, as record entries.
+  void AppendRecords(std::vector<uint8_t>* output) {
+    base::AutoLock guard(lock_);
+    const uint64_t record_count =
+        std::min<uint64_t>(next_record_, slots_.size());
+    for (uint64_t i = next_record_ - record_count; i < next_record_; ++i) {
+      const Slot& slot = slots_[i % slots_.size()];
+      output->push_back(kRecordEntry);
+      AppendBigEndian(slot.size, output);
+      output->insert(output->end(), slot.data, slot.data + slot.size);
+    }
+  }
+
+  template <typename T>
+  static void AppendBigEndian(T value, std::vector<uint8_t>* output) {
+    char buffer[sizeof(T)];
+    base::WriteBigEndian(buffer, value);
+    output->insert(output->end(), buffer, buffer + sizeof(T));
+  }
+
+ private:
+  struct Slot {
+    uint16_t size = 0;
+    char data[kMaxRecordSize];
+  };
+
+  base::Lock lock_;
+  base::FilePath crash_dump_path_ GUARDED_BY(lock_);
+  std::vector<Slot> slots_ GUARDED_BY(lock_);
+  uint64_t next_record_ GUARDED_BY(lock_) = 0;
+};
+
+RecordRing& GetRecordRing() {
+  static base::NoDestructor<RecordRing> record_ring;
+  return *record_ring;
+}
+
+// The record ring while the binary log is started, and null otherwise.
+std::atomic<RecordRing*> g_record_ring{nullptr};
+
+// Encodes a record of the site with |site_id| in |buffer|. Strings are
+// truncated to fit. Returns the size of the record.
+size_t EncodeRecord(uint32_t site_id,
+                    base::span<const BinaryLogArg> args,
+                    char (&buffer)[kMaxRecordSize]) {
+  size_t fixed_size = kRecordHeaderSize;
+  for (const BinaryLogArg& arg : args) {
+    fixed_size += arg.type() == BinaryLogArg::Type::kString
+                      ? kStringArgHeaderSize
+                      : kNumberArgSize;
+  }
+  size_t string_budget = kMaxRecordSize - fixed_size;
+
+  base::BigEndianWriter writer(buffer, kMaxRecordSize);
+  writer.WriteU32(site_id);
+  writer.WriteU64(static_cast<uint64_t>(
+      base::Time::Now().ToDeltaSinceWindowsEpoch().InMicroseconds()));
+  writer.WriteU64(static_cast<uint64_t>(base::PlatformThread::CurrentId()));
+  writer.WriteU8(static_cast<uint8_t>(args.size()));
+  for (const BinaryLogArg& arg : args) {
+    writer.WriteU8(static_cast<uint8_t>(arg.type()));
+    if (arg.type() == BinaryLogArg::Type::kString) {
+      const size_t length = std::min(arg.string().size(), string_budget);
+      string_budget -= length;
+      writer.WriteU16(static_cast<uint16_t>(length));
+      writer.WriteBytes(arg.string().data(), length);
+    } else {
+      writer.WriteU64(arg.bits());
+    }
+  }
+  return kMaxRecordSize - writer.remaining();
+}
+
+// Renders |arg| for the conversion |conversion|, with its |flags|, width and
+// precision.
+void RenderArg(base::StringPiece flags,
+               char conversion,
+               const BinaryLogArg& arg,
+               std::string* output) {
+  std::string spec = "%";
+  spec.append(flags.data(), flags.size());
+  switch (arg.type()) {
+    case BinaryLogArg::Type::kInt:
+    case BinaryLogArg::Type::kUnsigned:
+      if (conversion == 'c') {
+        spec.push_back('c');
+        output->append(base::StringPrintfNonConstexpr(
+            spec, static_cast<int>(static_cast<char>(arg.bits()))));
+      } else if (conversion == 'x' || conversion == 'X' || conversion == 'o') {
+        spec.append("ll").push_back(conversion);
+        output->append(base::StringPrintfNonConstexpr(
+            spec, static_cast<unsigned long long>(arg.bits())));
+      } else if (arg.type() == BinaryLogArg::Type::kInt) {
+        spec.append("lld");
+        output->append(base::StringPrintfNonConstexpr(
+            spec, static_cast<long long>(static_cast<int64_t>(arg.bits()))));
+      } else {
+        spec.append("llu");
+        output->append(base::StringPrintfNonConstexpr(
+            spec, static_cast<unsigned long long>(arg.bits())));
+      }
+      return;
+    case BinaryLogArg::Type::kDouble:
+      spec.push_back(strchr("eEfFgGaA", conversion) ? conversion : 'g');
+      output->append(base::StringPrintfNonConstexpr(
+          spec, base::bit_cast<double>(arg.bits())));
+      return;
+    case BinaryLogArg::Type::kString:
+      spec.push_back('s');
+      output->append(base::StringPrintfNonConstexpr(
+          spec, std::string(arg.string()).c_str()));
+      return;
+    case BinaryLogArg::Type::kPointer:
+      base::StringAppendF(output, "0x%llx",
+                          static_cast<unsigned long long>(arg.bits()));
+      return;
+  }
+}
+
+// Renders |format| with |args|.
+void RenderMessage(base::StringPiece format,
+                   base::span<const BinaryLogArg> args,
+                   std::string* output) {
+  size_t i = 0;
+  while (i < format.size()) {
+    const size_t percent = format.find('%', i);
+    if (percent == base::StringPiece::npos) {
+      output->append(format.substr(i));
+      break;
+    }
+    output->append(format.substr(i, percent - i));
+    if (percent + 1 < format.size() && format[percent + 1] == '%') {
+      output->push_back('%');
+      i = percent + 2;
+      continue;
+    }
+
+    // Parse the conversion: flags, width and precision, length modifiers and
+    // the conversion character. The length modifiers are dropped, as the type
+    // of the argument is known.
+    size_t end = percent + 1;
+    while (end < format.size() && strchr("-+ #0", format[end])) {
+      ++end;
+    }
+    while (end < format.size() &&
+           (base::IsAsciiDigit(format[end]) || format[end] == '.')) {
+      ++end;
+    }
+    const base::StringPiece flags =
+        format.substr(percent + 1, end - percent - 1);
+    while (end < format.size() && strchr("hlLqjzt", format[end])) {
+      ++end;
+    }
+    if (end == format.size()) {
+      output->append(format.substr(percent));
+      break;
+    }
+    i = end + 1;
+
+    if (args.empty()) {
+      // Leave the conversions without an argument as they are.
+      output->append(format.substr(percent, i - percent));
+      continue;
+    }
+    RenderArg(flags, format[end], args.front(), output);
+    args = args.subspan(1u);
+  }
+}
+
+// Reads the arguments of a record from |reader|. Returns false if they are
+// malformed.
+bool DecodeArgs(base::BigEndianReader* reader,
+                std::vector<BinaryLogArg>* args) {
+  uint8_t arg_count;
+  if (!reader->ReadU8(&arg_count)) {
+    return false;
+  }
+  for (uint8_t i = 0; i < arg_count; ++i) {
+    uint8_t type;
+    if (!reader->ReadU8(&type)) {
+      return false;
+    }
+    base::StringPiece string;
+    uint64_t bits;
+    switch (static_cast<BinaryLogArg::Type>(type)) {
+      case BinaryLogArg::Type::kInt:
+        if (!reader->ReadU64(&bits)) {
+          return false;
+        }
+        args->emplace_back(static_cast<int64_t>(bits));
+        break;
+      case BinaryLogArg::Type::kUnsigned:
+        if (!reader->ReadU64(&bits)) {
+          return false;
+        }
+        args->emplace_back(bits);
+        break;
+      case BinaryLogArg::Type::kDouble:
+        if (!reader->ReadU64(&bits)) {
+          return false;
+        }
+        args->emplace_back(base::bit_cast<double>(bits));
+        break;
+      case BinaryLogArg::Type::kString:
+        if (!reader->ReadU16LengthPrefixed(&string)) {
+          return false;
+        }
+        args->emplace_back(string);
+        break;
+      case BinaryLogArg::Type::kPointer:
+        if (!reader->ReadU64(&bits)) {
+          return false;
+        }
+        args->push_back(BinaryLogArg::FromPointerBits(bits));
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+const char* SeverityName(LogSeverity severity, std::string* buffer) {
+  static constexpr const char* kSeverityNames[] = {"INFO", "WARNING", "ERROR",
+                                                    "FATAL"};
+  static_assert(LOGGING_NUM_SEVERITIES == std::size(kSeverityNames),
+                "Incorrect number of kSeverityNames");
+  if (severity >= 0 && severity < LOGGING_NUM_SEVERITIES) {
+    return kSeverityNames[severity];
+  }
+  if (severity < 0) {
+    *buffer = "VERBOSE" + base::NumberToString(-severity);
+  } else {
+    *buffer = "UNKNOWN";
+  }
+  return buffer->c_str();
+}
+
+// A site, as read from GetBinaryLog().
+struct DecodedSite {
+  LogSeverity severity = 0;
+  int line = 0;
+  base::StringPiece file;
+  base::StringPiece format;
+};
+
+// Renders the record which |reader| holds, with the prefix of LogMessage.
+bool DecodeRecord(uint64_t process_id,
+                  const std::vector<DecodedSite>& sites,
+                  base::BigEndianReader* reader,
+                  std::string* text) {
+  uint32_t site_id;
+  uint64_t timestamp;
+  uint64_t thread_id;
+  if (!reader->ReadU32(&site_id) || site_id == 0 ||
+      site_id > sites.size() || !reader->ReadU64(&timestamp) ||
+      !reader->ReadU64(&thread_id)) {
+    return false;
+  }
+  const DecodedSite& site = sites[site_id - 1];
+  base::StringPiece filename = site.file;
+  const size_t last_slash_pos = filename.find_last_of("\\/");
+  if (last_slash_pos != base::StringPiece::npos) {
+    filename.remove_prefix(last_slash_pos + 1);
+  }
+
+  const int64_t microseconds = static_cast<int64_t>(timestamp);
+  base::Time::Exploded exploded;
+  base::Time::FromDeltaSinceWindowsEpoch(base::Microseconds(microseconds))
+      .LocalExplode(&exploded);
+  std::string severity_buffer;
+  base::StringAppendF(
+      text, "[%llu:%llu:%02d%02d/%02d%02d%02d.%06d:%s:",
+      static_cast<unsigned long long>(process_id),
+      static_cast<unsigned long long>(thread_id), exploded.month,
+      exploded.day_of_month, exploded.hour, exploded.minute, exploded.second,
+      static_cast<int>(microseconds % base::Time::kMicrosecondsPerSecond),
+      SeverityName(site.severity, &severity_buffer));
+  text->append(filename);
+  base::StringAppendF(text, "(%d)] ", site.line);
+  std::vector<BinaryLogArg> args;
+  if (!DecodeArgs(reader, &args)) {
+    return false;
+  }
+  RenderMessage(site.format, args, text);
+  text->push_back('\n');
+  return true;
+}
+
+}  // namespace
+
+void StartBinaryLog(const BinaryLogSettings& settings) {
+  CHECK_GT(settings.record_count, 0u);
+  RecordRing& record_ring = GetRecordRing();
+  record_ring.Reset(settings.record_count, settings.crash_dump_path);
+  g_record_ring.store(&record_ring, std::memory_order_release);
+}
+
+void StopBinaryLog() {
+  g_record_ring.store(nullptr, std::memory_order_release);
+  // BINARY_LOG() calls which loaded the ring before it was stopped add
+  // nothing to it once it is empty.
+  GetRecordRing().Reset(0, base::FilePath());
+}
+
+std::vector<uint8_t> GetBinaryLog() {
+  RecordRing* const record_ring =
+      g_record_ring.load(std::memory_order_acquire);
+  if (!record_ring) {
+    return {};
+  }
+
+  std::vector<uint8_t> output(std::begin(kMagic), std::end(kMagic));
+  RecordRing::AppendBigEndian(
+      static_cast<uint64_t>(base::GetUniqueIdForProcess().GetUnsafeValue()),
+      &output);
+  // The sites are registered before their records are added, so that each
+  // record added since has its site.
+  const std::vector<const BinaryLogSite*> sites =
+      GetSiteRegistry().GetSites();
+  for (size_t i = 0; i < sites.size(); ++i) {
+    const base::StringPiece file = sites[i]->file;
+    const base::StringPiece format = sites[i]->format;
+    output.push_back(kSiteEntry);
+    RecordRing::AppendBigEndian(static_cast<uint32_t>(i + 1), &output);
+    RecordRing::AppendBigEndian(sites[i]->severity, &output);
+    RecordRing::AppendBigEndian(sites[i]->line, &output);
+    for (base::StringPiece string : {file, format}) {
+      const size_t length = std::min<size_t>(string.size(), UINT16_MAX);
+      RecordRing::AppendBigEndian(static_cast<uint16_t>(length), &output);
+      output.insert(output.end(), string.begin(), string.begin() + length);
+    }
+  }
+  record_ring->AppendRecords(&output);
+  return output;
+}
+
+bool WriteBinaryLog(const base::FilePath& path) {
+  const std::vector<uint8_t> binary_log = GetBinaryLog();
+#if BUILDFLAG(IS_WIN)
+  FILE* file = _wfopen(path.value().c_str(), L"wb");
+#else
+  FILE* file = fopen(path.value().c_str(), "wb");
+#endif
+  if (!file) {
+    return false;
+  }
+  const bool written =
+      fwrite(binary_log.data(), 1, binary_log.size(), file) ==
+      binary_log.size();
+  return fclose(file) == 0 && written;
+}
+
+bool DecodeBinaryLog(base::span<const uint8_t> binary_log, std::string* text) {
+  base::BigEndianReader reader(binary_log);
+  base::StringPiece magic;
+  uint64_t process_id;
+  if (!reader.ReadPiece(&magic, sizeof(kMagic)) ||
+      magic != base::StringPiece(kMagic, sizeof(kMagic)) ||
+      !reader.ReadU64(&process_id)) {
+    return false;
+  }
+
+  std::vector<DecodedSite> sites;
+  while (reader.remaining()) {
+    uint8_t entry;
+    reader.ReadU8(&entry);
+    if (entry == kSiteEntry) {
+      uint32_t id;
+      uint32_t severity;
+      uint32_t line;
+      DecodedSite site;
+      // Sites are numbered in order.
+      if (!reader.ReadU32(&id) || id != sites.size() + 1 ||
+          !reader.ReadU32(&severity) || !reader.ReadU32(&line) ||
+          !reader.ReadU16LengthPrefixed(&site.file) ||
+          !reader.ReadU16LengthPrefixed(&site.format)) {
+        return false;
+      }
+      site.severity = static_cast<LogSeverity>(severity);
+      site.line = static_cast<int>(line);
+      sites.push_back(site);
+    } else if (entry == kRecordEntry) {
+      base::StringPiece record;
+      if (!reader.ReadU16LengthPrefixed(&record)) {
+        return false;
+      }
+      base::BigEndianReader record_reader =
+          base::BigEndianReader::FromStringPiece(record);
+      if (!DecodeRecord(process_id, sites, &record_reader, text)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+namespace internal {
+
+void BinaryLog(BinaryLogSite& site, base::span<const BinaryLogArg> args) {
+  RecordRing* const record_ring =
+      g_record_ring.load(std::memory_order_acquire);
+  if (record_ring && site.severity != LOGGING_FATAL) {
+    const uint32_t site_id = GetSiteRegistry().GetId(site);
+    char record[kMaxRecordSize];
+    const size_t size = EncodeRecord(site_id, args, record);
+    record_ring->Add(base::make_span(record, size));
+    return;
+  }
+
+  std::string message;
+  RenderMessage(site.format, args, &message);
+  LogMessage(site.file, site.line, site.severity).stream() << message;
+}
+
+void WriteBinaryLogForCrash() {
+  RecordRing* const record_ring =
+      g_record_ring.load(std::memory_order_acquire);
+  if (!record_ring) {
+    return;
+  }
+  const base::FilePath crash_dump_path = record_ring->crash_dump_path();
+  if (!crash_dump_path.empty()) {
+    WriteBinaryLog(crash_dump_path);
+  }
+}
+
+}  // namespace internal
+
+}  // namespace logging
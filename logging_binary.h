@@ -0,0 +1,173 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_LOGGING_BINARY_H_
+#define BASE_LOGGING_BINARY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/bit_cast.h"
+#include "base/containers/span.h"
+#include "base/files/file_path.h"
+#include "base/logging.h"
+#include "base/strings/string_piece.h"
+
+// BINARY_LOG() logs a message without formatting it, for messages which are
+// logged often but seldom read:
+//
+//   BINARY_LOG(INFO, "Evicted %s after %d ms", key, age_ms);
+//
+// The format string must be a literal, with printf-like conversions: each one,
+// e.g. "%d", "%08x", "%.2f" or "%s", is replaced with the next argument, which
+// may be an integer, a floating-point number, a string or a pointer. The
+// argument is rendered according to its type, with the flags, width and
+// precision of the conversion. "%%" is a percent sign.
+//
+// After StartBinaryLog(), BINARY_LOG() only copies the arguments, with the
+// timestamp, the thread and the call site, in a ring buffer of the last
+// records. GetBinaryLog() or WriteBinaryLog() save the ring buffer, which is
+// also written when the process crashes, and DecodeBinaryLog() renders it as
+// text later, offline. Otherwise, and for FATAL messages, BINARY_LOG() formats
+// its message and logs it as LOG() does.
+
+namespace logging {
+
+// The constant data of a BINARY_LOG() call site.
+struct BinaryLogSite {
+  const char* const file;
+  const int line;
+  const LogSeverity severity;
+  const char* const format;
+  // Identifies the call site in the records, once it was recorded. 0 before.
+  std::atomic<uint32_t> id{0};
+};
+
+// An argument of BINARY_LOG(). Strings are referred to, not copied.
+class BinaryLogArg {
+ public:
+  enum class Type : uint8_t {
+    kInt,
+    kUnsigned,
+    kDouble,
+    kString,
+    kPointer,
+  };
+
+  template <typename T>
+    requires(std::is_integral_v<T> && std::is_signed_v<T>)
+  BinaryLogArg(T value)
+      : type_(Type::kInt),
+        bits_(static_cast<uint64_t>(static_cast<int64_t>(value))) {}
+  template <typename T>
+    requires(std::is_integral_v<T> && std::is_unsigned_v<T>)
+  BinaryLogArg(T value) : type_(Type::kUnsigned), bits_(value) {}
+  template <typename T>
+    requires(std::is_floating_point_v<T>)
+  BinaryLogArg(T value)
+      : type_(Type::kDouble),
+        bits_(base::bit_cast<uint64_t>(static_cast<double>(value))) {}
+  BinaryLogArg(const char* value)
+      : type_(Type::kString), string_(value ? value : "(null)") {}
+  BinaryLogArg(base::StringPiece value)
+      : type_(Type::kString), string_(value) {}
+  template <typename T>
+    requires(!std::is_same_v<std::remove_cv_t<T>, char>)
+  BinaryLogArg(const T* value)
+      : type_(Type::kPointer), bits_(reinterpret_cast<uintptr_t>(value)) {}
+
+  // Returns a pointer argument with the address |bits|, e.g. as decoded from
+  // a log written by another process.
+  static BinaryLogArg FromPointerBits(uint64_t bits) {
+    BinaryLogArg arg(bits);
+    arg.type_ = Type::kPointer;
+    return arg;
+  }
+
+  Type type() const { return type_; }
+  // The value of numbers and pointers. Doubles are bit-cast.
+  uint64_t bits() const { return bits_; }
+  base::StringPiece string() const { return string_; }
+
+ private:
+  Type type_;
+  uint64_t bits_ = 0;
+  base::StringPiece string_;
+};
+
+struct BinaryLogSettings {
+  // The number of records kept. Once it is reached, each record overwrites
+  // the oldest one. A record takes up to 256 bytes, and longer strings are
+  // truncated.
+  size_t record_count = 4096;
+  // Where the records are written when a FATAL message is logged, if not
+  // empty.
+  base::FilePath crash_dump_path;
+};
+
+// Makes BINARY_LOG() record its messages, in a ring buffer, from which the
+// records of a previous start are dropped.
+BASE_EXPORT void StartBinaryLog(const BinaryLogSettings& settings);
+
+// Makes BINARY_LOG() log its messages as LOG() does again, and frees the ring
+// buffer.
+BASE_EXPORT void StopBinaryLog();
+
+// Returns the records of the ring buffer, oldest first, with their call sites,
+// or nothing if StartBinaryLog() wasn't called.
+BASE_EXPORT std::vector<uint8_t> GetBinaryLog();
+
+// Writes GetBinaryLog() to |path|. This doesn't check whether blocking is
+// allowed, so that it works as the process crashes.
+BASE_EXPORT bool WriteBinaryLog(const base::FilePath& path);
+
+// Renders |binary_log|, as returned by GetBinaryLog(), as text, with one line
+// per message, as LOG() would have written it. Returns false if |binary_log|
+// is malformed, in which case |text| has the messages before the error.
+BASE_EXPORT bool DecodeBinaryLog(base::span<const uint8_t> binary_log,
+                                 std::string* text);
+
+namespace internal {
+
+// The most arguments of a BINARY_LOG() message.
+inline constexpr size_t kMaxBinaryLogArgs = 16;
+
+BASE_EXPORT void BinaryLog(BinaryLogSite& site,
+                           base::span<const BinaryLogArg> args);
+
+template <typename... Args>
+void BinaryLog(BinaryLogSite& site, const Args&... args) {
+  static_assert(sizeof...(Args) <= kMaxBinaryLogArgs,
+                "Too many BINARY_LOG() arguments");
+  const std::array<BinaryLogArg, sizeof...(Args)> arg_array = {
+      BinaryLogArg(args)...};
+  BinaryLog(site, base::span<const BinaryLogArg>(arg_array));
+}
+
+// Writes the ring buffer to BinaryLogSettings::crash_dump_path, if any. Called
+// when a FATAL message is logged.
+void WriteBinaryLogForCrash();
+
+}  // namespace internal
+
+}  // namespace logging
+
+#define BINARY_LOG(severity, format, ...)                               \
+  do {                                                                  \
+    if (LOG_IS_ON(severity)) {                                          \
+      static ::logging::BinaryLogSite binary_log_site = {               \
+          __FILE__, __LINE__, ::logging::LOGGING_##severity, format};   \
+      ::logging::internal::BinaryLog(binary_log_site __VA_OPT__(, )     \
+                                         __VA_ARGS__);                  \
+    }                                                                   \
+  } while (false)
+
+#endif  // BASE_LOGGING_BINARY_H_
@@ -0,0 +1,80 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/logging_binary.h"
+
+#include <stddef.h>
+
+#include <string>
+
+#include "base/logging.h"
+#include "base/test/scoped_logging_settings.h"
+#include "base/time/time.h"
+#include "base/timer/lap_timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace logging {
+
+namespace {
+
+constexpr char kMetricPrefixLogging[] = "Logging.";
+constexpr char kMetricNsPerMessage[] = "ns_per_message";
+
+constexpr size_t kMessagesPerLap = 1000;
+
+// Drops the messages once they are formatted, to only measure the formatting.
+bool DropLogMessage(int severity,
+                    const char* file,
+                    int line,
+                    size_t message_start,
+                    const std::string& str) {
+  return true;
+}
+
+class LoggingBinaryPerfTest : public testing::Test {
+ protected:
+  LoggingBinaryPerfTest()
+      : timer_(/*warmup_laps=*/10, base::Seconds(1), /*check_interval=*/10) {}
+
+  void SetUp() override { SetLogMessageHandler(&DropLogMessage); }
+  void TearDown() override { StopBinaryLog(); }
+
+  void ReportResult(const std::string& story) {
+    perf_test::PerfResultReporter reporter(kMetricPrefixLogging, story);
+    reporter.RegisterImportantMetric(kMetricNsPerMessage, "ns");
+    reporter.AddResult(
+        kMetricNsPerMessage,
+        timer_.TimePerLap().InMicrosecondsF() * 1000 / kMessagesPerLap);
+  }
+
+  ScopedLoggingSettings scoped_logging_settings_;
+  base::LapTimer timer_;
+  const std::string key_ = "https://example.com/resource";
+};
+
+}  // namespace
+
+TEST_F(LoggingBinaryPerfTest, Log) {
+  do {
+    for (size_t i = 0; i < kMessagesPerLap; ++i) {
+      LOG(INFO) << "Evicted " << key_ << " after " << i << " ms";
+    }
+    timer_.NextLap();
+  } while (!timer_.HasTimeLimitExpired());
+  ReportResult("log");
+}
+
+TEST_F(LoggingBinaryPerfTest, BinaryLog) {
+  StartBinaryLog({});
+  do {
+    for (size_t i = 0; i < kMessagesPerLap; ++i) {
+      BINARY_LOG(INFO, "Evicted %s after %zu ms", key_, i);
+    }
+    timer_.NextLap();
+  } while (!timer_.HasTimeLimitExpired());
+  ReportResult("binary_log");
+}
+
+}  // namespace logging
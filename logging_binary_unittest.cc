@@ -0,0 +1,175 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/logging_binary.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/no_destructor.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/scoped_logging_settings.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+namespace logging {
+
+namespace {
+
+using ::testing::HasSubstr;
+
+// The messages which LOG() would have written.
+std::vector<std::string>& GetLoggedMessages() {
+  static base::NoDestructor<std::vector<std::string>> messages;
+  return *messages;
+}
+
+bool LogMessageHandler(int severity,
+                       const char* file,
+                       int line,
+                       size_t message_start,
+                       const std::string& str) {
+  GetLoggedMessages().push_back(str.substr(message_start));
+  return true;
+}
+
+class BinaryLogTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    GetLoggedMessages().clear();
+    SetLogMessageHandler(&LogMessageHandler);
+  }
+
+  void TearDown() override { StopBinaryLog(); }
+
+  // Returns the lines of the decoded log.
+  std::vector<std::string> DecodeLines(const std::vector<uint8_t>& binary_log) {
+    std::string text;
+    EXPECT_TRUE(DecodeBinaryLog(binary_log, &text));
+    return base::SplitString(text, "\n", base::KEEP_WHITESPACE,
+                             base::SPLIT_WANT_NONEMPTY);
+  }
+
+  ScopedLoggingSettings scoped_logging_settings_;
+};
+
+}  // namespace
+
+TEST_F(BinaryLogTest, LogsWhenNotStarted) {
+  BINARY_LOG(INFO, "int %d, string %s, double %.2f, hex %x, %%", -3, "str", 1.5,
+             255u);
+  BINARY_LOG(WARNING, "No arguments");
+
+  EXPECT_THAT(GetLoggedMessages(),
+              testing::ElementsAre(
+                  "int -3, string str, double 1.50, hex ff, %\n",
+                  "No arguments\n"));
+  EXPECT_TRUE(GetBinaryLog().empty());
+}
+
+TEST_F(BinaryLogTest, RecordsLastMessages) {
+  StartBinaryLog({.record_count = 8});
+  for (int i = 0; i < 10; ++i) {
+    BINARY_LOG(INFO, "Message %d", i);
+  }
+  EXPECT_TRUE(GetLoggedMessages().empty());
+
+  const std::vector<std::string> lines = DecodeLines(GetBinaryLog());
+  ASSERT_EQ(8u, lines.size());
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_THAT(lines[i], HasSubstr(":INFO:logging_binary_unittest.cc("));
+    EXPECT_TRUE(base::EndsWith(lines[i],
+                               ")] Message " + base::NumberToString(i + 2)))
+        << lines[i];
+  }
+}
+
+TEST_F(BinaryLogTest, RestartDropsRecords) {
+  StartBinaryLog({.record_count = 8});
+  BINARY_LOG(INFO, "Before stopping");
+  StopBinaryLog();
+  EXPECT_TRUE(GetBinaryLog().empty());
+
+  StartBinaryLog({.record_count = 4});
+  BINARY_LOG(INFO, "After restarting");
+  const std::vector<std::string> lines = DecodeLines(GetBinaryLog());
+  ASSERT_EQ(1u, lines.size());
+  EXPECT_TRUE(base::EndsWith(lines[0], ")] After restarting")) << lines[0];
+}
+
+TEST_F(BinaryLogTest, DecodesLikeLogging) {
+  StartBinaryLog({});
+  const std::string string = "string";
+  const int value = 0;
+  BINARY_LOG(ERROR, "[%5d|%-5s|%05.1f|%c|%s|%zu]", 42, "ab", 3.14159, 'z',
+             string, size_t{7});
+  BINARY_LOG(INFO, "%p", &value);
+  BINARY_LOG(INFO, "Missing %d %d", 1);
+  BINARY_LOG(INFO, "Extra", 1);
+
+  const std::vector<std::string> lines = DecodeLines(GetBinaryLog());
+  ASSERT_EQ(4u, lines.size());
+  EXPECT_THAT(lines[0], HasSubstr(":ERROR:"));
+  EXPECT_TRUE(base::EndsWith(lines[0], "] [   42|ab   |003.1|z|string|7]"))
+      << lines[0];
+  EXPECT_TRUE(base::EndsWith(
+      lines[1], base::StringPrintf("] 0x%" PRIxPTR,
+                                   reinterpret_cast<uintptr_t>(&value))))
+      << lines[1];
+  EXPECT_TRUE(base::EndsWith(lines[2], "] Missing 1 %d")) << lines[2];
+  EXPECT_TRUE(base::EndsWith(lines[3], "] Extra")) << lines[3];
+}
+
+TEST_F(BinaryLogTest, TruncatesLongStrings) {
+  StartBinaryLog({});
+  BINARY_LOG(INFO, "%s|%d", std::string(1000, 'x'), 1);
+
+  const std::vector<std::string> lines = DecodeLines(GetBinaryLog());
+  ASSERT_EQ(1u, lines.size());
+  EXPECT_TRUE(base::EndsWith(lines[0], "xxx|1")) << lines[0];
+  EXPECT_LT(lines[0].size(), 1000u);
+}
+
+TEST_F(BinaryLogTest, RejectsMalformedLogs) {
+  StartBinaryLog({});
+  BINARY_LOG(INFO, "Message %s", "string");
+  std::vector<uint8_t> binary_log = GetBinaryLog();
+
+  std::string text;
+  EXPECT_FALSE(DecodeBinaryLog({}, &text));
+  binary_log.pop_back();
+  EXPECT_FALSE(DecodeBinaryLog(binary_log, &text));
+  binary_log[0] = 'X';
+  EXPECT_FALSE(DecodeBinaryLog(binary_log, &text));
+}
+
+TEST_F(BinaryLogTest, WriteBinaryLog) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const base::FilePath path = temp_dir.GetPath().AppendASCII("binary_log");
+
+  StartBinaryLog({});
+  BINARY_LOG(INFO, "Message %d", 1);
+  ASSERT_TRUE(WriteBinaryLog(path));
+
+  const absl::optional<std::vector<uint8_t>> contents =
+      base::ReadFileToBytes(path);
+  ASSERT_TRUE(contents);
+  EXPECT_EQ(GetBinaryLog(), *contents);
+  const std::vector<std::string> lines = DecodeLines(*contents);
+  ASSERT_EQ(1u, lines.size());
+  EXPECT_TRUE(base::EndsWith(lines[0], "] Message 1")) << lines[0];
+}
+
+}  // namespace logging
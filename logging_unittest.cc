@@ -897,6 +897,35 @@ TEST_F(LoggingTest, ScopedVmoduleSwitches) {
   }
 }
 
+// Tests that a VLOG_IS_ON() call site, which caches its vlog level, follows
+// the changes of the vlog levels.
+TEST_F(LoggingTest, CachedVlogLevel) {
+  const auto vlog_is_on = [](int verbose_level) {
+    return VLOG_IS_ON(verbose_level);
+  };
+
+  SetMinLogLevel(LOGGING_INFO);
+  EXPECT_TRUE(vlog_is_on(0));
+  EXPECT_FALSE(vlog_is_on(1));
+
+  // Enables VLOG(1).
+  SetMinLogLevel(-1);
+  EXPECT_TRUE(vlog_is_on(1));
+  EXPECT_FALSE(vlog_is_on(2));
+
+  {
+    ScopedVmoduleSwitches scoped_vmodule_switches;
+    scoped_vmodule_switches.InitWithSwitches(__FILE__ "=3");
+    EXPECT_TRUE(vlog_is_on(3));
+    EXPECT_FALSE(vlog_is_on(4));
+  }
+  EXPECT_TRUE(vlog_is_on(1));
+  EXPECT_FALSE(vlog_is_on(3));
+
+  SetMinLogLevel(LOGGING_WARNING);
+  EXPECT_FALSE(vlog_is_on(0));
+}
+
 TEST_F(LoggingTest, BuildCrashString) {
   EXPECT_EQ("file.cc:42: ",
             LogMessage("file.cc", 42, LOGGING_ERROR).BuildCrashString());
@@ -0,0 +1,408 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/memory_pressure_monitor_linux.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "base/check.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_file.h"
+#include "base/functional/bind.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/process/process_metrics.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+
+namespace base {
+
+namespace {
+
+using MemoryPressureLevel = MemoryPressureListener::MemoryPressureLevel;
+
+constexpr char kSystemPsiFile[] = "/proc/pressure/memory";
+constexpr char kCgroupFile[] = "/proc/self/cgroup";
+constexpr char kCgroup2Root[] = "/sys/fs/cgroup";
+
+// Parses the avg10 value of a PSI line, e.g.
+// "some avg10=0.00 avg60=0.00 avg300=0.00 total=0".
+absl::optional<double> ParseAvg10(StringPiece line) {
+  for (StringPiece field :
+       SplitStringPiece(line, " ", TRIM_WHITESPACE, SPLIT_WANT_NONEMPTY)) {
+    if (!StartsWith(field, "avg10=")) {
+      continue;
+    }
+    double value;
+    if (!StringToDouble(field.substr(6), &value)) {
+      return absl::nullopt;
+    }
+    return value;
+  }
+  return absl::nullopt;
+}
+
+// Triggers signal with EPOLLPRI, while FileDescriptorWatcher only watches for
+// readability, so each trigger is registered on an epoll instance of its own,
+// which is readable whenever the trigger fires. Since the kernel clears the
+// event of the trigger when the message pump polls the epoll instance, the
+// instance being readable is what tells the trigger fired.
+class PsiTrigger : public MemoryPressureMonitorLinux::TriggerSource::Trigger {
+ public:
+  PsiTrigger(ScopedFD trigger_fd, ScopedFD epoll_fd)
+      : trigger_fd_(std::move(trigger_fd)), epoll_fd_(std::move(epoll_fd)) {}
+  ~PsiTrigger() override = default;
+
+  int fd() const override { return epoll_fd_.get(); }
+
+  bool HasFailed() override {
+    // Unlike events, errors aren't cleared by polling.
+    epoll_event event;
+    return HANDLE_EINTR(epoll_wait(epoll_fd_.get(), &event, 1,
+                                   /*timeout=*/0)) == 1 &&
+           (event.events & (EPOLLERR | EPOLLHUP));
+  }
+
+ private:
+  ScopedFD trigger_fd_;
+  ScopedFD epoll_fd_;
+};
+
+class PsiTriggerSource : public MemoryPressureMonitorLinux::TriggerSource {
+ public:
+  std::unique_ptr<Trigger> Register(const FilePath& psi_file,
+                                    const std::string& spec) override {
+    // Each file descriptor holds a single trigger.
+    ScopedFD trigger_fd(HANDLE_EINTR(
+        open(psi_file.value().c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC)));
+    ScopedFD epoll_fd(epoll_create1(EPOLL_CLOEXEC));
+    if (!trigger_fd.is_valid() || !epoll_fd.is_valid()) {
+      return nullptr;
+    }
+    // Adding the file to the epoll set first fails for files which can't be
+    // polled, e.g. regular files, before anything is written to them.
+    epoll_event event = {};
+    event.events = EPOLLPRI;
+    if (epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, trigger_fd.get(), &event) !=
+        0) {
+      return nullptr;
+    }
+    // The kernel expects the terminating null character.
+    if (HANDLE_EINTR(write(trigger_fd.get(), spec.c_str(), spec.size() + 1)) <
+        0) {
+      return nullptr;
+    }
+    return std::make_unique<PsiTrigger>(std::move(trigger_fd),
+                                        std::move(epoll_fd));
+  }
+};
+
+}  // namespace
+
+// static
+std::unique_ptr<MemoryPressureMonitorLinux::TriggerSource>
+MemoryPressureMonitorLinux::TriggerSource::Create() {
+  return std::make_unique<PsiTriggerSource>();
+}
+
+MemoryPressureMonitorLinux::Options::Options()
+    : psi_files(MemoryPressureMonitorLinux::GetDefaultPsiFiles()) {}
+MemoryPressureMonitorLinux::Options::Options(const Options&) = default;
+MemoryPressureMonitorLinux::Options&
+MemoryPressureMonitorLinux::Options::operator=(const Options&) = default;
+MemoryPressureMonitorLinux::Options::~Options() = default;
+
+MemoryPressureMonitorLinux::MemoryPressureMonitorLinux()
+    : MemoryPressureMonitorLinux(
+          Options(),
+          BindRepeating(&MemoryPressureListener::NotifyMemoryPressure)) {}
+
+MemoryPressureMonitorLinux::MemoryPressureMonitorLinux(
+    const Options& options,
+    DispatchCallback dispatch_callback)
+    : MemoryPressureMonitorLinux(options,
+                                 std::move(dispatch_callback),
+                                 TriggerSource::Create()) {}
+
+MemoryPressureMonitorLinux::MemoryPressureMonitorLinux(
+    const Options& options,
+    DispatchCallback dispatch_callback,
+    std::unique_ptr<TriggerSource> trigger_source)
+    : options_(options),
+      dispatch_callback_(std::move(dispatch_callback)),
+      trigger_source_(std::move(trigger_source)) {
+  for (const FilePath& psi_file : options_.psi_files) {
+    RegisterTriggers(psi_file);
+  }
+
+  if (!triggers_.empty()) {
+    mode_ = Mode::kPsiTriggers;
+    for (size_t i = 0; i < triggers_.size(); ++i) {
+      triggers_[i].watch_controller = FileDescriptorWatcher::WatchReadable(
+          triggers_[i].trigger->fd(),
+          BindRepeating(&MemoryPressureMonitorLinux::OnTriggerReadable,
+                        Unretained(this), i));
+    }
+  } else {
+    mode_ = GetLevelFromPsiFiles() ? Mode::kPsiPolling : Mode::kMemInfoPolling;
+  }
+  UpdatePollingTimer();
+}
+
+MemoryPressureMonitorLinux::~MemoryPressureMonitorLinux() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+}
+
+MemoryPressureMonitor::MemoryPressureLevel
+MemoryPressureMonitorLinux::GetCurrentPressureLevel() const {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  return current_level_;
+}
+
+// static
+std::vector<FilePath> MemoryPressureMonitorLinux::GetDefaultPsiFiles() {
+  std::vector<FilePath> psi_files;
+  // With cgroup v2, /proc/self/cgroup has a single "0::<path>" line. Under the
+  // root cgroup, its pressure is the system-wide one.
+  std::string cgroups;
+  if (ReadFileToStringNonBlocking(FilePath(kCgroupFile), &cgroups)) {
+    for (StringPiece line : SplitStringPiece(cgroups, "\n", TRIM_WHITESPACE,
+                                             SPLIT_WANT_NONEMPTY)) {
+      if (!StartsWith(line, "0::") || line == "0::/") {
+        continue;
+      }
+      psi_files.push_back(FilePath(kCgroup2Root)
+                              .Append(line.substr(4))
+                              .Append("memory.pressure"));
+    }
+  }
+  psi_files.emplace_back(kSystemPsiFile);
+  return psi_files;
+}
+
+// static
+absl::optional<MemoryPressureMonitorLinux::PsiStats>
+MemoryPressureMonitorLinux::ParsePsiStats(StringPiece contents) {
+  absl::optional<PsiStats> stats;
+  absl::optional<double> full_avg10;
+  for (StringPiece line :
+       SplitStringPiece(contents, "\n", TRIM_WHITESPACE, SPLIT_WANT_NONEMPTY)) {
+    if (StartsWith(line, "some ")) {
+      absl::optional<double> some_avg10 = ParseAvg10(line);
+      if (!some_avg10) {
+        return absl::nullopt;
+      }
+      stats.emplace();
+      stats->some_avg10 = *some_avg10;
+    } else if (StartsWith(line, "full ")) {
+      full_avg10 = ParseAvg10(line);
+    }
+  }
+  if (stats && full_avg10) {
+    stats->full_avg10 = *full_avg10;
+  }
+  return stats;
+}
+
+bool MemoryPressureMonitorLinux::GetSystemMemoryInfo(
+    SystemMemoryInfoKB* meminfo) {
+  return base::GetSystemMemoryInfo(meminfo);
+}
+
+bool MemoryPressureMonitorLinux::RegisterTriggers(const FilePath& psi_file) {
+  const struct {
+    const char* type;
+    double percent;
+    MemoryPressureLevel level;
+  } kTriggers[] = {
+      {"some", options_.moderate_some_percent,
+       MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_MODERATE},
+      {"full", options_.critical_full_percent,
+       MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_CRITICAL},
+  };
+  const int64_t window_us = options_.trigger_window.InMicroseconds();
+  const size_t first_trigger = triggers_.size();
+  for (const auto& trigger : kTriggers) {
+    const int64_t stall_us =
+        static_cast<int64_t>(window_us * trigger.percent / 100);
+    std::unique_ptr<TriggerSource::Trigger> registered =
+        trigger_source_->Register(
+            psi_file, StringPrintf("%s %" PRId64 " %" PRId64, trigger.type,
+                                   stall_us, window_us));
+    if (!registered) {
+      triggers_.erase(triggers_.begin() + first_trigger, triggers_.end());
+      return false;
+    }
+    triggers_.push_back({std::move(registered), trigger.level});
+  }
+  return true;
+}
+
+void MemoryPressureMonitorLinux::OnTriggerReadable(size_t index) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  RegisteredTrigger& trigger = triggers_[index];
+  if (trigger.trigger->HasFailed()) {
+    // The file is gone, e.g. because the cgroup was removed.
+    trigger.watch_controller.reset();
+    trigger.trigger.reset();
+    if (std::none_of(triggers_.begin(), triggers_.end(),
+                     [](const RegisteredTrigger& t) {
+                       return t.trigger != nullptr;
+                     })) {
+      StopTriggers();
+    }
+    return;
+  }
+  const MemoryPressureLevel level = trigger.level;
+
+  const TimeTicks now = TimeTicks::Now();
+  if (now - trigger_time_ < options_.trigger_hold_time) {
+    trigger_level_ = std::max(trigger_level_, level);
+  } else {
+    trigger_level_ = level;
+  }
+  trigger_time_ = now;
+  SetLevel(std::max(current_level_, trigger_level_));
+}
+
+void MemoryPressureMonitorLinux::StopTriggers() {
+  LOG(WARNING) << "All memory pressure triggers failed, polling instead";
+  triggers_.clear();
+  mode_ = GetLevelFromPsiFiles() ? Mode::kPsiPolling : Mode::kMemInfoPolling;
+  UpdatePollingTimer();
+}
+
+void MemoryPressureMonitorLinux::Poll() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  absl::optional<MemoryPressureLevel> level;
+  switch (mode_) {
+    case Mode::kPsiTriggers:
+      // The triggers raise the level, polling only lowers it.
+      level = GetLevelFromPsiFiles().value_or(
+          MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_NONE);
+      if (TimeTicks::Now() - trigger_time_ < options_.trigger_hold_time) {
+        level = std::max(*level, trigger_level_);
+      }
+      level = std::min(*level, current_level_);
+      break;
+    case Mode::kPsiPolling:
+      level = GetLevelFromPsiFiles();
+      break;
+    case Mode::kMemInfoPolling:
+      level = GetLevelFromMemInfo();
+      break;
+  }
+  if (level) {
+    SetLevel(*level);
+  }
+}
+
+absl::optional<MemoryPressureLevel>
+MemoryPressureMonitorLinux::GetLevelFromPsiFiles() const {
+  // The level is only lowered once the stalls are below the thresholds by the
+  // hysteresis margin.
+  const double critical_threshold =
+      options_.critical_full_percent *
+      (current_level_ == MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_CRITICAL
+           ? 1 - options_.hysteresis
+           : 1);
+  const double moderate_threshold =
+      options_.moderate_some_percent *
+      (current_level_ != MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_NONE
+           ? 1 - options_.hysteresis
+           : 1);
+
+  absl::optional<MemoryPressureLevel> level;
+  for (const FilePath& psi_file : options_.psi_files) {
+    std::string contents;
+    if (!ReadFileToStringNonBlocking(psi_file, &contents)) {
+      continue;
+    }
+    absl::optional<PsiStats> stats = ParsePsiStats(contents);
+    if (!stats) {
+      continue;
+    }
+    MemoryPressureLevel file_level =
+        MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_NONE;
+    if (stats->full_avg10 > critical_threshold) {
+      file_level = MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_CRITICAL;
+    } else if (stats->some_avg10 > moderate_threshold) {
+      file_level = MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_MODERATE;
+    }
+    level = std::max(level.value_or(file_level), file_level);
+  }
+  return level;
+}
+
+absl::optional<MemoryPressureLevel>
+MemoryPressureMonitorLinux::GetLevelFromMemInfo() {
+  SystemMemoryInfoKB meminfo;
+  if (!GetSystemMemoryInfo(&meminfo) || meminfo.total <= 0) {
+    return absl::nullopt;
+  }
+  // MemAvailable is missing before Linux 3.14.
+  const int available = meminfo.available
+                            ? meminfo.available
+                            : meminfo.free + meminfo.buffers + meminfo.cached;
+  const double available_percent = 100.0 * available / meminfo.total;
+
+  // The level is only lowered once the available memory is above the
+  // thresholds by the hysteresis margin.
+  const double critical_threshold =
+      options_.critical_available_percent *
+      (current_level_ == MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_CRITICAL
+           ? 1 + options_.hysteresis
+           : 1);
+  const double moderate_threshold =
+      options_.moderate_available_percent *
+      (current_level_ != MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_NONE
+           ? 1 + options_.hysteresis
+           : 1);
+  if (available_percent < critical_threshold) {
+    return MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_CRITICAL;
+  }
+  if (available_percent < moderate_threshold) {
+    return MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_MODERATE;
+  }
+  return MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_NONE;
+}
+
+void MemoryPressureMonitorLinux::SetLevel(MemoryPressureLevel level) {
+  const bool changed = level != current_level_;
+  current_level_ = level;
+  if (level != MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_NONE) {
+    // Keep reminding the listeners while the pressure lasts.
+    const TimeTicks now = TimeTicks::Now();
+    if (changed || now - last_dispatch_time_ >= options_.renotify_interval) {
+      last_dispatch_time_ = now;
+      dispatch_callback_.Run(level);
+    }
+  }
+  UpdatePollingTimer();
+}
+
+void MemoryPressureMonitorLinux::UpdatePollingTimer() {
+  // With triggers, polling is only needed to find out when the pressure ends.
+  const bool should_poll =
+      mode_ != Mode::kPsiTriggers ||
+      current_level_ != MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_NONE;
+  if (!should_poll) {
+    polling_timer_.Stop();
+  } else if (!polling_timer_.IsRunning()) {
+    polling_timer_.Start(FROM_HERE, options_.polling_interval,
+                         BindRepeating(&MemoryPressureMonitorLinux::Poll,
+                                       Unretained(this)));
+  }
+}
+
+}  // namespace base
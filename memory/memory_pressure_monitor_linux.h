@@ -0,0 +1,220 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MEMORY_MEMORY_PRESSURE_MONITOR_LINUX_H_
+#define BASE_MEMORY_MEMORY_PRESSURE_MONITOR_LINUX_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/files/file_descriptor_watcher_posix.h"
+#include "base/files/file_path.h"
+#include "base/memory/memory_pressure_monitor.h"
+#include "base/sequence_checker.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+namespace base {
+
+struct SystemMemoryInfoKB;
+
+// A MemoryPressureMonitor for Linux, based on Pressure Stall Information
+// (https://docs.kernel.org/accounting/psi.html).
+//
+// The monitor registers PSI triggers on the memory.pressure file of the cgroup
+// v2 the process belongs to and on /proc/pressure/memory: the kernel wakes it
+// up as soon as tasks stall on memory for more than a given share of the
+// trigger window, "some" stalls signaling MODERATE pressure and "full" stalls
+// CRITICAL pressure. While under pressure, the monitor polls the avg10 values
+// of the same files to find out when the pressure goes away, with hysteresis
+// so that the level doesn't flap around the thresholds.
+//
+// If triggers can't be registered (e.g. in a sandbox, or with a PSI file
+// which doesn't support them), or once all of them have failed (e.g. because
+// the cgroup was removed), the PSI files are polled instead. Without PSI
+// at all (kernels older than 4.20, or booted with psi=0), the monitor polls
+// GetSystemMemoryInfo() and derives the level from the available memory.
+//
+// Must be created and destroyed on a sequence which supports
+// FileDescriptorWatcher.
+class BASE_EXPORT MemoryPressureMonitorLinux : public MemoryPressureMonitor {
+ public:
+  struct BASE_EXPORT Options {
+    Options();
+    Options(const Options&);
+    Options& operator=(const Options&);
+    ~Options();
+
+    // PSI files to monitor. Defaults to GetDefaultPsiFiles().
+    std::vector<FilePath> psi_files;
+
+    // Share of time, in percent, during which some tasks (resp. all non-idle
+    // tasks) stall on memory, above which pressure is MODERATE (resp.
+    // CRITICAL). Compared against the stall time in a trigger window, and
+    // against the avg10 values when polling.
+    double moderate_some_percent = 10;
+    double critical_full_percent = 10;
+
+    // Available memory, in percent of the total memory, below which pressure
+    // is MODERATE (resp. CRITICAL). Only used without PSI.
+    double moderate_available_percent = 15;
+    double critical_available_percent = 5;
+
+    // Fraction of a threshold by which the signal must go back past it before
+    // the pressure level is lowered.
+    double hysteresis = 0.5;
+
+    // Window of the PSI triggers. Unprivileged processes may only use
+    // multiples of 2 seconds.
+    TimeDelta trigger_window = Seconds(2);
+
+    // Minimum time a level reported by a trigger is held for. The avg10 values
+    // lag behind the triggers, so they can't lower the level right away.
+    TimeDelta trigger_hold_time = Seconds(10);
+
+    // Interval at which the PSI files, or the system memory info, are polled.
+    TimeDelta polling_interval = Seconds(1);
+
+    // Interval at which a MODERATE or CRITICAL level is dispatched again while
+    // it lasts.
+    TimeDelta renotify_interval = Seconds(5);
+  };
+
+  enum class Mode {
+    // Woken up by PSI triggers.
+    kPsiTriggers,
+    // Polls the avg10 values of the PSI files.
+    kPsiPolling,
+    // Polls GetSystemMemoryInfo().
+    kMemInfoPolling,
+  };
+
+  // The stall averages read from a PSI file, in percent.
+  struct PsiStats {
+    double some_avg10 = 0;
+    double full_avg10 = 0;
+  };
+
+  // Registers PSI triggers. Overridden in tests.
+  class BASE_EXPORT TriggerSource {
+   public:
+    // A registered trigger, which is unregistered when destroyed.
+    class Trigger {
+     public:
+      virtual ~Trigger() = default;
+
+      // Becomes readable when the trigger fires or fails. This is the only
+      // sign that it fired: the kernel clears the event of a trigger whenever
+      // it is polled, so the event is gone once the message pump found the
+      // file descriptor readable.
+      virtual int fd() const = 0;
+
+      // Called once fd() became readable. Returns whether the trigger failed,
+      // e.g. because its cgroup was removed, rather than fired.
+      virtual bool HasFailed() = 0;
+    };
+
+    virtual ~TriggerSource() = default;
+
+    // Registers a trigger on |psi_file|, described by |spec| in the format
+    // the kernel expects, e.g. "some 150000 1000000". Returns null if
+    // |psi_file| doesn't support triggers.
+    virtual std::unique_ptr<Trigger> Register(const FilePath& psi_file,
+                                              const std::string& spec) = 0;
+
+    // Returns a source of actual PSI triggers.
+    static std::unique_ptr<TriggerSource> Create();
+  };
+
+  // Monitors the default PSI files, and dispatches to
+  // MemoryPressureListener::NotifyMemoryPressure().
+  MemoryPressureMonitorLinux();
+  MemoryPressureMonitorLinux(const Options& options,
+                             DispatchCallback dispatch_callback);
+  MemoryPressureMonitorLinux(const Options& options,
+                             DispatchCallback dispatch_callback,
+                             std::unique_ptr<TriggerSource> trigger_source);
+
+  MemoryPressureMonitorLinux(const MemoryPressureMonitorLinux&) = delete;
+  MemoryPressureMonitorLinux& operator=(const MemoryPressureMonitorLinux&) =
+      delete;
+
+  ~MemoryPressureMonitorLinux() override;
+
+  // MemoryPressureMonitor:
+  MemoryPressureLevel GetCurrentPressureLevel() const override;
+
+  Mode mode() const { return mode_; }
+
+  // Returns the memory.pressure file of the cgroup v2 of the process, if it's
+  // not the root one, followed by /proc/pressure/memory.
+  static std::vector<FilePath> GetDefaultPsiFiles();
+
+  // Parses the contents of a PSI file. Returns nullopt if there is no "some"
+  // line; the "full" line is optional.
+  static absl::optional<PsiStats> ParsePsiStats(StringPiece contents);
+
+ protected:
+  // Overridden in tests.
+  virtual bool GetSystemMemoryInfo(SystemMemoryInfoKB* meminfo);
+
+ private:
+  struct RegisteredTrigger {
+    std::unique_ptr<TriggerSource::Trigger> trigger;
+    MemoryPressureLevel level;
+    // Declared last, so that it stops watching before the trigger is closed.
+    std::unique_ptr<FileDescriptorWatcher::Controller> watch_controller;
+  };
+
+  // Registers the triggers on |psi_file|. Returns false if it doesn't support
+  // them.
+  bool RegisterTriggers(const FilePath& psi_file);
+
+  void OnTriggerReadable(size_t index);
+
+  // Called once all the triggers have failed: closes them and falls back to
+  // polling, as if they couldn't have been registered.
+  void StopTriggers();
+
+  // Polls the PSI files, or the system memory info, and updates the level.
+  void Poll();
+
+  // Returns the level derived from the PSI files, or nullopt if none of them
+  // could be read.
+  absl::optional<MemoryPressureLevel> GetLevelFromPsiFiles() const;
+  absl::optional<MemoryPressureLevel> GetLevelFromMemInfo();
+
+  void SetLevel(MemoryPressureLevel level);
+  void UpdatePollingTimer();
+
+  const Options options_;
+  const DispatchCallback dispatch_callback_;
+  Mode mode_ = Mode::kMemInfoPolling;
+
+  MemoryPressureLevel current_level_ =
+      MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_NONE;
+  TimeTicks last_dispatch_time_;
+
+  // Level of the last trigger that fired, and when it did.
+  MemoryPressureLevel trigger_level_ =
+      MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_NONE;
+  TimeTicks trigger_time_;
+
+  const std::unique_ptr<TriggerSource> trigger_source_;
+  // Triggers which failed are reset, and stay in the vector so that the
+  // indices the watchers are bound to remain valid.
+  std::vector<RegisteredTrigger> triggers_;
+
+  RepeatingTimer polling_timer_;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+};
+
+}  // namespace base
+
+#endif  // BASE_MEMORY_MEMORY_PRESSURE_MONITOR_LINUX_H_
@@ -0,0 +1,425 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/memory_pressure_monitor_linux.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/check_op.h"
+#include "base/containers/contains.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_file.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/functional/bind.h"
+#include "base/memory/raw_ptr.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/process/process_metrics.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/task_environment.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+using MemoryPressureLevel = MemoryPressureListener::MemoryPressureLevel;
+using Mode = MemoryPressureMonitorLinux::Mode;
+
+constexpr MemoryPressureLevel kNone =
+    MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_NONE;
+constexpr MemoryPressureLevel kModerate =
+    MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_MODERATE;
+constexpr MemoryPressureLevel kCritical =
+    MemoryPressureLevel::MEMORY_PRESSURE_LEVEL_CRITICAL;
+
+std::string MakePsiContents(double some_avg10, double full_avg10) {
+  return StringPrintf(
+      "some avg10=%.2f avg60=0.00 avg300=0.00 total=1000\n"
+      "full avg10=%.2f avg60=0.00 avg300=0.00 total=500\n",
+      some_avg10, full_avg10);
+}
+
+// Takes the system memory info from the test rather than from /proc/meminfo.
+class TestMemoryPressureMonitor : public MemoryPressureMonitorLinux {
+ public:
+  using MemoryPressureMonitorLinux::MemoryPressureMonitorLinux;
+
+  void set_available_percent(int available_percent) {
+    available_percent_ = available_percent;
+  }
+
+ protected:
+  bool GetSystemMemoryInfo(SystemMemoryInfoKB* meminfo) override {
+    meminfo->total = 1000;
+    meminfo->available = available_percent_ * 10;
+    return true;
+  }
+
+ private:
+  int available_percent_ = 100;
+};
+
+// Registers triggers which the test fires. Like a PSI trigger, whose event the
+// kernel clears as soon as the message pump polls it, a fake trigger only
+// tells it fired through the readability of its file descriptor.
+class FakeTriggerSource : public MemoryPressureMonitorLinux::TriggerSource {
+ public:
+  class FakeTrigger : public Trigger {
+   public:
+    FakeTrigger(FakeTriggerSource* source, std::string spec)
+        : source_(source), spec_(std::move(spec)) {
+      int fds[2];
+      CHECK_EQ(0, pipe2(fds, O_NONBLOCK | O_CLOEXEC));
+      read_fd_.reset(fds[0]);
+      write_fd_.reset(fds[1]);
+    }
+    ~FakeTrigger() override { source_->triggers_.erase(this); }
+
+    int fd() const override { return read_fd_.get(); }
+
+    bool HasFailed() override {
+      char buffer[16];
+      while (HANDLE_EINTR(read(read_fd_.get(), buffer, sizeof(buffer))) > 0) {
+      }
+      return failed_;
+    }
+
+    void Fire() {
+      CHECK_EQ(1, HANDLE_EINTR(write(write_fd_.get(), "x", 1)));
+    }
+
+    void Fail() {
+      failed_ = true;
+      Fire();
+    }
+
+    const std::string& spec() const { return spec_; }
+
+   private:
+    const raw_ptr<FakeTriggerSource> source_;
+    const std::string spec_;
+    ScopedFD read_fd_;
+    ScopedFD write_fd_;
+    bool failed_ = false;
+  };
+
+  std::unique_ptr<Trigger> Register(const FilePath& psi_file,
+                                    const std::string& spec) override {
+    if (!Contains(supported_files_, psi_file)) {
+      return nullptr;
+    }
+    auto trigger = std::make_unique<FakeTrigger>(this, spec);
+    triggers_.insert(trigger.get());
+    return trigger;
+  }
+
+  void set_supported_files(std::vector<FilePath> files) {
+    supported_files_ = std::move(files);
+  }
+
+  // Fires the triggers whose spec starts with |type|, i.e. "some" or "full".
+  void Fire(StringPiece type) {
+    for (FakeTrigger* trigger : triggers_) {
+      if (StartsWith(trigger->spec(), type)) {
+        trigger->Fire();
+      }
+    }
+  }
+
+  void FailAll() {
+    for (FakeTrigger* trigger : triggers_) {
+      trigger->Fail();
+    }
+  }
+
+  std::vector<std::string> GetSpecs() const {
+    std::vector<std::string> specs;
+    for (const FakeTrigger* trigger : triggers_) {
+      specs.push_back(trigger->spec());
+    }
+    return specs;
+  }
+
+ private:
+  std::vector<FilePath> supported_files_;
+  std::set<FakeTrigger*> triggers_;
+};
+
+}  // namespace
+
+class MemoryPressureMonitorLinuxTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    psi_file_ = temp_dir_.GetPath().AppendASCII("memory.pressure");
+    SetPsi(0, 0);
+  }
+
+  void SetPsi(double some_avg10, double full_avg10) {
+    ASSERT_TRUE(WriteFile(psi_file_, MakePsiContents(some_avg10, full_avg10)));
+  }
+
+  std::unique_ptr<TestMemoryPressureMonitor> CreateMonitor(
+      std::vector<FilePath> psi_files) {
+    MemoryPressureMonitorLinux::Options options;
+    options.psi_files = std::move(psi_files);
+    return std::make_unique<TestMemoryPressureMonitor>(
+        options,
+        BindRepeating(&MemoryPressureMonitorLinuxTest::OnMemoryPressure,
+                      Unretained(this)));
+  }
+
+  // Creates a monitor whose triggers on |psi_files| are fake ones, which
+  // |*trigger_source| fires.
+  std::unique_ptr<TestMemoryPressureMonitor> CreateMonitorWithFakeTriggers(
+      std::vector<FilePath> psi_files,
+      FakeTriggerSource** trigger_source) {
+    MemoryPressureMonitorLinux::Options options;
+    options.psi_files = psi_files;
+    auto source = std::make_unique<FakeTriggerSource>();
+    source->set_supported_files(std::move(psi_files));
+    *trigger_source = source.get();
+    return std::make_unique<TestMemoryPressureMonitor>(
+        options,
+        BindRepeating(&MemoryPressureMonitorLinuxTest::OnMemoryPressure,
+                      Unretained(this)),
+        std::move(source));
+  }
+
+  // Runs the polling timer once.
+  void Poll() {
+    task_environment_.FastForwardBy(
+        MemoryPressureMonitorLinux::Options().polling_interval);
+  }
+
+  std::vector<MemoryPressureLevel> TakeDispatchedLevels() {
+    return std::move(dispatched_levels_);
+  }
+
+  test::TaskEnvironment task_environment_{
+      test::TaskEnvironment::MainThreadType::IO,
+      test::TaskEnvironment::TimeSource::MOCK_TIME};
+  ScopedTempDir temp_dir_;
+  FilePath psi_file_;
+
+ private:
+  void OnMemoryPressure(MemoryPressureLevel level) {
+    dispatched_levels_.push_back(level);
+  }
+
+  std::vector<MemoryPressureLevel> dispatched_levels_;
+};
+
+TEST_F(MemoryPressureMonitorLinuxTest, ParsePsiStats) {
+  auto stats = MemoryPressureMonitorLinux::ParsePsiStats(
+      "some avg10=12.50 avg60=3.00 avg300=1.00 total=123456\n"
+      "full avg10=4.25 avg60=1.00 avg300=0.50 total=65432\n");
+  ASSERT_TRUE(stats);
+  EXPECT_DOUBLE_EQ(12.5, stats->some_avg10);
+  EXPECT_DOUBLE_EQ(4.25, stats->full_avg10);
+
+  // Older kernels have no "full" line for some resources.
+  stats = MemoryPressureMonitorLinux::ParsePsiStats(
+      "some avg10=1.00 avg60=0.00 avg300=0.00 total=0\n");
+  ASSERT_TRUE(stats);
+  EXPECT_DOUBLE_EQ(1, stats->some_avg10);
+  EXPECT_DOUBLE_EQ(0, stats->full_avg10);
+
+  EXPECT_FALSE(MemoryPressureMonitorLinux::ParsePsiStats(""));
+  EXPECT_FALSE(MemoryPressureMonitorLinux::ParsePsiStats(
+      "full avg10=1.00 avg60=0.00 avg300=0.00 total=0\n"));
+  EXPECT_FALSE(MemoryPressureMonitorLinux::ParsePsiStats(
+      "some avg10=abc avg60=0.00 avg300=0.00 total=0\n"));
+}
+
+TEST_F(MemoryPressureMonitorLinuxTest, DefaultPsiFiles) {
+  std::vector<FilePath> psi_files =
+      MemoryPressureMonitorLinux::GetDefaultPsiFiles();
+  ASSERT_FALSE(psi_files.empty());
+  EXPECT_EQ(FilePath("/proc/pressure/memory"), psi_files.back());
+  // Any other file belongs to the cgroup of the process.
+  for (size_t i = 0; i + 1 < psi_files.size(); ++i) {
+    EXPECT_EQ("memory.pressure", psi_files[i].BaseName().value());
+  }
+}
+
+TEST_F(MemoryPressureMonitorLinuxTest, PollsPsiFile) {
+  // A regular file doesn't support triggers.
+  auto monitor = CreateMonitor({psi_file_});
+  EXPECT_EQ(Mode::kPsiPolling, monitor->mode());
+  Poll();
+  EXPECT_EQ(kNone, monitor->GetCurrentPressureLevel());
+  EXPECT_TRUE(TakeDispatchedLevels().empty());
+
+  SetPsi(20, 0);
+  Poll();
+  EXPECT_EQ(kModerate, monitor->GetCurrentPressureLevel());
+  EXPECT_EQ(std::vector<MemoryPressureLevel>({kModerate}),
+            TakeDispatchedLevels());
+
+  SetPsi(40, 15);
+  Poll();
+  EXPECT_EQ(kCritical, monitor->GetCurrentPressureLevel());
+  EXPECT_EQ(std::vector<MemoryPressureLevel>({kCritical}),
+            TakeDispatchedLevels());
+}
+
+TEST_F(MemoryPressureMonitorLinuxTest, Hysteresis) {
+  auto monitor = CreateMonitor({psi_file_});
+  SetPsi(40, 15);
+  Poll();
+  EXPECT_EQ(kCritical, monitor->GetCurrentPressureLevel());
+
+  // Below the CRITICAL threshold, but not by the hysteresis margin.
+  SetPsi(40, 7);
+  Poll();
+  EXPECT_EQ(kCritical, monitor->GetCurrentPressureLevel());
+
+  SetPsi(7, 4);
+  Poll();
+  EXPECT_EQ(kModerate, monitor->GetCurrentPressureLevel());
+
+  SetPsi(4, 0);
+  Poll();
+  EXPECT_EQ(kNone, monitor->GetCurrentPressureLevel());
+
+  // Going back up requires crossing the threshold itself.
+  SetPsi(7, 0);
+  Poll();
+  EXPECT_EQ(kNone, monitor->GetCurrentPressureLevel());
+  EXPECT_EQ(std::vector<MemoryPressureLevel>({kCritical, kModerate}),
+            TakeDispatchedLevels());
+}
+
+TEST_F(MemoryPressureMonitorLinuxTest, RenotifiesWhilePressureLasts) {
+  auto monitor = CreateMonitor({psi_file_});
+  SetPsi(20, 0);
+  Poll();
+  EXPECT_EQ(1u, TakeDispatchedLevels().size());
+
+  task_environment_.FastForwardBy(
+      MemoryPressureMonitorLinux::Options().renotify_interval);
+  EXPECT_EQ(std::vector<MemoryPressureLevel>({kModerate}),
+            TakeDispatchedLevels());
+
+  SetPsi(0, 0);
+  task_environment_.FastForwardBy(
+      MemoryPressureMonitorLinux::Options().renotify_interval);
+  EXPECT_TRUE(TakeDispatchedLevels().empty());
+}
+
+TEST_F(MemoryPressureMonitorLinuxTest, TakesHighestLevelOfAllFiles) {
+  const FilePath other_psi_file =
+      temp_dir_.GetPath().AppendASCII("other.pressure");
+  ASSERT_TRUE(WriteFile(other_psi_file, MakePsiContents(20, 0)));
+  auto monitor = CreateMonitor(
+      {temp_dir_.GetPath().AppendASCII("missing"), psi_file_, other_psi_file});
+  EXPECT_EQ(Mode::kPsiPolling, monitor->mode());
+  Poll();
+  EXPECT_EQ(kModerate, monitor->GetCurrentPressureLevel());
+
+  SetPsi(50, 50);
+  Poll();
+  EXPECT_EQ(kCritical, monitor->GetCurrentPressureLevel());
+}
+
+TEST_F(MemoryPressureMonitorLinuxTest, FallsBackToMemInfo) {
+  auto monitor = CreateMonitor({temp_dir_.GetPath().AppendASCII("missing")});
+  EXPECT_EQ(Mode::kMemInfoPolling, monitor->mode());
+  Poll();
+  EXPECT_EQ(kNone, monitor->GetCurrentPressureLevel());
+
+  monitor->set_available_percent(10);
+  Poll();
+  EXPECT_EQ(kModerate, monitor->GetCurrentPressureLevel());
+
+  monitor->set_available_percent(4);
+  Poll();
+  EXPECT_EQ(kCritical, monitor->GetCurrentPressureLevel());
+
+  // Above the CRITICAL threshold, but not by the hysteresis margin.
+  monitor->set_available_percent(6);
+  Poll();
+  EXPECT_EQ(kCritical, monitor->GetCurrentPressureLevel());
+
+  monitor->set_available_percent(20);
+  Poll();
+  EXPECT_EQ(kModerate, monitor->GetCurrentPressureLevel());
+
+  monitor->set_available_percent(30);
+  Poll();
+  EXPECT_EQ(kNone, monitor->GetCurrentPressureLevel());
+  EXPECT_EQ(std::vector<MemoryPressureLevel>({kModerate, kCritical, kModerate}),
+            TakeDispatchedLevels());
+}
+
+TEST_F(MemoryPressureMonitorLinuxTest, TriggersRaiseLevel) {
+  FakeTriggerSource* trigger_source = nullptr;
+  auto monitor = CreateMonitorWithFakeTriggers({psi_file_}, &trigger_source);
+  EXPECT_EQ(Mode::kPsiTriggers, monitor->mode());
+  // Stalls of 10% of the 2 second window.
+  std::vector<std::string> specs = trigger_source->GetSpecs();
+  std::sort(specs.begin(), specs.end());
+  EXPECT_EQ(std::vector<std::string>(
+                {"full 200000 2000000", "some 200000 2000000"}),
+            specs);
+
+  // The avg10 values lag behind the triggers, and don't lower the level right
+  // away.
+  trigger_source->Fire("some");
+  task_environment_.RunUntilIdle();
+  EXPECT_EQ(kModerate, monitor->GetCurrentPressureLevel());
+  Poll();
+  EXPECT_EQ(kModerate, monitor->GetCurrentPressureLevel());
+
+  trigger_source->Fire("full");
+  task_environment_.RunUntilIdle();
+  EXPECT_EQ(kCritical, monitor->GetCurrentPressureLevel());
+  EXPECT_EQ(std::vector<MemoryPressureLevel>({kModerate, kCritical}),
+            TakeDispatchedLevels());
+
+  // Once the hold time is over, the avg10 values lower the level.
+  task_environment_.FastForwardBy(
+      MemoryPressureMonitorLinux::Options().trigger_hold_time);
+  EXPECT_EQ(kNone, monitor->GetCurrentPressureLevel());
+}
+
+TEST_F(MemoryPressureMonitorLinuxTest, PollsOnceAllTriggersFailed) {
+  FakeTriggerSource* trigger_source = nullptr;
+  auto monitor = CreateMonitorWithFakeTriggers({psi_file_}, &trigger_source);
+  EXPECT_EQ(Mode::kPsiTriggers, monitor->mode());
+
+  trigger_source->FailAll();
+  task_environment_.RunUntilIdle();
+  EXPECT_EQ(Mode::kPsiPolling, monitor->mode());
+  EXPECT_EQ(kNone, monitor->GetCurrentPressureLevel());
+
+  SetPsi(20, 0);
+  Poll();
+  EXPECT_EQ(kModerate, monitor->GetCurrentPressureLevel());
+}
+
+TEST_F(MemoryPressureMonitorLinuxTest, SystemPsi) {
+  const FilePath system_psi_file("/proc/pressure/memory");
+  std::string contents;
+  if (!ReadFileToString(system_psi_file, &contents) ||
+      !MemoryPressureMonitorLinux::ParsePsiStats(contents)) {
+    GTEST_SKIP() << "No PSI support";
+  }
+  // Registering triggers may not be allowed, but the file can be polled.
+  auto monitor = CreateMonitor({system_psi_file});
+  EXPECT_NE(Mode::kMemInfoPolling, monitor->mode());
+}
+
+}  // namespace base
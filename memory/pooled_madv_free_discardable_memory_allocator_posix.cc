@@ -0,0 +1,557 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/pooled_madv_free_discardable_memory_allocator_posix.h"
+
+#include <inttypes.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <string>
+
+#include "base/bits.h"
+#include "base/check_op.h"
+#include "base/functional/bind.h"
+#include "base/functional/callback_helpers.h"
+#include "base/memory/madv_free_discardable_memory_posix.h"
+#include "base/memory/page_size.h"
+#include "base/memory/raw_ptr.h"
+#include "base/notreached.h"
+#include "base/strings/stringprintf.h"
+#include "base/task/single_thread_task_runner.h"
+#include "base/tracing_buildflags.h"
+#include "build/build_config.h"
+
+#if BUILDFLAG(IS_ANDROID)
+#include <sys/prctl.h>
+#endif
+
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+#include "base/trace_event/memory_allocator_dump.h"  // no-presubmit-check
+#include "base/trace_event/memory_dump_manager.h"    // no-presubmit-check
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+
+namespace base {
+
+namespace {
+
+constexpr intptr_t kPageMagicCookie = 1;
+
+size_t GetSizeClass(size_t size) {
+  constexpr size_t kMinPooledSize =
+      PooledMadvFreeDiscardableMemoryAllocatorPosix::kMinPooledSize;
+  size = std::max(size, kMinPooledSize);
+  return static_cast<size_t>(bits::Log2Ceiling(static_cast<uint32_t>(size)) -
+                             bits::Log2Floor(kMinPooledSize));
+}
+
+}  // namespace
+
+struct PooledMadvFreeDiscardableMemoryAllocatorPosix::Chunk
+    : public LinkNode<Chunk> {
+  enum class State { kLocked, kUnlocked, kPurged };
+
+  explicit Chunk(size_t size_class)
+      : size_class(size_class),
+        slot_size(kMinPooledSize << size_class),
+        slot_count(kChunkSize / slot_size),
+        page_first_words(kChunkSize / GetPageSize()) {
+    CHECK_EQ(kChunkSize % GetPageSize(), 0u);
+    data = static_cast<uint8_t*>(mmap(nullptr, kChunkSize,
+                                      PROT_READ | PROT_WRITE,
+                                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+    PCHECK(data != MAP_FAILED);
+#if BUILDFLAG(IS_ANDROID)
+    prctl(PR_SET_VMA, PR_SET_VMA_ANON_NAME, data, kChunkSize,
+          "madv-free-discardable-pooled");
+#endif
+    // Slots past the end of the chunk are never free.
+    for (size_t slot = slot_count; slot < kMaxSlotCount; ++slot) {
+      used_slots[slot / 64] |= uint64_t{1} << (slot % 64);
+    }
+  }
+
+  ~Chunk() { PCHECK(!munmap(data, kChunkSize)); }
+
+  bool is_full() const { return used_slot_count == slot_count; }
+
+  size_t AllocateSlot() {
+    DCHECK(!is_full());
+    for (size_t word = 0; word < used_slots.size(); ++word) {
+      if (~used_slots[word]) {
+        const size_t bit =
+            static_cast<size_t>(bits::CountTrailingZeroBits(~used_slots[word]));
+        used_slots[word] |= uint64_t{1} << bit;
+        ++used_slot_count;
+        return word * 64 + bit;
+      }
+    }
+    NOTREACHED_NORETURN();
+  }
+
+  void FreeSlot(size_t slot) {
+    DCHECK(used_slots[slot / 64] & (uint64_t{1} << (slot % 64)));
+    used_slots[slot / 64] &= ~(uint64_t{1} << (slot % 64));
+    --used_slot_count;
+  }
+
+  std::atomic<intptr_t>* page_first_word(size_t page_index) {
+    static_assert(sizeof(intptr_t) == sizeof(std::atomic<intptr_t>),
+                  "Incompatible layout of std::atomic.");
+    return reinterpret_cast<std::atomic<intptr_t>*>(data +
+                                                    page_index * GetPageSize());
+  }
+
+  // Replaces the first word of each page with a non-zero cookie, so that pages
+  // discarded by the kernel can be told apart. Must be done before MADV_FREE
+  // is applied, since writing to a page cancels it.
+  void WriteCookies() {
+    for (size_t i = 0; i < page_first_words.size(); ++i) {
+      page_first_words[i] =
+          page_first_word(i)->load(std::memory_order_relaxed);
+      page_first_word(i)->store(kPageMagicCookie, std::memory_order_relaxed);
+    }
+  }
+
+  // Restores the first word of each page, and returns false if any page was
+  // discarded.
+  bool RestoreCookies() {
+    for (size_t i = 0; i < page_first_words.size(); ++i) {
+      intptr_t expected = kPageMagicCookie;
+      if (!page_first_word(i)->compare_exchange_strong(
+              expected, page_first_words[i], std::memory_order_relaxed)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static constexpr size_t kMaxSlotCount = kChunkSize / kMinPooledSize;
+
+  // Data comes from mmap() and we manage its lifetime.
+  RAW_PTR_EXCLUSION uint8_t* data;
+  const size_t size_class;
+  const size_t slot_size;
+  const size_t slot_count;
+
+  State state = State::kLocked;
+  // Number of locked allocations.
+  size_t lock_count = 0;
+  // Whether MADV_FREE was applied since the chunk was last unlocked.
+  bool advised = false;
+
+  std::array<uint64_t, kMaxSlotCount / 64> used_slots = {};
+  size_t used_slot_count = 0;
+  std::vector<intptr_t> page_first_words;
+};
+
+class PooledMadvFreeDiscardableMemoryAllocatorPosix::PooledDiscardableMemory
+    : public DiscardableMemory {
+ public:
+  PooledDiscardableMemory(
+      PooledMadvFreeDiscardableMemoryAllocatorPosix* allocator,
+      Chunk* chunk,
+      size_t slot,
+      size_t size)
+      : allocator_(allocator), chunk_(chunk), slot_(slot), size_(size) {}
+
+  PooledDiscardableMemory(const PooledDiscardableMemory&) = delete;
+  PooledDiscardableMemory& operator=(const PooledDiscardableMemory&) = delete;
+
+  ~PooledDiscardableMemory() override {
+    // The chunk may be deleted.
+    allocator_->FreeSlot(chunk_.ExtractAsDangling(), slot_, size_, is_locked_);
+  }
+
+  bool Lock() override {
+    DCHECK(!is_locked_);
+    if (!allocator_->LockSlot(chunk_)) {
+      return false;
+    }
+    is_locked_ = true;
+    return true;
+  }
+
+  void Unlock() override {
+    DCHECK(is_locked_);
+    is_locked_ = false;
+    allocator_->UnlockSlot(chunk_);
+  }
+
+  void* data() const override {
+    DCHECK(is_locked_);
+    return chunk_->data + slot_ * chunk_->slot_size;
+  }
+
+  void DiscardForTesting() override {
+    DCHECK(!is_locked_);
+    allocator_->DiscardChunkForTesting(chunk_);
+  }
+
+  trace_event::MemoryAllocatorDump* CreateMemoryAllocatorDump(
+      const char* name,
+      trace_event::ProcessMemoryDump* pmd) const override {
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+    using base::trace_event::MemoryAllocatorDump;
+    const bool is_purged = allocator_->IsChunkPurged(chunk_);
+    const std::string chunk_dump_name = StringPrintf(
+        "discardable/madv_free_pooled/chunk_0x%" PRIXPTR,
+        reinterpret_cast<uintptr_t>(chunk_.get()));
+    if (!pmd->GetAllocatorDump(chunk_dump_name)) {
+      pmd->CreateAllocatorDump(chunk_dump_name)
+          ->AddScalar(MemoryAllocatorDump::kNameSize,
+                      MemoryAllocatorDump::kUnitsBytes,
+                      is_purged ? 0U : static_cast<uint64_t>(kChunkSize));
+    }
+
+    MemoryAllocatorDump* dump = pmd->CreateAllocatorDump(name);
+    dump->AddScalar(MemoryAllocatorDump::kNameSize,
+                    MemoryAllocatorDump::kUnitsBytes,
+                    is_purged ? 0U : static_cast<uint64_t>(size_));
+    pmd->AddSuballocation(dump->guid(), chunk_dump_name);
+    return dump;
+#else   // BUILDFLAG(ENABLE_BASE_TRACING)
+    NOTREACHED();
+    return nullptr;
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+  }
+
+ private:
+  const raw_ptr<PooledMadvFreeDiscardableMemoryAllocatorPosix> allocator_;
+  raw_ptr<Chunk> chunk_;
+  const size_t slot_;
+  const size_t size_;
+  bool is_locked_ = true;
+};
+
+PooledMadvFreeDiscardableMemoryAllocatorPosix::
+    PooledMadvFreeDiscardableMemoryAllocatorPosix()
+    : PooledMadvFreeDiscardableMemoryAllocatorPosix(Options()) {}
+
+PooledMadvFreeDiscardableMemoryAllocatorPosix::
+    PooledMadvFreeDiscardableMemoryAllocatorPosix(const Options& options)
+    : options_(options),
+      // Purging is thread-safe, so it is done synchronously on the thread
+      // notifying memory pressure, which doesn't require a task runner.
+      memory_pressure_listener_(
+          FROM_HERE,
+          DoNothing(),
+          BindRepeating(
+              &PooledMadvFreeDiscardableMemoryAllocatorPosix::OnMemoryPressure,
+              Unretained(this))) {
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+  // Don't register dump provider if
+  // SingleThreadTaskRunner::CurrentDefaultHandle is not set, such as in tests
+  // and Android Webview.
+  if (SingleThreadTaskRunner::HasCurrentDefault()) {
+    trace_event::MemoryDumpManager::GetInstance()->RegisterDumpProvider(
+        this, "PooledMadvFreeDiscardableMemoryAllocator",
+        SingleThreadTaskRunner::GetCurrentDefault());
+  }
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+}
+
+PooledMadvFreeDiscardableMemoryAllocatorPosix::
+    ~PooledMadvFreeDiscardableMemoryAllocatorPosix() {
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+  trace_event::MemoryDumpManager::GetInstance()->UnregisterDumpProvider(this);
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+  AutoLock lock(lock_);
+  DCHECK_EQ(stats_.chunk_count, 0u) << "Allocations must not outlive the "
+                                       "allocator";
+}
+
+std::unique_ptr<DiscardableMemory>
+PooledMadvFreeDiscardableMemoryAllocatorPosix::AllocateLockedDiscardableMemory(
+    size_t size) {
+  if (size > kMaxPooledSize) {
+    return std::make_unique<MadvFreeDiscardableMemoryPosix>(
+        size, &unpooled_bytes_allocated_);
+  }
+
+  const size_t size_class = GetSizeClass(size);
+  AutoLock lock(lock_);
+  std::vector<Chunk*>& partial_chunks = partial_chunks_[size_class];
+  Chunk* chunk = nullptr;
+  while (!chunk && !partial_chunks.empty()) {
+    // Locking a chunk whose pages were discarded purges it, which removes it
+    // from |partial_chunks|.
+    if (LockChunk(partial_chunks.back())) {
+      chunk = partial_chunks.back();
+    }
+  }
+  if (!chunk) {
+    chunk = new Chunk(size_class);
+    chunk->lock_count = 1;
+    ++stats_.chunk_count;
+    stats_.locked_size += kChunkSize;
+    partial_chunks.push_back(chunk);
+  }
+
+  const size_t slot = chunk->AllocateSlot();
+  if (chunk->is_full()) {
+    partial_chunks.pop_back();
+  }
+  stats_.allocated_size += size;
+  return std::make_unique<PooledDiscardableMemory>(this, chunk, slot, size);
+}
+
+size_t PooledMadvFreeDiscardableMemoryAllocatorPosix::GetBytesAllocated()
+    const {
+  AutoLock lock(lock_);
+  return stats_.allocated_size + unpooled_bytes_allocated_;
+}
+
+void PooledMadvFreeDiscardableMemoryAllocatorPosix::ReleaseFreeMemory() {
+  AutoLock lock(lock_);
+  ApplyPendingMadvise();
+}
+
+bool PooledMadvFreeDiscardableMemoryAllocatorPosix::OnMemoryDump(
+    const trace_event::MemoryDumpArgs& args,
+    trace_event::ProcessMemoryDump* pmd) {
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+  using base::trace_event::MemoryAllocatorDump;
+  const Stats stats = GetStats();
+  MemoryAllocatorDump* dump =
+      pmd->CreateAllocatorDump("discardable/madv_free_pooled");
+  // Purged chunks don't use any memory.
+  dump->AddScalar(MemoryAllocatorDump::kNameSize,
+                  MemoryAllocatorDump::kUnitsBytes,
+                  stats.locked_size + stats.unlocked_size);
+  dump->AddScalar(MemoryAllocatorDump::kNameObjectCount,
+                  MemoryAllocatorDump::kUnitsObjects, stats.chunk_count);
+  dump->AddScalar("allocated_size", MemoryAllocatorDump::kUnitsBytes,
+                  stats.allocated_size);
+  dump->AddScalar("locked_size", MemoryAllocatorDump::kUnitsBytes,
+                  stats.locked_size);
+  dump->AddScalar("unlocked_size", MemoryAllocatorDump::kUnitsBytes,
+                  stats.unlocked_size);
+  dump->AddScalar("pending_madvise_size", MemoryAllocatorDump::kUnitsBytes,
+                  stats.pending_madvise_size);
+  dump->AddScalar("purged_size", MemoryAllocatorDump::kUnitsBytes,
+                  stats.purged_size);
+  dump->AddScalar("unpooled_size", MemoryAllocatorDump::kUnitsBytes,
+                  unpooled_bytes_allocated_);
+  return true;
+#else   // BUILDFLAG(ENABLE_BASE_TRACING)
+  return false;
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+}
+
+void PooledMadvFreeDiscardableMemoryAllocatorPosix::Purge(
+    size_t unlocked_size) {
+  AutoLock lock(lock_);
+  PurgeLocked(unlocked_size);
+}
+
+PooledMadvFreeDiscardableMemoryAllocatorPosix::Stats
+PooledMadvFreeDiscardableMemoryAllocatorPosix::GetStats() const {
+  AutoLock lock(lock_);
+  return stats_;
+}
+
+bool PooledMadvFreeDiscardableMemoryAllocatorPosix::LockSlot(Chunk* chunk) {
+  AutoLock lock(lock_);
+  return LockChunk(chunk);
+}
+
+void PooledMadvFreeDiscardableMemoryAllocatorPosix::UnlockSlot(Chunk* chunk) {
+  AutoLock lock(lock_);
+  DCHECK_GT(chunk->lock_count, 0u);
+  if (--chunk->lock_count == 0) {
+    OnChunkUnlocked(chunk);
+  }
+}
+
+void PooledMadvFreeDiscardableMemoryAllocatorPosix::FreeSlot(Chunk* chunk,
+                                                             size_t slot,
+                                                             size_t size,
+                                                             bool locked) {
+  AutoLock lock(lock_);
+  stats_.allocated_size -= size;
+  const bool was_full = chunk->is_full();
+  chunk->FreeSlot(slot);
+  if (locked) {
+    --chunk->lock_count;
+  }
+  if (!chunk->used_slot_count) {
+    DeleteChunk(chunk);
+    return;
+  }
+  if (locked && !chunk->lock_count) {
+    OnChunkUnlocked(chunk);
+  }
+  if (was_full && chunk->state != Chunk::State::kPurged) {
+    partial_chunks_[chunk->size_class].push_back(chunk);
+  }
+}
+
+void PooledMadvFreeDiscardableMemoryAllocatorPosix::DiscardChunkForTesting(
+    Chunk* chunk) {
+  AutoLock lock(lock_);
+  // All the allocations of the chunk must be unlocked.
+  DCHECK_EQ(chunk->lock_count, 0u);
+  if (chunk->state == Chunk::State::kUnlocked) {
+    PurgeChunk(chunk);
+  }
+}
+
+bool PooledMadvFreeDiscardableMemoryAllocatorPosix::IsChunkPurged(
+    const Chunk* chunk) const {
+  AutoLock lock(lock_);
+  return chunk->state == Chunk::State::kPurged;
+}
+
+bool PooledMadvFreeDiscardableMemoryAllocatorPosix::LockChunk(Chunk* chunk) {
+  switch (chunk->state) {
+    case Chunk::State::kPurged:
+      return false;
+    case Chunk::State::kLocked:
+      ++chunk->lock_count;
+      return true;
+    case Chunk::State::kUnlocked:
+      if (chunk->advised && !chunk->RestoreCookies()) {
+        // The kernel discarded some pages of the chunk.
+        PurgeChunk(chunk);
+        return false;
+      }
+      chunk->RemoveFromList();
+      stats_.unlocked_size -= kChunkSize;
+      if (!chunk->advised) {
+        stats_.pending_madvise_size -= kChunkSize;
+      }
+      chunk->advised = false;
+      chunk->state = Chunk::State::kLocked;
+      chunk->lock_count = 1;
+      stats_.locked_size += kChunkSize;
+      return true;
+  }
+}
+
+void PooledMadvFreeDiscardableMemoryAllocatorPosix::OnChunkUnlocked(
+    Chunk* chunk) {
+  DCHECK_EQ(chunk->state, Chunk::State::kLocked);
+  chunk->state = Chunk::State::kUnlocked;
+  stats_.locked_size -= kChunkSize;
+  unlocked_chunks_.Append(chunk);
+  stats_.unlocked_size += kChunkSize;
+  stats_.pending_madvise_size += kChunkSize;
+
+  if (stats_.pending_madvise_size >= options_.madvise_batch_size) {
+    ApplyPendingMadvise();
+  }
+  if (stats_.unlocked_size > options_.unlocked_budget) {
+    PurgeLocked(options_.unlocked_budget);
+  }
+}
+
+void PooledMadvFreeDiscardableMemoryAllocatorPosix::PurgeChunk(Chunk* chunk) {
+  DCHECK_EQ(chunk->state, Chunk::State::kUnlocked);
+  chunk->RemoveFromList();
+  stats_.unlocked_size -= kChunkSize;
+  if (!chunk->advised) {
+    stats_.pending_madvise_size -= kChunkSize;
+  }
+  // Unlike MADV_FREE, MADV_DONTNEED releases the memory right away.
+  PCHECK(!madvise(chunk->data, kChunkSize, MADV_DONTNEED));
+  ++stats_.madvise_calls;
+  chunk->advised = false;
+  chunk->state = Chunk::State::kPurged;
+  stats_.purged_size += kChunkSize;
+
+  std::vector<Chunk*>& partial_chunks = partial_chunks_[chunk->size_class];
+  auto it = std::find(partial_chunks.begin(), partial_chunks.end(), chunk);
+  if (it != partial_chunks.end()) {
+    partial_chunks.erase(it);
+  }
+}
+
+void PooledMadvFreeDiscardableMemoryAllocatorPosix::DeleteChunk(Chunk* chunk) {
+  DCHECK_EQ(chunk->lock_count, 0u);
+  switch (chunk->state) {
+    case Chunk::State::kLocked:
+      stats_.locked_size -= kChunkSize;
+      break;
+    case Chunk::State::kUnlocked:
+      chunk->RemoveFromList();
+      stats_.unlocked_size -= kChunkSize;
+      if (!chunk->advised) {
+        stats_.pending_madvise_size -= kChunkSize;
+      }
+      break;
+    case Chunk::State::kPurged:
+      stats_.purged_size -= kChunkSize;
+      break;
+  }
+  std::vector<Chunk*>& partial_chunks = partial_chunks_[chunk->size_class];
+  auto it = std::find(partial_chunks.begin(), partial_chunks.end(), chunk);
+  if (it != partial_chunks.end()) {
+    partial_chunks.erase(it);
+  }
+  --stats_.chunk_count;
+  delete chunk;
+}
+
+void PooledMadvFreeDiscardableMemoryAllocatorPosix::ApplyPendingMadvise() {
+  std::vector<Chunk*> pending_chunks;
+  for (LinkNode<Chunk>* node = unlocked_chunks_.head();
+       node != unlocked_chunks_.end(); node = node->next()) {
+    if (!node->value()->advised) {
+      pending_chunks.push_back(node->value());
+    }
+  }
+  if (pending_chunks.empty()) {
+    return;
+  }
+
+  // mmap() tends to return adjacent chunks, which can be advised together.
+  std::sort(pending_chunks.begin(), pending_chunks.end(),
+            [](const Chunk* a, const Chunk* b) { return a->data < b->data; });
+  for (size_t begin = 0; begin < pending_chunks.size();) {
+    size_t end = begin + 1;
+    while (end < pending_chunks.size() &&
+           pending_chunks[end]->data ==
+               pending_chunks[end - 1]->data + kChunkSize) {
+      ++end;
+    }
+    for (size_t i = begin; i < end; ++i) {
+      pending_chunks[i]->WriteCookies();
+      pending_chunks[i]->advised = true;
+    }
+#if defined(MADV_FREE)
+    const int retval = madvise(pending_chunks[begin]->data,
+                               (end - begin) * kChunkSize, MADV_FREE);
+    DPCHECK(!retval);
+    ++stats_.madvise_calls;
+#endif
+    begin = end;
+  }
+  stats_.pending_madvise_size = 0;
+}
+
+void PooledMadvFreeDiscardableMemoryAllocatorPosix::PurgeLocked(
+    size_t unlocked_size) {
+  while (stats_.unlocked_size > unlocked_size) {
+    DCHECK(!unlocked_chunks_.empty());
+    PurgeChunk(unlocked_chunks_.head()->value());
+  }
+}
+
+void PooledMadvFreeDiscardableMemoryAllocatorPosix::OnMemoryPressure(
+    MemoryPressureListener::MemoryPressureLevel memory_pressure_level) {
+  AutoLock lock(lock_);
+  switch (memory_pressure_level) {
+    case MemoryPressureListener::MEMORY_PRESSURE_LEVEL_NONE:
+      break;
+    case MemoryPressureListener::MEMORY_PRESSURE_LEVEL_MODERATE:
+      PurgeLocked(stats_.unlocked_size / 2);
+      break;
+    case MemoryPressureListener::MEMORY_PRESSURE_LEVEL_CRITICAL:
+      PurgeLocked(0);
+      break;
+  }
+}
+
+}  // namespace base
@@ -0,0 +1,144 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MEMORY_POOLED_MADV_FREE_DISCARDABLE_MEMORY_ALLOCATOR_POSIX_H_
+#define BASE_MEMORY_POOLED_MADV_FREE_DISCARDABLE_MEMORY_ALLOCATOR_POSIX_H_
+
+#include <stddef.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/containers/linked_list.h"
+#include "base/memory/discardable_memory.h"
+#include "base/memory/discardable_memory_allocator.h"
+#include "base/memory/memory_pressure_listener.h"
+#include "base/synchronization/lock.h"
+#include "base/thread_annotations.h"
+#include "base/trace_event/base_tracing.h"
+
+namespace base {
+
+// A DiscardableMemoryAllocator backed by MADV_FREE, like
+// MadvFreeDiscardableMemoryAllocatorPosix, which packs small allocations into
+// shared chunks instead of mapping each of them separately.
+//
+// Allocations of up to |kMaxPooledSize| bytes are rounded up to a power of two
+// and carved out of |kChunkSize| chunks holding allocations of a single size.
+// Larger ones are backed by MadvFreeDiscardableMemoryPosix.
+//
+// A chunk is locked while any of its allocations is. Once all of them are
+// unlocked, the chunk is appended to an LRU list, and MADV_FREE is applied to
+// it lazily: unlocked chunks are advised together, with one madvise() call per
+// run of contiguous chunks, once |madvise_batch_size| bytes are waiting for it
+// (or on ReleaseFreeMemory()). Until then, locking the chunk again is free.
+//
+// Unlocked chunks are purged, in LRU order, when they exceed
+// |unlocked_budget|, and on memory pressure (half of them on MODERATE
+// pressure, all of them on CRITICAL pressure). As with MADV_FREE, a purged
+// chunk fails to lock: all its allocations are lost. The kernel may also
+// reclaim pages of chunks which were advised, in which case the chunk fails to
+// lock as well.
+//
+// This class is thread-safe. Allocations must not outlive it.
+class BASE_EXPORT PooledMadvFreeDiscardableMemoryAllocatorPosix
+    : public DiscardableMemoryAllocator,
+      public trace_event::MemoryDumpProvider {
+ public:
+  static constexpr size_t kChunkSize = 64 * 1024;
+  static constexpr size_t kMinPooledSize = 256;
+  static constexpr size_t kMaxPooledSize = kChunkSize / 4;
+
+  struct Options {
+    // Maximum size of the unlocked chunks.
+    size_t unlocked_budget = 32 * 1024 * 1024;
+    // Size of the unlocked chunks waiting for MADV_FREE above which it is
+    // applied to all of them.
+    size_t madvise_batch_size = 1024 * 1024;
+  };
+
+  PooledMadvFreeDiscardableMemoryAllocatorPosix();
+  explicit PooledMadvFreeDiscardableMemoryAllocatorPosix(
+      const Options& options);
+
+  PooledMadvFreeDiscardableMemoryAllocatorPosix(
+      const PooledMadvFreeDiscardableMemoryAllocatorPosix&) = delete;
+  PooledMadvFreeDiscardableMemoryAllocatorPosix& operator=(
+      const PooledMadvFreeDiscardableMemoryAllocatorPosix&) = delete;
+
+  ~PooledMadvFreeDiscardableMemoryAllocatorPosix() override;
+
+  // DiscardableMemoryAllocator:
+  std::unique_ptr<DiscardableMemory> AllocateLockedDiscardableMemory(
+      size_t size) override;
+  size_t GetBytesAllocated() const override;
+  // Applies MADV_FREE to the unlocked chunks which are still waiting for it.
+  void ReleaseFreeMemory() override;
+
+  // MemoryDumpProvider:
+  bool OnMemoryDump(const trace_event::MemoryDumpArgs& args,
+                    trace_event::ProcessMemoryDump* pmd) override;
+
+  // Purges unlocked chunks, least recently used first, until they take at most
+  // |unlocked_size| bytes.
+  void Purge(size_t unlocked_size);
+
+  // Sizes of the chunks in each state, and of the allocations.
+  struct Stats {
+    size_t chunk_count = 0;
+    size_t locked_size = 0;
+    size_t unlocked_size = 0;
+    size_t pending_madvise_size = 0;
+    size_t purged_size = 0;
+    size_t allocated_size = 0;
+    size_t madvise_calls = 0;
+  };
+  Stats GetStats() const;
+
+ private:
+  class PooledDiscardableMemory;
+  struct Chunk;
+
+  static constexpr size_t kSizeClassCount = 7;
+  static_assert(kMinPooledSize << (kSizeClassCount - 1) == kMaxPooledSize);
+
+  // Methods called by PooledDiscardableMemory.
+  bool LockSlot(Chunk* chunk);
+  void UnlockSlot(Chunk* chunk);
+  void FreeSlot(Chunk* chunk, size_t slot, size_t size, bool locked);
+  void DiscardChunkForTesting(Chunk* chunk);
+  bool IsChunkPurged(const Chunk* chunk) const;
+
+  bool LockChunk(Chunk* chunk) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void OnChunkUnlocked(Chunk* chunk) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void PurgeChunk(Chunk* chunk) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void DeleteChunk(Chunk* chunk) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void ApplyPendingMadvise() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void PurgeLocked(size_t unlocked_size) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  void OnMemoryPressure(
+      MemoryPressureListener::MemoryPressureLevel memory_pressure_level);
+
+  const Options options_;
+
+  mutable Lock lock_;
+  // Chunks with free slots, which are not purged, for each size class.
+  std::array<std::vector<Chunk*>, kSizeClassCount> partial_chunks_
+      GUARDED_BY(lock_);
+  // Unlocked chunks, least recently used first.
+  LinkedList<Chunk> unlocked_chunks_ GUARDED_BY(lock_);
+  Stats stats_ GUARDED_BY(lock_);
+
+  // Bytes allocated by allocations which are too large to be pooled.
+  std::atomic<size_t> unpooled_bytes_allocated_{0};
+
+  MemoryPressureListener memory_pressure_listener_;
+};
+
+}  // namespace base
+
+#endif  // BASE_MEMORY_POOLED_MADV_FREE_DISCARDABLE_MEMORY_ALLOCATOR_POSIX_H_
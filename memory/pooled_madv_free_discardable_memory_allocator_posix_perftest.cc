@@ -0,0 +1,152 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/pooled_madv_free_discardable_memory_allocator_posix.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "base/memory/madv_free_discardable_memory_allocator_posix.h"
+#include "base/memory/madv_free_discardable_memory_posix.h"
+#include "base/memory/memory_pressure_listener.h"
+#include "base/memory/page_size.h"
+#include "base/strings/stringprintf.h"
+#include "base/timer/lap_timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace base {
+
+namespace {
+
+constexpr char kMetricPrefixDiscardable[] = "MadvFreeDiscardableMemory.";
+constexpr char kMetricLockUnlockThroughput[] = "lock_unlock_throughput";
+constexpr char kMetricResidentSize[] = "resident_size";
+constexpr char kMetricResidentSizeAfterPressure[] =
+    "resident_size_after_pressure";
+
+constexpr size_t kAllocationCount = 4096;
+
+perf_test::PerfResultReporter SetUpReporter(const std::string& story_name) {
+  perf_test::PerfResultReporter reporter(kMetricPrefixDiscardable, story_name);
+  reporter.RegisterImportantMetric(kMetricLockUnlockThroughput, "runs/s");
+  reporter.RegisterImportantMetric(kMetricResidentSize, "bytes");
+  reporter.RegisterImportantMetric(kMetricResidentSizeAfterPressure, "bytes");
+  return reporter;
+}
+
+std::unique_ptr<DiscardableMemoryAllocator> CreateAllocator(bool pooled) {
+  if (pooled) {
+    return std::make_unique<PooledMadvFreeDiscardableMemoryAllocatorPosix>();
+  }
+  return std::make_unique<MadvFreeDiscardableMemoryAllocatorPosix>();
+}
+
+std::string GetStoryName(bool pooled, size_t allocation_size) {
+  return StringPrintf("%s_%zu", pooled ? "pooled" : "unpooled",
+                      allocation_size);
+}
+
+// Returns how much of the pages in |pages| is resident.
+size_t GetResidentSize(const std::set<uintptr_t>& pages) {
+  size_t resident_size = 0;
+  for (uintptr_t page : pages) {
+    unsigned char vec = 0;
+    if (!mincore(reinterpret_cast<void*>(page), GetPageSize(), &vec) &&
+        (vec & 1)) {
+      resident_size += GetPageSize();
+    }
+  }
+  return resident_size;
+}
+
+class DiscardableMemoryPerfTest
+    : public ::testing::TestWithParam<std::tuple<bool, size_t>> {
+ public:
+  void SetUp() override {
+    if (GetMadvFreeSupport() != MadvFreeSupport::kSupported) {
+      GTEST_SKIP() << "MADV_FREE is not supported";
+    }
+  }
+
+  bool pooled() const { return std::get<0>(GetParam()); }
+  size_t allocation_size() const { return std::get<1>(GetParam()); }
+};
+
+}  // namespace
+
+INSTANTIATE_TEST_SUITE_P(
+    All,
+    DiscardableMemoryPerfTest,
+    ::testing::Combine(::testing::Bool(),
+                       ::testing::Values<size_t>(512, 4096, 16384)));
+
+// Locks and unlocks allocations in turn, as a cache would.
+TEST_P(DiscardableMemoryPerfTest, LockUnlock) {
+  auto allocator = CreateAllocator(pooled());
+  std::vector<std::unique_ptr<DiscardableMemory>> allocations;
+  for (size_t i = 0; i < kAllocationCount; ++i) {
+    allocations.push_back(
+        allocator->AllocateLockedDiscardableMemory(allocation_size()));
+    memset(allocations.back()->data(), 1, allocation_size());
+    allocations.back()->Unlock();
+  }
+
+  LapTimer timer;
+  timer.Start();
+  do {
+    for (auto& allocation : allocations) {
+      ASSERT_TRUE(allocation->Lock());
+      allocation->data_as<uint8_t>()[0]++;
+      allocation->Unlock();
+    }
+    timer.NextLap();
+  } while (!timer.HasTimeLimitExpired());
+
+  auto reporter = SetUpReporter(GetStoryName(pooled(), allocation_size()));
+  reporter.AddResult(kMetricLockUnlockThroughput,
+                     timer.LapsPerSecond() * kAllocationCount);
+}
+
+// Measures the memory used by unlocked allocations, before and after moderate
+// memory pressure.
+TEST_P(DiscardableMemoryPerfTest, ResidentSizeUnderPressure) {
+  auto allocator = CreateAllocator(pooled());
+  std::vector<std::unique_ptr<DiscardableMemory>> allocations;
+  std::set<uintptr_t> pages;
+  for (size_t i = 0; i < kAllocationCount; ++i) {
+    allocations.push_back(
+        allocator->AllocateLockedDiscardableMemory(allocation_size()));
+    uint8_t* data = allocations.back()->data_as<uint8_t>();
+    memset(data, 1, allocation_size());
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(data);
+    for (uintptr_t page = begin & ~(GetPageSize() - 1);
+         page < begin + allocation_size(); page += GetPageSize()) {
+      pages.insert(page);
+    }
+  }
+  for (auto& allocation : allocations) {
+    allocation->Unlock();
+  }
+  const size_t resident_size = GetResidentSize(pages);
+
+  MemoryPressureListener::SimulatePressureNotification(
+      MemoryPressureListener::MEMORY_PRESSURE_LEVEL_MODERATE);
+  allocator->ReleaseFreeMemory();
+  const size_t resident_size_after_pressure = GetResidentSize(pages);
+
+  auto reporter = SetUpReporter(GetStoryName(pooled(), allocation_size()));
+  reporter.AddResult(kMetricResidentSize, resident_size);
+  reporter.AddResult(kMetricResidentSizeAfterPressure,
+                     resident_size_after_pressure);
+}
+
+}  // namespace base
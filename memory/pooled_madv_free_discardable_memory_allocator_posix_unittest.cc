@@ -0,0 +1,276 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/pooled_madv_free_discardable_memory_allocator_posix.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/memory/madv_free_discardable_memory_posix.h"
+#include "base/memory/memory_pressure_listener.h"
+#include "base/memory/page_size.h"
+#include "base/tracing_buildflags.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+#include "base/trace_event/memory_allocator_dump.h"  // no-presubmit-check
+#include "base/trace_event/process_memory_dump.h"    // no-presubmit-check
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+
+namespace base {
+
+namespace {
+
+using Allocator = PooledMadvFreeDiscardableMemoryAllocatorPosix;
+constexpr size_t kChunkSize = Allocator::kChunkSize;
+
+// Allocations of different size classes never share a chunk.
+constexpr size_t kSizes[] = {Allocator::kMinPooledSize,
+                             Allocator::kMinPooledSize * 2,
+                             Allocator::kMinPooledSize * 4,
+                             Allocator::kMinPooledSize * 8};
+
+}  // namespace
+
+class PooledMadvFreeDiscardableMemoryAllocatorPosixTest
+    : public ::testing::Test {
+ protected:
+  std::unique_ptr<Allocator> CreateAllocator(
+      const Allocator::Options& options = Allocator::Options()) {
+    return std::make_unique<Allocator>(options);
+  }
+};
+
+TEST_F(PooledMadvFreeDiscardableMemoryAllocatorPosixTest,
+       PacksSmallAllocations) {
+  auto allocator = CreateAllocator();
+  std::vector<std::unique_ptr<DiscardableMemory>> allocations;
+  for (size_t i = 0; i < 4; ++i) {
+    allocations.push_back(allocator->AllocateLockedDiscardableMemory(1000));
+    memset(allocations.back()->data(), static_cast<int>(i), 1000);
+  }
+  EXPECT_EQ(4000u, allocator->GetBytesAllocated());
+  EXPECT_EQ(1u, allocator->GetStats().chunk_count);
+  EXPECT_EQ(kChunkSize, allocator->GetStats().locked_size);
+
+  for (size_t i = 0; i < allocations.size(); ++i) {
+    const uint8_t* data = allocations[i]->data_as<uint8_t>();
+    EXPECT_EQ(i, data[0]);
+    EXPECT_EQ(i, data[999]);
+  }
+
+  allocations.clear();
+  EXPECT_EQ(0u, allocator->GetBytesAllocated());
+  EXPECT_EQ(0u, allocator->GetStats().chunk_count);
+}
+
+TEST_F(PooledMadvFreeDiscardableMemoryAllocatorPosixTest,
+       DoesNotPoolLargeAllocations) {
+  auto allocator = CreateAllocator();
+  auto memory =
+      allocator->AllocateLockedDiscardableMemory(Allocator::kMaxPooledSize + 1);
+  EXPECT_EQ(Allocator::kMaxPooledSize + 1, allocator->GetBytesAllocated());
+  EXPECT_EQ(0u, allocator->GetStats().chunk_count);
+}
+
+TEST_F(PooledMadvFreeDiscardableMemoryAllocatorPosixTest,
+       ChunkLockedWhileAnyAllocationIs) {
+  auto allocator = CreateAllocator();
+  auto memory1 = allocator->AllocateLockedDiscardableMemory(100);
+  auto memory2 = allocator->AllocateLockedDiscardableMemory(100);
+  memset(memory1->data(), 'a', 100);
+
+  memory1->Unlock();
+  EXPECT_EQ(kChunkSize, allocator->GetStats().locked_size);
+  EXPECT_EQ(0u, allocator->GetStats().unlocked_size);
+
+  memory2->Unlock();
+  EXPECT_EQ(0u, allocator->GetStats().locked_size);
+  EXPECT_EQ(kChunkSize, allocator->GetStats().unlocked_size);
+  EXPECT_EQ(kChunkSize, allocator->GetStats().pending_madvise_size);
+
+  // MADV_FREE is not applied yet, so nothing can be lost.
+  ASSERT_TRUE(memory1->Lock());
+  EXPECT_EQ('a', memory1->data_as<char>()[99]);
+  EXPECT_EQ(0u, allocator->GetStats().madvise_calls);
+  memory1->Unlock();
+
+  // Destroying the allocations while unlocked frees the chunk.
+  memory1.reset();
+  memory2.reset();
+  EXPECT_EQ(0u, allocator->GetStats().chunk_count);
+  EXPECT_EQ(0u, allocator->GetStats().unlocked_size);
+}
+
+TEST_F(PooledMadvFreeDiscardableMemoryAllocatorPosixTest, BatchesMadvise) {
+  Allocator::Options options;
+  options.madvise_batch_size = 4 * kChunkSize;
+  auto allocator = CreateAllocator(options);
+
+  std::vector<std::unique_ptr<DiscardableMemory>> allocations;
+  for (size_t i = 0; i < 4; ++i) {
+    allocations.push_back(allocator->AllocateLockedDiscardableMemory(
+        Allocator::kMaxPooledSize));
+  }
+  ASSERT_EQ(1u, allocator->GetStats().chunk_count);
+  for (size_t size : kSizes) {
+    allocations.push_back(allocator->AllocateLockedDiscardableMemory(size));
+  }
+  for (auto& allocation : allocations) {
+    memset(allocation->data(), 'a', Allocator::kMinPooledSize);
+  }
+  ASSERT_EQ(5u, allocator->GetStats().chunk_count);
+
+  for (size_t i = 0; i < 6; ++i) {
+    allocations[i]->Unlock();
+  }
+  EXPECT_EQ(3 * kChunkSize, allocator->GetStats().pending_madvise_size);
+  EXPECT_EQ(0u, allocator->GetStats().madvise_calls);
+
+  allocations[6]->Unlock();
+  const Allocator::Stats stats = allocator->GetStats();
+  EXPECT_EQ(0u, stats.pending_madvise_size);
+  EXPECT_EQ(4 * kChunkSize, stats.unlocked_size);
+#if defined(MADV_FREE)
+  // Adjacent chunks are advised together.
+  EXPECT_GE(stats.madvise_calls, 1u);
+  EXPECT_LE(stats.madvise_calls, 4u);
+#endif
+
+  // Unless the kernel reclaims them, advised chunks can be locked again.
+  if (GetMadvFreeSupport() == MadvFreeSupport::kSupported) {
+    for (size_t i = 0; i < 7; ++i) {
+      ASSERT_TRUE(allocations[i]->Lock());
+      EXPECT_EQ('a', allocations[i]->data_as<char>()[0]);
+    }
+  }
+}
+
+TEST_F(PooledMadvFreeDiscardableMemoryAllocatorPosixTest,
+       ReleaseFreeMemoryAppliesMadvise) {
+  auto allocator = CreateAllocator();
+  auto memory = allocator->AllocateLockedDiscardableMemory(100);
+  memory->Unlock();
+  EXPECT_EQ(kChunkSize, allocator->GetStats().pending_madvise_size);
+  allocator->ReleaseFreeMemory();
+  EXPECT_EQ(0u, allocator->GetStats().pending_madvise_size);
+  EXPECT_EQ(kChunkSize, allocator->GetStats().unlocked_size);
+}
+
+TEST_F(PooledMadvFreeDiscardableMemoryAllocatorPosixTest,
+       PurgesLeastRecentlyUsedOverBudget) {
+  Allocator::Options options;
+  options.unlocked_budget = 2 * kChunkSize;
+  auto allocator = CreateAllocator(options);
+
+  std::vector<std::unique_ptr<DiscardableMemory>> allocations;
+  for (size_t size : kSizes) {
+    allocations.push_back(allocator->AllocateLockedDiscardableMemory(size));
+  }
+  ASSERT_EQ(4u, allocator->GetStats().chunk_count);
+
+  allocations[0]->Unlock();
+  allocations[1]->Unlock();
+  // Using the first allocation makes the second one the least recently used.
+  ASSERT_TRUE(allocations[0]->Lock());
+  allocations[0]->Unlock();
+  allocations[2]->Unlock();
+  EXPECT_EQ(2 * kChunkSize, allocator->GetStats().unlocked_size);
+  EXPECT_EQ(kChunkSize, allocator->GetStats().purged_size);
+
+  EXPECT_FALSE(allocations[1]->Lock());
+  EXPECT_TRUE(allocations[0]->Lock());
+  EXPECT_TRUE(allocations[2]->Lock());
+
+  // A new allocation of the same size doesn't go to the purged chunk.
+  auto memory = allocator->AllocateLockedDiscardableMemory(kSizes[1]);
+  EXPECT_EQ(5u, allocator->GetStats().chunk_count);
+
+  allocations.clear();
+  EXPECT_EQ(1u, allocator->GetStats().chunk_count);
+  EXPECT_EQ(0u, allocator->GetStats().purged_size);
+}
+
+TEST_F(PooledMadvFreeDiscardableMemoryAllocatorPosixTest,
+       PurgesOnMemoryPressure) {
+  auto allocator = CreateAllocator();
+  std::vector<std::unique_ptr<DiscardableMemory>> allocations;
+  for (size_t size : kSizes) {
+    allocations.push_back(allocator->AllocateLockedDiscardableMemory(size));
+    allocations.back()->Unlock();
+  }
+  EXPECT_EQ(4 * kChunkSize, allocator->GetStats().unlocked_size);
+
+  MemoryPressureListener::SimulatePressureNotification(
+      MemoryPressureListener::MEMORY_PRESSURE_LEVEL_MODERATE);
+  EXPECT_EQ(2 * kChunkSize, allocator->GetStats().unlocked_size);
+  EXPECT_FALSE(allocations[0]->Lock());
+  EXPECT_FALSE(allocations[1]->Lock());
+
+  MemoryPressureListener::SimulatePressureNotification(
+      MemoryPressureListener::MEMORY_PRESSURE_LEVEL_CRITICAL);
+  EXPECT_EQ(0u, allocator->GetStats().unlocked_size);
+  EXPECT_EQ(4 * kChunkSize, allocator->GetStats().purged_size);
+  EXPECT_FALSE(allocations[2]->Lock());
+  EXPECT_FALSE(allocations[3]->Lock());
+}
+
+TEST_F(PooledMadvFreeDiscardableMemoryAllocatorPosixTest,
+       DetectsPagesDiscardedByKernel) {
+  auto allocator = CreateAllocator();
+  auto memory1 = allocator->AllocateLockedDiscardableMemory(100);
+  auto memory2 = allocator->AllocateLockedDiscardableMemory(100);
+  const uintptr_t page = reinterpret_cast<uintptr_t>(memory2->data()) &
+                         ~(GetPageSize() - 1);
+  memory1->Unlock();
+  memory2->Unlock();
+  allocator->ReleaseFreeMemory();
+
+  // Has the same effect as the kernel reclaiming the page.
+  ASSERT_EQ(0, madvise(reinterpret_cast<void*>(page), GetPageSize(),
+                       MADV_DONTNEED));
+  EXPECT_FALSE(memory2->Lock());
+  // The whole chunk is lost.
+  EXPECT_FALSE(memory1->Lock());
+  EXPECT_EQ(kChunkSize, allocator->GetStats().purged_size);
+}
+
+TEST_F(PooledMadvFreeDiscardableMemoryAllocatorPosixTest, DiscardForTesting) {
+  auto allocator = CreateAllocator();
+  auto memory = allocator->AllocateLockedDiscardableMemory(100);
+  memory->Unlock();
+  memory->DiscardForTesting();
+  EXPECT_FALSE(memory->Lock());
+}
+
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+TEST_F(PooledMadvFreeDiscardableMemoryAllocatorPosixTest, MemoryDump) {
+  auto allocator = CreateAllocator();
+  auto memory1 = allocator->AllocateLockedDiscardableMemory(100);
+  auto memory2 = allocator->AllocateLockedDiscardableMemory(200);
+  memory2->Unlock();
+
+  trace_event::MemoryDumpArgs dump_args = {
+      trace_event::MemoryDumpLevelOfDetail::kDetailed};
+  trace_event::ProcessMemoryDump pmd(dump_args);
+  ASSERT_TRUE(allocator->OnMemoryDump(dump_args, &pmd));
+  auto* dump = pmd.GetAllocatorDump("discardable/madv_free_pooled");
+  ASSERT_TRUE(dump);
+  EXPECT_EQ(kChunkSize, dump->GetSizeInternal());
+
+  // Both allocations are suballocations of the same chunk dump.
+  EXPECT_EQ(100u,
+            memory1->CreateMemoryAllocatorDump("test/memory1", &pmd)
+                ->GetSizeInternal());
+  EXPECT_EQ(200u,
+            memory2->CreateMemoryAllocatorDump("test/memory2", &pmd)
+                ->GetSizeInternal());
+}
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+
+}  // namespace base
@@ -7,6 +7,7 @@
 #include <utility>
 
 #include "base/check_op.h"
+#include "base/files/memory_mapped_file.h"
 #include "base/memory/read_only_shared_memory_region.h"
 
 namespace base {
@@ -119,4 +120,20 @@ RefCountedSharedMemoryMapping::CreateFromWholeRegion(
   return MakeRefCounted<RefCountedSharedMemoryMapping>(std::move(mapping));
 }
 
+RefCountedMemoryMappedFile::RefCountedMemoryMappedFile(
+    std::unique_ptr<MemoryMappedFile> file)
+    : file_(std::move(file)) {
+  DCHECK(file_->IsValid());
+}
+
+RefCountedMemoryMappedFile::~RefCountedMemoryMappedFile() = default;
+
+const unsigned char* RefCountedMemoryMappedFile::front() const {
+  return file_->data();
+}
+
+size_t RefCountedMemoryMappedFile::size() const {
+  return file_->length();
+}
+
 }  //  namespace base
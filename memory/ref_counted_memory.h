@@ -18,6 +18,7 @@
 
 namespace base {
 
+class MemoryMappedFile;
 class ReadOnlySharedMemoryRegion;
 
 // A generic interface to memory. This object is reference counted because most
@@ -193,6 +194,29 @@ class BASE_EXPORT RefCountedSharedMemoryMapping : public RefCountedMemory {
   const size_t size_;
 };
 
+// An implementation of RefCountedMemory, where the bytes are those of a
+// MemoryMappedFile. The file must not be truncated while mapped, as accessing
+// the bytes past its new end then crashes.
+class BASE_EXPORT RefCountedMemoryMappedFile : public RefCountedMemory {
+ public:
+  // Constructs a RefCountedMemory object by taking ownership of an already
+  // initialized MemoryMappedFile.
+  explicit RefCountedMemoryMappedFile(std::unique_ptr<MemoryMappedFile> file);
+
+  RefCountedMemoryMappedFile(const RefCountedMemoryMappedFile&) = delete;
+  RefCountedMemoryMappedFile& operator=(const RefCountedMemoryMappedFile&) =
+      delete;
+
+  // RefCountedMemory:
+  const unsigned char* front() const override;
+  size_t size() const override;
+
+ private:
+  ~RefCountedMemoryMappedFile() override;
+
+  const std::unique_ptr<MemoryMappedFile> file_;
+};
+
 }  // namespace base
 
 #endif  // BASE_MEMORY_REF_COUNTED_MEMORY_H_
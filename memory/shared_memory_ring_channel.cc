@@ -0,0 +1,452 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/shared_memory_ring_channel.h"
+
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <utility>
+
+#include "base/bits.h"
+#include "base/check_op.h"
+#include "base/files/scoped_file.h"
+#include "base/functional/function_ref.h"
+#include "base/logging.h"
+#include "base/memory/platform_shared_memory_region.h"
+#include "base/posix/unix_domain_socket.h"
+#include "base/unguessable_token.h"
+
+namespace base {
+
+namespace {
+
+constexpr size_t kCacheLineSize = 64;
+constexpr size_t kMinCapacity = 4096;
+
+// Number of times a side checks for its peer before sleeping.
+constexpr int kSpinCount = 256;
+
+// Stored in the header of the record which fills the end of the ring when the
+// next record doesn't fit there.
+constexpr uint32_t kPaddingFlag = 1;
+
+struct RecordHeader {
+  uint32_t size;
+  uint32_t flags;
+};
+static_assert(sizeof(RecordHeader) ==
+              SharedMemoryRingChannel::kRecordAlignment);
+
+// Metadata sent along with the file descriptor of a region.
+struct RegionMessage {
+  uint64_t guid_high;
+  uint64_t guid_low;
+  uint64_t size;
+};
+
+using Futex = std::atomic<uint32_t>;
+static_assert(sizeof(Futex) == sizeof(uint32_t) &&
+              Futex::is_always_lock_free);
+
+// The futexes live in memory shared with another process, so they can't use
+// FUTEX_PRIVATE_FLAG.
+void FutexWait(Futex* futex, uint32_t expected, const timespec* timeout) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(futex), FUTEX_WAIT, expected,
+          timeout, nullptr, 0);
+}
+
+void FutexWake(Futex* futex) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(futex), FUTEX_WAKE, 1,
+          nullptr, nullptr, 0);
+}
+
+// Waits until |condition| is true, or until |timeout| expires, in which case
+// false is returned. Sets |waiting| while sleeping, so that the peer knows to
+// wake this side up with WakeIfWaiting() after changing the outcome of
+// |condition|.
+bool WaitUntil(Futex* waiting,
+               FunctionRef<bool()> condition,
+               TimeDelta timeout) {
+  for (int i = 0; i < kSpinCount; ++i) {
+    if (condition()) {
+      return true;
+    }
+  }
+  const TimeTicks deadline =
+      timeout.is_max() ? TimeTicks::Max() : TimeTicks::Now() + timeout;
+  while (true) {
+    // Pairs with the fence in WakeIfWaiting(): either the peer sees |waiting|,
+    // or this side sees the change which the peer made before checking it.
+    waiting->store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (condition()) {
+      waiting->store(0, std::memory_order_relaxed);
+      return true;
+    }
+    timespec timeout_spec;
+    const timespec* timeout_ptr = nullptr;
+    if (!deadline.is_max()) {
+      const TimeDelta remaining = deadline - TimeTicks::Now();
+      if (!remaining.is_positive()) {
+        waiting->store(0, std::memory_order_relaxed);
+        return false;
+      }
+      timeout_spec = remaining.ToTimeSpec();
+      timeout_ptr = &timeout_spec;
+    }
+    FutexWait(waiting, 1, timeout_ptr);
+  }
+}
+
+void WakeIfWaiting(Futex* waiting) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting->load(std::memory_order_relaxed) &&
+      waiting->exchange(0, std::memory_order_relaxed)) {
+    FutexWake(waiting);
+  }
+}
+
+}  // namespace
+
+// Laid out at the start of the region, followed by the ring. Each position is
+// the number of bytes written to, or read from, the ring since its creation.
+struct SharedMemoryRingChannel::Header {
+  // Written by the writer only.
+  alignas(kCacheLineSize) std::atomic<uint64_t> write_position;
+  // Written by the reader only.
+  alignas(kCacheLineSize) std::atomic<uint64_t> read_position;
+  // Written by both sides, but only when closing or sleeping.
+  alignas(kCacheLineSize) Futex reader_waiting;
+  Futex writer_waiting;
+  std::atomic<uint32_t> reader_closed;
+  std::atomic<uint32_t> writer_closed;
+};
+
+// static
+UnsafeSharedMemoryRegion SharedMemoryRingChannel::CreateRegion(
+    size_t capacity) {
+  DCHECK(bits::IsPowerOfTwo(capacity));
+  DCHECK_GE(capacity, kMinCapacity);
+  // The region is zero-filled, which makes a valid, empty header.
+  return UnsafeSharedMemoryRegion::Create(sizeof(Header) + capacity);
+}
+
+// static
+bool SharedMemoryRingChannel::SendRegion(int socket,
+                                         UnsafeSharedMemoryRegion region) {
+  subtle::PlatformSharedMemoryRegion platform_region =
+      UnsafeSharedMemoryRegion::TakeHandleForSerialization(std::move(region));
+  if (!platform_region.IsValid()) {
+    return false;
+  }
+  const RegionMessage message = {
+      platform_region.GetGUID().GetHighForSerialization(),
+      platform_region.GetGUID().GetLowForSerialization(),
+      platform_region.GetSize()};
+  ScopedFD fd = std::move(platform_region.PassPlatformHandle().fd);
+  return UnixDomainSocket::SendMsg(socket, &message, sizeof(message),
+                                   {fd.get()});
+}
+
+// static
+UnsafeSharedMemoryRegion SharedMemoryRingChannel::ReceiveRegion(int socket) {
+  RegionMessage message;
+  std::vector<ScopedFD> fds;
+  const ssize_t size =
+      UnixDomainSocket::RecvMsg(socket, &message, sizeof(message), &fds);
+  if (size != sizeof(message) || fds.size() != 1) {
+    return UnsafeSharedMemoryRegion();
+  }
+  absl::optional<UnguessableToken> guid =
+      UnguessableToken::Deserialize(message.guid_high, message.guid_low);
+  if (!guid) {
+    return UnsafeSharedMemoryRegion();
+  }
+  return UnsafeSharedMemoryRegion::Deserialize(
+      subtle::PlatformSharedMemoryRegion::Take(
+          std::move(fds[0]),
+          subtle::PlatformSharedMemoryRegion::Mode::kUnsafe,
+          static_cast<size_t>(message.size), *guid));
+}
+
+SharedMemoryRingChannel::SharedMemoryRingChannel(
+    const UnsafeSharedMemoryRegion& region) {
+  if (!region.IsValid() || region.GetSize() < sizeof(Header) + kMinCapacity) {
+    return;
+  }
+  const size_t capacity = region.GetSize() - sizeof(Header);
+  if (!bits::IsPowerOfTwo(capacity)) {
+    return;
+  }
+  mapping_ = region.Map();
+  if (mapping_.IsValid()) {
+    capacity_ = capacity;
+  }
+}
+
+SharedMemoryRingChannel::~SharedMemoryRingChannel() = default;
+
+SharedMemoryRingChannel::Header* SharedMemoryRingChannel::header() const {
+  return static_cast<Header*>(mapping_.memory());
+}
+
+uint8_t* SharedMemoryRingChannel::ring() const {
+  return static_cast<uint8_t*>(mapping_.memory()) + sizeof(Header);
+}
+
+SharedMemoryRingWriter::SharedMemoryRingWriter(
+    const UnsafeSharedMemoryRegion& region)
+    : SharedMemoryRingChannel(region) {
+  if (!IsValid()) {
+    closed_ = true;
+    return;
+  }
+  write_position_ = header()->write_position.load(std::memory_order_relaxed);
+  cached_read_position_ =
+      header()->read_position.load(std::memory_order_acquire);
+}
+
+SharedMemoryRingWriter::~SharedMemoryRingWriter() {
+  Close();
+}
+
+absl::optional<span<uint8_t>> SharedMemoryRingWriter::BeginWrite(
+    size_t size,
+    TimeDelta timeout) {
+  DCHECK(!reserved_size_);
+  if (closed_ || size > max_record_size()) {
+    return absl::nullopt;
+  }
+
+  const size_t record_size =
+      bits::AlignUp(sizeof(RecordHeader) + size, kRecordAlignment);
+  const size_t offset = write_position_ & (capacity_ - 1);
+  // Records are contiguous: one which doesn't fit at the end of the ring is
+  // preceded by a padding record filling it. max_record_size() guarantees that
+  // both fit in an empty ring.
+  const size_t padding_size =
+      offset + record_size > capacity_ ? capacity_ - offset : 0;
+
+  Header* const shared_header = header();
+  const bool has_room = WaitUntil(
+      &shared_header->writer_waiting,
+      [&] {
+        return IsClosed() || HasRoom(padding_size + record_size);
+      },
+      timeout);
+  if (!has_room || IsClosed()) {
+    return absl::nullopt;
+  }
+
+  if (padding_size) {
+    const RecordHeader padding = {
+        static_cast<uint32_t>(padding_size - sizeof(RecordHeader)),
+        kPaddingFlag};
+    memcpy(ring() + offset, &padding, sizeof(padding));
+    // The padding is published along with the record.
+    write_position_ += padding_size;
+  }
+  reserved_size_ = size;
+  return span<uint8_t>(
+      ring() + (write_position_ & (capacity_ - 1)) + sizeof(RecordHeader),
+      size);
+}
+
+void SharedMemoryRingWriter::EndWrite(size_t size) {
+  DCHECK(reserved_size_);
+  DCHECK_LE(size, *reserved_size_);
+  reserved_size_.reset();
+
+  const RecordHeader record = {static_cast<uint32_t>(size), 0};
+  memcpy(ring() + (write_position_ & (capacity_ - 1)), &record,
+         sizeof(record));
+  write_position_ +=
+      bits::AlignUp(sizeof(RecordHeader) + size, kRecordAlignment);
+
+  Header* const shared_header = header();
+  shared_header->write_position.store(write_position_,
+                                      std::memory_order_release);
+  WakeIfWaiting(&shared_header->reader_waiting);
+}
+
+bool SharedMemoryRingWriter::Write(span<const uint8_t> record,
+                                   TimeDelta timeout) {
+  absl::optional<span<uint8_t>> buffer = BeginWrite(record.size(), timeout);
+  if (!buffer) {
+    return false;
+  }
+  if (!record.empty()) {
+    memcpy(buffer->data(), record.data(), record.size());
+  }
+  EndWrite(record.size());
+  return true;
+}
+
+void SharedMemoryRingWriter::Close() {
+  DCHECK(!reserved_size_);
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  Header* const shared_header = header();
+  shared_header->writer_closed.store(1, std::memory_order_release);
+  WakeIfWaiting(&shared_header->reader_waiting);
+}
+
+bool SharedMemoryRingWriter::IsClosed() const {
+  return closed_ ||
+         header()->reader_closed.load(std::memory_order_relaxed) != 0;
+}
+
+bool SharedMemoryRingWriter::HasRoom(size_t size) {
+  uint64_t used = write_position_ - cached_read_position_;
+  if (used <= capacity_ && capacity_ - used >= size) {
+    return true;
+  }
+  cached_read_position_ =
+      header()->read_position.load(std::memory_order_acquire);
+  used = write_position_ - cached_read_position_;
+  if (used > capacity_) {
+    DLOG(ERROR) << "Corrupted shared memory ring";
+    Close();
+    return false;
+  }
+  return capacity_ - used >= size;
+}
+
+SharedMemoryRingReader::SharedMemoryRingReader(
+    const UnsafeSharedMemoryRegion& region)
+    : SharedMemoryRingChannel(region) {
+  if (!IsValid()) {
+    closed_ = true;
+    return;
+  }
+  read_position_ = header()->read_position.load(std::memory_order_relaxed);
+  cached_write_position_ =
+      header()->write_position.load(std::memory_order_acquire);
+}
+
+SharedMemoryRingReader::~SharedMemoryRingReader() {
+  Close();
+}
+
+absl::optional<span<const uint8_t>> SharedMemoryRingReader::BeginRead(
+    TimeDelta timeout) {
+  DCHECK(!pending_size_);
+  Header* const shared_header = header();
+  while (true) {
+    if (closed_) {
+      return absl::nullopt;
+    }
+    bool writer_closed = false;
+    WaitUntil(
+        &shared_header->reader_waiting,
+        [&] {
+          // Check whether the writer closed the channel first, so that the
+          // records it wrote before are seen.
+          writer_closed =
+              shared_header->writer_closed.load(std::memory_order_acquire);
+          return GetAvailableSize() != 0 || writer_closed || closed_;
+        },
+        timeout);
+    const size_t available_size = GetAvailableSize();
+    if (available_size == 0) {
+      if (writer_closed) {
+        closed_ = true;
+      }
+      return absl::nullopt;
+    }
+
+    // The writer may change the record header at any time: copy it before
+    // validating it.
+    const size_t offset = read_position_ & (capacity_ - 1);
+    RecordHeader record;
+    memcpy(&record, ring() + offset, sizeof(record));
+    const size_t record_size =
+        bits::AlignUp(sizeof(RecordHeader) + record.size, kRecordAlignment);
+    if (record.size > capacity_ || record_size > available_size ||
+        offset + record_size > capacity_ ||
+        (record.flags == kPaddingFlag && offset + record_size != capacity_) ||
+        (record.flags != 0 && record.flags != kPaddingFlag)) {
+      DLOG(ERROR) << "Corrupted shared memory ring";
+      Close();
+      return absl::nullopt;
+    }
+
+    if (record.flags == kPaddingFlag) {
+      read_position_ += record_size;
+      shared_header->read_position.store(read_position_,
+                                         std::memory_order_release);
+      continue;
+    }
+    pending_size_ = record_size;
+    return span<const uint8_t>(ring() + offset + sizeof(RecordHeader),
+                               record.size);
+  }
+}
+
+void SharedMemoryRingReader::EndRead() {
+  DCHECK(pending_size_);
+  read_position_ += *pending_size_;
+  pending_size_.reset();
+
+  Header* const shared_header = header();
+  shared_header->read_position.store(read_position_,
+                                     std::memory_order_release);
+  WakeIfWaiting(&shared_header->writer_waiting);
+}
+
+bool SharedMemoryRingReader::Read(std::vector<uint8_t>* record,
+                                  TimeDelta timeout) {
+  absl::optional<span<const uint8_t>> buffer = BeginRead(timeout);
+  if (!buffer) {
+    return false;
+  }
+  record->assign(buffer->begin(), buffer->end());
+  EndRead();
+  return true;
+}
+
+void SharedMemoryRingReader::Close() {
+  pending_size_.reset();
+  closed_ = true;
+  if (!IsValid()) {
+    return;
+  }
+  Header* const shared_header = header();
+  shared_header->reader_closed.store(1, std::memory_order_release);
+  WakeIfWaiting(&shared_header->writer_waiting);
+}
+
+bool SharedMemoryRingReader::IsClosed() const {
+  if (closed_) {
+    return true;
+  }
+  // The writer only closes the channel after publishing its last record.
+  Header* const shared_header = header();
+  return shared_header->writer_closed.load(std::memory_order_acquire) &&
+         shared_header->write_position.load(std::memory_order_acquire) ==
+             read_position_;
+}
+
+size_t SharedMemoryRingReader::GetAvailableSize() {
+  if (cached_write_position_ == read_position_) {
+    cached_write_position_ =
+        header()->write_position.load(std::memory_order_acquire);
+  }
+  const uint64_t available = cached_write_position_ - read_position_;
+  if (available > capacity_) {
+    DLOG(ERROR) << "Corrupted shared memory ring";
+    Close();
+    return 0;
+  }
+  return static_cast<size_t>(available);
+}
+
+}  // namespace base
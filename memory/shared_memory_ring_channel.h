@@ -0,0 +1,171 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MEMORY_SHARED_MEMORY_RING_CHANNEL_H_
+#define BASE_MEMORY_SHARED_MEMORY_RING_CHANNEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/containers/span.h"
+#include "base/memory/shared_memory_mapping.h"
+#include "base/memory/unsafe_shared_memory_region.h"
+#include "base/time/time.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+namespace base {
+
+// A single-producer/single-consumer channel of variable-size records, backed
+// by a ring buffer in shared memory. Unlike a socket, records are written and
+// read in place, without copying them into and out of the kernel.
+//
+// One process creates the region with CreateRegion() and sends it to its peer,
+// e.g. with SendRegion(). One side then wraps it in a SharedMemoryRingWriter,
+// and the other in a SharedMemoryRingReader.
+//
+// The read and write positions live on separate cache lines. A side which has
+// to wait for its peer spins briefly, then sleeps on a futex; its peer only
+// issues the wake-up syscall when it finds it sleeping, so a busy channel
+// doesn't enter the kernel at all.
+//
+// Values read from shared memory are validated, and a channel which a
+// misbehaving peer corrupted is closed. However, the peer can modify a record
+// while it is being read: its contents must be treated as untrusted.
+//
+// A peer which exits without closing its side of the channel is not detected;
+// use timeouts, or watch the peer process, in that case.
+class BASE_EXPORT SharedMemoryRingChannel {
+ public:
+  // Records are aligned on, and take a multiple of, this many bytes, including
+  // a header of the same size.
+  static constexpr size_t kRecordAlignment = 8;
+
+  // Returns a region for a channel whose ring holds |capacity| bytes, which
+  // must be a power of two of at least 4 KiB. Returns an invalid region on
+  // failure.
+  static UnsafeSharedMemoryRegion CreateRegion(size_t capacity);
+
+  // Sends |region| over the Unix domain socket |socket|, with what the peer
+  // needs to rebuild it in ReceiveRegion(). Returns false on failure.
+  static bool SendRegion(int socket, UnsafeSharedMemoryRegion region);
+  // Receives a region sent by SendRegion() on |socket|. Returns an invalid
+  // region on failure.
+  static UnsafeSharedMemoryRegion ReceiveRegion(int socket);
+
+  SharedMemoryRingChannel(const SharedMemoryRingChannel&) = delete;
+  SharedMemoryRingChannel& operator=(const SharedMemoryRingChannel&) = delete;
+
+  // Returns false if the region couldn't be mapped, or wasn't created by
+  // CreateRegion().
+  bool IsValid() const { return capacity_ != 0; }
+
+  // Size of the ring, in bytes.
+  size_t capacity() const { return capacity_; }
+  // Largest record which can be written to the channel.
+  size_t max_record_size() const { return capacity_ / 2 - kRecordAlignment; }
+
+ protected:
+  struct Header;
+
+  explicit SharedMemoryRingChannel(const UnsafeSharedMemoryRegion& region);
+  ~SharedMemoryRingChannel();
+
+  Header* header() const;
+  uint8_t* ring() const;
+
+  WritableSharedMemoryMapping mapping_;
+  size_t capacity_ = 0;
+};
+
+// The writing side of a SharedMemoryRingChannel. Must be used from one thread
+// at a time.
+class BASE_EXPORT SharedMemoryRingWriter : public SharedMemoryRingChannel {
+ public:
+  explicit SharedMemoryRingWriter(const UnsafeSharedMemoryRegion& region);
+  // Closes the channel.
+  ~SharedMemoryRingWriter();
+
+  // Reserves room for a record of up to |size| bytes, waiting up to |timeout|
+  // for the reader to make room for it, and returns where to write it. The
+  // record is only visible to the reader once EndWrite() is called. Returns
+  // nullopt on timeout, if the channel is closed, or if |size| exceeds
+  // max_record_size().
+  absl::optional<span<uint8_t>> BeginWrite(
+      size_t size,
+      TimeDelta timeout = TimeDelta::Max());
+  // Publishes the first |size| bytes of the record reserved by BeginWrite().
+  void EndWrite(size_t size);
+
+  // Copies |record| to the channel. Returns false in the cases where
+  // BeginWrite() returns nullopt.
+  bool Write(span<const uint8_t> record, TimeDelta timeout = TimeDelta::Max());
+
+  // Tells the reader that no more records will be written. It may still read
+  // the records which are already in the ring.
+  void Close();
+
+  // Returns true once either side closed the channel.
+  bool IsClosed() const;
+
+ private:
+  // Returns whether |size| bytes are free in the ring.
+  bool HasRoom(size_t size);
+
+  uint64_t write_position_ = 0;
+  // Last read position seen by the writer, which is updated only when the ring
+  // looks full, to avoid sharing the reader's cache line.
+  uint64_t cached_read_position_ = 0;
+  // Size of the record reserved by BeginWrite(), if any.
+  absl::optional<size_t> reserved_size_;
+  bool closed_ = false;
+};
+
+// The reading side of a SharedMemoryRingChannel. Must be used from one thread
+// at a time.
+class BASE_EXPORT SharedMemoryRingReader : public SharedMemoryRingChannel {
+ public:
+  explicit SharedMemoryRingReader(const UnsafeSharedMemoryRegion& region);
+  // Closes the channel.
+  ~SharedMemoryRingReader();
+
+  // Returns the next record, waiting up to |timeout| for the writer to write
+  // it. The record stays valid, and its room in the ring is not reused, until
+  // EndRead() is called. Returns nullopt on timeout, or once the channel is
+  // closed and all records were read.
+  absl::optional<span<const uint8_t>> BeginRead(
+      TimeDelta timeout = TimeDelta::Max());
+  // Releases the record returned by BeginRead().
+  void EndRead();
+
+  // Copies the next record to |record|. Returns false in the cases where
+  // BeginRead() returns nullopt.
+  bool Read(std::vector<uint8_t>* record,
+            TimeDelta timeout = TimeDelta::Max());
+
+  // Tells the writer that no more records will be read.
+  void Close();
+
+  // Returns true once the reader closed the channel, or once the writer closed
+  // it and all records were read.
+  bool IsClosed() const;
+
+ private:
+  // Returns how many bytes were written to the ring and not read yet.
+  size_t GetAvailableSize();
+
+  uint64_t read_position_ = 0;
+  // Last write position seen by the reader, which is updated only when the
+  // ring looks empty, to avoid sharing the writer's cache line.
+  uint64_t cached_write_position_ = 0;
+  // Size taken in the ring by the record returned by BeginRead(), if any.
+  absl::optional<size_t> pending_size_;
+  bool closed_ = false;
+};
+
+}  // namespace base
+
+#endif  // BASE_MEMORY_SHARED_MEMORY_RING_CHANNEL_H_
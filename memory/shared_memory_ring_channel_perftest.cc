@@ -0,0 +1,253 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/shared_memory_ring_channel.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "base/check_op.h"
+#include "base/files/scoped_file.h"
+#include "base/process/launch.h"
+#include "base/process/process.h"
+#include "base/strings/stringprintf.h"
+#include "base/sync_socket.h"
+#include "base/test/multiprocess_test.h"
+#include "base/test/test_timeouts.h"
+#include "base/timer/elapsed_timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/multiprocess_func_list.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace base {
+
+namespace {
+
+constexpr char kMetricPrefixChannel[] = "SharedMemoryRingChannel.";
+constexpr char kMetricThroughput[] = "throughput";
+constexpr char kMetricRoundTripTime[] = "round_trip_time";
+
+// Where the child finds its end of the socket connected to the parent.
+constexpr int kChildSocket = 20;
+
+constexpr size_t kCapacity = 1024 * 1024;
+constexpr size_t kThroughputBytes = 256 * 1024 * 1024;
+constexpr size_t kRoundTripCount = 10000;
+
+enum class Transport { kRing, kSyncSocket };
+
+// Sent to the SyncSocket children, which can't tell where records end.
+struct Config {
+  uint64_t record_size;
+  uint64_t record_count;
+};
+
+perf_test::PerfResultReporter SetUpReporter(const std::string& story_name) {
+  perf_test::PerfResultReporter reporter(kMetricPrefixChannel, story_name);
+  reporter.RegisterImportantMetric(kMetricThroughput, "bytesPerSecond");
+  reporter.RegisterImportantMetric(kMetricRoundTripTime, "us");
+  return reporter;
+}
+
+uint8_t Checksum(span<const uint8_t> record) {
+  uint8_t checksum = 0;
+  for (uint8_t byte : record) {
+    checksum += byte;
+  }
+  return checksum;
+}
+
+Config ReceiveConfig(SyncSocket& socket) {
+  Config config;
+  CHECK_EQ(sizeof(config), socket.Receive(&config, sizeof(config)));
+  return config;
+}
+
+}  // namespace
+
+// Reads records until the channel is closed, then acknowledges them on the
+// socket.
+MULTIPROCESS_TEST_MAIN(RingSinkChild) {
+  SyncSocket socket((ScopedFD(kChildSocket)));
+  SharedMemoryRingReader reader(
+      SharedMemoryRingChannel::ReceiveRegion(kChildSocket));
+  CHECK(reader.IsValid());
+  uint8_t checksum = 0;
+  while (absl::optional<span<const uint8_t>> record = reader.BeginRead()) {
+    checksum += Checksum(*record);
+    reader.EndRead();
+  }
+  CHECK_EQ(1u, socket.Send(&checksum, sizeof(checksum)));
+  return 0;
+}
+
+MULTIPROCESS_TEST_MAIN(SyncSocketSinkChild) {
+  SyncSocket socket((ScopedFD(kChildSocket)));
+  const Config config = ReceiveConfig(socket);
+  std::vector<uint8_t> record(config.record_size);
+  uint8_t checksum = 0;
+  for (uint64_t i = 0; i < config.record_count; ++i) {
+    CHECK_EQ(record.size(), socket.Receive(record.data(), record.size()));
+    checksum += Checksum(record);
+  }
+  CHECK_EQ(1u, socket.Send(&checksum, sizeof(checksum)));
+  return 0;
+}
+
+// Sends back each record it reads, until the channel is closed.
+MULTIPROCESS_TEST_MAIN(RingEchoChild) {
+  SharedMemoryRingReader reader(
+      SharedMemoryRingChannel::ReceiveRegion(kChildSocket));
+  SharedMemoryRingWriter writer(
+      SharedMemoryRingChannel::ReceiveRegion(kChildSocket));
+  CHECK(reader.IsValid() && writer.IsValid());
+  while (absl::optional<span<const uint8_t>> record = reader.BeginRead()) {
+    absl::optional<span<uint8_t>> reply = writer.BeginWrite(record->size());
+    CHECK(reply);
+    memcpy(reply->data(), record->data(), record->size());
+    writer.EndWrite(record->size());
+    reader.EndRead();
+  }
+  return 0;
+}
+
+MULTIPROCESS_TEST_MAIN(SyncSocketEchoChild) {
+  SyncSocket socket((ScopedFD(kChildSocket)));
+  const Config config = ReceiveConfig(socket);
+  std::vector<uint8_t> record(config.record_size);
+  for (uint64_t i = 0; i < config.record_count; ++i) {
+    CHECK_EQ(record.size(), socket.Receive(record.data(), record.size()));
+    CHECK_EQ(record.size(), socket.Send(record.data(), record.size()));
+  }
+  return 0;
+}
+
+class SharedMemoryRingChannelPerfTest
+    : public MultiProcessTest,
+      public testing::WithParamInterface<std::tuple<Transport, size_t>> {
+ protected:
+  Transport transport() const { return std::get<0>(GetParam()); }
+  size_t record_size() const { return std::get<1>(GetParam()); }
+
+  std::string GetStoryName() const {
+    return StringPrintf(
+        "%s_%zu", transport() == Transport::kRing ? "ring" : "sync_socket",
+        record_size());
+  }
+
+  // Spawns the child named |procname|, connected to |socket|.
+  Process SpawnConnectedChild(const std::string& procname,
+                              SyncSocket* socket) {
+    SyncSocket child_socket;
+    CHECK(SyncSocket::CreatePair(socket, &child_socket));
+    LaunchOptions options;
+    options.fds_to_remap.emplace_back(child_socket.handle(), kChildSocket);
+    return SpawnChildWithOptions(procname, options);
+  }
+
+  void WaitForChild(Process& child) {
+    int exit_code = -1;
+    EXPECT_TRUE(child.WaitForExitWithTimeout(TestTimeouts::action_max_timeout(),
+                                             &exit_code));
+    EXPECT_EQ(0, exit_code);
+  }
+};
+
+INSTANTIATE_TEST_SUITE_P(
+    All,
+    SharedMemoryRingChannelPerfTest,
+    ::testing::Combine(::testing::Values(Transport::kRing,
+                                         Transport::kSyncSocket),
+                       ::testing::Values<size_t>(64, 4096, 65536)));
+
+// Streams records to a child process, which reads them all.
+TEST_P(SharedMemoryRingChannelPerfTest, Throughput) {
+  const size_t record_count = kThroughputBytes / record_size();
+  SyncSocket socket;
+  Process child;
+  ElapsedTimer timer;
+  if (transport() == Transport::kRing) {
+    child = SpawnConnectedChild("RingSinkChild", &socket);
+    UnsafeSharedMemoryRegion region =
+        SharedMemoryRingChannel::CreateRegion(kCapacity);
+    SharedMemoryRingWriter writer(region);
+    ASSERT_TRUE(SharedMemoryRingChannel::SendRegion(socket.handle(),
+                                                    std::move(region)));
+    timer = ElapsedTimer();
+    for (size_t i = 0; i < record_count; ++i) {
+      absl::optional<span<uint8_t>> record = writer.BeginWrite(record_size());
+      ASSERT_TRUE(record);
+      memset(record->data(), static_cast<int>(i), record->size());
+      writer.EndWrite(record_size());
+    }
+  } else {
+    child = SpawnConnectedChild("SyncSocketSinkChild", &socket);
+    const Config config = {record_size(), record_count};
+    ASSERT_EQ(sizeof(config), socket.Send(&config, sizeof(config)));
+    std::vector<uint8_t> record(record_size());
+    timer = ElapsedTimer();
+    for (size_t i = 0; i < record_count; ++i) {
+      memset(record.data(), static_cast<int>(i), record.size());
+      ASSERT_EQ(record.size(), socket.Send(record.data(), record.size()));
+    }
+  }
+  // For the ring, the writer closed the channel when going out of scope.
+  uint8_t checksum;
+  ASSERT_EQ(1u, socket.Receive(&checksum, sizeof(checksum)));
+  const TimeDelta elapsed = timer.Elapsed();
+  WaitForChild(child);
+
+  auto reporter = SetUpReporter(GetStoryName());
+  reporter.AddResult(kMetricThroughput,
+                     record_count * record_size() / elapsed.InSecondsF());
+}
+
+// Sends records to a child process one at a time, waiting for the child to
+// send each of them back.
+TEST_P(SharedMemoryRingChannelPerfTest, RoundTrip) {
+  std::vector<uint8_t> record(record_size(), 'a');
+  SyncSocket socket;
+  Process child;
+  TimeDelta elapsed;
+  if (transport() == Transport::kRing) {
+    child = SpawnConnectedChild("RingEchoChild", &socket);
+    UnsafeSharedMemoryRegion request_region =
+        SharedMemoryRingChannel::CreateRegion(kCapacity);
+    UnsafeSharedMemoryRegion reply_region =
+        SharedMemoryRingChannel::CreateRegion(kCapacity);
+    SharedMemoryRingWriter writer(request_region);
+    SharedMemoryRingReader reader(reply_region);
+    ASSERT_TRUE(SharedMemoryRingChannel::SendRegion(socket.handle(),
+                                                    std::move(request_region)));
+    ASSERT_TRUE(SharedMemoryRingChannel::SendRegion(socket.handle(),
+                                                    std::move(reply_region)));
+    ElapsedTimer timer;
+    for (size_t i = 0; i < kRoundTripCount; ++i) {
+      ASSERT_TRUE(writer.Write(record));
+      ASSERT_TRUE(reader.Read(&record));
+    }
+    elapsed = timer.Elapsed();
+  } else {
+    child = SpawnConnectedChild("SyncSocketEchoChild", &socket);
+    const Config config = {record_size(), kRoundTripCount};
+    ASSERT_EQ(sizeof(config), socket.Send(&config, sizeof(config)));
+    ElapsedTimer timer;
+    for (size_t i = 0; i < kRoundTripCount; ++i) {
+      ASSERT_EQ(record.size(), socket.Send(record.data(), record.size()));
+      ASSERT_EQ(record.size(), socket.Receive(record.data(), record.size()));
+    }
+    elapsed = timer.Elapsed();
+  }
+  WaitForChild(child);
+
+  auto reporter = SetUpReporter(GetStoryName());
+  reporter.AddResult(kMetricRoundTripTime,
+                     elapsed.InMicrosecondsF() / kRoundTripCount);
+}
+
+}  // namespace base
@@ -0,0 +1,200 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/shared_memory_ring_channel.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "base/files/scoped_file.h"
+#include "base/posix/unix_domain_socket.h"
+#include "base/test/bind.h"
+#include "base/threading/thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+constexpr size_t kCapacity = 4096;
+
+std::vector<uint8_t> MakeRecord(size_t size, uint8_t seed) {
+  std::vector<uint8_t> record(size);
+  for (size_t i = 0; i < size; ++i) {
+    record[i] = static_cast<uint8_t>(seed + i);
+  }
+  return record;
+}
+
+}  // namespace
+
+class SharedMemoryRingChannelTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    region_ = SharedMemoryRingChannel::CreateRegion(kCapacity);
+    ASSERT_TRUE(region_.IsValid());
+    writer_.emplace(region_);
+    reader_.emplace(region_);
+    ASSERT_TRUE(writer_->IsValid());
+    ASSERT_TRUE(reader_->IsValid());
+  }
+
+  UnsafeSharedMemoryRegion region_;
+  absl::optional<SharedMemoryRingWriter> writer_;
+  absl::optional<SharedMemoryRingReader> reader_;
+};
+
+TEST_F(SharedMemoryRingChannelTest, WriteAndRead) {
+  EXPECT_EQ(kCapacity, writer_->capacity());
+  for (size_t size : {0, 1, 7, 8, 100}) {
+    ASSERT_TRUE(writer_->Write(MakeRecord(size, size)));
+  }
+  for (size_t size : {0, 1, 7, 8, 100}) {
+    std::vector<uint8_t> record;
+    ASSERT_TRUE(reader_->Read(&record, TimeDelta()));
+    EXPECT_EQ(MakeRecord(size, size), record);
+  }
+  std::vector<uint8_t> record;
+  EXPECT_FALSE(reader_->Read(&record, TimeDelta()));
+  EXPECT_FALSE(reader_->IsClosed());
+}
+
+TEST_F(SharedMemoryRingChannelTest, WritesInPlace) {
+  absl::optional<span<uint8_t>> buffer = writer_->BeginWrite(100);
+  ASSERT_TRUE(buffer);
+  ASSERT_EQ(100u, buffer->size());
+  memset(buffer->data(), 'a', buffer->size());
+
+  // The record isn't visible until it is published.
+  EXPECT_FALSE(reader_->BeginRead(TimeDelta()));
+  writer_->EndWrite(10);
+
+  absl::optional<span<const uint8_t>> record = reader_->BeginRead(TimeDelta());
+  ASSERT_TRUE(record);
+  EXPECT_EQ(std::vector<uint8_t>(10, 'a'),
+            std::vector<uint8_t>(record->begin(), record->end()));
+  reader_->EndRead();
+  EXPECT_FALSE(reader_->BeginRead(TimeDelta()));
+}
+
+TEST_F(SharedMemoryRingChannelTest, WrapsAround) {
+  // Sizes which don't divide the capacity, so that records regularly don't fit
+  // at the end of the ring.
+  for (size_t i = 0; i < 100; ++i) {
+    const size_t size = 1 + (i * 397) % writer_->max_record_size();
+    ASSERT_TRUE(writer_->Write(MakeRecord(size, i), TimeDelta()));
+    std::vector<uint8_t> record;
+    ASSERT_TRUE(reader_->Read(&record, TimeDelta()));
+    EXPECT_EQ(MakeRecord(size, i), record);
+  }
+}
+
+TEST_F(SharedMemoryRingChannelTest, FullRing) {
+  const std::vector<uint8_t> record = MakeRecord(1000, 0);
+  size_t count = 0;
+  while (writer_->Write(record, TimeDelta())) {
+    ++count;
+  }
+  EXPECT_EQ(kCapacity / 1008, count);
+  EXPECT_FALSE(writer_->IsClosed());
+
+  std::vector<uint8_t> read_record;
+  ASSERT_TRUE(reader_->Read(&read_record, TimeDelta()));
+  EXPECT_TRUE(writer_->Write(record, TimeDelta()));
+}
+
+TEST_F(SharedMemoryRingChannelTest, RejectsLargeRecords) {
+  EXPECT_TRUE(writer_->BeginWrite(writer_->max_record_size(), TimeDelta()));
+  writer_->EndWrite(0);
+  EXPECT_FALSE(writer_->BeginWrite(writer_->max_record_size() + 1));
+}
+
+TEST_F(SharedMemoryRingChannelTest, WriterClose) {
+  ASSERT_TRUE(writer_->Write(MakeRecord(10, 0)));
+  writer_->Close();
+  EXPECT_FALSE(writer_->Write(MakeRecord(10, 0)));
+
+  // Records written before closing can still be read.
+  EXPECT_FALSE(reader_->IsClosed());
+  std::vector<uint8_t> record;
+  EXPECT_TRUE(reader_->Read(&record));
+  EXPECT_TRUE(reader_->IsClosed());
+  EXPECT_FALSE(reader_->Read(&record));
+}
+
+TEST_F(SharedMemoryRingChannelTest, ReaderClose) {
+  reader_->Close();
+  EXPECT_TRUE(writer_->IsClosed());
+  EXPECT_FALSE(writer_->Write(MakeRecord(10, 0)));
+}
+
+TEST_F(SharedMemoryRingChannelTest, WakesUpPeer) {
+  // Many more records than fit in the ring, so that both sides wait for each
+  // other.
+  constexpr size_t kRecordCount = 10000;
+  Thread thread("Writer");
+  ASSERT_TRUE(thread.Start());
+  thread.task_runner()->PostTask(
+      FROM_HERE, BindLambdaForTesting([&] {
+        for (size_t i = 0; i < kRecordCount; ++i) {
+          ASSERT_TRUE(writer_->Write(MakeRecord(i % 500, i)));
+        }
+        writer_->Close();
+      }));
+
+  std::vector<uint8_t> record;
+  for (size_t i = 0; i < kRecordCount; ++i) {
+    ASSERT_TRUE(reader_->Read(&record));
+    ASSERT_EQ(MakeRecord(i % 500, i), record);
+  }
+  EXPECT_FALSE(reader_->Read(&record));
+  EXPECT_TRUE(reader_->IsClosed());
+  thread.Stop();
+}
+
+TEST_F(SharedMemoryRingChannelTest, ClosesCorruptedChannel) {
+  // The write position is at the start of the region.
+  WritableSharedMemoryMapping mapping = region_.Map();
+  ASSERT_TRUE(mapping.IsValid());
+  const uint64_t write_position = kCapacity * 2;
+  memcpy(mapping.memory(), &write_position, sizeof(write_position));
+
+  EXPECT_FALSE(reader_->BeginRead(TimeDelta()));
+  EXPECT_TRUE(reader_->IsClosed());
+  EXPECT_TRUE(writer_->IsClosed());
+}
+
+TEST(SharedMemoryRingChannelRegionTest, RejectsInvalidRegions) {
+  EXPECT_FALSE(SharedMemoryRingWriter(UnsafeSharedMemoryRegion()).IsValid());
+  UnsafeSharedMemoryRegion region = UnsafeSharedMemoryRegion::Create(5000);
+  ASSERT_TRUE(region.IsValid());
+  EXPECT_FALSE(SharedMemoryRingReader(region).IsValid());
+}
+
+TEST(SharedMemoryRingChannelRegionTest, SendsRegion) {
+  ScopedFD send_socket;
+  ScopedFD receive_socket;
+  ASSERT_TRUE(CreateSocketPair(&send_socket, &receive_socket));
+
+  UnsafeSharedMemoryRegion region =
+      SharedMemoryRingChannel::CreateRegion(kCapacity);
+  SharedMemoryRingWriter writer(region);
+  ASSERT_TRUE(SharedMemoryRingChannel::SendRegion(send_socket.get(),
+                                                  std::move(region)));
+
+  UnsafeSharedMemoryRegion received_region =
+      SharedMemoryRingChannel::ReceiveRegion(receive_socket.get());
+  ASSERT_TRUE(received_region.IsValid());
+  SharedMemoryRingReader reader(received_region);
+  ASSERT_TRUE(reader.IsValid());
+
+  ASSERT_TRUE(writer.Write(MakeRecord(42, 1)));
+  std::vector<uint8_t> record;
+  ASSERT_TRUE(reader.Read(&record, TimeDelta()));
+  EXPECT_EQ(MakeRecord(42, 1), record);
+}
+
+}  // namespace base
@@ -4,15 +4,52 @@
 
 #include "base/memory/unsafe_shared_memory_pool.h"
 
+#include <algorithm>
+
+#include "base/bits.h"
+#include "base/functional/bind.h"
+#include "base/functional/callback_helpers.h"
 #include "base/logging.h"
+#include "base/memory/page_size.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
 
 namespace {
-constexpr size_t kMaxStoredBuffers = 32;
+// Number of size classes between two consecutive powers of two.
+constexpr size_t kSizeClassesPerPowerOfTwo = 4;
 }  // namespace
 
 namespace base {
 
-UnsafeSharedMemoryPool::UnsafeSharedMemoryPool() = default;
+UnsafeSharedMemoryPool::IdleRegion::IdleRegion(
+    UnsafeSharedMemoryRegion region,
+    WritableSharedMemoryMapping mapping,
+    TimeTicks release_time)
+    : region(std::move(region)),
+      mapping(std::move(mapping)),
+      release_time(release_time) {}
+
+UnsafeSharedMemoryPool::IdleRegion::IdleRegion(IdleRegion&&) = default;
+
+UnsafeSharedMemoryPool::IdleRegion&
+UnsafeSharedMemoryPool::IdleRegion::operator=(IdleRegion&&) = default;
+
+UnsafeSharedMemoryPool::IdleRegion::~IdleRegion() = default;
+
+UnsafeSharedMemoryPool::UnsafeSharedMemoryPool()
+    : UnsafeSharedMemoryPool(Options()) {}
+
+UnsafeSharedMemoryPool::UnsafeSharedMemoryPool(const Options& options)
+    : options_(options),
+      task_runner_(SequencedTaskRunner::HasCurrentDefault()
+                       ? SequencedTaskRunner::GetCurrentDefault()
+                       : nullptr),
+      // Trimming is thread-safe, so it is done synchronously on the thread
+      // notifying memory pressure, which doesn't require a task runner.
+      memory_pressure_listener_(
+          FROM_HERE,
+          DoNothing(),
+          BindRepeating(&UnsafeSharedMemoryPool::OnMemoryPressure,
+                        Unretained(this))) {}
 
 UnsafeSharedMemoryPool::~UnsafeSharedMemoryPool() = default;
 
@@ -43,31 +80,49 @@ const WritableSharedMemoryMapping& UnsafeSharedMemoryPool::Handle::GetMapping()
   return mapping_;
 }
 
-std::unique_ptr<UnsafeSharedMemoryPool::Handle>
-UnsafeSharedMemoryPool::MaybeAllocateBuffer(size_t region_size) {
-  AutoLock lock(lock_);
+// static
+size_t UnsafeSharedMemoryPool::GetSizeClass(size_t size) {
+  const size_t page_size = GetPageSize();
+  if (size <= page_size) {
+    return size ? page_size : 0;
+  }
+  // |size| is in (2^n, 2^(n+1)]: round it up to a multiple of 2^n / 4.
+  const int n = static_cast<int>(sizeof(size_t) * 8) - 1 -
+                bits::CountLeadingZeroBits(size - 1);
+  const size_t step = (size_t{1} << n) / kSizeClassesPerPowerOfTwo;
+  return bits::AlignUp(bits::AlignUp(size, step), page_size);
+}
 
-  DCHECK_GE(region_size, 0u);
-  if (is_shutdown_)
+std::unique_ptr<UnsafeSharedMemoryPool::Handle>
+UnsafeSharedMemoryPool::MaybeAllocateBuffer(size_t size) {
+  const size_t region_size = GetSizeClass(size);
+  if (!region_size) {
     return nullptr;
-
-  // Only change the configured size if bigger region is requested to avoid
-  // unncecessary reallocations.
-  if (region_size > region_size_) {
-    regions_.clear();
-    region_size_ = region_size;
   }
-  if (!regions_.empty()) {
-    auto region = std::move(regions_.back());
-    regions_.pop_back();
-    DCHECK_GE(region.first.GetSize(), region_size_);
-    auto handle = std::make_unique<Handle>(PassKey<UnsafeSharedMemoryPool>(),
-                                           std::move(region.first),
-                                           std::move(region.second), this);
-    return handle;
+
+  {
+    AutoLock lock(lock_);
+    if (is_shutdown_) {
+      return nullptr;
+    }
+    auto it = idle_regions_.find(region_size);
+    if (it != idle_regions_.end() && !it->second.empty()) {
+      // Reuse the most recently used region, whose pages are the most likely
+      // to still be resident.
+      IdleRegion idle_region = std::move(it->second.back());
+      it->second.pop_back();
+      ++stats_.hit_count;
+      --stats_.idle_region_count;
+      stats_.idle_bytes -= region_size;
+      return std::make_unique<Handle>(PassKey<UnsafeSharedMemoryPool>(),
+                                      std::move(idle_region.region),
+                                      std::move(idle_region.mapping), this);
+    }
+    ++stats_.miss_count;
   }
 
-  auto region = UnsafeSharedMemoryRegion::Create(region_size_);
+  // Creating the region doesn't need the lock.
+  auto region = UnsafeSharedMemoryRegion::Create(region_size);
   if (!region.IsValid())
     return nullptr;
 
@@ -83,25 +138,125 @@ void UnsafeSharedMemoryPool::Shutdown() {
   AutoLock lock(lock_);
   DCHECK(!is_shutdown_);
   is_shutdown_ = true;
-  regions_.clear();
+  TrimLocked(0);
+}
+
+UnsafeSharedMemoryPool::Stats UnsafeSharedMemoryPool::GetStats() const {
+  AutoLock lock(lock_);
+  return stats_;
 }
 
 void UnsafeSharedMemoryPool::ReleaseBuffer(
     UnsafeSharedMemoryRegion region,
     WritableSharedMemoryMapping mapping) {
+  absl::optional<TimeDelta> trim_delay;
+  {
+    AutoLock lock(lock_);
+    const size_t region_size = region.GetSize();
+    // Only keep regions which fit in the budget of their size class.
+    if (is_shutdown_ || !region.IsValid() ||
+        GetSizeClass(region_size) != region_size ||
+        options_.max_idle_regions_per_class == 0 ||
+        region_size > options_.max_idle_bytes_per_class) {
+      DLOG_IF(WARNING, !is_shutdown_)
+          << "Not returning SharedMemoryRegion to the pool:"
+          << " this region size: " << region_size
+          << " valid: " << (region.IsValid() ? "true" : "false");
+      return;
+    }
+
+    std::vector<IdleRegion>& regions = idle_regions_[region_size];
+    // Make room for the region, evicting the least recently used ones.
+    const size_t max_count =
+        std::min(options_.max_idle_regions_per_class,
+                 options_.max_idle_bytes_per_class / region_size);
+    if (regions.size() >= max_count) {
+      const size_t evicted_count = regions.size() - max_count + 1;
+      regions.erase(regions.begin(), regions.begin() + evicted_count);
+      stats_.trimmed_count += evicted_count;
+      stats_.idle_region_count -= evicted_count;
+      stats_.idle_bytes -= evicted_count * region_size;
+    }
+    regions.emplace_back(std::move(region), std::move(mapping),
+                         TimeTicks::Now());
+    ++stats_.idle_region_count;
+    stats_.idle_bytes += region_size;
+
+    if (task_runner_ && !options_.idle_timeout.is_zero() && !trim_scheduled_) {
+      trim_scheduled_ = true;
+      trim_delay = options_.idle_timeout;
+    }
+  }
+  if (trim_delay) {
+    PostTrimIdleRegions(*trim_delay);
+  }
+}
+
+void UnsafeSharedMemoryPool::TrimLocked(double fraction) {
+  for (auto& [region_size, regions] : idle_regions_) {
+    const size_t kept_count = static_cast<size_t>(regions.size() * fraction);
+    const size_t trimmed_count = regions.size() - kept_count;
+    regions.erase(regions.begin(), regions.begin() + trimmed_count);
+    stats_.trimmed_count += trimmed_count;
+    stats_.idle_region_count -= trimmed_count;
+    stats_.idle_bytes -= trimmed_count * region_size;
+  }
+}
+
+void UnsafeSharedMemoryPool::TrimIdleRegions() {
+  absl::optional<TimeDelta> trim_delay;
+  {
+    AutoLock lock(lock_);
+    const TimeTicks now = TimeTicks::Now();
+    TimeTicks oldest_release_time = TimeTicks::Max();
+    for (auto& [region_size, regions] : idle_regions_) {
+      auto first_kept = std::find_if(
+          regions.begin(), regions.end(), [&](const IdleRegion& idle_region) {
+            return now - idle_region.release_time < options_.idle_timeout;
+          });
+      const size_t trimmed_count =
+          static_cast<size_t>(first_kept - regions.begin());
+      regions.erase(regions.begin(), first_kept);
+      stats_.trimmed_count += trimmed_count;
+      stats_.idle_region_count -= trimmed_count;
+      stats_.idle_bytes -= trimmed_count * region_size;
+      if (!regions.empty()) {
+        oldest_release_time =
+            std::min(oldest_release_time, regions.front().release_time);
+      }
+    }
+    trim_scheduled_ = !oldest_release_time.is_max();
+    if (trim_scheduled_) {
+      trim_delay = oldest_release_time + options_.idle_timeout - now;
+    }
+  }
+  if (trim_delay) {
+    PostTrimIdleRegions(*trim_delay);
+  }
+}
+
+void UnsafeSharedMemoryPool::PostTrimIdleRegions(TimeDelta delay) {
+  // The task keeps the pool alive until it runs, which is at most
+  // |Options::idle_timeout| after the last region was released.
+  task_runner_->PostDelayedTask(
+      FROM_HERE,
+      BindOnce(&UnsafeSharedMemoryPool::TrimIdleRegions, WrapRefCounted(this)),
+      delay);
+}
+
+void UnsafeSharedMemoryPool::OnMemoryPressure(
+    MemoryPressureListener::MemoryPressureLevel memory_pressure_level) {
   AutoLock lock(lock_);
-  // Only return regions which are at least as big as the current configuration.
-  if (is_shutdown_ || regions_.size() >= kMaxStoredBuffers ||
-      !region.IsValid() || region.GetSize() < region_size_) {
-    DLOG(WARNING) << "Not returning SharedMemoryRegion to the pool:"
-                  << " is_shutdown: " << (is_shutdown_ ? "true" : "false")
-                  << " stored regions: " << regions_.size()
-                  << " configured size: " << region_size_
-                  << " this region size: " << region.GetSize()
-                  << " valid: " << (region.IsValid() ? "true" : "false");
-    return;
+  switch (memory_pressure_level) {
+    case MemoryPressureListener::MEMORY_PRESSURE_LEVEL_NONE:
+      break;
+    case MemoryPressureListener::MEMORY_PRESSURE_LEVEL_MODERATE:
+      TrimLocked(0.5);
+      break;
+    case MemoryPressureListener::MEMORY_PRESSURE_LEVEL_CRITICAL:
+      TrimLocked(0);
+      break;
   }
-  regions_.emplace_back(std::move(region), std::move(mapping));
 }
 
 }  // namespace base
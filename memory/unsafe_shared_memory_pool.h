@@ -5,24 +5,38 @@
 #ifndef BASE_MEMORY_UNSAFE_SHARED_MEMORY_POOL_H_
 #define BASE_MEMORY_UNSAFE_SHARED_MEMORY_POOL_H_
 
+#include <stddef.h>
+
 #include <memory>
 #include <utility>
 #include <vector>
 
 #include "base/base_export.h"
+#include "base/containers/flat_map.h"
+#include "base/memory/memory_pressure_listener.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/unsafe_shared_memory_region.h"
 #include "base/synchronization/lock.h"
+#include "base/task/sequenced_task_runner.h"
+#include "base/thread_annotations.h"
+#include "base/time/time.h"
 #include "base/types/pass_key.h"
 
 namespace base {
 
 // UnsafeSharedMemoryPool manages allocation and pooling of
 // UnsafeSharedMemoryRegions. Using pool saves cost of repeated shared memory
-// allocations. Up-to 32 regions would be pooled. It is thread-safe. May return
-// bigger regions than requested. If a requested size is increased, all stored
-// regions are purged. Regions are returned to the buffer on destruction of
-// |SharedMemoryHandle| if they are of a correct size.
+// allocations. It is thread-safe.
+//
+// Requested sizes are rounded up to a size class (see GetSizeClass()), so it
+// may return bigger regions than requested, and regions are pooled separately
+// for each size class: alternating between sizes reuses regions of each of
+// them. Regions are returned to the pool on destruction of their |Handle|.
+//
+// Unused regions are freed, least recently used first, when a size class goes
+// over its budget, on memory pressure, and once they have been unused for
+// |Options::idle_timeout| (only if the pool was created on a sequence, which
+// runs the trimming).
 class BASE_EXPORT UnsafeSharedMemoryPool
     : public RefCountedThreadSafe<UnsafeSharedMemoryPool> {
  public:
@@ -50,11 +64,37 @@ class BASE_EXPORT UnsafeSharedMemoryPool
     scoped_refptr<UnsafeSharedMemoryPool> pool_;
   };
 
+  struct Options {
+    // Maximum number of unused regions kept for each size class.
+    size_t max_idle_regions_per_class = 32;
+    // Maximum total size of the unused regions kept for each size class.
+    size_t max_idle_bytes_per_class = 128 * 1024 * 1024;
+    // Unused regions are freed after this long. Zero disables the timeout.
+    TimeDelta idle_timeout = Seconds(10);
+  };
+
+  // Counts of allocations served by a pooled region (hits) or by a new one
+  // (misses), of unused regions freed by the pool, and the unused regions
+  // currently kept.
+  struct Stats {
+    size_t hit_count = 0;
+    size_t miss_count = 0;
+    size_t trimmed_count = 0;
+    size_t idle_region_count = 0;
+    size_t idle_bytes = 0;
+  };
+
   UnsafeSharedMemoryPool();
+  explicit UnsafeSharedMemoryPool(const Options& options);
   // Disallow copy and assign.
   UnsafeSharedMemoryPool(const UnsafeSharedMemoryPool&) = delete;
   UnsafeSharedMemoryPool& operator=(const UnsafeSharedMemoryPool&) = delete;
 
+  // Returns the size of the regions allocated for a request of |size| bytes:
+  // |size| rounded up to the page size, then to one of four sizes between
+  // consecutive powers of two, which wastes less than 25% of the region.
+  static size_t GetSizeClass(size_t size);
+
   // Allocates a region of the given |size| or reuses a previous allocation if
   // possible.
   std::unique_ptr<Handle> MaybeAllocateBuffer(size_t size);
@@ -63,21 +103,53 @@ class BASE_EXPORT UnsafeSharedMemoryPool
   // outstanding ones as they are returned.
   void Shutdown();
 
+  Stats GetStats() const;
+
  private:
   friend class RefCountedThreadSafe<UnsafeSharedMemoryPool>;
+
+  struct IdleRegion {
+    IdleRegion(UnsafeSharedMemoryRegion region,
+               WritableSharedMemoryMapping mapping,
+               TimeTicks release_time);
+    IdleRegion(IdleRegion&&);
+    IdleRegion& operator=(IdleRegion&&);
+    ~IdleRegion();
+
+    UnsafeSharedMemoryRegion region;
+    WritableSharedMemoryMapping mapping;
+    TimeTicks release_time;
+  };
+
   ~UnsafeSharedMemoryPool();
 
   void ReleaseBuffer(UnsafeSharedMemoryRegion region,
                      WritableSharedMemoryMapping mapping);
 
-  Lock lock_;
-  // All shared memory regions cached internally are guaranteed to be
-  // at least `region_size_` bytes in size.
-  size_t region_size_ GUARDED_BY(lock_) = 0u;
-  // Cached unused regions and their mappings.
-  std::vector<std::pair<UnsafeSharedMemoryRegion, WritableSharedMemoryMapping>>
-      regions_ GUARDED_BY(lock_);
+  // Frees the least recently used regions of each size class, so that at most
+  // |fraction| of them are kept.
+  void TrimLocked(double fraction) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  // Frees the regions which have been unused for |Options::idle_timeout|.
+  void TrimIdleRegions();
+  void PostTrimIdleRegions(TimeDelta delay);
+
+  void OnMemoryPressure(
+      MemoryPressureListener::MemoryPressureLevel memory_pressure_level);
+
+  const Options options_;
+  // Runs TrimIdleRegions(). Null if the pool wasn't created on a sequence.
+  const scoped_refptr<SequencedTaskRunner> task_runner_;
+
+  mutable Lock lock_;
+  // Cached unused regions and their mappings for each size class, least
+  // recently used first.
+  flat_map<size_t, std::vector<IdleRegion>> idle_regions_ GUARDED_BY(lock_);
+  Stats stats_ GUARDED_BY(lock_);
+  // Whether TrimIdleRegions() is posted.
+  bool trim_scheduled_ GUARDED_BY(lock_) = false;
   bool is_shutdown_ GUARDED_BY(lock_) = false;
+
+  MemoryPressureListener memory_pressure_listener_;
 };
 
 }  // namespace base
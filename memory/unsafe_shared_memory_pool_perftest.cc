@@ -0,0 +1,108 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/unsafe_shared_memory_pool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/memory/page_size.h"
+#include "base/memory/shared_memory_mapping.h"
+#include "base/memory/unsafe_shared_memory_region.h"
+#include "base/timer/lap_timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace base {
+
+namespace {
+
+constexpr char kMetricPrefixPool[] = "UnsafeSharedMemoryPool.";
+constexpr char kMetricAllocationTime[] = "allocation_time";
+constexpr char kMetricHitRate[] = "hit_rate";
+
+// Sizes of I420 frames of a few resolutions, as a video pipeline switching
+// between streams would allocate.
+constexpr size_t kFrameSizes[] = {640 * 360 * 3 / 2, 1280 * 720 * 3 / 2,
+                                  1920 * 1080 * 3 / 2, 1280 * 720 * 3 / 2};
+// Number of frames in use at any time.
+constexpr size_t kFramesInFlight = 4;
+
+perf_test::PerfResultReporter SetUpReporter(const std::string& story_name) {
+  perf_test::PerfResultReporter reporter(kMetricPrefixPool, story_name);
+  reporter.RegisterImportantMetric(kMetricAllocationTime, "ns");
+  reporter.RegisterImportantMetric(kMetricHitRate, "%");
+  return reporter;
+}
+
+// Writes to each page of |mapping|, as filling a frame would.
+void TouchPages(const WritableSharedMemoryMapping& mapping) {
+  uint8_t* memory = static_cast<uint8_t*>(mapping.memory());
+  for (size_t offset = 0; offset < mapping.size(); offset += GetPageSize()) {
+    memory[offset] = 1;
+  }
+}
+
+}  // namespace
+
+// Allocates frames of mixed sizes from the pool, releasing each one after the
+// next few are allocated.
+TEST(UnsafeSharedMemoryPoolPerfTest, MixedSizes) {
+  auto pool = MakeRefCounted<UnsafeSharedMemoryPool>();
+  std::vector<std::unique_ptr<UnsafeSharedMemoryPool::Handle>> frames(
+      kFramesInFlight);
+
+  LapTimer timer;
+  size_t i = 0;
+  timer.Start();
+  do {
+    auto frame =
+        pool->MaybeAllocateBuffer(kFrameSizes[i % std::size(kFrameSizes)]);
+    ASSERT_TRUE(frame);
+    TouchPages(frame->GetMapping());
+    frames[i % kFramesInFlight] = std::move(frame);
+    ++i;
+    timer.NextLap();
+  } while (!timer.HasTimeLimitExpired());
+
+  const UnsafeSharedMemoryPool::Stats stats = pool->GetStats();
+  auto reporter = SetUpReporter("pooled");
+  reporter.AddResult(kMetricAllocationTime,
+                     timer.TimePerLap().InMicrosecondsF() * 1000);
+  reporter.AddResult(kMetricHitRate, 100.0 * stats.hit_count /
+                                         (stats.hit_count + stats.miss_count));
+}
+
+// Same workload, creating and mapping a new region for each frame.
+TEST(UnsafeSharedMemoryPoolPerfTest, MixedSizesUnpooled) {
+  std::vector<std::pair<UnsafeSharedMemoryRegion, WritableSharedMemoryMapping>>
+      frames(kFramesInFlight);
+
+  LapTimer timer;
+  size_t i = 0;
+  timer.Start();
+  do {
+    auto region = UnsafeSharedMemoryRegion::Create(
+        kFrameSizes[i % std::size(kFrameSizes)]);
+    ASSERT_TRUE(region.IsValid());
+    WritableSharedMemoryMapping mapping = region.Map();
+    ASSERT_TRUE(mapping.IsValid());
+    TouchPages(mapping);
+    frames[i % kFramesInFlight] = {std::move(region), std::move(mapping)};
+    ++i;
+    timer.NextLap();
+  } while (!timer.HasTimeLimitExpired());
+
+  auto reporter = SetUpReporter("unpooled");
+  reporter.AddResult(kMetricAllocationTime,
+                     timer.TimePerLap().InMicrosecondsF() * 1000);
+}
+
+}  // namespace base
@@ -4,6 +4,12 @@
 
 #include "base/memory/unsafe_shared_memory_pool.h"
 
+#include <memory>
+#include <vector>
+
+#include "base/memory/memory_pressure_listener.h"
+#include "base/memory/page_size.h"
+#include "base/test/task_environment.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace base {
@@ -47,4 +53,134 @@ TEST(UnsafeSharedMemoryPoolTest, RespectsSize) {
   ASSERT_TRUE(handle);
   EXPECT_GE(handle->GetRegion().GetSize(), 1100u);
 }
+
+TEST(UnsafeSharedMemoryPoolTest, SizeClasses) {
+  const size_t page_size = GetPageSize();
+  EXPECT_EQ(0u, UnsafeSharedMemoryPool::GetSizeClass(0));
+  EXPECT_EQ(page_size, UnsafeSharedMemoryPool::GetSizeClass(1));
+  EXPECT_EQ(page_size, UnsafeSharedMemoryPool::GetSizeClass(page_size));
+  EXPECT_EQ(1u << 20, UnsafeSharedMemoryPool::GetSizeClass(1u << 20));
+  EXPECT_EQ(5u << 18, UnsafeSharedMemoryPool::GetSizeClass((1u << 20) + 1));
+  for (size_t size = 1; size < (64u << 20); size = size * 3 / 2 + 1) {
+    const size_t size_class = UnsafeSharedMemoryPool::GetSizeClass(size);
+    EXPECT_GE(size_class, size);
+    EXPECT_EQ(0u, size_class % page_size);
+    EXPECT_LE(size_class, size + size / 4 + page_size);
+    EXPECT_EQ(size_class, UnsafeSharedMemoryPool::GetSizeClass(size_class));
+  }
+}
+
+TEST(UnsafeSharedMemoryPoolTest, ReusesRegionsOfAlternatingSizes) {
+  scoped_refptr<UnsafeSharedMemoryPool> pool(
+      base::MakeRefCounted<UnsafeSharedMemoryPool>());
+  auto small_handle = pool->MaybeAllocateBuffer(100000u);
+  auto large_handle = pool->MaybeAllocateBuffer(1000000u);
+  ASSERT_TRUE(small_handle);
+  ASSERT_TRUE(large_handle);
+  const auto small_id = small_handle->GetRegion().GetGUID();
+  const auto large_id = large_handle->GetRegion().GetGUID();
+  small_handle.reset();
+  large_handle.reset();
+
+  for (int i = 0; i < 3; ++i) {
+    small_handle = pool->MaybeAllocateBuffer(100000u);
+    EXPECT_EQ(small_id, small_handle->GetRegion().GetGUID());
+    small_handle.reset();
+    large_handle = pool->MaybeAllocateBuffer(1000000u);
+    EXPECT_EQ(large_id, large_handle->GetRegion().GetGUID());
+    large_handle.reset();
+  }
+
+  const UnsafeSharedMemoryPool::Stats stats = pool->GetStats();
+  EXPECT_EQ(6u, stats.hit_count);
+  EXPECT_EQ(2u, stats.miss_count);
+  EXPECT_EQ(2u, stats.idle_region_count);
+  EXPECT_EQ(UnsafeSharedMemoryPool::GetSizeClass(100000u) +
+                UnsafeSharedMemoryPool::GetSizeClass(1000000u),
+            stats.idle_bytes);
+}
+
+TEST(UnsafeSharedMemoryPoolTest, RespectsBudget) {
+  UnsafeSharedMemoryPool::Options options;
+  options.max_idle_regions_per_class = 3;
+  options.max_idle_bytes_per_class = 2 * GetPageSize();
+  scoped_refptr<UnsafeSharedMemoryPool> pool(
+      base::MakeRefCounted<UnsafeSharedMemoryPool>(options));
+
+  std::vector<std::unique_ptr<UnsafeSharedMemoryPool::Handle>> handles;
+  for (int i = 0; i < 4; ++i) {
+    handles.push_back(pool->MaybeAllocateBuffer(1));
+  }
+  // The most recently released regions are kept.
+  const auto kept_id = handles.back()->GetRegion().GetGUID();
+  for (auto& handle : handles) {
+    handle.reset();
+  }
+  UnsafeSharedMemoryPool::Stats stats = pool->GetStats();
+  EXPECT_EQ(2u, stats.idle_region_count);
+  EXPECT_EQ(2u, stats.trimmed_count);
+  EXPECT_EQ(kept_id, pool->MaybeAllocateBuffer(1)->GetRegion().GetGUID());
+
+  // Regions larger than the budget aren't kept at all.
+  pool->MaybeAllocateBuffer(3 * GetPageSize()).reset();
+  stats = pool->GetStats();
+  EXPECT_EQ(2u, stats.idle_region_count);
+  EXPECT_EQ(2 * GetPageSize(), stats.idle_bytes);
+}
+
+TEST(UnsafeSharedMemoryPoolTest, TrimsOnMemoryPressure) {
+  scoped_refptr<UnsafeSharedMemoryPool> pool(
+      base::MakeRefCounted<UnsafeSharedMemoryPool>());
+  std::vector<std::unique_ptr<UnsafeSharedMemoryPool::Handle>> handles;
+  for (int i = 0; i < 4; ++i) {
+    handles.push_back(pool->MaybeAllocateBuffer(1000u));
+  }
+  handles.clear();
+  EXPECT_EQ(4u, pool->GetStats().idle_region_count);
+
+  MemoryPressureListener::SimulatePressureNotification(
+      MemoryPressureListener::MEMORY_PRESSURE_LEVEL_MODERATE);
+  EXPECT_EQ(2u, pool->GetStats().idle_region_count);
+
+  MemoryPressureListener::SimulatePressureNotification(
+      MemoryPressureListener::MEMORY_PRESSURE_LEVEL_CRITICAL);
+  EXPECT_EQ(0u, pool->GetStats().idle_region_count);
+  EXPECT_EQ(4u, pool->GetStats().trimmed_count);
+}
+
+TEST(UnsafeSharedMemoryPoolTest, TrimsIdleRegions) {
+  test::TaskEnvironment task_environment(
+      test::TaskEnvironment::TimeSource::MOCK_TIME);
+  const TimeDelta idle_timeout = UnsafeSharedMemoryPool::Options().idle_timeout;
+  scoped_refptr<UnsafeSharedMemoryPool> pool(
+      base::MakeRefCounted<UnsafeSharedMemoryPool>());
+
+  pool->MaybeAllocateBuffer(1000u).reset();
+  task_environment.FastForwardBy(idle_timeout / 2);
+  pool->MaybeAllocateBuffer(100000u).reset();
+  EXPECT_EQ(2u, pool->GetStats().idle_region_count);
+
+  task_environment.FastForwardBy(idle_timeout / 2);
+  EXPECT_EQ(1u, pool->GetStats().idle_region_count);
+
+  task_environment.FastForwardBy(idle_timeout / 2);
+  EXPECT_EQ(0u, pool->GetStats().idle_region_count);
+  EXPECT_EQ(0u, task_environment.GetPendingMainThreadTaskCount());
+}
+
+TEST(UnsafeSharedMemoryPoolTest, ShutdownFreesRegions) {
+  scoped_refptr<UnsafeSharedMemoryPool> pool(
+      base::MakeRefCounted<UnsafeSharedMemoryPool>());
+  auto handle = pool->MaybeAllocateBuffer(1000u);
+  pool->MaybeAllocateBuffer(1000u).reset();
+  EXPECT_EQ(1u, pool->GetStats().idle_region_count);
+
+  pool->Shutdown();
+  EXPECT_EQ(0u, pool->GetStats().idle_region_count);
+  EXPECT_FALSE(pool->MaybeAllocateBuffer(1000u));
+  // Outstanding regions are freed as they are returned.
+  handle.reset();
+  EXPECT_EQ(0u, pool->GetStats().idle_region_count);
+}
+
 }  // namespace base
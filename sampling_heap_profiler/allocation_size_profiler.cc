@@ -0,0 +1,330 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/sampling_heap_profiler/allocation_size_profiler.h"
+
+#include <limits>
+#include <string>
+
+#include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_constants.h"
+#include "base/allocator/partition_allocator/src/partition_alloc/partition_bucket_lookup.h"
+#include "base/bits.h"
+#include "base/check_op.h"
+#include "base/memory/page_size.h"
+#include "base/strings/stringprintf.h"
+#include "base/tracing_buildflags.h"
+
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+#include "base/trace_event/memory_allocator_dump.h"  // no-presubmit-check
+#include "base/trace_event/memory_dump_manager.h"    // no-presubmit-check
+#include "base/trace_event/process_memory_dump.h"    // no-presubmit-check
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+
+namespace base {
+
+namespace {
+
+using partition_alloc::internal::BucketIndexLookup;
+using partition_alloc::internal::kMaxBucketed;
+
+constexpr size_t kNumBits = std::numeric_limits<size_t>::digits;
+// Direct mapped sizes are grouped by power of two, indexed by the exponent.
+constexpr size_t kNumSizeClasses = partition_alloc::kNumBuckets + kNumBits + 1;
+
+constexpr const char* kLifetimeBucketNames[] = {
+    "1ms", "10ms", "100ms", "1s", "10s", "100s", "inf"};
+static_assert(std::size(kLifetimeBucketNames) ==
+              AllocationSizeProfiler::kNumLifetimeBuckets);
+
+constexpr BucketIndexLookup kBucketIndexLookup;
+
+// Returns i such as 2^(i-1) < n <= 2^i.
+size_t Log2Ceiling(size_t n) {
+  return n <= 1 ? 0 : kNumBits - bits::CountLeadingZeroBits(n - 1);
+}
+
+size_t LifetimeBucket(TimeDelta lifetime) {
+  size_t bucket = 0;
+  while (bucket < std::size(AllocationSizeProfiler::kLifetimeBounds) &&
+         lifetime >= AllocationSizeProfiler::kLifetimeBounds[bucket]) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+// The slot sizes below are computed from the requested size, whereas
+// PartitionAlloc adds its in-slot metadata first. This is close enough to
+// compare distributions, and doesn't depend on the configuration.
+size_t SlotSize(size_t size, bool denser) {
+  if (size > kMaxBucketed) {
+    return bits::AlignUp(size, GetPageSize());
+  }
+  uint16_t index = denser ? BucketIndexLookup::GetIndexForDenserBuckets(size)
+                          : BucketIndexLookup::GetIndexForNeutralBuckets(size);
+  return kBucketIndexLookup.bucket_sizes()[index];
+}
+
+std::vector<AllocationSizeProfiler::SizeClass> CreateSizeClasses() {
+  std::vector<AllocationSizeProfiler::SizeClass> size_classes(
+      kNumSizeClasses);
+  size_t min_size = 0;
+  for (size_t i = 0; i < partition_alloc::kNumBuckets; ++i) {
+    size_t bucket_size = kBucketIndexLookup.bucket_sizes()[i];
+    if (bucket_size == partition_alloc::kInvalidBucketSize) {
+      break;
+    }
+    size_classes[i].min_size = min_size;
+    size_classes[i].max_size = bucket_size;
+    min_size = bucket_size + 1;
+  }
+  for (size_t order = Log2Ceiling(kMaxBucketed + 1); order <= kNumBits;
+       ++order) {
+    auto& size_class = size_classes[partition_alloc::kNumBuckets + order];
+    size_class.direct_mapped = true;
+    size_class.min_size = min_size;
+    size_class.max_size = order == kNumBits
+                              ? std::numeric_limits<size_t>::max()
+                              : size_t{1} << order;
+    min_size = size_class.max_size + 1;
+  }
+  return size_classes;
+}
+
+Value::Dict SizeClassToValue(const AllocationSizeProfiler::SizeClass& stats) {
+  Value::List lifetimes;
+  for (double count : stats.lifetimes) {
+    lifetimes.Append(count);
+  }
+  return Value::Dict()
+      .Set("min_size", static_cast<double>(stats.min_size))
+      .Set("max_size", static_cast<double>(stats.max_size))
+      .Set("direct_mapped", stats.direct_mapped)
+      .Set("samples", static_cast<double>(stats.samples))
+      .Set("allocations", stats.allocations)
+      .Set("requested_bytes", stats.requested_bytes)
+      .Set("neutral_slot_bytes", stats.neutral_slot_bytes)
+      .Set("denser_slot_bytes", stats.denser_slot_bytes)
+      .Set("live_allocations", stats.live_allocations)
+      .Set("live_bytes", stats.live_bytes)
+      .Set("lifetimes", std::move(lifetimes));
+}
+
+}  // namespace
+
+AllocationSizeProfiler::Report::Report() = default;
+AllocationSizeProfiler::Report::Report(const Report&) = default;
+AllocationSizeProfiler::Report& AllocationSizeProfiler::Report::operator=(
+    const Report&) = default;
+AllocationSizeProfiler::Report::~Report() = default;
+
+Value::Dict AllocationSizeProfiler::Report::ToValue() const {
+  Value::List lifetime_bounds;
+  for (TimeDelta bound : kLifetimeBounds) {
+    lifetime_bounds.Append(bound.InMillisecondsF());
+  }
+  Value::List classes;
+  for (const SizeClass& size_class : size_classes) {
+    classes.Append(SizeClassToValue(size_class));
+  }
+  return Value::Dict()
+      .Set("sampling_interval", static_cast<double>(sampling_interval))
+      .Set("allocations", allocations)
+      .Set("requested_bytes", requested_bytes)
+      .Set("neutral_slot_bytes", neutral_slot_bytes)
+      .Set("denser_slot_bytes", denser_slot_bytes)
+      .Set("lifetime_bounds_ms", std::move(lifetime_bounds))
+      .Set("size_classes", std::move(classes));
+}
+
+// static
+AllocationSizeProfiler* AllocationSizeProfiler::Get() {
+  static NoDestructor<AllocationSizeProfiler> instance;
+  return instance.get();
+}
+
+AllocationSizeProfiler::AllocationSizeProfiler()
+    : size_classes_(CreateSizeClasses()) {
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+  trace_event::MemoryDumpManager::GetInstance()->RegisterDumpProvider(
+      this, "AllocationSizeProfiler", nullptr);
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+}
+
+AllocationSizeProfiler::~AllocationSizeProfiler() = default;
+
+void AllocationSizeProfiler::Start() {
+  AutoLock lock(start_stop_mutex_);
+  if (!running_sessions_++) {
+    PoissonAllocationSampler::Get()->AddSamplesObserver(this);
+  }
+}
+
+void AllocationSizeProfiler::Stop() {
+  AutoLock lock(start_stop_mutex_);
+  DCHECK_GT(running_sessions_, 0);
+  if (!--running_sessions_) {
+    PoissonAllocationSampler::Get()->RemoveSamplesObserver(this);
+  }
+}
+
+AllocationSizeProfiler::Report AllocationSizeProfiler::GetReport() {
+  // Copying the data allocates, don't let this be sampled while holding the
+  // lock.
+  PoissonAllocationSampler::ScopedMuteThreadSamples mute_samples;
+  Report report;
+  report.sampling_interval =
+      PoissonAllocationSampler::Get()->SamplingInterval();
+  AutoLock lock(mutex_);
+  for (const SizeClass& size_class : size_classes_) {
+    if (!size_class.samples) {
+      continue;
+    }
+    report.size_classes.push_back(size_class);
+    report.allocations += size_class.allocations;
+    report.requested_bytes += size_class.requested_bytes;
+    report.neutral_slot_bytes += size_class.neutral_slot_bytes;
+    report.denser_slot_bytes += size_class.denser_slot_bytes;
+  }
+  return report;
+}
+
+void AllocationSizeProfiler::Reset() {
+  PoissonAllocationSampler::ScopedMuteThreadSamples mute_samples;
+  AutoLock lock(mutex_);
+  size_classes_ = CreateSizeClasses();
+  live_samples_.clear();
+}
+
+bool AllocationSizeProfiler::OnMemoryDump(
+    const trace_event::MemoryDumpArgs& args,
+    trace_event::ProcessMemoryDump* pmd) {
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+  using trace_event::MemoryAllocatorDump;
+  // This is a tuning aid, it isn't meant to be reported from the field.
+  if (args.level_of_detail ==
+      trace_event::MemoryDumpLevelOfDetail::kBackground) {
+    return true;
+  }
+  Report report = GetReport();
+  if (report.size_classes.empty()) {
+    return true;
+  }
+
+  double live_bytes = 0;
+  for (const SizeClass& size_class : report.size_classes) {
+    live_bytes += size_class.live_bytes;
+  }
+  MemoryAllocatorDump* dump =
+      pmd->CreateAllocatorDump("allocation_size_profiler");
+  dump->AddScalar(MemoryAllocatorDump::kNameSize,
+                  MemoryAllocatorDump::kUnitsBytes,
+                  static_cast<uint64_t>(live_bytes));
+  dump->AddScalar("allocated_objects", MemoryAllocatorDump::kUnitsObjects,
+                  static_cast<uint64_t>(report.allocations));
+  dump->AddScalar("requested_size", MemoryAllocatorDump::kUnitsBytes,
+                  static_cast<uint64_t>(report.requested_bytes));
+  dump->AddScalar("neutral_slot_size", MemoryAllocatorDump::kUnitsBytes,
+                  static_cast<uint64_t>(report.neutral_slot_bytes));
+  dump->AddScalar("denser_slot_size", MemoryAllocatorDump::kUnitsBytes,
+                  static_cast<uint64_t>(report.denser_slot_bytes));
+
+  if (args.level_of_detail !=
+      trace_event::MemoryDumpLevelOfDetail::kDetailed) {
+    return true;
+  }
+  for (const SizeClass& size_class : report.size_classes) {
+    // Zero-padded so that size classes sort by size.
+    MemoryAllocatorDump* class_dump = pmd->CreateAllocatorDump(
+        StringPrintf("allocation_size_profiler/size_classes/%020zu",
+                     size_class.max_size));
+    class_dump->AddScalar(MemoryAllocatorDump::kNameSize,
+                          MemoryAllocatorDump::kUnitsBytes,
+                          static_cast<uint64_t>(size_class.live_bytes));
+    class_dump->AddScalar("allocated_objects",
+                          MemoryAllocatorDump::kUnitsObjects,
+                          static_cast<uint64_t>(size_class.allocations));
+    class_dump->AddScalar("requested_size", MemoryAllocatorDump::kUnitsBytes,
+                          static_cast<uint64_t>(size_class.requested_bytes));
+    class_dump->AddScalar("neutral_slot_size", MemoryAllocatorDump::kUnitsBytes,
+                          static_cast<uint64_t>(size_class.neutral_slot_bytes));
+    class_dump->AddScalar("denser_slot_size", MemoryAllocatorDump::kUnitsBytes,
+                          static_cast<uint64_t>(size_class.denser_slot_bytes));
+    for (size_t i = 0; i < kNumLifetimeBuckets; ++i) {
+      class_dump->AddScalar(
+          std::string("freed_objects_within_") + kLifetimeBucketNames[i],
+          MemoryAllocatorDump::kUnitsObjects,
+          static_cast<uint64_t>(size_class.lifetimes[i]));
+    }
+  }
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+  return true;
+}
+
+void AllocationSizeProfiler::SampleAdded(
+    void* address,
+    size_t size,
+    size_t total,
+    base::allocator::dispatcher::AllocationSubsystem type,
+    const char* context) {
+  DCHECK(PoissonAllocationSampler::ScopedMuteThreadSamples::IsMuted());
+  // A sample stands for |total| bytes worth of allocations of this size.
+  const double weight =
+      size ? static_cast<double>(total) / static_cast<double>(size) : 1;
+  const size_t size_class_index = SizeClassIndex(size);
+  const size_t neutral_slot_size = SlotSize(size, /*denser=*/false);
+  const size_t denser_slot_size = SlotSize(size, /*denser=*/true);
+  const TimeTicks now = TimeTicks::Now();
+
+  AutoLock lock(mutex_);
+  SizeClass& size_class = size_classes_[size_class_index];
+  ++size_class.samples;
+  size_class.allocations += weight;
+  size_class.requested_bytes += weight * size;
+  size_class.neutral_slot_bytes += weight * neutral_slot_size;
+  size_class.denser_slot_bytes += weight * denser_slot_size;
+  size_class.live_allocations += weight;
+  size_class.live_bytes += weight * size;
+
+  LiveSample sample{now, size_class_index, weight, size};
+  auto [it, inserted] = live_samples_.try_emplace(address, sample);
+  if (!inserted) {
+    // The free of the previous allocation at this address was missed, e.g.
+    // because the profiler was stopped. Its lifetime is unknown.
+    RemoveLiveSample(it->second, TimeTicks());
+    it->second = sample;
+  }
+}
+
+void AllocationSizeProfiler::SampleRemoved(void* address) {
+  DCHECK(PoissonAllocationSampler::ScopedMuteThreadSamples::IsMuted());
+  const TimeTicks now = TimeTicks::Now();
+  AutoLock lock(mutex_);
+  auto it = live_samples_.find(address);
+  if (it == live_samples_.end()) {
+    return;
+  }
+  RemoveLiveSample(it->second, now);
+  live_samples_.erase(it);
+}
+
+// static
+size_t AllocationSizeProfiler::SizeClassIndex(size_t size) {
+  if (size > kMaxBucketed) {
+    return partition_alloc::kNumBuckets + Log2Ceiling(size);
+  }
+  return BucketIndexLookup::GetIndexForDenserBuckets(size);
+}
+
+void AllocationSizeProfiler::RemoveLiveSample(const LiveSample& sample,
+                                              TimeTicks now) {
+  SizeClass& size_class = size_classes_[sample.size_class];
+  size_class.live_allocations -= sample.weight;
+  size_class.live_bytes -= sample.weight * sample.size;
+  if (!now.is_null()) {
+    size_class.lifetimes[LifetimeBucket(now - sample.allocation_time)] +=
+        sample.weight;
+  }
+}
+
+}  // namespace base
@@ -0,0 +1,155 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_SAMPLING_HEAP_PROFILER_ALLOCATION_SIZE_PROFILER_H_
+#define BASE_SAMPLING_HEAP_PROFILER_ALLOCATION_SIZE_PROFILER_H_
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/no_destructor.h"
+#include "base/sampling_heap_profiler/poisson_allocation_sampler.h"
+#include "base/synchronization/lock.h"
+#include "base/thread_annotations.h"
+#include "base/time/time.h"
+#include "base/trace_event/base_tracing.h"
+#include "base/values.h"
+
+namespace base {
+
+// Records the distribution of allocation sizes and lifetimes, to tune the
+// PartitionAlloc bucket distribution and thread cache limits for a workload.
+//
+// It relies on PoissonAllocationSampler, so it only sees a sample of the
+// allocations made through the allocator dispatcher. Each sample is weighted
+// by the number of allocations it stands for, so all counts and sizes are
+// estimates for the whole allocation stream.
+//
+// Allocations are grouped into size classes matching PartitionAlloc buckets
+// with the denser distribution, plus one class per power of two for direct
+// mapped sizes. For each, the profiler estimates the memory that slots would
+// take with either bucket distribution, i.e. the internal fragmentation, and
+// how long allocations live before being freed.
+//
+// Results are available from GetReport(), and in memory-infra dumps under
+// "allocation_size_profiler".
+class BASE_EXPORT AllocationSizeProfiler
+    : private PoissonAllocationSampler::SamplesObserver,
+      public trace_event::MemoryDumpProvider {
+ public:
+  // Upper bounds of the lifetime buckets. Allocations living longer than the
+  // last bound go to an extra, last bucket.
+  static constexpr TimeDelta kLifetimeBounds[] = {
+      Milliseconds(1), Milliseconds(10), Seconds(1) / 10,
+      Seconds(1),      Seconds(10),      Seconds(100)};
+  static constexpr size_t kNumLifetimeBuckets = std::size(kLifetimeBounds) + 1;
+
+  struct BASE_EXPORT SizeClass {
+    // Range of requested sizes, inclusive, that fall into this class.
+    size_t min_size = 0;
+    size_t max_size = 0;
+    // Whether allocations of this class are direct mapped by PartitionAlloc.
+    bool direct_mapped = false;
+    // Number of samples recorded for this class.
+    size_t samples = 0;
+    // Estimated number and total requested size of allocations.
+    double allocations = 0;
+    double requested_bytes = 0;
+    // Estimated size of the slots holding these allocations, with the neutral
+    // and denser bucket distributions. The difference with |requested_bytes|
+    // is lost to internal fragmentation.
+    double neutral_slot_bytes = 0;
+    double denser_slot_bytes = 0;
+    // Estimated number and requested size of allocations not freed yet.
+    double live_allocations = 0;
+    double live_bytes = 0;
+    // Estimated number of freed allocations per lifetime bucket.
+    std::array<double, kNumLifetimeBuckets> lifetimes{};
+  };
+
+  struct BASE_EXPORT Report {
+    Report();
+    Report(const Report&);
+    Report& operator=(const Report&);
+    ~Report();
+
+    // Mean sampling interval at the time of the report, in bytes.
+    size_t sampling_interval = 0;
+    // Size classes which got at least one sample, by increasing size.
+    std::vector<SizeClass> size_classes;
+    // Sums over all size classes.
+    double allocations = 0;
+    double requested_bytes = 0;
+    double neutral_slot_bytes = 0;
+    double denser_slot_bytes = 0;
+
+    // Returns the report as a dictionary, which can be serialized to JSON.
+    Value::Dict ToValue() const;
+  };
+
+  static AllocationSizeProfiler* Get();
+
+  AllocationSizeProfiler(const AllocationSizeProfiler&) = delete;
+  AllocationSizeProfiler& operator=(const AllocationSizeProfiler&) = delete;
+
+  // Starts and stops collecting samples. Calls can be nested, collection stops
+  // on the last call to Stop(). PoissonAllocationSampler::Init() must have been
+  // called before. Stopping keeps the data collected so far, but allocations
+  // freed while stopped are not accounted for.
+  void Start();
+  void Stop();
+
+  // Returns the data collected since the profiler was created or Reset().
+  Report GetReport();
+
+  // Discards all the data collected so far.
+  void Reset();
+
+  // trace_event::MemoryDumpProvider implementation.
+  bool OnMemoryDump(const trace_event::MemoryDumpArgs& args,
+                    trace_event::ProcessMemoryDump* pmd) override;
+
+ private:
+  struct LiveSample {
+    TimeTicks allocation_time;
+    size_t size_class;
+    double weight;
+    size_t size;
+  };
+
+  AllocationSizeProfiler();
+  ~AllocationSizeProfiler() override;
+
+  // PoissonAllocationSampler::SamplesObserver implementation.
+  void SampleAdded(void* address,
+                   size_t size,
+                   size_t total,
+                   base::allocator::dispatcher::AllocationSubsystem type,
+                   const char* context) override;
+  void SampleRemoved(void* address) override;
+
+  // Returns the index into |size_classes_| of requests of |size| bytes.
+  static size_t SizeClassIndex(size_t size);
+
+  void RemoveLiveSample(const LiveSample& sample, TimeTicks now)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  Lock mutex_;
+  std::vector<SizeClass> size_classes_ GUARDED_BY(mutex_);
+  std::unordered_map<void*, LiveSample> live_samples_ GUARDED_BY(mutex_);
+
+  // Makes the number of running sessions and the observer registration
+  // consistent.
+  Lock start_stop_mutex_;
+  int running_sessions_ GUARDED_BY(start_stop_mutex_) = 0;
+
+  friend class AllocationSizeProfilerTest;
+  friend class NoDestructor<AllocationSizeProfiler>;
+};
+
+}  // namespace base
+
+#endif  // BASE_SAMPLING_HEAP_PROFILER_ALLOCATION_SIZE_PROFILER_H_
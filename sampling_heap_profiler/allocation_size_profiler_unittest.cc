@@ -0,0 +1,209 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/sampling_heap_profiler/allocation_size_profiler.h"
+
+#include <stdlib.h>
+
+#include "base/allocator/dispatcher/dispatcher.h"
+#include "base/allocator/partition_allocator/src/partition_alloc/partition_alloc_constants.h"
+#include "base/allocator/partition_allocator/src/partition_alloc/shim/allocator_shim.h"
+#include "base/debug/alias.h"
+#include "base/memory/page_size.h"
+#include "base/sampling_heap_profiler/poisson_allocation_sampler.h"
+#include "base/tracing_buildflags.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+#include "base/trace_event/memory_allocator_dump.h"
+#include "base/trace_event/process_memory_dump.h"
+#endif
+
+namespace base {
+
+using allocator::dispatcher::AllocationSubsystem;
+
+class AllocationSizeProfilerTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+#if BUILDFLAG(IS_APPLE)
+    allocator_shim::InitializeAllocatorShim();
+#endif
+    PoissonAllocationSampler::Init();
+    AllocationSizeProfiler::Get()->Reset();
+  }
+
+  void TearDown() override { AllocationSizeProfiler::Get()->Reset(); }
+
+  static void AddSample(void* address, size_t size, size_t total) {
+    PoissonAllocationSampler::ScopedMuteThreadSamples mute_samples;
+    AllocationSizeProfiler::Get()->SampleAdded(
+        address, size, total, AllocationSubsystem::kManualForTesting, nullptr);
+  }
+
+  static void RemoveSample(void* address) {
+    PoissonAllocationSampler::ScopedMuteThreadSamples mute_samples;
+    AllocationSizeProfiler::Get()->SampleRemoved(address);
+  }
+
+  static const AllocationSizeProfiler::SizeClass* FindSizeClass(
+      const AllocationSizeProfiler::Report& report,
+      size_t size) {
+    for (const auto& size_class : report.size_classes) {
+      if (size_class.min_size <= size && size <= size_class.max_size) {
+        return &size_class;
+      }
+    }
+    return nullptr;
+  }
+};
+
+TEST_F(AllocationSizeProfilerTest, WeightsSamples) {
+  int dummy;
+  AddSample(&dummy, 100, 1000);
+
+  auto report = AllocationSizeProfiler::Get()->GetReport();
+  ASSERT_EQ(1u, report.size_classes.size());
+  const auto& size_class = report.size_classes[0];
+  EXPECT_LE(size_class.min_size, 100u);
+  EXPECT_GE(size_class.max_size, 100u);
+  EXPECT_FALSE(size_class.direct_mapped);
+  EXPECT_EQ(1u, size_class.samples);
+  EXPECT_DOUBLE_EQ(10, size_class.allocations);
+  EXPECT_DOUBLE_EQ(1000, size_class.requested_bytes);
+  EXPECT_DOUBLE_EQ(10, size_class.live_allocations);
+  EXPECT_DOUBLE_EQ(1000, size_class.live_bytes);
+  EXPECT_DOUBLE_EQ(10 * size_class.max_size, size_class.denser_slot_bytes);
+  // The neutral distribution never has more buckets than the denser one.
+  EXPECT_GE(size_class.neutral_slot_bytes, size_class.denser_slot_bytes);
+  EXPECT_DOUBLE_EQ(report.allocations, size_class.allocations);
+  EXPECT_DOUBLE_EQ(report.requested_bytes, size_class.requested_bytes);
+
+  RemoveSample(&dummy);
+}
+
+TEST_F(AllocationSizeProfilerTest, RecordsLifetimes) {
+  int dummy[2];
+  AddSample(&dummy[0], 64, 128);
+  AddSample(&dummy[1], 64, 64);
+  RemoveSample(&dummy[0]);
+
+  auto report = AllocationSizeProfiler::Get()->GetReport();
+  const auto* size_class = FindSizeClass(report, 64);
+  ASSERT_TRUE(size_class);
+  EXPECT_DOUBLE_EQ(3, size_class->allocations);
+  EXPECT_DOUBLE_EQ(1, size_class->live_allocations);
+  EXPECT_DOUBLE_EQ(64, size_class->live_bytes);
+  double freed = 0;
+  for (double count : size_class->lifetimes) {
+    freed += count;
+  }
+  EXPECT_DOUBLE_EQ(2, freed);
+
+  // Unknown addresses are ignored.
+  RemoveSample(&dummy[0]);
+  RemoveSample(&dummy[1]);
+  report = AllocationSizeProfiler::Get()->GetReport();
+  size_class = FindSizeClass(report, 64);
+  ASSERT_TRUE(size_class);
+  EXPECT_DOUBLE_EQ(0, size_class->live_allocations);
+}
+
+TEST_F(AllocationSizeProfilerTest, DirectMappedSizes) {
+  const size_t size = 3 * partition_alloc::internal::kMaxBucketed + 1;
+  int dummy;
+  AddSample(&dummy, size, size);
+
+  auto report = AllocationSizeProfiler::Get()->GetReport();
+  const auto* size_class = FindSizeClass(report, size);
+  ASSERT_TRUE(size_class);
+  EXPECT_TRUE(size_class->direct_mapped);
+  EXPECT_GT(size_class->min_size, partition_alloc::internal::kMaxBucketed);
+  const double slot_size = (size + GetPageSize() - 1) / GetPageSize() *
+                           static_cast<double>(GetPageSize());
+  EXPECT_DOUBLE_EQ(slot_size, size_class->neutral_slot_bytes);
+  EXPECT_DOUBLE_EQ(slot_size, size_class->denser_slot_bytes);
+
+  RemoveSample(&dummy);
+}
+
+TEST_F(AllocationSizeProfilerTest, ReportToValue) {
+  int dummy;
+  AddSample(&dummy, 32, 64);
+
+  Value::Dict value = AllocationSizeProfiler::Get()->GetReport().ToValue();
+  EXPECT_EQ(2, value.FindDouble("allocations"));
+  const Value::List* size_classes = value.FindList("size_classes");
+  ASSERT_TRUE(size_classes);
+  ASSERT_EQ(1u, size_classes->size());
+  const Value::List* lifetimes =
+      (*size_classes)[0].GetDict().FindList("lifetimes");
+  ASSERT_TRUE(lifetimes);
+  EXPECT_EQ(AllocationSizeProfiler::kNumLifetimeBuckets, lifetimes->size());
+
+  RemoveSample(&dummy);
+}
+
+TEST_F(AllocationSizeProfilerTest, SamplesHookedAllocations) {
+  PoissonAllocationSampler::ScopedSuppressRandomnessForTesting
+      suppress_randomness;
+  allocator::dispatcher::Dispatcher::GetInstance().InitializeForTesting(
+      PoissonAllocationSampler::Get());
+  auto* sampler = PoissonAllocationSampler::Get();
+  const size_t previous_interval = sampler->SamplingInterval();
+  sampler->SetSamplingInterval(1024);
+
+  constexpr size_t kSize = 4000;
+  auto* profiler = AllocationSizeProfiler::Get();
+  profiler->Start();
+  for (int i = 0; i < 100; ++i) {
+    void* ptr = malloc(kSize);
+    debug::Alias(&ptr);
+    free(ptr);
+  }
+  profiler->Stop();
+
+  sampler->SetSamplingInterval(previous_interval);
+  allocator::dispatcher::Dispatcher::GetInstance().ResetForTesting();
+
+  auto report = profiler->GetReport();
+  EXPECT_EQ(1024u, report.sampling_interval);
+  const auto* size_class = FindSizeClass(report, kSize);
+  ASSERT_TRUE(size_class);
+  EXPECT_GE(size_class->samples, 50u);
+  double freed = 0;
+  for (double count : size_class->lifetimes) {
+    freed += count;
+  }
+  EXPECT_GT(freed, 0);
+}
+
+#if BUILDFLAG(ENABLE_BASE_TRACING)
+TEST_F(AllocationSizeProfilerTest, MemoryDump) {
+  int dummy;
+  AddSample(&dummy, 100, 1000);
+
+  using trace_event::MemoryDumpArgs;
+  using trace_event::MemoryDumpLevelOfDetail;
+  using trace_event::ProcessMemoryDump;
+
+  MemoryDumpArgs background_args = {MemoryDumpLevelOfDetail::kBackground};
+  ProcessMemoryDump background_pmd(background_args);
+  AllocationSizeProfiler::Get()->OnMemoryDump(background_args,
+                                              &background_pmd);
+  EXPECT_TRUE(background_pmd.allocator_dumps().empty());
+
+  MemoryDumpArgs detailed_args = {MemoryDumpLevelOfDetail::kDetailed};
+  ProcessMemoryDump pmd(detailed_args);
+  AllocationSizeProfiler::Get()->OnMemoryDump(detailed_args, &pmd);
+  ASSERT_TRUE(pmd.GetAllocatorDump("allocation_size_profiler"));
+  // The root dump, and the one size class.
+  EXPECT_EQ(2u, pmd.allocator_dumps().size());
+
+  RemoveSample(&dummy);
+}
+#endif  // BUILDFLAG(ENABLE_BASE_TRACING)
+
+}  // namespace base
@@ -0,0 +1,416 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/sampling_heap_profiler/heap_profile_pprof_exporter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <utility>
+
+#include "base/containers/span.h"
+#include "base/hash/hash.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "build/build_config.h"
+
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+#include "base/debug/proc_maps_linux.h"
+#define HAS_PROC_MAPS 1
+#else
+#define HAS_PROC_MAPS 0
+#endif
+
+namespace base {
+
+namespace {
+
+// Field numbers from profile.proto.
+namespace profile {
+constexpr uint32_t kSampleType = 1;
+constexpr uint32_t kSample = 2;
+constexpr uint32_t kMapping = 3;
+constexpr uint32_t kLocation = 4;
+constexpr uint32_t kFunction = 5;
+constexpr uint32_t kStringTable = 6;
+constexpr uint32_t kTimeNanos = 9;
+constexpr uint32_t kPeriodType = 11;
+constexpr uint32_t kPeriod = 12;
+constexpr uint32_t kDefaultSampleType = 14;
+}  // namespace profile
+
+namespace value_type {
+constexpr uint32_t kType = 1;
+constexpr uint32_t kUnit = 2;
+}  // namespace value_type
+
+namespace sample {
+constexpr uint32_t kLocationId = 1;
+constexpr uint32_t kValue = 2;
+constexpr uint32_t kLabel = 3;
+}  // namespace sample
+
+namespace label {
+constexpr uint32_t kKey = 1;
+constexpr uint32_t kStr = 2;
+}  // namespace label
+
+namespace mapping {
+constexpr uint32_t kId = 1;
+constexpr uint32_t kMemoryStart = 2;
+constexpr uint32_t kMemoryLimit = 3;
+constexpr uint32_t kFileOffset = 4;
+constexpr uint32_t kFilename = 5;
+constexpr uint32_t kBuildId = 6;
+constexpr uint32_t kHasFunctions = 7;
+}  // namespace mapping
+
+namespace location {
+constexpr uint32_t kId = 1;
+constexpr uint32_t kMappingId = 2;
+constexpr uint32_t kAddress = 3;
+constexpr uint32_t kLine = 4;
+}  // namespace location
+
+namespace line {
+constexpr uint32_t kFunctionId = 1;
+constexpr uint32_t kLine = 2;
+}  // namespace line
+
+namespace function {
+constexpr uint32_t kId = 1;
+constexpr uint32_t kName = 2;
+constexpr uint32_t kSystemName = 3;
+constexpr uint32_t kFilename = 4;
+}  // namespace function
+
+// Minimal protocol buffer encoder, appending to a string. Fields with a zero
+// value are skipped, as they would be by the protobuf library.
+class ProtoWriter {
+ public:
+  explicit ProtoWriter(std::string* out) : out_(out) {}
+
+  void AppendVarint(uint32_t field, uint64_t value) {
+    if (!value) {
+      return;
+    }
+    AppendTag(field, kWireTypeVarint);
+    AppendRawVarint(value);
+  }
+
+  void AppendBytes(uint32_t field, StringPiece bytes) {
+    AppendTag(field, kWireTypeLengthDelimited);
+    AppendRawVarint(bytes.size());
+    out_->append(bytes.data(), bytes.size());
+  }
+
+  void AppendPackedVarints(uint32_t field, span<const uint64_t> values) {
+    if (values.empty()) {
+      return;
+    }
+    size_t size = 0;
+    for (uint64_t value : values) {
+      size += VarintSize(value);
+    }
+    AppendTag(field, kWireTypeLengthDelimited);
+    AppendRawVarint(size);
+    for (uint64_t value : values) {
+      AppendRawVarint(value);
+    }
+  }
+
+ private:
+  static constexpr uint32_t kWireTypeVarint = 0;
+  static constexpr uint32_t kWireTypeLengthDelimited = 2;
+
+  static size_t VarintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+      value >>= 7;
+      ++size;
+    }
+    return size;
+  }
+
+  void AppendTag(uint32_t field, uint32_t wire_type) {
+    AppendRawVarint((field << 3) | wire_type);
+  }
+
+  void AppendRawVarint(uint64_t value) {
+    while (value >= 0x80) {
+      out_->push_back(static_cast<char>((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+    out_->push_back(static_cast<char>(value));
+  }
+
+  const raw_ptr<std::string> out_;
+};
+
+class StringTable {
+ public:
+  StringTable() { Intern(""); }
+
+  uint64_t Intern(StringPiece string) {
+    auto [it, inserted] = indices_.try_emplace(std::string(string), 0);
+    if (inserted) {
+      it->second = strings_.size();
+      strings_.push_back(&it->first);
+    }
+    return it->second;
+  }
+
+  void WriteTo(ProtoWriter& writer) const {
+    for (const std::string* string : strings_) {
+      writer.AppendBytes(profile::kStringTable, *string);
+    }
+  }
+
+ private:
+  // Keys of unordered_map are stable, so |strings_| can point into it.
+  std::unordered_map<std::string, uint64_t> indices_;
+  std::vector<const std::string*> strings_;
+};
+
+// Samples are aggregated by stack, and labels. Thread names and contexts are
+// interned by SamplingHeapProfiler, so comparing pointers is enough.
+struct AggregationKey {
+  raw_ptr<const std::vector<const void*>> stack;
+  const char* thread_name;
+  const char* context;
+
+  bool operator==(const AggregationKey& other) const {
+    return thread_name == other.thread_name && context == other.context &&
+           *stack == *other.stack;
+  }
+};
+
+struct AggregationKeyHash {
+  size_t operator()(const AggregationKey& key) const {
+    size_t hash = FastHash(as_bytes(make_span(*key.stack)));
+    hash = HashInts64(hash, reinterpret_cast<uintptr_t>(key.thread_name));
+    return HashInts64(hash, reinterpret_cast<uintptr_t>(key.context));
+  }
+};
+
+struct AggregatedValues {
+  double objects = 0;
+  uint64_t bytes = 0;
+};
+
+}  // namespace
+
+HeapProfilePprofExporter::Symbol::Symbol() = default;
+HeapProfilePprofExporter::Symbol::Symbol(const Symbol&) = default;
+HeapProfilePprofExporter::Symbol& HeapProfilePprofExporter::Symbol::operator=(
+    const Symbol&) = default;
+HeapProfilePprofExporter::Symbol::~Symbol() = default;
+
+HeapProfilePprofExporter::HeapProfilePprofExporter(ModuleCache* module_cache)
+    : module_cache_(module_cache) {}
+
+HeapProfilePprofExporter::~HeapProfilePprofExporter() = default;
+
+std::string HeapProfilePprofExporter::Export(
+    const std::vector<SamplingHeapProfiler::Sample>& samples) {
+  std::unordered_map<AggregationKey, AggregatedValues, AggregationKeyHash>
+      aggregated;
+  aggregated.reserve(samples.size());
+  for (const auto& sample : samples) {
+    AggregationKey key{&sample.stack, nullptr, nullptr};
+    if (record_labels_) {
+      key.thread_name = sample.thread_name;
+      key.context = sample.context;
+    }
+    AggregatedValues& values = aggregated[key];
+    // Each sample stands for |total| bytes worth of allocations of its size.
+    values.objects +=
+        sample.size ? static_cast<double>(sample.total) / sample.size : 1;
+    values.bytes += sample.total;
+  }
+
+  std::string out;
+  ProtoWriter writer(&out);
+  StringTable strings;
+  std::string scratch;
+  std::string nested_scratch;
+  ProtoWriter scratch_writer(&scratch);
+  ProtoWriter nested_writer(&nested_scratch);
+
+  auto write_value_type = [&](uint32_t field, StringPiece type,
+                              StringPiece unit) {
+    scratch.clear();
+    scratch_writer.AppendVarint(value_type::kType, strings.Intern(type));
+    scratch_writer.AppendVarint(value_type::kUnit, strings.Intern(unit));
+    writer.AppendBytes(field, scratch);
+  };
+  write_value_type(profile::kSampleType, "inuse_objects", "count");
+  write_value_type(profile::kSampleType, "inuse_space", "bytes");
+
+  // Assigns ids to locations, and to the mappings and functions they refer
+  // to. Only the ids are needed to write samples, the messages describing
+  // them are written afterwards.
+  std::unordered_map<uintptr_t, uint64_t> location_ids;
+  std::vector<uintptr_t> locations;
+  location_ids.reserve(samples.size());
+
+  std::vector<uint64_t> location_ids_scratch;
+  for (const auto& [key, values] : aggregated) {
+    location_ids_scratch.clear();
+    for (const void* frame : *key.stack) {
+      uintptr_t address = reinterpret_cast<uintptr_t>(frame);
+      auto [it, inserted] =
+          location_ids.try_emplace(address, locations.size() + 1);
+      if (inserted) {
+        locations.push_back(address);
+      }
+      location_ids_scratch.push_back(it->second);
+    }
+
+    scratch.clear();
+    scratch_writer.AppendPackedVarints(sample::kLocationId,
+                                       location_ids_scratch);
+    const uint64_t sample_values[] = {
+        static_cast<uint64_t>(std::llround(values.objects)), values.bytes};
+    scratch_writer.AppendPackedVarints(sample::kValue, sample_values);
+    if (key.thread_name) {
+      nested_scratch.clear();
+      nested_writer.AppendVarint(label::kKey, strings.Intern("thread_name"));
+      nested_writer.AppendVarint(label::kStr, strings.Intern(key.thread_name));
+      scratch_writer.AppendBytes(sample::kLabel, nested_scratch);
+    }
+    if (key.context) {
+      nested_scratch.clear();
+      nested_writer.AppendVarint(label::kKey, strings.Intern("context"));
+      nested_writer.AppendVarint(label::kStr, strings.Intern(key.context));
+      scratch_writer.AppendBytes(sample::kLabel, nested_scratch);
+    }
+    writer.AppendBytes(profile::kSample, scratch);
+  }
+
+#if HAS_PROC_MAPS
+  // Read lazily, only if some address doesn't belong to a loaded module.
+  std::vector<debug::MappedMemoryRegion> regions;
+  bool regions_read = false;
+#endif
+  struct Mapping {
+    uintptr_t start;
+    uintptr_t limit;
+    uint64_t file_offset;
+    std::string filename;
+    std::string build_id;
+  };
+  std::vector<Mapping> mappings;
+  std::unordered_map<uintptr_t, uint64_t> mapping_ids;  // By start address.
+  std::unordered_map<std::string, uint64_t> function_ids;
+
+  for (size_t i = 0; i < locations.size(); ++i) {
+    const uintptr_t address = locations[i];
+    const ModuleCache::Module* module =
+        module_cache_->GetModuleForAddress(address);
+    uint64_t mapping_id = 0;
+    if (module) {
+      auto [it, inserted] = mapping_ids.try_emplace(module->GetBaseAddress(),
+                                                    mappings.size() + 1);
+      if (inserted) {
+        mappings.push_back({module->GetBaseAddress(),
+                            module->GetBaseAddress() + module->GetSize(), 0,
+                            module->GetDebugBasename().AsUTF8Unsafe(),
+                            module->GetId()});
+      }
+      mapping_id = it->second;
+    }
+#if HAS_PROC_MAPS
+    if (!module) {
+      if (!regions_read) {
+        std::string proc_maps;
+        if (debug::ReadProcMaps(&proc_maps)) {
+          debug::ParseProcMaps(proc_maps, &regions);
+        }
+        regions_read = true;
+      }
+      auto region = std::upper_bound(
+          regions.begin(), regions.end(), address,
+          [](uintptr_t address, const debug::MappedMemoryRegion& region) {
+            return address < region.start;
+          });
+      if (region != regions.begin() && address < (--region)->end) {
+        auto [it, inserted] =
+            mapping_ids.try_emplace(region->start, mappings.size() + 1);
+        if (inserted) {
+          mappings.push_back({region->start, region->end, region->offset,
+                              region->path, std::string()});
+        }
+        mapping_id = it->second;
+      }
+    }
+#endif  // HAS_PROC_MAPS
+
+    uint64_t function_id = 0;
+    int line_number = 0;
+    if (symbolize_callback_) {
+      absl::optional<Symbol> symbol = symbolize_callback_.Run(address, module);
+      if (symbol) {
+        auto [it, inserted] = function_ids.try_emplace(
+            symbol->function_name + '\0' + symbol->file_name,
+            function_ids.size() + 1);
+        if (inserted) {
+          nested_scratch.clear();
+          nested_writer.AppendVarint(function::kId, it->second);
+          nested_writer.AppendVarint(function::kName,
+                                     strings.Intern(symbol->function_name));
+          nested_writer.AppendVarint(function::kSystemName,
+                                     strings.Intern(symbol->function_name));
+          nested_writer.AppendVarint(function::kFilename,
+                                     strings.Intern(symbol->file_name));
+          writer.AppendBytes(profile::kFunction, nested_scratch);
+        }
+        function_id = it->second;
+        line_number = symbol->line;
+      }
+    }
+
+    scratch.clear();
+    scratch_writer.AppendVarint(location::kId, i + 1);
+    scratch_writer.AppendVarint(location::kMappingId, mapping_id);
+    scratch_writer.AppendVarint(location::kAddress, address);
+    if (function_id) {
+      nested_scratch.clear();
+      nested_writer.AppendVarint(line::kFunctionId, function_id);
+      nested_writer.AppendVarint(line::kLine,
+                                 static_cast<uint64_t>(line_number));
+      scratch_writer.AppendBytes(location::kLine, nested_scratch);
+    }
+    writer.AppendBytes(profile::kLocation, scratch);
+  }
+
+  for (size_t i = 0; i < mappings.size(); ++i) {
+    const Mapping& mapping = mappings[i];
+    scratch.clear();
+    scratch_writer.AppendVarint(mapping::kId, i + 1);
+    scratch_writer.AppendVarint(mapping::kMemoryStart, mapping.start);
+    scratch_writer.AppendVarint(mapping::kMemoryLimit, mapping.limit);
+    scratch_writer.AppendVarint(mapping::kFileOffset, mapping.file_offset);
+    scratch_writer.AppendVarint(mapping::kFilename,
+                                strings.Intern(mapping.filename));
+    scratch_writer.AppendVarint(mapping::kBuildId,
+                                strings.Intern(mapping.build_id));
+    scratch_writer.AppendVarint(mapping::kHasFunctions,
+                                !symbolize_callback_.is_null());
+    writer.AppendBytes(profile::kMapping, scratch);
+  }
+
+  writer.AppendVarint(
+      profile::kTimeNanos,
+      static_cast<uint64_t>((Time::Now() - Time::UnixEpoch()).InNanoseconds()));
+  write_value_type(profile::kPeriodType, "space", "bytes");
+  writer.AppendVarint(profile::kPeriod, sampling_interval_);
+  writer.AppendVarint(profile::kDefaultSampleType,
+                      strings.Intern("inuse_space"));
+  // Last, as writing the other messages adds strings.
+  strings.WriteTo(writer);
+  return out;
+}
+
+}  // namespace base
@@ -0,0 +1,83 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_SAMPLING_HEAP_PROFILER_HEAP_PROFILE_PPROF_EXPORTER_H_
+#define BASE_SAMPLING_HEAP_PROFILER_HEAP_PROFILE_PPROF_EXPORTER_H_
+
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/functional/callback.h"
+#include "base/memory/raw_ptr.h"
+#include "base/profiler/module_cache.h"
+#include "base/sampling_heap_profiler/sampling_heap_profiler.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+namespace base {
+
+// Converts samples from SamplingHeapProfiler into a pprof profile, i.e. an
+// uncompressed perftools.profiles.Profile protocol buffer, as described in
+// https://github.com/google/pprof/blob/main/proto/profile.proto.
+//
+// Samples with the same stack (and labels, when enabled) are aggregated into a
+// single pprof sample, carrying the estimated number of live objects and bytes
+// ("inuse_objects" and "inuse_space"). Stack frames are mapped to the modules
+// they belong to, using the ModuleCache and, on Linux and Android,
+// /proc/self/maps for addresses outside of any loaded library. Modules are
+// identified by build ID, so that the profile can be symbolized offline; it can
+// also be symbolized while exporting, by setting a SymbolizeCallback.
+class BASE_EXPORT HeapProfilePprofExporter {
+ public:
+  struct BASE_EXPORT Symbol {
+    Symbol();
+    Symbol(const Symbol&);
+    Symbol& operator=(const Symbol&);
+    ~Symbol();
+
+    std::string function_name;
+    std::string file_name;
+    int line = 0;
+  };
+
+  // Returns the symbol for |address|, which belongs to |module| if it's not
+  // null. Called once per distinct address.
+  using SymbolizeCallback =
+      RepeatingCallback<absl::optional<Symbol>(uintptr_t address,
+                                               const ModuleCache::Module*)>;
+
+  // |module_cache| must outlive this object.
+  explicit HeapProfilePprofExporter(ModuleCache* module_cache);
+  ~HeapProfilePprofExporter();
+
+  HeapProfilePprofExporter(const HeapProfilePprofExporter&) = delete;
+  HeapProfilePprofExporter& operator=(const HeapProfilePprofExporter&) = delete;
+
+  // Sampling interval the samples were collected with, in bytes. Reported as
+  // the period of the profile.
+  void set_sampling_interval(size_t sampling_interval) {
+    sampling_interval_ = sampling_interval;
+  }
+
+  // Adds the thread name and allocation context of samples as labels. Samples
+  // with different labels are not aggregated together.
+  void set_record_labels(bool record_labels) { record_labels_ = record_labels; }
+
+  void set_symbolize_callback(SymbolizeCallback symbolize_callback) {
+    symbolize_callback_ = std::move(symbolize_callback);
+  }
+
+  // Returns the serialized profile for |samples|.
+  std::string Export(const std::vector<SamplingHeapProfiler::Sample>& samples);
+
+ private:
+  const raw_ptr<ModuleCache> module_cache_;
+  size_t sampling_interval_ = 0;
+  bool record_labels_ = false;
+  SymbolizeCallback symbolize_callback_;
+};
+
+}  // namespace base
+
+#endif  // BASE_SAMPLING_HEAP_PROFILER_HEAP_PROFILE_PPROF_EXPORTER_H_
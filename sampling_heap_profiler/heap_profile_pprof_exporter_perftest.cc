@@ -0,0 +1,99 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/sampling_heap_profiler/heap_profile_pprof_exporter.h"
+
+#include <string>
+#include <vector>
+
+#include "base/compiler_specific.h"
+#include "base/rand_util.h"
+#include "base/timer/lap_timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace base {
+
+namespace {
+
+constexpr char kMetricPrefixPprofExporter[] = "HeapProfilePprofExporter.";
+constexpr char kMetricExportTime[] = "export_time";
+constexpr char kMetricTimePerSample[] = "time_per_sample";
+constexpr char kMetricProfileSize[] = "profile_size";
+
+constexpr size_t kNumSamples = 100000;
+constexpr size_t kNumStacks = 5000;
+constexpr size_t kStackDepth = 24;
+// Number of distinct return addresses the stacks are built from.
+constexpr size_t kNumFrames = 20000;
+
+perf_test::PerfResultReporter SetUpReporter(const std::string& story_name) {
+  perf_test::PerfResultReporter reporter(kMetricPrefixPprofExporter,
+                                         story_name);
+  reporter.RegisterImportantMetric(kMetricExportTime, "ms");
+  reporter.RegisterImportantMetric(kMetricTimePerSample, "ns");
+  reporter.RegisterImportantMetric(kMetricProfileSize, "bytes");
+  return reporter;
+}
+
+NOINLINE void FunctionInThisModule() {}
+
+// Returns |kNumSamples| samples spread over |kNumStacks| distinct stacks, whose
+// frames point into this module, like real ones would.
+std::vector<SamplingHeapProfiler::Sample> MakeSamples() {
+  const uintptr_t text = reinterpret_cast<uintptr_t>(&FunctionInThisModule);
+  std::vector<std::vector<const void*>> stacks(kNumStacks);
+  for (auto& stack : stacks) {
+    // Stacks share their outermost frames, as they would in a real program.
+    for (size_t depth = 0; depth < kStackDepth; ++depth) {
+      const size_t frame =
+          RandGenerator(kNumFrames * (depth + 1) / kStackDepth);
+      stack.push_back(reinterpret_cast<const void*>(text + frame * 16));
+    }
+  }
+
+  std::vector<SamplingHeapProfiler::Sample> samples;
+  samples.reserve(kNumSamples);
+  for (size_t i = 0; i < kNumSamples; ++i) {
+    const size_t size = 16 + RandGenerator(4096);
+    SamplingHeapProfiler::Sample sample(size, size + 128 * 1024, i);
+    sample.stack = stacks[RandGenerator(kNumStacks)];
+    samples.push_back(std::move(sample));
+  }
+  return samples;
+}
+
+void RunExport(const std::string& story_name, bool record_labels) {
+  const auto samples = MakeSamples();
+  ModuleCache module_cache;
+  HeapProfilePprofExporter exporter(&module_cache);
+  exporter.set_sampling_interval(128 * 1024);
+  exporter.set_record_labels(record_labels);
+
+  size_t profile_size = 0;
+  LapTimer timer(/*warmup_laps=*/1, Seconds(2), /*check_interval=*/1);
+  timer.Start();
+  do {
+    profile_size = exporter.Export(samples).size();
+    timer.NextLap();
+  } while (!timer.HasTimeLimitExpired());
+
+  auto reporter = SetUpReporter(story_name);
+  reporter.AddResult(kMetricExportTime, timer.TimePerLap().InMillisecondsF());
+  reporter.AddResult(kMetricTimePerSample,
+                     timer.TimePerLap().InMicrosecondsF() * 1000 / kNumSamples);
+  reporter.AddResult(kMetricProfileSize, profile_size);
+}
+
+}  // namespace
+
+TEST(HeapProfilePprofExporterPerfTest, Export) {
+  RunExport("no_labels", /*record_labels=*/false);
+}
+
+TEST(HeapProfilePprofExporterPerfTest, ExportWithLabels) {
+  RunExport("labels", /*record_labels=*/true);
+}
+
+}  // namespace base
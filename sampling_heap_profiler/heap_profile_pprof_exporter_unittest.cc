@@ -0,0 +1,248 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/sampling_heap_profiler/heap_profile_pprof_exporter.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/check.h"
+#include "base/compiler_specific.h"
+#include "base/functional/bind.h"
+#include "base/strings/string_piece.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Just enough of a protocol buffer decoder to check the profile.
+struct Field {
+  uint32_t number = 0;
+  uint64_t varint = 0;
+  std::string bytes;
+};
+
+uint64_t ReadVarint(StringPiece& data) {
+  uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    CHECK(!data.empty());
+    uint8_t byte = static_cast<uint8_t>(data[0]);
+    data.remove_prefix(1);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+}
+
+std::vector<Field> ParseMessage(StringPiece data) {
+  std::vector<Field> fields;
+  while (!data.empty()) {
+    uint64_t tag = ReadVarint(data);
+    Field field;
+    field.number = static_cast<uint32_t>(tag >> 3);
+    switch (tag & 7) {
+      case 0:
+        field.varint = ReadVarint(data);
+        break;
+      case 2: {
+        size_t size = ReadVarint(data);
+        CHECK_LE(size, data.size());
+        field.bytes = std::string(data.substr(0, size));
+        data.remove_prefix(size);
+        break;
+      }
+      default:
+        ADD_FAILURE() << "Unexpected wire type " << (tag & 7);
+        return fields;
+    }
+    fields.push_back(std::move(field));
+  }
+  return fields;
+}
+
+std::vector<uint64_t> ParsePacked(StringPiece data) {
+  std::vector<uint64_t> values;
+  while (!data.empty()) {
+    values.push_back(ReadVarint(data));
+  }
+  return values;
+}
+
+std::vector<std::string> GetFields(const std::vector<Field>& fields,
+                                   uint32_t number) {
+  std::vector<std::string> result;
+  for (const Field& field : fields) {
+    if (field.number == number) {
+      result.push_back(field.bytes);
+    }
+  }
+  return result;
+}
+
+uint64_t GetVarint(const std::vector<Field>& fields, uint32_t number) {
+  for (const Field& field : fields) {
+    if (field.number == number) {
+      return field.varint;
+    }
+  }
+  return 0;
+}
+
+// Field numbers from profile.proto.
+constexpr uint32_t kProfileSample = 2;
+constexpr uint32_t kProfileMapping = 3;
+constexpr uint32_t kProfileLocation = 4;
+constexpr uint32_t kProfileFunction = 5;
+constexpr uint32_t kProfileStringTable = 6;
+constexpr uint32_t kProfilePeriod = 12;
+
+SamplingHeapProfiler::Sample MakeSample(size_t size,
+                                        size_t total,
+                                        std::vector<const void*> stack) {
+  SamplingHeapProfiler::Sample sample(size, total, /*ordinal=*/0);
+  sample.stack = std::move(stack);
+  return sample;
+}
+
+const void* FrameAt(uintptr_t address) {
+  return reinterpret_cast<const void*>(address);
+}
+
+NOINLINE void FunctionInThisModule() {}
+
+}  // namespace
+
+class HeapProfilePprofExporterTest : public ::testing::Test {
+ protected:
+  ModuleCache module_cache_;
+  HeapProfilePprofExporter exporter_{&module_cache_};
+};
+
+TEST_F(HeapProfilePprofExporterTest, AggregatesSamplesByStack) {
+  std::vector<SamplingHeapProfiler::Sample> samples;
+  samples.push_back(MakeSample(100, 1000, {FrameAt(0x10), FrameAt(0x20)}));
+  samples.push_back(MakeSample(100, 1000, {FrameAt(0x10), FrameAt(0x20)}));
+  samples.push_back(MakeSample(50, 500, {FrameAt(0x10), FrameAt(0x30)}));
+  exporter_.set_sampling_interval(1024);
+
+  auto profile = ParseMessage(exporter_.Export(samples));
+  EXPECT_EQ(1024u, GetVarint(profile, kProfilePeriod));
+  auto strings = GetFields(profile, kProfileStringTable);
+  ASSERT_FALSE(strings.empty());
+  EXPECT_EQ("", strings[0]);
+
+  auto pprof_samples = GetFields(profile, kProfileSample);
+  ASSERT_EQ(2u, pprof_samples.size());
+  // Three distinct addresses.
+  EXPECT_EQ(3u, GetFields(profile, kProfileLocation).size());
+
+  bool found_aggregated = false;
+  for (const std::string& pprof_sample : pprof_samples) {
+    auto fields = ParseMessage(pprof_sample);
+    auto location_ids = ParsePacked(GetFields(fields, 1).at(0));
+    EXPECT_EQ(2u, location_ids.size());
+    auto values = ParsePacked(GetFields(fields, 2).at(0));
+    ASSERT_EQ(2u, values.size());
+    if (values[1] == 2000u) {
+      EXPECT_EQ(20u, values[0]);
+      found_aggregated = true;
+    } else {
+      EXPECT_EQ(500u, values[1]);
+      EXPECT_EQ(10u, values[0]);
+    }
+  }
+  EXPECT_TRUE(found_aggregated);
+}
+
+TEST_F(HeapProfilePprofExporterTest, MapsFramesToModules) {
+  const uintptr_t address = reinterpret_cast<uintptr_t>(&FunctionInThisModule);
+  const ModuleCache::Module* module =
+      module_cache_.GetModuleForAddress(address);
+  if (!module) {
+    GTEST_SKIP() << "No module for this binary";
+  }
+
+  std::vector<SamplingHeapProfiler::Sample> samples;
+  samples.push_back(MakeSample(8, 8, {FrameAt(address)}));
+  auto profile = ParseMessage(exporter_.Export(samples));
+  auto strings = GetFields(profile, kProfileStringTable);
+
+  auto mappings = GetFields(profile, kProfileMapping);
+  ASSERT_EQ(1u, mappings.size());
+  auto mapping = ParseMessage(mappings[0]);
+  EXPECT_EQ(1u, GetVarint(mapping, 1));
+  EXPECT_LE(GetVarint(mapping, 2), address);
+  EXPECT_GT(GetVarint(mapping, 3), address);
+  EXPECT_EQ(module->GetId(), strings.at(GetVarint(mapping, 6)));
+
+  auto location = ParseMessage(GetFields(profile, kProfileLocation).at(0));
+  EXPECT_EQ(1u, GetVarint(location, 2));
+  EXPECT_EQ(address, GetVarint(location, 3));
+}
+
+TEST_F(HeapProfilePprofExporterTest, RecordsLabels) {
+  static const char kThreadA[] = "ThreadA";
+  static const char kThreadB[] = "ThreadB";
+  std::vector<SamplingHeapProfiler::Sample> samples;
+  samples.push_back(MakeSample(16, 16, {FrameAt(0x10)}));
+  samples.back().thread_name = kThreadA;
+  samples.push_back(MakeSample(16, 16, {FrameAt(0x10)}));
+  samples.back().thread_name = kThreadB;
+
+  // Without labels, both samples are merged.
+  auto profile = ParseMessage(exporter_.Export(samples));
+  EXPECT_EQ(1u, GetFields(profile, kProfileSample).size());
+
+  exporter_.set_record_labels(true);
+  profile = ParseMessage(exporter_.Export(samples));
+  EXPECT_EQ(2u, GetFields(profile, kProfileSample).size());
+  auto strings = GetFields(profile, kProfileStringTable);
+  EXPECT_NE(strings.end(), std::find(strings.begin(), strings.end(), kThreadA));
+  EXPECT_NE(strings.end(), std::find(strings.begin(), strings.end(), kThreadB));
+}
+
+TEST_F(HeapProfilePprofExporterTest, Symbolizes) {
+  exporter_.set_symbolize_callback(BindRepeating(
+      [](uintptr_t address, const ModuleCache::Module* module)
+          -> absl::optional<HeapProfilePprofExporter::Symbol> {
+        if (address == 0x30) {
+          return absl::nullopt;
+        }
+        HeapProfilePprofExporter::Symbol symbol;
+        symbol.function_name = "Function";
+        symbol.file_name = "file.cc";
+        symbol.line = static_cast<int>(address);
+        return symbol;
+      }));
+  std::vector<SamplingHeapProfiler::Sample> samples;
+  samples.push_back(
+      MakeSample(16, 16, {FrameAt(0x10), FrameAt(0x20), FrameAt(0x30)}));
+
+  auto profile = ParseMessage(exporter_.Export(samples));
+  auto strings = GetFields(profile, kProfileStringTable);
+  // Both symbolized addresses share the same function.
+  auto functions = GetFields(profile, kProfileFunction);
+  ASSERT_EQ(1u, functions.size());
+  auto function = ParseMessage(functions[0]);
+  EXPECT_EQ("Function", strings.at(GetVarint(function, 2)));
+  EXPECT_EQ("file.cc", strings.at(GetVarint(function, 4)));
+
+  for (const std::string& location : GetFields(profile, kProfileLocation)) {
+    auto fields = ParseMessage(location);
+    auto lines = GetFields(fields, 4);
+    if (GetVarint(fields, 3) == 0x30) {
+      EXPECT_TRUE(lines.empty());
+      continue;
+    }
+    ASSERT_EQ(1u, lines.size());
+    auto line = ParseMessage(lines[0]);
+    EXPECT_EQ(GetVarint(function, 1), GetVarint(line, 1));
+    EXPECT_EQ(GetVarint(fields, 3), GetVarint(line, 2));
+  }
+}
+
+}  // namespace base
@@ -7,59 +7,191 @@
 #include <limits>
 
 #include "base/bits.h"
-#include "base/containers/contains.h"
 
 namespace base {
 
 LockFreeAddressHashSet::LockFreeAddressHashSet(size_t buckets_count)
-    : buckets_(buckets_count), bucket_mask_(buckets_count - 1) {
+    : initial_buckets_(std::make_unique<std::atomic<Node*>[]>(buckets_count)),
+      state_(static_cast<uint64_t>(buckets_count - 1) << kMaskShift),
+      initial_buckets_count_(buckets_count) {
   DCHECK(bits::IsPowerOfTwo(buckets_count));
-  DCHECK_LE(bucket_mask_, std::numeric_limits<uint32_t>::max());
+  DCHECK_LE(buckets_count - 1, std::numeric_limits<uint32_t>::max());
 }
 
 LockFreeAddressHashSet::~LockFreeAddressHashSet() {
-  for (std::atomic<Node*>& bucket : buckets_) {
-    Node* node = bucket.load(std::memory_order_relaxed);
+  const size_t buckets_count = buckets_in_use();
+  for (size_t i = 0; i < buckets_count; ++i) {
+    Node* node = bucket(i).load(std::memory_order_relaxed);
     while (node) {
-      Node* next = node->next;
+      Node* next = node->next.load(std::memory_order_relaxed);
       delete node;
       node = next;
     }
   }
+  for (Node* node : unlinked_nodes_)
+    delete node;
+  for (Node* node : free_nodes_)
+    delete node;
 }
 
 void LockFreeAddressHashSet::Insert(void* key) {
   DCHECK_NE(key, nullptr);
   CHECK(!Contains(key));
   ++size_;
+  InsertIntoBucket(
+      BucketIndex(Hash(key), state_.load(std::memory_order_relaxed)), key);
+  if (UNLIKELY(is_resizing())) {
+    SplitBuckets(kBucketsSplitPerOperation);
+  }
+}
+
+void LockFreeAddressHashSet::Grow() {
+  DCHECK(!is_resizing());
+  const uint64_t state = state_.load(std::memory_order_relaxed);
+  const size_t buckets_count = BaseBucketsCount(state);
+  // Splits must fit in the lower bits of |state_|.
+  CHECK_LE(buckets_count, kSplitBucketsMask);
+  // Readers only access the new segment once a split is published, which
+  // happens after this.
+  segments_[bits::Log2Floor(static_cast<uint32_t>(buckets_count))] =
+      std::make_unique<std::atomic<Node*>[]>(buckets_count);
+  // Readers which were iterating over the nodes unlinked by the previous
+  // resize loaded |state_| before it completed. Changing it again makes sure
+  // they look again if they are affected by these nodes being reused.
+  free_nodes_.insert(free_nodes_.end(), unlinked_nodes_.begin(),
+                     unlinked_nodes_.end());
+  unlinked_nodes_.clear();
+  state_.store(state | kResizingBit, std::memory_order_release);
+}
+
+void LockFreeAddressHashSet::Copy(const LockFreeAddressHashSet& other) {
+  DCHECK_EQ(0u, size());
+  const size_t buckets_count = other.buckets_in_use();
+  for (size_t i = 0; i < buckets_count; ++i) {
+    for (Node* node = other.bucket(i).load(std::memory_order_relaxed); node;
+         node = node->next.load(std::memory_order_relaxed)) {
+      void* key = node->key.load(std::memory_order_relaxed);
+      if (key)
+        Insert(key);
+    }
+  }
+}
+
+bool LockFreeAddressHashSet::ContainsAfterStateChange(void* key,
+                                                      uint32_t hash,
+                                                      size_t index,
+                                                      uint64_t state) const {
+  // Splits only ever move keys to buckets with a larger index, and clear them
+  // from their previous bucket after the split is published. Nodes are only
+  // reused after |Grow| changes the upper bits of |state_|. So if neither the
+  // bucket |key| maps to nor the upper bits of |state_| changed, missing |key|
+  // wasn't caused by a concurrent split. Otherwise, look again: the index can
+  // only increase 32 times, and the upper bits of |state_| change 64 times,
+  // which bounds the number of iterations.
+  while (true) {
+    const uint64_t new_state = state_.load(std::memory_order_acquire);
+    const size_t new_index = BucketIndex(hash, new_state);
+    if (new_index == index &&
+        (new_state >> kEpochShift) == (state >> kEpochShift)) {
+      return false;
+    }
+    state = new_state;
+    index = new_index;
+    if (FindNodeInBucket(index, key)) {
+      return true;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+}
+
+void LockFreeAddressHashSet::InsertIntoBucket(size_t index, void* key) {
   // Note: There's no need to use std::atomic_compare_exchange here,
   // as we do not support concurrent inserts, so values cannot change midair.
-  std::atomic<Node*>& bucket = buckets_[Hash(key) & bucket_mask_];
+  std::atomic<Node*>& bucket = this->bucket(index);
   Node* node = bucket.load(std::memory_order_relaxed);
   // First iterate over the bucket nodes and try to reuse an empty one if found.
-  for (; node != nullptr; node = node->next) {
+  for (; node != nullptr; node = node->next.load(std::memory_order_relaxed)) {
     if (node->key.load(std::memory_order_relaxed) == nullptr) {
       node->key.store(key, std::memory_order_relaxed);
       return;
     }
   }
   // There are no empty nodes to reuse left in the bucket.
-  // Create a new node first...
-  Node* new_node = new Node(key, bucket.load(std::memory_order_relaxed));
+  // Take a free node or create a new one first...
+  Node* new_node;
+  if (!free_nodes_.empty()) {
+    new_node = free_nodes_.back();
+    free_nodes_.pop_back();
+    // Readers that may still be iterating over the node must synchronize with
+    // these writes if they observe them, hence the release ordering.
+    new_node->key.store(key, std::memory_order_release);
+    new_node->next.store(bucket.load(std::memory_order_relaxed),
+                         std::memory_order_release);
+  } else {
+    new_node = new Node(key, bucket.load(std::memory_order_relaxed));
+  }
   // ... and then publish the new chain.
   bucket.store(new_node, std::memory_order_release);
 }
 
-void LockFreeAddressHashSet::Copy(const LockFreeAddressHashSet& other) {
-  DCHECK_EQ(0u, size());
-  for (const std::atomic<Node*>& bucket : other.buckets_) {
-    for (Node* node = bucket.load(std::memory_order_relaxed); node;
-         node = node->next) {
-      void* key = node->key.load(std::memory_order_relaxed);
-      if (key)
-        Insert(key);
+void LockFreeAddressHashSet::SplitBuckets(size_t count) {
+  DCHECK(is_resizing());
+  for (; count && is_resizing(); --count) {
+    const uint64_t state = state_.load(std::memory_order_relaxed);
+    const size_t base_count = BaseBucketsCount(state);
+    const size_t index = state & kSplitBucketsMask;
+    SplitBucket(index, base_count);
+  }
+}
+
+void LockFreeAddressHashSet::SplitBucket(size_t index, size_t base_count) {
+  const size_t new_mask = 2 * base_count - 1;
+  std::atomic<Node*>& bucket = this->bucket(index);
+  // Copy the keys that now belong to the new bucket...
+  for (Node* node = bucket.load(std::memory_order_relaxed); node;
+       node = node->next.load(std::memory_order_relaxed)) {
+    void* key = node->key.load(std::memory_order_relaxed);
+    if (key && (Hash(key) & new_mask) != index) {
+      InsertIntoBucket(index + base_count, key);
     }
   }
+
+  // ... publish the split, which makes the copies visible to the readers that
+  // look keys up in the new bucket...
+  const uint64_t state = state_.load(std::memory_order_relaxed);
+  if (index + 1 == base_count) {
+    state_.store(static_cast<uint64_t>(new_mask) << kMaskShift,
+                 std::memory_order_release);
+  } else {
+    state_.store(state + 1, std::memory_order_release);
+  }
+
+  // ... and only then clear them from the old one. Readers that miss a key
+  // because of this synchronize with the release store, so they see the
+  // split and look again in the new bucket. Empty nodes are unlinked; readers
+  // iterating over them can still follow their next pointer.
+  std::atomic<Node*>* link = &bucket;
+  Node* node = bucket.load(std::memory_order_relaxed);
+  while (node) {
+    Node* next = node->next.load(std::memory_order_relaxed);
+    void* key = node->key.load(std::memory_order_relaxed);
+    if (key && (Hash(key) & new_mask) != index) {
+      node->key.store(nullptr, std::memory_order_release);
+      key = nullptr;
+    }
+    if (key) {
+      link = &node->next;
+    } else {
+      link->store(next, std::memory_order_release);
+      unlinked_nodes_.push_back(node);
+    }
+    node = next;
+  }
+}
+
+size_t LockFreeAddressHashSet::buckets_in_use() const {
+  const uint64_t state = state_.load(std::memory_order_relaxed);
+  return BaseBucketsCount(state) + (state & kSplitBucketsMask);
 }
 
 }  // namespace base
@@ -5,32 +5,31 @@
 #ifndef BASE_SAMPLING_HEAP_PROFILER_LOCK_FREE_ADDRESS_HASH_SET_H_
 #define BASE_SAMPLING_HEAP_PROFILER_LOCK_FREE_ADDRESS_HASH_SET_H_
 
+#include <array>
 #include <atomic>
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "base/base_export.h"
+#include "base/bits.h"
 #include "base/check_op.h"
 #include "base/compiler_specific.h"
-#include "base/memory/raw_ptr_exclusion.h"
 
 namespace base {
 
 // A hash set container that provides lock-free version of |Contains| operation.
-// It does not support concurrent write operations |Insert| and |Remove|.
-// All write operations if performed from multiple threads must be properly
-// guarded with a lock.
+// It does not support concurrent write operations |Insert|, |Remove| and
+// |Grow|. All write operations if performed from multiple threads must be
+// properly guarded with a lock.
 // |Contains| method can be executed concurrently with other |Insert|, |Remove|,
-// or |Contains| even over the same key.
+// |Grow| or |Contains| even over the same key, and is wait-free.
 // However, please note the result of concurrent execution of |Contains|
 // with |Insert| or |Remove| over the same key is racy.
 //
-// The hash set never rehashes, so the number of buckets stays the same
-// for the lifetime of the set.
-//
-// Internally the hashset is implemented as a vector of N buckets
-// (N has to be a power of 2). Each bucket holds a single-linked list of
-// nodes each corresponding to a key.
+// Internally the hashset is implemented as N buckets (N has to be a power
+// of 2). Each bucket holds a single-linked list of nodes each corresponding
+// to a key.
 // It is not possible to really delete nodes from the list as there might
 // be concurrent reads being executed over the node. The |Remove| operation
 // just marks the node as empty by placing nullptr into its key field.
@@ -42,35 +41,67 @@ namespace base {
 // 2: {*}--> {NULL,*}--> {key3,*}--> {key4,*}--> NULL
 // ...
 // N-1: {*}--> {keyM,*}--> NULL
+//
+// |Grow| doubles the number of buckets incrementally, using linear hashing:
+// subsequent write operations each split a couple of buckets i < N into
+// buckets i and i + N, until all of them are split. Splitting a bucket copies
+// the keys that now belong to bucket i + N there, publishes the split, and
+// only then clears them from bucket i. Empty nodes of bucket i are unlinked at
+// that point, so that chains stay short, but as readers may still be
+// iterating over them, they are only reused for new keys after the next call
+// to |Grow|. Readers that miss a key notice when a split or a |Grow| happened
+// concurrently, and look again; this can only happen a bounded number of
+// times, as the set can't grow more than 32 times.
+// Bucket arrays are allocated as segments of growing size that are never
+// reallocated, so no bucket array has to be reclaimed while readers may still
+// access it. All the memory is freed by the destructor.
 class BASE_EXPORT LockFreeAddressHashSet {
  public:
   explicit LockFreeAddressHashSet(size_t buckets_count);
   ~LockFreeAddressHashSet();
 
   // Checks if the |key| is in the set. Can be executed concurrently with
-  // |Insert|, |Remove|, and |Contains| operations.
+  // |Insert|, |Remove|, |Grow| and |Contains| operations.
   ALWAYS_INLINE bool Contains(void* key) const;
 
   // Removes the |key| from the set. The key must be present in the set before
   // the invocation.
-  // Concurrent execution of |Insert|, |Remove|, or |Copy| is not supported.
+  // Concurrent execution of |Insert|, |Remove|, |Grow| or |Copy| is not
+  // supported.
   ALWAYS_INLINE void Remove(void* key);
 
   // Inserts the |key| into the set. The key must not be present in the set
   // before the invocation.
-  // Concurrent execution of |Insert|, |Remove|, or |Copy| is not supported.
+  // Concurrent execution of |Insert|, |Remove|, |Grow| or |Copy| is not
+  // supported.
   void Insert(void* key);
 
+  // Starts doubling the number of buckets. The buckets are split by the
+  // following |Insert| and |Remove| operations, a few at a time. Must not be
+  // called while a previous resize is still in progress.
+  // Concurrent execution of |Insert|, |Remove|, |Grow| or |Copy| is not
+  // supported.
+  void Grow();
+
   // Copies contents of |other| set into the current set. The current set
   // must be empty before the call.
-  // Concurrent execution of |Insert|, |Remove|, or |Copy| is not supported.
+  // Concurrent execution of |Insert|, |Remove|, |Grow| or |Copy| is not
+  // supported.
   void Copy(const LockFreeAddressHashSet& other);
 
-  size_t buckets_count() const { return buckets_.size(); }
+  // Returns the number of buckets, including the ones that are still being
+  // split into while resizing.
+  size_t buckets_count() const {
+    return BaseBucketsCount(state_.load(std::memory_order_relaxed))
+           << (is_resizing() ? 1 : 0);
+  }
   size_t size() const { return size_; }
+  bool is_resizing() const {
+    return state_.load(std::memory_order_relaxed) & kResizingBit;
+  }
 
   // Returns the average bucket utilization.
-  float load_factor() const { return 1.f * size() / buckets_.size(); }
+  float load_factor() const { return 1.f * size() / buckets_count(); }
 
  private:
   friend class LockFreeAddressHashSetTest;
@@ -78,25 +109,81 @@ class BASE_EXPORT LockFreeAddressHashSet {
   struct Node {
     ALWAYS_INLINE Node(void* key, Node* next);
     std::atomic<void*> key;
-    // This field is not a raw_ptr<> to avoid out-of-line destructor.
-    RAW_PTR_EXCLUSION Node* next;
+    // Atomic, as unlinked nodes may be reused while readers are iterating
+    // over them.
+    std::atomic<Node*> next;
   };
 
+  // Each resize adds a segment of buckets, as large as all the previous ones.
+  // The hash has 32 bits, so the number of buckets never exceeds 2^32.
+  static constexpr size_t kMaxSegments = 32;
+  // Number of buckets split by each write operation while resizing. This
+  // makes sure a resize completes well before the set needs to grow again.
+  static constexpr size_t kBucketsSplitPerOperation = 2;
+
+  // |state_| packs the mask of the buckets in use before the current resize
+  // into its upper 32 bits, whether a resize is in progress into bit 31, and
+  // the number of buckets already split by the current resize into its lower
+  // 31 bits. The upper 33 bits change on every |Grow| and completed resize.
+  static constexpr int kMaskShift = 32;
+  static constexpr int kEpochShift = 31;
+  static constexpr uint64_t kResizingBit = uint64_t{1} << kEpochShift;
+  static constexpr uint64_t kSplitBucketsMask = kResizingBit - 1;
+
   ALWAYS_INLINE static uint32_t Hash(void* key);
+  ALWAYS_INLINE static size_t BaseBucketsCount(uint64_t state);
+  ALWAYS_INLINE static size_t BucketIndex(uint32_t hash, uint64_t state);
+  ALWAYS_INLINE std::atomic<Node*>& bucket(size_t index) const;
   ALWAYS_INLINE Node* FindNode(void* key) const;
+  ALWAYS_INLINE Node* FindNodeInBucket(size_t index, void* key) const;
+
+  // Slow path of |Contains|, when |state_| changed from |state| while looking
+  // up |key| in bucket |index|.
+  NOINLINE bool ContainsAfterStateChange(void* key,
+                                         uint32_t hash,
+                                         size_t index,
+                                         uint64_t state) const;
+  void InsertIntoBucket(size_t index, void* key);
+  void SplitBuckets(size_t count);
+  void SplitBucket(size_t index, size_t base_count);
+  // Returns the number of buckets readers may currently look keys up in.
+  size_t buckets_in_use() const;
 
-  std::vector<std::atomic<Node*>> buckets_;
+  // Buckets [0, initial_buckets_count_) are in |initial_buckets_|, and the
+  // ones added by resizes are in |segments_|, where segment i holds buckets
+  // [2^i, 2^(i + 1)).
+  const std::unique_ptr<std::atomic<Node*>[]> initial_buckets_;
+  std::array<std::unique_ptr<std::atomic<Node*>[]>, kMaxSegments> segments_;
+  std::atomic<uint64_t> state_;
+  // Nodes unlinked by the current resize, which readers may still access.
+  std::vector<Node*> unlinked_nodes_;
+  // Nodes unlinked by previous resizes, which can be reused.
+  std::vector<Node*> free_nodes_;
   size_t size_ = 0;
-  const size_t bucket_mask_;
+  const size_t initial_buckets_count_;
 };
 
-ALWAYS_INLINE LockFreeAddressHashSet::Node::Node(void* key, Node* next)
-    : next(next) {
+ALWAYS_INLINE LockFreeAddressHashSet::Node::Node(void* key, Node* next) {
   this->key.store(key, std::memory_order_relaxed);
+  this->next.store(next, std::memory_order_relaxed);
 }
 
 ALWAYS_INLINE bool LockFreeAddressHashSet::Contains(void* key) const {
-  return FindNode(key) != nullptr;
+  DCHECK_NE(key, nullptr);
+  const uint32_t hash = Hash(key);
+  const uint64_t state = state_.load(std::memory_order_acquire);
+  const size_t index = BucketIndex(hash, state);
+  if (FindNodeInBucket(index, key)) {
+    return true;
+  }
+  // If the key was cleared from the bucket by a split, or a node was reused
+  // while iterating over it, synchronize with that write so that the state
+  // change preceding it becomes visible below. This is free on x86.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (LIKELY(state_.load(std::memory_order_relaxed) == state)) {
+    return false;
+  }
+  return ContainsAfterStateChange(key, hash, index, state);
 }
 
 ALWAYS_INLINE void LockFreeAddressHashSet::Remove(void* key) {
@@ -107,19 +194,54 @@ ALWAYS_INLINE void LockFreeAddressHashSet::Remove(void* key) {
   // Instead we just mark it as empty, so |Insert| can reuse it later.
   node->key.store(nullptr, std::memory_order_relaxed);
   --size_;
+  if (UNLIKELY(is_resizing())) {
+    SplitBuckets(kBucketsSplitPerOperation);
+  }
+}
+
+// static
+ALWAYS_INLINE size_t LockFreeAddressHashSet::BaseBucketsCount(uint64_t state) {
+  return static_cast<size_t>(state >> kMaskShift) + 1;
+}
+
+// static
+ALWAYS_INLINE size_t LockFreeAddressHashSet::BucketIndex(uint32_t hash,
+                                                         uint64_t state) {
+  const uint32_t mask = static_cast<uint32_t>(state >> kMaskShift);
+  const uint32_t index = hash & mask;
+  if (index < (state & kSplitBucketsMask)) {
+    // The bucket was already split by the current resize.
+    return hash & (2 * mask + 1);
+  }
+  return index;
+}
+
+ALWAYS_INLINE std::atomic<LockFreeAddressHashSet::Node*>&
+LockFreeAddressHashSet::bucket(size_t index) const {
+  if (index < initial_buckets_count_) {
+    return initial_buckets_[index];
+  }
+  const int segment = bits::Log2Floor(static_cast<uint32_t>(index));
+  return segments_[segment][index ^ (size_t{1} << segment)];
 }
 
 ALWAYS_INLINE LockFreeAddressHashSet::Node* LockFreeAddressHashSet::FindNode(
     void* key) const {
   DCHECK_NE(key, nullptr);
-  const std::atomic<Node*>& bucket = buckets_[Hash(key) & bucket_mask_];
+  return FindNodeInBucket(
+      BucketIndex(Hash(key), state_.load(std::memory_order_relaxed)), key);
+}
+
+ALWAYS_INLINE LockFreeAddressHashSet::Node*
+LockFreeAddressHashSet::FindNodeInBucket(size_t index, void* key) const {
+  const std::atomic<Node*>& bucket = this->bucket(index);
   // It's enough to use std::memory_order_consume ordering here, as the
   // node->next->...->next loads form dependency chain.
   // However std::memory_order_consume is temporary deprecated in C++17.
   // See https://isocpp.org/files/papers/p0636r0.html#removed
   // Make use of more strong std::memory_order_acquire for now.
   for (Node* node = bucket.load(std::memory_order_acquire); node != nullptr;
-       node = node->next) {
+       node = node->next.load(std::memory_order_relaxed)) {
     if (node->key.load(std::memory_order_relaxed) == key)
       return node;
   }
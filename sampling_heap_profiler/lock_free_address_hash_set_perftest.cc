@@ -0,0 +1,158 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/sampling_heap_profiler/lock_free_address_hash_set.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/memory/raw_ptr.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace base {
+namespace {
+
+constexpr char kMetricPrefixHashSet[] = "LockFreeAddressHashSet.";
+constexpr char kMetricContainsThroughput[] = "contains_throughput";
+constexpr char kMetricMaxInsertTime[] = "max_insert_time";
+
+// Each thread samples one allocation out of |kSampleRate|, and checks all the
+// others against the set, like PoissonAllocationSampler does on free.
+constexpr size_t kOperationsPerThread = 1 << 21;
+constexpr size_t kSampleRate = 64;
+// Number of sampled allocations each thread keeps alive.
+constexpr size_t kLiveSamplesPerThread = 2048;
+
+perf_test::PerfResultReporter SetUpReporter(const std::string& story_name) {
+  perf_test::PerfResultReporter reporter(kMetricPrefixHashSet, story_name);
+  reporter.RegisterImportantMetric(kMetricContainsThroughput, "runs/s");
+  reporter.RegisterImportantMetric(kMetricMaxInsertTime, "us");
+  return reporter;
+}
+
+// Grows the set the same way PoissonAllocationSampler does.
+void MaybeGrow(LockFreeAddressHashSet& set) {
+  if (set.load_factor() >= 1 && !set.is_resizing()) {
+    set.Grow();
+  }
+}
+
+class AllocatingThread : public PlatformThread::Delegate {
+ public:
+  AllocatingThread(LockFreeAddressHashSet* set,
+                   Lock* lock,
+                   size_t thread_index,
+                   size_t threads_count,
+                   std::atomic<bool>* start)
+      : set_(set),
+        lock_(lock),
+        thread_index_(thread_index),
+        threads_count_(threads_count),
+        start_(start) {}
+  ~AllocatingThread() override = default;
+
+  void ThreadMain() override {
+    while (!start_->load(std::memory_order_acquire)) {
+      PlatformThread::YieldCurrentThread();
+    }
+    std::vector<void*> live_samples;
+    live_samples.reserve(kLiveSamplesPerThread);
+    size_t found = 0;
+    for (size_t i = 0; i < kOperationsPerThread; ++i) {
+      // Fake, but unique, addresses.
+      void* address = reinterpret_cast<void*>(
+          (i * threads_count_ + thread_index_ + 1) * 16);
+      if (i % kSampleRate) {
+        found += set_->Contains(address);
+        continue;
+      }
+      const TimeTicks start = TimeTicks::Now();
+      {
+        AutoLock lock(*lock_);
+        set_->Insert(address);
+        MaybeGrow(*set_);
+        if (live_samples.size() == kLiveSamplesPerThread) {
+          set_->Remove(live_samples[i / kSampleRate % kLiveSamplesPerThread]);
+        }
+      }
+      max_insert_time_ = std::max(max_insert_time_, TimeTicks::Now() - start);
+      if (live_samples.size() < kLiveSamplesPerThread) {
+        live_samples.push_back(address);
+      } else {
+        live_samples[i / kSampleRate % kLiveSamplesPerThread] = address;
+      }
+    }
+    EXPECT_EQ(0u, found);
+  }
+
+  TimeDelta max_insert_time() const { return max_insert_time_; }
+
+ private:
+  raw_ptr<LockFreeAddressHashSet> set_;
+  raw_ptr<Lock> lock_;
+  const size_t thread_index_;
+  const size_t threads_count_;
+  raw_ptr<std::atomic<bool>> start_;
+  TimeDelta max_insert_time_;
+};
+
+void RunContentionTest(size_t threads_count, size_t initial_buckets_count) {
+  LockFreeAddressHashSet set(initial_buckets_count);
+  Lock lock;
+  std::atomic<bool> start(false);
+  std::vector<std::unique_ptr<AllocatingThread>> threads;
+  std::vector<PlatformThreadHandle> handles(threads_count);
+  for (size_t i = 0; i < threads_count; ++i) {
+    threads.push_back(std::make_unique<AllocatingThread>(
+        &set, &lock, i, threads_count, &start));
+    ASSERT_TRUE(PlatformThread::Create(0, threads.back().get(), &handles[i]));
+  }
+
+  const TimeTicks start_time = TimeTicks::Now();
+  start.store(true, std::memory_order_release);
+  TimeDelta max_insert_time;
+  for (size_t i = 0; i < threads_count; ++i) {
+    PlatformThread::Join(handles[i]);
+    max_insert_time = std::max(max_insert_time, threads[i]->max_insert_time());
+  }
+  const TimeDelta elapsed = TimeTicks::Now() - start_time;
+
+  const size_t contains_count =
+      threads_count * kOperationsPerThread * (kSampleRate - 1) / kSampleRate;
+  auto reporter = SetUpReporter(StringPrintf(
+      "%zu_threads_%s", threads_count,
+      initial_buckets_count == 1 ? "growing" : "presized"));
+  reporter.AddResult(kMetricContainsThroughput,
+                     contains_count / elapsed.InSecondsF());
+  reporter.AddResult(kMetricMaxInsertTime, max_insert_time.InMicrosecondsF());
+}
+
+}  // namespace
+
+class LockFreeAddressHashSetPerfTest
+    : public ::testing::TestWithParam<size_t> {};
+
+INSTANTIATE_TEST_SUITE_P(All,
+                         LockFreeAddressHashSetPerfTest,
+                         ::testing::Values<size_t>(1, 4, 16));
+
+// The set starts with a single bucket and grows while the threads run.
+TEST_P(LockFreeAddressHashSetPerfTest, Growing) {
+  RunContentionTest(GetParam(), 1);
+}
+
+// The set is already large enough for all the samples.
+TEST_P(LockFreeAddressHashSetPerfTest, Presized) {
+  RunContentionTest(GetParam(), 1 << 16);
+}
+
+}  // namespace base
@@ -21,11 +21,10 @@ class LockFreeAddressHashSetTest : public ::testing::Test {
  public:
   static bool IsSubset(const LockFreeAddressHashSet& superset,
                        const LockFreeAddressHashSet& subset) {
-    for (const std::atomic<LockFreeAddressHashSet::Node*>& bucket :
-         subset.buckets_) {
+    for (size_t i = 0; i < subset.buckets_in_use(); ++i) {
       for (LockFreeAddressHashSet::Node* node =
-               bucket.load(std::memory_order_acquire);
-           node; node = node->next) {
+               subset.bucket(i).load(std::memory_order_acquire);
+           node; node = node->next.load(std::memory_order_relaxed)) {
         void* key = node->key.load(std::memory_order_relaxed);
         if (key && !superset.Contains(key))
           return false;
@@ -42,11 +41,31 @@ class LockFreeAddressHashSetTest : public ::testing::Test {
   static size_t BucketSize(const LockFreeAddressHashSet& set, size_t bucket) {
     size_t count = 0;
     LockFreeAddressHashSet::Node* node =
-        set.buckets_[bucket].load(std::memory_order_acquire);
-    for (; node; node = node->next)
+        set.bucket(bucket).load(std::memory_order_acquire);
+    for (; node; node = node->next.load(std::memory_order_relaxed))
       ++count;
     return count;
   }
+
+  static size_t KeysCount(const LockFreeAddressHashSet& set) {
+    size_t count = 0;
+    for (size_t i = 0; i < set.buckets_in_use(); ++i) {
+      for (LockFreeAddressHashSet::Node* node =
+               set.bucket(i).load(std::memory_order_acquire);
+           node; node = node->next.load(std::memory_order_relaxed)) {
+        if (node->key.load(std::memory_order_relaxed))
+          ++count;
+      }
+    }
+    return count;
+  }
+
+  static size_t NodesCount(const LockFreeAddressHashSet& set) {
+    size_t count = 0;
+    for (size_t i = 0; i < set.buckets_in_use(); ++i)
+      count += BucketSize(set, i);
+    return count;
+  }
 };
 
 namespace {
@@ -179,5 +198,101 @@ TEST_F(LockFreeAddressHashSetTest, BucketsUsage) {
   }
 }
 
+TEST_F(LockFreeAddressHashSetTest, Grow) {
+  LockFreeAddressHashSet set(8);
+  for (size_t i = 1; i <= 16; ++i)
+    set.Insert(reinterpret_cast<void*>(i * 0x10));
+
+  set.Grow();
+  EXPECT_TRUE(set.is_resizing());
+  EXPECT_EQ(size_t(16), set.buckets_count());
+  EXPECT_EQ(1., set.load_factor());
+
+  // Buckets are split while inserting and removing keys.
+  size_t operations = 0;
+  for (size_t i = 17; set.is_resizing(); ++i, ++operations) {
+    set.Insert(reinterpret_cast<void*>(i * 0x10));
+    set.Remove(reinterpret_cast<void*>(i * 0x10));
+    for (size_t j = 1; j <= 16; ++j)
+      EXPECT_TRUE(set.Contains(reinterpret_cast<void*>(j * 0x10)));
+    // Keys are never duplicated across buckets.
+    EXPECT_EQ(set.size(), KeysCount(set));
+  }
+  EXPECT_EQ(size_t(2), operations);
+  EXPECT_EQ(size_t(16), set.buckets_count());
+  EXPECT_EQ(size_t(16), set.size());
+
+  for (size_t i = 1; i <= 16; ++i) {
+    void* ptr = reinterpret_cast<void*>(i * 0x10);
+    EXPECT_TRUE(set.Contains(ptr));
+    set.Remove(ptr);
+    EXPECT_FALSE(set.Contains(ptr));
+  }
+  EXPECT_EQ(size_t(0), set.size());
+}
+
+TEST_F(LockFreeAddressHashSetTest, GrowRepeatedly) {
+  LockFreeAddressHashSet set(1);
+  for (size_t i = 1; i <= 10000; ++i) {
+    set.Insert(reinterpret_cast<void*>(i));
+    if (set.load_factor() >= 1 && !set.is_resizing())
+      set.Grow();
+  }
+  EXPECT_EQ(size_t(10000), set.size());
+  EXPECT_EQ(size_t(16384), set.buckets_count());
+  EXPECT_EQ(size_t(10000), KeysCount(set));
+  // Splits unlink the nodes they empty.
+  EXPECT_EQ(size_t(10000), NodesCount(set));
+  for (size_t i = 1; i <= 10000; ++i)
+    EXPECT_TRUE(set.Contains(reinterpret_cast<void*>(i)));
+  EXPECT_FALSE(set.Contains(reinterpret_cast<void*>(10001)));
+
+  LockFreeAddressHashSet set2(4);
+  set2.Copy(set);
+  EXPECT_TRUE(Equals(set, set2));
+}
+
+class GrowingWriterThread : public SimpleThread {
+ public:
+  GrowingWriterThread(LockFreeAddressHashSet* set, std::atomic_bool* cancel)
+      : SimpleThread("GrowingWriterThread"), set_(set), cancel_(cancel) {}
+
+  void Run() override {
+    // Keeps growing the set, so that readers observe many splits.
+    for (size_t value = 0x100000; !cancel_->load(std::memory_order_acquire) &&
+                                  set_->buckets_count() < (1 << 20);
+         ++value) {
+      set_->Insert(reinterpret_cast<void*>(value));
+      if (value % 3 == 0)
+        set_->Remove(reinterpret_cast<void*>(value));
+      if (set_->load_factor() >= 1 && !set_->is_resizing())
+        set_->Grow();
+    }
+  }
+
+ private:
+  raw_ptr<LockFreeAddressHashSet> set_;
+  raw_ptr<std::atomic_bool> cancel_;
+};
+
+TEST_F(LockFreeAddressHashSetTest, ConcurrentGrowth) {
+  // Keys present in the set must be found while buckets are being split.
+  LockFreeAddressHashSet set(1);
+  for (size_t i = 1; i <= 1000; ++i)
+    set.Insert(reinterpret_cast<void*>(i * 8));
+
+  std::atomic_bool cancel(false);
+  auto thread = std::make_unique<GrowingWriterThread>(&set, &cancel);
+  thread->Start();
+
+  for (size_t k = 0; k < 1000; ++k) {
+    for (size_t i = 1; i <= 1000; ++i)
+      ASSERT_TRUE(set.Contains(reinterpret_cast<void*>(i * 8)));
+    EXPECT_FALSE(set.Contains(reinterpret_cast<void*>(0x1337)));
+  }
+  cancel.store(true, std::memory_order_release);
+  thread->Join();
+}
+
 }  // namespace
 }  // namespace base
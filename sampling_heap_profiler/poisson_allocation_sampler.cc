@@ -6,7 +6,6 @@
 
 #include <atomic>
 #include <cmath>
-#include <memory>
 #include <utility>
 
 #include "base/allocator/dispatcher/reentry_guard.h"
@@ -32,7 +31,7 @@ const intptr_t kAccumulatedBytesOffset = 1 << 29;
 // Controls if sample intervals should not be randomized. Used for testing.
 bool g_deterministic = false;
 
-// Pointer to the current |LockFreeAddressHashSet|.
+// Pointer to the |LockFreeAddressHashSet| of sampled addresses.
 ABSL_CONST_INIT std::atomic<LockFreeAddressHashSet*> g_sampled_addresses_set{
     nullptr};
 
@@ -334,25 +333,15 @@ void PoissonAllocationSampler::DoRecordFree(void* address) {
 }
 
 void PoissonAllocationSampler::BalanceAddressesHashSet() {
-  // Check if the load_factor of the current addresses hash set becomes higher
-  // than 1, allocate a new twice larger one, copy all the data,
-  // and switch to using it.
-  // During the copy process no other writes are made to both sets
-  // as it's behind the lock.
-  // All the readers continue to use the old one until the atomic switch
-  // process takes place.
+  // Check if the load_factor of the addresses hash set becomes higher than 1,
+  // and start growing it twice larger if so. The set splits its buckets
+  // incrementally on the following writes, which are all made behind the
+  // lock, while readers keep using it without locking.
   LockFreeAddressHashSet& current_set = sampled_addresses_set();
-  if (current_set.load_factor() < 1) {
+  if (current_set.load_factor() < 1 || current_set.is_resizing()) {
     return;
   }
-  auto new_set =
-      std::make_unique<LockFreeAddressHashSet>(current_set.buckets_count() * 2);
-  new_set->Copy(current_set);
-  // Atomically switch all the new readers to the new set.
-  g_sampled_addresses_set.store(new_set.release(), std::memory_order_release);
-  // We leak the older set because we still have to keep all the old maps alive
-  // as there might be reader threads that have already obtained the map,
-  // but haven't yet managed to access it.
+  current_set.Grow();
 }
 
 // static
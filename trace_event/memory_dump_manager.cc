@@ -19,9 +19,14 @@
 #include "base/debug/stack_trace.h"
 #include "base/logging.h"
 #include "base/memory/ptr_util.h"
+#include "base/memory/raw_ptr.h"
+#include "base/metrics/histogram_functions.h"
+#include "base/strings/strcat.h"
 #include "base/strings/string_util.h"
 #include "base/task/sequenced_task_runner.h"
 #include "base/task/single_thread_task_runner.h"
+#include "base/task/thread_pool.h"
+#include "base/task/thread_pool/thread_pool_instance.h"
 #include "base/third_party/dynamic_annotations/dynamic_annotations.h"
 #include "base/threading/thread.h"
 #include "base/trace_event/heap_profiler.h"
@@ -68,6 +73,179 @@ void DoGlobalDumpWithoutCallback(
 
 }  // namespace
 
+// Joins the groups of dump providers of a process dump which run concurrently:
+// each provider which supports concurrent dumps makes a group, and the others
+// one more. Each group dumps into a ProcessMemoryDump of its own, on the
+// sequence of its providers, and hands it back on the thread which requested
+// the dump, where the dumps are merged once all the groups are done. A provider
+// which spends longer than its timeout in OnMemoryDump() is left behind, and
+// its dump is dropped, as are the dumps of the groups queued after it on the
+// same task runner.
+class MemoryDumpManager::ProcessMemoryDumpJoin
+    : public RefCountedThreadSafe<ProcessMemoryDumpJoin> {
+ public:
+  ProcessMemoryDumpJoin(
+      MemoryDumpManager* mdm,
+      std::unique_ptr<ProcessMemoryDumpAsyncState> result_state)
+      : mdm_(mdm),
+        task_runner_(result_state->callback_task_runner),
+        result_state_(std::move(result_state)) {}
+
+  ProcessMemoryDumpJoin(const ProcessMemoryDumpJoin&) = delete;
+  ProcessMemoryDumpJoin& operator=(const ProcessMemoryDumpJoin&) = delete;
+
+  // Returns the index of a new group, whose providers may each spend |timeout|
+  // in OnMemoryDump(), or forever if it is TimeDelta::Max().
+  // |runs_after_previous_group| is true if the group runs on the same task
+  // runner as the previous one, and so can't start before that one is done.
+  size_t AddGroup(TimeDelta timeout, bool runs_after_previous_group) {
+    AutoLock lock(lock_);
+    DCHECK(!runs_after_previous_group || !groups_.empty());
+    groups_.emplace_back();
+    groups_.back().timeout = timeout;
+    groups_.back().runs_after_previous_group = runs_after_previous_group;
+    ++pending_group_count_;
+    return groups_.size() - 1;
+  }
+
+  // Called on the sequence of the group before it invokes a provider. Returns
+  // false if the group was left behind, in which case it should stop dumping.
+  bool WillInvokeProvider(size_t group_index, const char* provider_name) {
+    AutoLock lock(lock_);
+    Group& group = groups_[group_index];
+    if (group.done)
+      return false;
+    group.started = true;
+    group.in_provider = true;
+    group.provider_start_time = TimeTicks::Now();
+    group.provider_name = provider_name;
+    // The deadline only starts now, so that the time the group waited to be
+    // scheduled doesn't count against its provider.
+    if (!group.timeout.is_max()) {
+      task_runner_->PostDelayedTask(
+          FROM_HERE, BindOnce(&ProcessMemoryDumpJoin::CheckTimeouts, this),
+          group.timeout);
+    }
+    return true;
+  }
+
+  // Called on the sequence of the group once the provider returned.
+  void DidInvokeProvider(size_t group_index) {
+    AutoLock lock(lock_);
+    groups_[group_index].in_provider = false;
+  }
+
+  // Called on the thread which requested the dump once the group is done.
+  void OnGroupDumped(size_t group_index,
+                     std::unique_ptr<ProcessMemoryDump> process_memory_dump) {
+    DCHECK(task_runner_->BelongsToCurrentThread());
+    {
+      AutoLock lock(lock_);
+      Group& group = groups_[group_index];
+      if (group.done)
+        return;  // The group was left behind.
+      group.done = true;
+      group.process_memory_dump = std::move(process_memory_dump);
+      if (--pending_group_count_ > 0)
+        return;
+    }
+    Finish();
+  }
+
+ private:
+  friend class RefCountedThreadSafe<ProcessMemoryDumpJoin>;
+
+  struct Group {
+    TimeDelta timeout;
+    bool runs_after_previous_group = false;
+    // Whether the group invoked a provider yet.
+    bool started = false;
+    // Whether the group is in OnMemoryDump(), since |provider_start_time|.
+    bool in_provider = false;
+    // Whether the group is done, or was left behind.
+    bool done = false;
+    bool left_behind = false;
+    TimeTicks provider_start_time;
+    const char* provider_name = nullptr;
+    std::unique_ptr<ProcessMemoryDump> process_memory_dump;
+  };
+
+  ~ProcessMemoryDumpJoin() = default;
+
+  void CheckTimeouts() {
+    DCHECK(task_runner_->BelongsToCurrentThread());
+    {
+      AutoLock lock(lock_);
+      if (pending_group_count_ == 0)
+        return;  // Already finished.
+      const TimeTicks now = TimeTicks::Now();
+      // Groups are checked in order, so that a group left behind also leaves
+      // behind the groups queued after it.
+      for (size_t i = 0; i < groups_.size(); ++i) {
+        Group& group = groups_[i];
+        if (group.done)
+          continue;
+        const bool timed_out =
+            group.in_provider &&
+            now - group.provider_start_time >= group.timeout;
+        // A group which didn't start can't until the previous one returns.
+        const bool blocked = !group.started &&
+                             group.runs_after_previous_group &&
+                             groups_[i - 1].left_behind;
+        if (!timed_out && !blocked)
+          continue;
+        if (timed_out) {
+          DLOG(ERROR) << "MemoryDumpProvider \"" << group.provider_name
+                      << "\" timed out. The dump completes without it.";
+          ++timed_out_provider_count_;
+        }
+        group.done = true;
+        group.left_behind = true;
+        --pending_group_count_;
+      }
+      if (pending_group_count_ > 0)
+        return;
+    }
+    Finish();
+  }
+
+  // Merges the dumps of the groups in the order they were added, i.e. the
+  // sequential providers first, then the concurrent ones in the order of
+  // |dump_providers_| (by task runner, then provider), so that the result
+  // doesn't depend on which group finished first.
+  void Finish() {
+    DCHECK(task_runner_->BelongsToCurrentThread());
+    std::vector<std::unique_ptr<ProcessMemoryDump>> process_memory_dumps;
+    int timed_out_provider_count;
+    {
+      AutoLock lock(lock_);
+      for (Group& group : groups_)
+        process_memory_dumps.push_back(std::move(group.process_memory_dump));
+      timed_out_provider_count = timed_out_provider_count_;
+    }
+    for (const auto& process_memory_dump : process_memory_dumps) {
+      if (process_memory_dump) {
+        result_state_->process_memory_dump->MergeDumpsFrom(
+            process_memory_dump.get());
+      }
+    }
+    UmaHistogramCounts100("Memory.ProcessDump.TimedOutDumpProviders",
+                          timed_out_provider_count);
+    mdm_->FinishAsyncProcessDump(std::move(result_state_));
+  }
+
+  const raw_ptr<MemoryDumpManager> mdm_;
+  // The thread which requested the dump.
+  const scoped_refptr<SingleThreadTaskRunner> task_runner_;
+  // Only accessed on |task_runner_|.
+  std::unique_ptr<ProcessMemoryDumpAsyncState> result_state_;
+
+  Lock lock_;
+  std::vector<Group> groups_ GUARDED_BY(lock_);
+  size_t pending_group_count_ GUARDED_BY(lock_) = 0;
+  int timed_out_provider_count_ GUARDED_BY(lock_) = 0;
+};
+
 // static
 constexpr const char* MemoryDumpManager::kTraceCategory;
 
@@ -318,12 +496,65 @@ void MemoryDumpManager::CreateProcessDump(const MemoryDumpRequestArgs& args,
   }
 
   std::unique_ptr<ProcessMemoryDumpAsyncState> pmd_async_state;
+  std::unique_ptr<ProcessMemoryDumpAsyncState> sequential_state;
+  std::vector<std::unique_ptr<ProcessMemoryDumpAsyncState>> concurrent_states;
   {
     AutoLock lock(lock_);
 
-    pmd_async_state = std::make_unique<ProcessMemoryDumpAsyncState>(
-        args, dump_providers_, std::move(callback),
-        GetOrCreateBgTaskRunnerLocked());
+    scoped_refptr<SequencedTaskRunner> dump_thread_task_runner =
+        GetOrCreateBgTaskRunnerLocked();
+    std::vector<scoped_refptr<MemoryDumpProviderInfo>> sequential_providers;
+    std::vector<scoped_refptr<MemoryDumpProviderInfo>> concurrent_providers;
+    for (const scoped_refptr<MemoryDumpProviderInfo>& mdpinfo :
+         dump_providers_) {
+      if (!mdpinfo->options.supports_concurrent_dumps) {
+        sequential_providers.push_back(mdpinfo);
+        continue;
+      }
+      // Unbound providers run on sequences of their own.
+      if (!mdpinfo->task_runner && !mdpinfo->concurrent_dump_task_runner) {
+        mdpinfo->concurrent_dump_task_runner =
+            ThreadPoolInstance::Get()
+                ? ThreadPool::CreateSequencedTaskRunner(
+                      {MayBlock(), TaskPriority::USER_VISIBLE})
+                : dump_thread_task_runner;
+      }
+      concurrent_providers.push_back(mdpinfo);
+    }
+
+    if (concurrent_providers.empty()) {
+      pmd_async_state = std::make_unique<ProcessMemoryDumpAsyncState>(
+          args, sequential_providers, std::move(callback),
+          dump_thread_task_runner);
+    } else {
+      pmd_async_state = std::make_unique<ProcessMemoryDumpAsyncState>(
+          args, std::vector<scoped_refptr<MemoryDumpProviderInfo>>(),
+          std::move(callback), dump_thread_task_runner);
+      if (!sequential_providers.empty()) {
+        sequential_state = std::make_unique<ProcessMemoryDumpAsyncState>(
+            args, sequential_providers, ProcessMemoryDumpCallback(),
+            dump_thread_task_runner);
+      }
+      // Each provider dumps into a ProcessMemoryDump of its own, so that
+      // only its own dump is dropped if it times out.
+      for (const scoped_refptr<MemoryDumpProviderInfo>& mdpinfo :
+           concurrent_providers) {
+        concurrent_states.push_back(
+            std::make_unique<ProcessMemoryDumpAsyncState>(
+                args,
+                std::vector<scoped_refptr<MemoryDumpProviderInfo>>{mdpinfo},
+                ProcessMemoryDumpCallback(),
+                mdpinfo->task_runner ? dump_thread_task_runner
+                                     : mdpinfo->concurrent_dump_task_runner));
+      }
+    }
+  }
+
+  if (!concurrent_states.empty()) {
+    StartConcurrentProcessDump(std::move(pmd_async_state),
+                               std::move(sequential_state),
+                               std::move(concurrent_states));
+    return;
   }
 
   // Start the process dump. This involves task runner hops as specified by the
@@ -331,6 +562,41 @@ void MemoryDumpManager::CreateProcessDump(const MemoryDumpRequestArgs& args,
   ContinueAsyncProcessDump(pmd_async_state.release());
 }
 
+void MemoryDumpManager::StartConcurrentProcessDump(
+    std::unique_ptr<ProcessMemoryDumpAsyncState> result_state,
+    std::unique_ptr<ProcessMemoryDumpAsyncState> sequential_state,
+    std::vector<std::unique_ptr<ProcessMemoryDumpAsyncState>>
+        concurrent_states) {
+  auto join =
+      MakeRefCounted<ProcessMemoryDumpJoin>(this, std::move(result_state));
+  if (sequential_state) {
+    sequential_state->join = join;
+    sequential_state->group_index = join->AddGroup(
+        TimeDelta::Max(), /*runs_after_previous_group=*/false);
+  }
+  // The providers which share a task runner are adjacent. Their tasks are
+  // posted in order, so each one runs after the previous one returned.
+  const SequencedTaskRunner* previous_task_runner = nullptr;
+  for (auto& state : concurrent_states) {
+    const MemoryDumpProviderInfo* mdpinfo =
+        state->pending_dump_providers.front().get();
+    const bool runs_after_previous_group =
+        mdpinfo->task_runner &&
+        mdpinfo->task_runner.get() == previous_task_runner;
+    previous_task_runner = mdpinfo->task_runner.get();
+    state->join = join;
+    state->group_index = join->AddGroup(
+        mdpinfo->options.concurrent_dump_timeout, runs_after_previous_group);
+  }
+
+  // The groups which run on this thread, if any, run before this returns, so
+  // start the others first.
+  for (auto& state : concurrent_states)
+    ContinueAsyncProcessDump(state.release());
+  if (sequential_state)
+    ContinueAsyncProcessDump(sequential_state.release());
+}
+
 // Invokes OnMemoryDump() on all MDPs that are next in the pending list and run
 // on the current sequenced task runner. If the next MDP does not run in current
 // sequenced task runner, then switches to that task runner and continues. All
@@ -381,7 +647,18 @@ void MemoryDumpManager::ContinueAsyncProcessDump(
     // If |RunsTasksInCurrentSequence()| is true then no PostTask is
     // required since we are on the right SequencedTaskRunner.
     if (task_runner->RunsTasksInCurrentSequence()) {
+      if (pmd_async_state->join &&
+          !pmd_async_state->join->WillInvokeProvider(
+              pmd_async_state->group_index, mdpinfo->name)) {
+        // The group timed out, and the process dump completed without it.
+        pmd_async_state->pending_dump_providers.clear();
+        break;
+      }
       InvokeOnMemoryDump(mdpinfo, pmd_async_state->process_memory_dump.get());
+      if (pmd_async_state->join) {
+        pmd_async_state->join->DidInvokeProvider(
+            pmd_async_state->group_index);
+      }
       pmd_async_state->pending_dump_providers.pop_back();
       continue;
     }
@@ -466,8 +743,12 @@ void MemoryDumpManager::InvokeOnMemoryDump(MemoryDumpProviderInfo* mdpinfo,
   ANNOTATE_BENIGN_RACE(&mdpinfo->disabled, "best-effort race detection");
   CHECK(!is_thread_bound ||
         !*(static_cast<volatile bool*>(&mdpinfo->disabled)));
+  const TimeTicks start_time = TimeTicks::Now();
   bool dump_successful =
       mdpinfo->dump_provider->OnMemoryDump(pmd->dump_args(), pmd);
+  UmaHistogramTimes(
+      StrCat({"Memory.DumpProvider.OnMemoryDumpTime.", mdpinfo->name}),
+      TimeTicks::Now() - start_time);
   mdpinfo->consecutive_failures =
       dump_successful ? 0 : mdpinfo->consecutive_failures + 1;
 }
@@ -486,7 +767,18 @@ void MemoryDumpManager::FinishAsyncProcessDump(
     return;
   }
 
+  if (pmd_async_state->join) {
+    // The dump of this group is merged with the others'.
+    scoped_refptr<ProcessMemoryDumpJoin> join =
+        std::move(pmd_async_state->join);
+    join->OnGroupDumped(pmd_async_state->group_index,
+                        std::move(pmd_async_state->process_memory_dump));
+    return;
+  }
+
   TRACE_EVENT0(kTraceCategory, "MemoryDumpManager::FinishAsyncProcessDump");
+  UmaHistogramMediumTimes("Memory.ProcessDump.Duration",
+                          TimeTicks::Now() - pmd_async_state->start_time);
 
   if (!pmd_async_state->callback.is_null()) {
     std::move(pmd_async_state->callback)
@@ -536,13 +828,14 @@ void MemoryDumpManager::TeardownForTracing() {
 
 MemoryDumpManager::ProcessMemoryDumpAsyncState::ProcessMemoryDumpAsyncState(
     MemoryDumpRequestArgs req_args,
-    const MemoryDumpProviderInfo::OrderedSet& dump_providers,
+    const std::vector<scoped_refptr<MemoryDumpProviderInfo>>& dump_providers,
     ProcessMemoryDumpCallback callback,
     scoped_refptr<SequencedTaskRunner> dump_thread_task_runner)
     : req_args(req_args),
       callback(std::move(callback)),
       callback_task_runner(SingleThreadTaskRunner::GetCurrentDefault()),
-      dump_thread_task_runner(std::move(dump_thread_task_runner)) {
+      dump_thread_task_runner(std::move(dump_thread_task_runner)),
+      start_time(TimeTicks::Now()) {
   pending_dump_providers.reserve(dump_providers.size());
   pending_dump_providers.assign(dump_providers.rbegin(), dump_providers.rend());
   MemoryDumpArgs args = {req_args.level_of_detail, req_args.determinism,
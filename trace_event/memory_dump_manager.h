@@ -16,6 +16,7 @@
 #include "base/gtest_prod_util.h"
 #include "base/memory/singleton.h"
 #include "base/synchronization/lock.h"
+#include "base/time/time.h"
 #include "base/trace_event/memory_allocator_dump.h"
 #include "base/trace_event/memory_dump_provider_info.h"
 #include "base/trace_event/memory_dump_request_args.h"
@@ -164,14 +165,19 @@ class BASE_EXPORT MemoryDumpManager {
   FRIEND_TEST_ALL_PREFIXES(MemoryDumpManagerTest,
                            NoStackOverflowWithTooManyMDPs);
 
+  class ProcessMemoryDumpJoin;
+
   // Holds the state of a process memory dump that needs to be carried over
   // across task runners in order to fulfill an asynchronous CreateProcessDump()
   // request. At any time exactly one task runner owns a
-  // ProcessMemoryDumpAsyncState.
+  // ProcessMemoryDumpAsyncState. When some providers support concurrent dumps,
+  // there is one of these for each of them, and one for all the others, and
+  // |join| merges their dumps.
   struct ProcessMemoryDumpAsyncState {
     ProcessMemoryDumpAsyncState(
         MemoryDumpRequestArgs req_args,
-        const MemoryDumpProviderInfo::OrderedSet& dump_providers,
+        const std::vector<scoped_refptr<MemoryDumpProviderInfo>>&
+            dump_providers,
         ProcessMemoryDumpCallback callback,
         scoped_refptr<SequencedTaskRunner> dump_thread_task_runner);
     ProcessMemoryDumpAsyncState(const ProcessMemoryDumpAsyncState&) = delete;
@@ -202,8 +208,17 @@ class BASE_EXPORT MemoryDumpManager {
     // This is essentially |dump_thread_|.task_runner() but needs to be kept
     // as a separate variable as it needs to be accessed by arbitrary dumpers'
     // threads outside of the lock_ to avoid races when disabling tracing.
-    // It is immutable for all the duration of a tracing session.
+    // It is immutable for all the duration of a tracing session. For an
+    // unbound provider which runs concurrently, this is its own sequence.
     const scoped_refptr<SequencedTaskRunner> dump_thread_task_runner;
+
+    // When the dump was requested.
+    const TimeTicks start_time;
+
+    // Merges the dump of these providers into the process dump, if some
+    // providers run concurrently. Null otherwise.
+    scoped_refptr<ProcessMemoryDumpJoin> join;
+    size_t group_index = 0;
   };
 
   static const int kMaxConsecutiveFailuresCount;
@@ -218,6 +233,15 @@ class BASE_EXPORT MemoryDumpManager {
   scoped_refptr<base::SequencedTaskRunner> GetOrCreateBgTaskRunnerLocked()
       EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
+  // Starts the groups of providers which run concurrently, and the group of
+  // those which don't, if any, at once. |result_state| has no providers; it
+  // gets the merged dumps of all the groups once they are done.
+  void StartConcurrentProcessDump(
+      std::unique_ptr<ProcessMemoryDumpAsyncState> result_state,
+      std::unique_ptr<ProcessMemoryDumpAsyncState> sequential_state,
+      std::vector<std::unique_ptr<ProcessMemoryDumpAsyncState>>
+          concurrent_states);
+
   // Calls InvokeOnMemoryDump() for the each MDP that belongs to the current
   // task runner and switches to the task runner of the next MDP. Handles
   // failures in MDP and thread hops, and always calls FinishAsyncProcessDump()
@@ -0,0 +1,141 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/memory_dump_manager.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/functional/bind.h"
+#include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/test/task_environment.h"
+#include "base/time/time.h"
+#include "base/timer/elapsed_timer.h"
+#include "base/timer/lap_timer.h"
+#include "base/trace_event/memory_dump_manager_test_utils.h"
+#include "base/trace_event/memory_dump_provider.h"
+#include "base/trace_event/memory_dump_request_args.h"
+#include "base/trace_event/process_memory_dump.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+constexpr char kMetricPrefixMemoryDumpManager[] = "MemoryDumpManager.";
+constexpr char kMetricMsPerDump[] = "ms_per_dump";
+
+// About as many providers as a renderer process registers.
+constexpr size_t kNumProviders = 32;
+
+// Stands in for a provider which walks its allocator to compute its dump.
+class BusyMemoryDumpProvider : public MemoryDumpProvider {
+ public:
+  explicit BusyMemoryDumpProvider(size_t index)
+      : name_("perf_test/provider_" + NumberToString(index)) {}
+
+  bool OnMemoryDump(const MemoryDumpArgs& args,
+                    ProcessMemoryDump* pmd) override {
+    ElapsedTimer timer;
+    uint64_t size = 0;
+    while (timer.Elapsed() < Microseconds(200))
+      ++size;
+    pmd->CreateAllocatorDump(name_)->AddScalar(
+        MemoryAllocatorDump::kNameSize, MemoryAllocatorDump::kUnitsBytes, size);
+    return true;
+  }
+
+ private:
+  const std::string name_;
+};
+
+class MemoryDumpManagerPerfTest : public testing::Test {
+ protected:
+  MemoryDumpManagerPerfTest()
+      : timer_(/*warmup_laps=*/10, Seconds(1), /*check_interval=*/10) {}
+
+  void SetUp() override {
+    // Brings up MemoryDumpManager before TaskEnvironment, as
+    // MemoryDumpManagerTest does.
+    mdm_ = MemoryDumpManager::CreateInstanceForTesting();
+    InitializeMemoryDumpManagerForInProcessTesting(/*is_coordinator=*/false);
+    task_environment_ = std::make_unique<test::TaskEnvironment>();
+  }
+
+  void TearDown() override {
+    // The providers have no task runner, so they can only be unregistered by
+    // handing them over to the MemoryDumpManager.
+    for (auto& mdp : mdps_)
+      mdm_->UnregisterAndDeleteDumpProviderSoon(std::move(mdp));
+    mdps_.clear();
+    task_environment_.reset();
+    mdm_.reset();
+  }
+
+  // Registers |kNumProviders| providers without a task runner, which either
+  // run one after the other on the dump thread, or each on its own sequence
+  // if |supports_concurrent_dumps|. Reports the wall time per process dump.
+  void RunDumps(bool supports_concurrent_dumps, const std::string& story) {
+    MemoryDumpProvider::Options options;
+    options.supports_concurrent_dumps = supports_concurrent_dumps;
+    mdm_->set_dumper_registrations_ignored_for_testing(false);
+    for (size_t i = 0; i < kNumProviders; ++i) {
+      mdps_.push_back(std::make_unique<BusyMemoryDumpProvider>(i));
+      mdm_->RegisterDumpProvider(mdps_.back().get(), "BusyMemoryDumpProvider",
+                                 nullptr, options);
+    }
+    mdm_->set_dumper_registrations_ignored_for_testing(true);
+
+    MemoryDumpRequestArgs request_args{
+        0, MemoryDumpType::kExplicitlyTriggered,
+        MemoryDumpLevelOfDetail::kDetailed, MemoryDumpDeterminism::kNone};
+    do {
+      RunLoop run_loop;
+      bool success = false;
+      mdm_->CreateProcessDump(
+          request_args,
+          BindOnce(
+              [](bool* curried_success, OnceClosure quit_closure, bool success,
+                 uint64_t dump_guid, std::unique_ptr<ProcessMemoryDump> pmd) {
+                *curried_success = success;
+                std::move(quit_closure).Run();
+              },
+              Unretained(&success), run_loop.QuitClosure()));
+      run_loop.Run();
+      ASSERT_TRUE(success);
+      timer_.NextLap();
+    } while (!timer_.HasTimeLimitExpired());
+
+    perf_test::PerfResultReporter reporter(kMetricPrefixMemoryDumpManager,
+                                           story);
+    reporter.RegisterImportantMetric(kMetricMsPerDump, "ms");
+    reporter.AddResult(kMetricMsPerDump, timer_.TimePerLap().InMillisecondsF());
+  }
+
+  std::unique_ptr<MemoryDumpManager> mdm_;
+  std::unique_ptr<test::TaskEnvironment> task_environment_;
+  std::vector<std::unique_ptr<BusyMemoryDumpProvider>> mdps_;
+  LapTimer timer_;
+};
+
+}  // namespace
+
+TEST_F(MemoryDumpManagerPerfTest, SequentialDumpProviders) {
+  RunDumps(/*supports_concurrent_dumps=*/false, "sequential_providers");
+}
+
+TEST_F(MemoryDumpManagerPerfTest, ConcurrentDumpProviders) {
+  RunDumps(/*supports_concurrent_dumps=*/true, "concurrent_providers");
+}
+
+}  // namespace trace_event
+}  // namespace base
@@ -6,7 +6,9 @@
 
 #include <stdint.h>
 
+#include <map>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -17,12 +19,16 @@
 #include "base/functional/bind.h"
 #include "base/functional/callback.h"
 #include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/task/sequenced_task_runner.h"
 #include "base/task/single_thread_task_runner.h"
 #include "base/task/thread_pool.h"
+#include "base/task/thread_pool/thread_pool_instance.h"
+#include "base/test/metrics/histogram_tester.h"
 #include "base/test/task_environment.h"
 #include "base/test/test_io_thread.h"
+#include "base/test/test_timeouts.h"
 #include "base/threading/platform_thread.h"
 #include "base/threading/thread.h"
 #include "base/trace_event/memory_dump_manager_test_utils.h"
@@ -202,9 +208,12 @@ class MemoryDumpManagerTest : public testing::Test {
   // Blocks the current thread (spinning a nested message loop) until the
   // memory dump is complete. Returns:
   // - return value: the |success| from the CreateProcessDump() callback.
-  bool RequestProcessDumpAndWait(MemoryDumpType dump_type,
-                                 MemoryDumpLevelOfDetail level_of_detail,
-                                 MemoryDumpDeterminism determinism) {
+  // - |out_pmd|, if not null: the dump passed to the callback.
+  bool RequestProcessDumpAndWait(
+      MemoryDumpType dump_type,
+      MemoryDumpLevelOfDetail level_of_detail,
+      MemoryDumpDeterminism determinism,
+      std::unique_ptr<ProcessMemoryDump>* out_pmd = nullptr) {
     RunLoop run_loop;
     bool success = false;
     static uint64_t test_guid = 1;
@@ -222,15 +231,20 @@ class MemoryDumpManagerTest : public testing::Test {
     // get around the limitation of BindOnce() in supporting only capture-less
     // lambdas.
     ProcessMemoryDumpCallback callback = BindOnce(
-        [](bool* curried_success, OnceClosure curried_quit_closure,
-           uint64_t curried_expected_guid, bool success, uint64_t dump_guid,
+        [](bool* curried_success,
+           std::unique_ptr<ProcessMemoryDump>* curried_out_pmd,
+           OnceClosure curried_quit_closure, uint64_t curried_expected_guid,
+           bool success, uint64_t dump_guid,
            std::unique_ptr<ProcessMemoryDump> pmd) {
           *curried_success = success;
+          if (curried_out_pmd)
+            *curried_out_pmd = std::move(pmd);
           EXPECT_EQ(curried_expected_guid, dump_guid);
           SingleThreadTaskRunner::GetCurrentDefault()->PostTask(
               FROM_HERE, std::move(curried_quit_closure));
         },
-        Unretained(&success), run_loop.QuitClosure(), test_guid);
+        Unretained(&success), Unretained(out_pmd), run_loop.QuitClosure(),
+        test_guid);
 
     mdm_->CreateProcessDump(request_args, std::move(callback));
     run_loop.Run();
@@ -836,6 +850,241 @@ TEST_F(MemoryDumpManagerTest, UnregisterAndDeleteDumpProviderSoonDuringDump) {
   DisableTracing();
 }
 
+// Checks that providers which support concurrent dumps run at the same time,
+// and that their dumps are merged with the dumps of the other providers.
+TEST_F(MemoryDumpManagerTest, ConcurrentDumpers) {
+  MemoryDumpProvider::Options concurrent_options;
+  concurrent_options.supports_concurrent_dumps = true;
+
+  // Each of the providers waits for the other one to start dumping, which
+  // only happens if they run concurrently.
+  std::vector<std::unique_ptr<Thread>> threads;
+  std::vector<MockMemoryDumpProvider> mdps(2);
+  WaitableEvent started[2];
+  for (int i = 0; i < 2; ++i) {
+    threads.push_back(std::make_unique<Thread>("test thread"));
+    threads.back()->Start();
+    RegisterDumpProvider(&mdps[i], threads.back()->task_runner(),
+                         concurrent_options);
+    EXPECT_CALL(mdps[i], OnMemoryDump(_, _))
+        .WillOnce(Invoke([&started, i](const MemoryDumpArgs&,
+                                       ProcessMemoryDump* pmd) -> bool {
+          started[i].Signal();
+          EXPECT_TRUE(started[1 - i].TimedWait(TestTimeouts::action_timeout()));
+          pmd->CreateAllocatorDump("concurrent/" + NumberToString(i));
+          return true;
+        }));
+  }
+  MockMemoryDumpProvider sequential_mdp;
+  RegisterDumpProvider(&sequential_mdp,
+                       SingleThreadTaskRunner::GetCurrentDefault());
+  EXPECT_CALL(sequential_mdp, OnMemoryDump(_, _))
+      .WillOnce(Invoke([](const MemoryDumpArgs&, ProcessMemoryDump* pmd) {
+        pmd->CreateAllocatorDump("sequential");
+        return true;
+      }));
+
+  EnableForTracing();
+  std::unique_ptr<ProcessMemoryDump> pmd;
+  EXPECT_TRUE(RequestProcessDumpAndWait(MemoryDumpType::kExplicitlyTriggered,
+                                        MemoryDumpLevelOfDetail::kDetailed,
+                                        MemoryDumpDeterminism::kNone, &pmd));
+  ASSERT_TRUE(pmd);
+  EXPECT_TRUE(pmd->GetAllocatorDump("concurrent/0"));
+  EXPECT_TRUE(pmd->GetAllocatorDump("concurrent/1"));
+  EXPECT_TRUE(pmd->GetAllocatorDump("sequential"));
+  DisableTracing();
+
+  for (int i = 0; i < 2; ++i) {
+    PostTaskAndWait(FROM_HERE, threads[i]->task_runner().get(),
+                    BindOnce(&MemoryDumpManager::UnregisterDumpProvider,
+                             Unretained(mdm_.get()), &mdps[i]));
+  }
+  mdm_->UnregisterDumpProvider(&sequential_mdp);
+}
+
+// Checks that the dump doesn't depend on the order in which the providers
+// which run concurrently complete, and that the shared global dumps they all
+// create are merged.
+TEST_F(MemoryDumpManagerTest, ConcurrentDumpsDontDependOnOrder) {
+  static constexpr int kNumProviders = 8;
+  MemoryDumpProvider::Options concurrent_options;
+  concurrent_options.supports_concurrent_dumps = true;
+
+  // The providers take longer in one dump, and shorter in the other one, as
+  // their index grows.
+  bool reverse_order = false;
+  const MemoryAllocatorDumpGuid shared_guid(1);
+  std::vector<std::unique_ptr<MockMemoryDumpProvider>> mdps;
+  for (int i = 0; i < kNumProviders; ++i) {
+    mdps.push_back(std::make_unique<MockMemoryDumpProvider>());
+    // Every other provider doesn't support concurrent dumps.
+    RegisterDumpProvider(mdps[i].get(), nullptr,
+                         i % 2 ? concurrent_options : kDefaultOptions);
+    EXPECT_CALL(*mdps[i], OnMemoryDump(_, _))
+        .Times(2)
+        .WillRepeatedly(Invoke([&reverse_order, &shared_guid, i](
+                                   const MemoryDumpArgs&,
+                                   ProcessMemoryDump* pmd) {
+          PlatformThread::Sleep(
+              Milliseconds(reverse_order ? kNumProviders - i : i));
+          std::string name = "provider/" + NumberToString(i);
+          pmd->CreateAllocatorDump(name)->AddScalar(
+              MemoryAllocatorDump::kNameSize,
+              MemoryAllocatorDump::kUnitsBytes, i + 1);
+          pmd->AddOwnershipEdge(pmd->GetAllocatorDump(name)->guid(),
+                                pmd->CreateAllocatorDump(name + "/owned")
+                                    ->guid());
+          // Only the last provider's copy of the shared dump isn't weak.
+          if (i == kNumProviders - 1)
+            pmd->CreateSharedGlobalAllocatorDump(shared_guid);
+          else
+            pmd->CreateWeakSharedGlobalAllocatorDump(shared_guid);
+          return true;
+        }));
+  }
+
+  EnableForTracing();
+  std::map<std::string, uint64_t> sizes[2];
+  size_t edge_counts[2];
+  int shared_dump_flags[2];
+  for (int run = 0; run < 2; ++run) {
+    reverse_order = run == 1;
+    std::unique_ptr<ProcessMemoryDump> pmd;
+    EXPECT_TRUE(RequestProcessDumpAndWait(
+        MemoryDumpType::kExplicitlyTriggered,
+        MemoryDumpLevelOfDetail::kDetailed, MemoryDumpDeterminism::kNone,
+        &pmd));
+    ASSERT_TRUE(pmd);
+    for (const auto& name_and_dump : pmd->allocator_dumps())
+      sizes[run][name_and_dump.first] = name_and_dump.second->GetSizeInternal();
+    edge_counts[run] = pmd->allocator_dumps_edges().size();
+    ASSERT_TRUE(pmd->GetSharedGlobalAllocatorDump(shared_guid));
+    shared_dump_flags[run] =
+        pmd->GetSharedGlobalAllocatorDump(shared_guid)->flags();
+  }
+  DisableTracing();
+
+  EXPECT_EQ(2u * kNumProviders + 1, sizes[0].size());
+  EXPECT_EQ(5u, sizes[0]["provider/4"]);
+  EXPECT_EQ(sizes[0], sizes[1]);
+  EXPECT_EQ(static_cast<size_t>(kNumProviders), edge_counts[0]);
+  EXPECT_EQ(edge_counts[0], edge_counts[1]);
+  EXPECT_FALSE(shared_dump_flags[0] & MemoryAllocatorDump::Flags::WEAK);
+  EXPECT_FALSE(shared_dump_flags[1] & MemoryAllocatorDump::Flags::WEAK);
+
+  for (auto& mdp : mdps)
+    mdm_->UnregisterAndDeleteDumpProviderSoon(std::move(mdp));
+}
+
+// Checks that the dump completes without a provider which runs concurrently
+// and takes too long.
+TEST_F(MemoryDumpManagerTest, ConcurrentDumperTimesOut) {
+  HistogramTester histograms;
+  MemoryDumpProvider::Options concurrent_options;
+  concurrent_options.supports_concurrent_dumps = true;
+  MemoryDumpProvider::Options slow_options = concurrent_options;
+  slow_options.concurrent_dump_timeout = Milliseconds(10);
+
+  WaitableEvent release_slow_mdp;
+  auto slow_mdp = std::make_unique<MockMemoryDumpProvider>();
+  RegisterDumpProvider(slow_mdp.get(), nullptr, slow_options);
+  EXPECT_CALL(*slow_mdp, OnMemoryDump(_, _))
+      .WillOnce(Invoke([&release_slow_mdp](const MemoryDumpArgs&,
+                                           ProcessMemoryDump* pmd) {
+        EXPECT_TRUE(
+            release_slow_mdp.TimedWait(TestTimeouts::action_max_timeout()));
+        pmd->CreateAllocatorDump("slow");
+        return true;
+      }));
+  // The fast provider keeps the default timeout, so that only the slow one
+  // can time out.
+  auto fast_mdp = std::make_unique<MockMemoryDumpProvider>();
+  RegisterDumpProvider(fast_mdp.get(), nullptr, concurrent_options);
+  EXPECT_CALL(*fast_mdp, OnMemoryDump(_, _))
+      .WillOnce(Invoke([](const MemoryDumpArgs&, ProcessMemoryDump* pmd) {
+        pmd->CreateAllocatorDump("fast");
+        return true;
+      }));
+
+  EnableForTracing();
+  std::unique_ptr<ProcessMemoryDump> pmd;
+  EXPECT_TRUE(RequestProcessDumpAndWait(MemoryDumpType::kExplicitlyTriggered,
+                                        MemoryDumpLevelOfDetail::kDetailed,
+                                        MemoryDumpDeterminism::kNone, &pmd));
+  ASSERT_TRUE(pmd);
+  EXPECT_TRUE(pmd->GetAllocatorDump("fast"));
+  EXPECT_FALSE(pmd->GetAllocatorDump("slow"));
+  histograms.ExpectUniqueSample("Memory.ProcessDump.TimedOutDumpProviders", 1,
+                                1);
+  DisableTracing();
+
+  // The slow provider is deleted once it completes. The dump it then hands
+  // back is dropped on this thread, which must happen before |mdm_| goes away.
+  mdm_->UnregisterAndDeleteDumpProviderSoon(std::move(slow_mdp));
+  mdm_->UnregisterAndDeleteDumpProviderSoon(std::move(fast_mdp));
+  release_slow_mdp.Signal();
+  ThreadPoolInstance::Get()->FlushForTesting();
+  RunLoop().RunUntilIdle();
+}
+
+// Checks that when providers which run concurrently share a task runner, only
+// the one which takes too long is left out of the dump.
+TEST_F(MemoryDumpManagerTest, ConcurrentDumperOnSharedTaskRunnerTimesOut) {
+  HistogramTester histograms;
+  Thread thread("test thread");
+  thread.Start();
+
+  // The providers which share a task runner run by decreasing address, so
+  // |mdps[1]| runs first and |mdps[0]| after it.
+  std::vector<MockMemoryDumpProvider> mdps(2);
+  MemoryDumpProvider::Options fast_options;
+  fast_options.supports_concurrent_dumps = true;
+  MemoryDumpProvider::Options slow_options = fast_options;
+  slow_options.concurrent_dump_timeout = Milliseconds(10);
+  RegisterDumpProvider(&mdps[0], thread.task_runner(), slow_options);
+  RegisterDumpProvider(&mdps[1], thread.task_runner(), fast_options);
+
+  int num_dumps = 0;
+  WaitableEvent release_slow_mdp;
+  EXPECT_CALL(mdps[1], OnMemoryDump(_, _))
+      .WillOnce(Invoke([&num_dumps](const MemoryDumpArgs&,
+                                    ProcessMemoryDump* pmd) {
+        EXPECT_EQ(0, num_dumps++);
+        pmd->CreateAllocatorDump("first");
+        return true;
+      }));
+  EXPECT_CALL(mdps[0], OnMemoryDump(_, _))
+      .WillOnce(Invoke([&num_dumps, &release_slow_mdp](const MemoryDumpArgs&,
+                                                       ProcessMemoryDump* pmd) {
+        EXPECT_EQ(1, num_dumps++);
+        EXPECT_TRUE(
+            release_slow_mdp.TimedWait(TestTimeouts::action_max_timeout()));
+        pmd->CreateAllocatorDump("second");
+        return true;
+      }));
+
+  EnableForTracing();
+  std::unique_ptr<ProcessMemoryDump> pmd;
+  EXPECT_TRUE(RequestProcessDumpAndWait(MemoryDumpType::kExplicitlyTriggered,
+                                        MemoryDumpLevelOfDetail::kDetailed,
+                                        MemoryDumpDeterminism::kNone, &pmd));
+  ASSERT_TRUE(pmd);
+  EXPECT_TRUE(pmd->GetAllocatorDump("first"));
+  EXPECT_FALSE(pmd->GetAllocatorDump("second"));
+  histograms.ExpectUniqueSample("Memory.ProcessDump.TimedOutDumpProviders", 1,
+                                1);
+  DisableTracing();
+
+  release_slow_mdp.Signal();
+  for (auto& mdp : mdps) {
+    PostTaskAndWait(FROM_HERE, thread.task_runner().get(),
+                    BindOnce(&MemoryDumpManager::UnregisterDumpProvider,
+                             Unretained(mdm_.get()), &mdp));
+  }
+  RunLoop().RunUntilIdle();
+}
+
 // Mock MDP class that tests if the number of OnMemoryDump() calls are expected.
 // It is implemented without gmocks since EXPECT_CALL implementation is slow
 // when there are 1000s of instances, as required in
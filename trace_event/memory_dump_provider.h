@@ -7,6 +7,7 @@
 
 #include "base/base_export.h"
 #include "base/process/process_handle.h"
+#include "base/time/time.h"
 #include "base/trace_event/memory_dump_request_args.h"
 
 namespace base {
@@ -19,12 +20,32 @@ class BASE_EXPORT MemoryDumpProvider {
  public:
   // Optional arguments for MemoryDumpManager::RegisterDumpProvider().
   struct Options {
-    Options() : dumps_on_single_thread_task_runner(false) {}
+    Options()
+        : dumps_on_single_thread_task_runner(false),
+          supports_concurrent_dumps(false),
+          concurrent_dump_timeout(Seconds(10)) {}
 
     // |dumps_on_single_thread_task_runner| is true if the dump provider runs on
     // a SingleThreadTaskRunner, which is usually the case. It is faster to run
     // all providers that run on the same thread together without thread hops.
     bool dumps_on_single_thread_task_runner;
+
+    // |supports_concurrent_dumps| is true if OnMemoryDump() may run at the same
+    // time as the other providers' instead of after them. The provider then
+    // dumps into a ProcessMemoryDump of its own, which is merged into the
+    // process dump at the end, so it must not look up the dumps of other
+    // providers. Shared global dumps and ownership edges which several
+    // providers create are merged as if they had dumped one after the other.
+    // It is still invoked on its task runner, if it has one, and on a sequence
+    // of its own otherwise, after the providers which share that task runner
+    // and come before it.
+    bool supports_concurrent_dumps;
+
+    // If |supports_concurrent_dumps|, how long OnMemoryDump() may take before
+    // the process dump completes without this provider. The providers queued
+    // after it on its task runner, which can't run until it returns, are left
+    // out as well.
+    TimeDelta concurrent_dump_timeout;
   };
 
   MemoryDumpProvider(const MemoryDumpProvider&) = delete;
@@ -102,6 +102,11 @@ struct BASE_EXPORT MemoryDumpProviderInfo
   // Flagged either by the auto-disable logic or during unregistration.
   bool disabled;
 
+  // The sequence on which a provider without |task_runner| is invoked if it
+  // supports concurrent dumps, created by the MDM for the first dump. Guarded
+  // by the MDM lock.
+  scoped_refptr<SequencedTaskRunner> concurrent_dump_task_runner;
+
  private:
   friend class base::RefCountedThreadSafe<MemoryDumpProviderInfo>;
   ~MemoryDumpProviderInfo();
@@ -137,6 +137,7 @@ constexpr auto kAllocatorDumpNameAllowlist = base::MakeFixedFlatSet<
         "devtools/file_watcher_0x?",
         "discardable",
         "discardable/madv_free_allocated",
+        "discardable/madv_free_pooled",
         "discardable/child_0x?",
         "extensions/functions",
         "extensions/value_store/Extensions.Database.Open.OriginManagedConfiguration/0x?",
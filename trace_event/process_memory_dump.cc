@@ -399,6 +399,55 @@ void ProcessMemoryDump::TakeAllDumpsFrom(ProcessMemoryDump* other) {
   other->allocator_dumps_edges_.clear();
 }
 
+void ProcessMemoryDump::MergeDumpsFrom(ProcessMemoryDump* other) {
+  for (auto& it : other->allocator_dumps_) {
+    std::unique_ptr<MemoryAllocatorDump>& other_mad = it.second;
+    MemoryAllocatorDump* mad = GetAllocatorDump(it.first);
+    if (!mad ||
+        it.first != GetSharedGlobalAllocatorDumpName(other_mad->guid())) {
+      AddAllocatorDumpInternal(std::move(other_mad));
+      continue;
+    }
+    // Both dumps created the same shared global dump. Merge it as if both had
+    // created it in this instance: it stays weak only if both copies are weak,
+    // and it keeps the entries of both.
+    DCHECK_EQ(mad->guid().ToUint64(), other_mad->guid().ToUint64());
+    if (!(other_mad->flags() & MemoryAllocatorDump::Flags::WEAK))
+      mad->clear_flags(MemoryAllocatorDump::Flags::WEAK);
+    for (const MemoryAllocatorDump::Entry& entry : other_mad->entries()) {
+      if (entry.entry_type == MemoryAllocatorDump::Entry::kUint64) {
+        mad->AddScalar(entry.name.c_str(), entry.units.c_str(),
+                       entry.value_uint64);
+      } else {
+        mad->AddString(entry.name.c_str(), entry.units.c_str(),
+                       entry.value_string);
+      }
+    }
+  }
+  other->allocator_dumps_.clear();
+
+  // Merge the edges as AddOwnershipEdge() and AddOverridableOwnershipEdge()
+  // would, had |other| added them after this instance: an overridable edge
+  // doesn't override an existing one, and a strong edge makes the existing
+  // edge strong and keeps the higher importance of the two.
+  for (const auto& it : other->allocator_dumps_edges_) {
+    const MemoryAllocatorDumpEdge& edge = it.second;
+    auto edge_it = allocator_dumps_edges_.find(edge.source);
+    if (edge_it == allocator_dumps_edges_.end()) {
+      allocator_dumps_edges_.emplace(edge.source, edge);
+      continue;
+    }
+    if (edge.overridable)
+      continue;
+    MemoryAllocatorDumpEdge& existing_edge = edge_it->second;
+    DCHECK_EQ(edge.target.ToUint64(), existing_edge.target.ToUint64());
+    existing_edge.importance =
+        std::max(existing_edge.importance, edge.importance);
+    existing_edge.overridable = false;
+  }
+  other->allocator_dumps_edges_.clear();
+}
+
 void ProcessMemoryDump::SerializeAllocatorDumpsInto(TracedValue* value) const {
   if (allocator_dumps_.size() > 0) {
     value->BeginDictionary("allocators");
@@ -234,6 +234,12 @@ class BASE_EXPORT ProcessMemoryDump {
   // of the MemoryDumpProvider::OnMemoryDump(ProcessMemoryDump*) callback.
   void TakeAllDumpsFrom(ProcessMemoryDump* other);
 
+  // Like TakeAllDumpsFrom(), but shared global dumps which both instances
+  // contain are merged instead of being duplicates, and so are the ownership
+  // edges from the same source. This is used to combine the dumps of
+  // providers which dumped concurrently into separate ProcessMemoryDump(s).
+  void MergeDumpsFrom(ProcessMemoryDump* other);
+
   // Populate the traced value with information about the memory allocator
   // dumps.
   void SerializeAllocatorDumpsInto(TracedValue* value) const;
@@ -215,6 +215,65 @@ TEST(ProcessMemoryDumpTest, TakeAllDumpsFrom) {
   pmd1.reset();
 }
 
+TEST(ProcessMemoryDumpTest, MergeDumpsFrom) {
+  std::unique_ptr<ProcessMemoryDump> pmd1(
+      new ProcessMemoryDump(kDetailedDumpArgs));
+  std::unique_ptr<ProcessMemoryDump> pmd2(
+      new ProcessMemoryDump(kDetailedDumpArgs));
+
+  // Both dumps create the same shared global dumps, and own them from the
+  // same local dumps.
+  MemoryAllocatorDumpGuid shared_mad_guid1(1);
+  MemoryAllocatorDumpGuid shared_mad_guid2(2);
+  MemoryAllocatorDumpGuid shared_mad_guid3(3);
+  MemoryAllocatorDumpGuid local_guid1(11);
+  MemoryAllocatorDumpGuid local_guid2(12);
+  MemoryAllocatorDumpGuid local_guid3(13);
+  auto* shared_mad1 =
+      pmd1->CreateWeakSharedGlobalAllocatorDump(shared_mad_guid1);
+  shared_mad1->AddScalar("size", "bytes", 1);
+  pmd2->CreateSharedGlobalAllocatorDump(shared_mad_guid1)
+      ->AddScalar("count", "objects", 2);
+  auto* shared_mad2 =
+      pmd1->CreateWeakSharedGlobalAllocatorDump(shared_mad_guid2);
+  pmd2->CreateWeakSharedGlobalAllocatorDump(shared_mad_guid2);
+  pmd2->CreateSharedGlobalAllocatorDump(shared_mad_guid3);
+
+  pmd1->AddOverridableOwnershipEdge(local_guid1, shared_mad_guid1, 3);
+  pmd2->AddOwnershipEdge(local_guid1, shared_mad_guid1, 1);
+  pmd1->AddOwnershipEdge(local_guid2, shared_mad_guid2, 2);
+  pmd2->AddOwnershipEdge(local_guid2, shared_mad_guid2, 1);
+  pmd1->AddOwnershipEdge(local_guid3, shared_mad_guid3, 1);
+  pmd2->AddOverridableOwnershipEdge(local_guid3, shared_mad_guid3, 2);
+
+  pmd1->MergeDumpsFrom(pmd2.get());
+  ASSERT_TRUE(pmd2->allocator_dumps().empty());
+  ASSERT_TRUE(pmd2->allocator_dumps_edges().empty());
+  pmd2.reset();
+
+  ASSERT_EQ(3u, pmd1->allocator_dumps().size());
+  ASSERT_EQ(shared_mad1, pmd1->GetSharedGlobalAllocatorDump(shared_mad_guid1));
+  ASSERT_EQ(shared_mad2, pmd1->GetSharedGlobalAllocatorDump(shared_mad_guid2));
+  ASSERT_TRUE(pmd1->GetSharedGlobalAllocatorDump(shared_mad_guid3));
+
+  // A shared dump is weak only if all of its copies are.
+  EXPECT_FALSE(MemoryAllocatorDump::Flags::WEAK & shared_mad1->flags());
+  EXPECT_TRUE(MemoryAllocatorDump::Flags::WEAK & shared_mad2->flags());
+  ASSERT_EQ(2u, shared_mad1->entries().size());
+  EXPECT_EQ("size", shared_mad1->entries()[0].name);
+  EXPECT_EQ("count", shared_mad1->entries()[1].name);
+
+  // Strong edges override overridable ones, and the highest importance wins.
+  const auto& edges = pmd1->allocator_dumps_edges();
+  ASSERT_EQ(3u, edges.size());
+  EXPECT_FALSE(edges.find(local_guid1)->second.overridable);
+  EXPECT_EQ(3, edges.find(local_guid1)->second.importance);
+  EXPECT_FALSE(edges.find(local_guid2)->second.overridable);
+  EXPECT_EQ(2, edges.find(local_guid2)->second.importance);
+  EXPECT_FALSE(edges.find(local_guid3)->second.overridable);
+  EXPECT_EQ(1, edges.find(local_guid3)->second.importance);
+}
+
 TEST(ProcessMemoryDumpTest, OverrideOwnershipEdge) {
   std::unique_ptr<ProcessMemoryDump> pmd(
       new ProcessMemoryDump(kDetailedDumpArgs));
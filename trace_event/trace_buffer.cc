@@ -9,8 +9,10 @@
 #include <vector>
 
 #include "base/functional/bind.h"
+#include "base/task/sequenced_task_runner.h"
 #include "base/trace_event/heap_profiler.h"
 #include "base/trace_event/trace_event_impl.h"
+#include "base/trace_event/trace_spool.h"
 
 namespace base {
 namespace trace_event {
@@ -19,8 +21,12 @@ namespace {
 
 class TraceBufferRingBuffer : public TraceBuffer {
  public:
-  TraceBufferRingBuffer(size_t max_chunks)
-      : max_chunks_(max_chunks),
+  // If |spool_writer| is not null, the chunks which would be overwritten are
+  // handed to it instead.
+  TraceBufferRingBuffer(size_t max_chunks,
+                        std::unique_ptr<TraceSpoolWriter> spool_writer)
+      : spool_writer_(std::move(spool_writer)),
+        max_chunks_(max_chunks),
         recyclable_chunks_queue_(new size_t[queue_capacity()]),
         queue_head_(0),
         queue_tail_(max_chunks),
@@ -37,25 +43,26 @@ class TraceBufferRingBuffer : public TraceBuffer {
   std::unique_ptr<TraceBufferChunk> GetChunk(size_t* index) override {
     HEAP_PROFILER_SCOPED_IGNORE;
 
-    // Because the number of threads is much less than the number of chunks,
-    // the queue should never be empty.
-    DCHECK(!QueueIsEmpty());
-
-    *index = recyclable_chunks_queue_[queue_head_];
-    queue_head_ = NextQueueIndex(queue_head_);
-    current_iteration_index_ = queue_head_;
-
-    if (*index >= chunks_.size())
-      chunks_.resize(*index + 1);
-
-    TraceBufferChunk* chunk = chunks_[*index].release();
-    chunks_[*index] = nullptr;  // Put nullptr in the slot of a in-flight chunk.
+    std::unique_ptr<TraceBufferChunk> chunk = TakeRecyclableChunk(index);
     if (chunk)
       chunk->Reset(current_chunk_seq_++);
     else
-      chunk = new TraceBufferChunk(current_chunk_seq_++);
+      chunk = std::make_unique<TraceBufferChunk>(current_chunk_seq_++);
+    return chunk;
+  }
 
-    return std::unique_ptr<TraceBufferChunk>(chunk);
+  std::unique_ptr<TraceBufferChunk> GetChunkWithSpare(
+      size_t* index,
+      std::unique_ptr<TraceBufferChunk>* spare_chunk) override {
+    if (!*spare_chunk)
+      return GetChunk(index);
+    DCHECK_EQ(0u, (*spare_chunk)->size());
+
+    std::unique_ptr<TraceBufferChunk> chunk = std::move(*spare_chunk);
+    *spare_chunk = TakeRecyclableChunk(index);
+    // This is cheap because the chunk is empty.
+    chunk->Reset(current_chunk_seq_++);
+    return chunk;
   }
 
   void ReturnChunk(size_t index,
@@ -92,20 +99,20 @@ class TraceBufferRingBuffer : public TraceBuffer {
   }
 
   const TraceBufferChunk* NextChunk() override {
-    if (chunks_.empty())
-      return nullptr;
+    if (!spool_writer_)
+      return NextChunkInRing();
 
-    while (current_iteration_index_ != queue_tail_) {
-      size_t chunk_index = recyclable_chunks_queue_[current_iteration_index_];
-      current_iteration_index_ = NextQueueIndex(current_iteration_index_);
-      if (chunk_index >= chunks_.size())  // Skip uninitialized chunks.
-        continue;
-      DCHECK(chunks_[chunk_index]);
-      return chunks_[chunk_index].get();
-    }
+    // The remaining chunks of a spool are written after the spooled ones.
+    spool_writer_->WritePendingChunks();
+    while (const TraceBufferChunk* chunk = NextChunkInRing())
+      spool_writer_->WriteChunk(*chunk);
     return nullptr;
   }
 
+  scoped_refptr<SequencedTaskRunner> GetIterationTaskRunner() const override {
+    return spool_writer_ ? spool_writer_->task_runner() : nullptr;
+  }
+
   void EstimateTraceMemoryOverhead(
       TraceEventMemoryOverhead* overhead) override {
     overhead->Add(TraceEventMemoryOverhead::kTraceBuffer, sizeof(*this));
@@ -119,6 +126,44 @@ class TraceBufferRingBuffer : public TraceBuffer {
   }
 
  private:
+  // Takes the oldest chunk out of the ring, and returns it unreset, or null if
+  // its slot wasn't used yet.
+  std::unique_ptr<TraceBufferChunk> TakeRecyclableChunk(size_t* index) {
+    // Because the number of threads is much less than the number of chunks,
+    // the queue should never be empty.
+    DCHECK(!QueueIsEmpty());
+
+    *index = recyclable_chunks_queue_[queue_head_];
+    queue_head_ = NextQueueIndex(queue_head_);
+    current_iteration_index_ = queue_head_;
+
+    if (*index >= chunks_.size())
+      chunks_.resize(*index + 1);
+
+    // Leaves nullptr in the slot of a in-flight chunk.
+    std::unique_ptr<TraceBufferChunk> chunk = std::move(chunks_[*index]);
+    // A spool writes the chunk rather than overwriting it, and reuses a chunk
+    // which was already written, if any.
+    if (chunk && spool_writer_)
+      chunk = spool_writer_->Spool(std::move(chunk));
+    return chunk;
+  }
+
+  const TraceBufferChunk* NextChunkInRing() {
+    if (chunks_.empty())
+      return nullptr;
+
+    while (current_iteration_index_ != queue_tail_) {
+      size_t chunk_index = recyclable_chunks_queue_[current_iteration_index_];
+      current_iteration_index_ = NextQueueIndex(current_iteration_index_);
+      if (chunk_index >= chunks_.size())  // Skip uninitialized chunks.
+        continue;
+      DCHECK(chunks_[chunk_index]);
+      return chunks_[chunk_index].get();
+    }
+    return nullptr;
+  }
+
   bool QueueIsEmpty() const { return queue_head_ == queue_tail_; }
 
   size_t QueueSize() const {
@@ -141,6 +186,7 @@ class TraceBufferRingBuffer : public TraceBuffer {
     return index;
   }
 
+  std::unique_ptr<TraceSpoolWriter> spool_writer_;
   size_t max_chunks_;
   std::vector<std::unique_ptr<TraceBufferChunk>> chunks_;
 
@@ -180,6 +226,21 @@ class TraceBufferVector : public TraceBuffer {
                                               1);
   }
 
+  std::unique_ptr<TraceBufferChunk> GetChunkWithSpare(
+      size_t* index,
+      std::unique_ptr<TraceBufferChunk>* spare_chunk) override {
+    if (!*spare_chunk)
+      return GetChunk(index);
+    DCHECK_EQ(0u, (*spare_chunk)->size());
+
+    *index = chunks_.size();
+    chunks_.push_back(nullptr);
+    ++in_flight_chunk_count_;
+    std::unique_ptr<TraceBufferChunk> chunk = std::move(*spare_chunk);
+    chunk->Reset(static_cast<uint32_t>(*index) + 1);
+    return chunk;
+  }
+
   void ReturnChunk(size_t index,
                    std::unique_ptr<TraceBufferChunk> chunk) override {
     DCHECK_GT(in_flight_chunk_count_, 0u);
@@ -336,13 +397,30 @@ void TraceResultBuffer::Finish() {
   output_callback_.Run("]");
 }
 
+std::unique_ptr<TraceBufferChunk> TraceBuffer::GetChunkWithSpare(
+    size_t* index,
+    std::unique_ptr<TraceBufferChunk>* spare_chunk) {
+  return GetChunk(index);
+}
+
+scoped_refptr<SequencedTaskRunner> TraceBuffer::GetIterationTaskRunner() const {
+  return nullptr;
+}
+
 TraceBuffer* TraceBuffer::CreateTraceBufferRingBuffer(size_t max_chunks) {
-  return new TraceBufferRingBuffer(max_chunks);
+  return new TraceBufferRingBuffer(max_chunks, nullptr);
 }
 
 TraceBuffer* TraceBuffer::CreateTraceBufferVectorOfSize(size_t max_chunks) {
   return new TraceBufferVector(max_chunks);
 }
 
+TraceBuffer* TraceBuffer::CreateTraceBufferSpool(
+    size_t max_chunks,
+    std::unique_ptr<TraceSpoolWriter> spool_writer) {
+  DCHECK(spool_writer);
+  return new TraceBufferRingBuffer(max_chunks, std::move(spool_writer));
+}
+
 }  // namespace trace_event
 }  // namespace base
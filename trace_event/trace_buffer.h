@@ -10,13 +10,18 @@
 
 #include "base/base_export.h"
 #include "base/check.h"
+#include "base/memory/scoped_refptr.h"
 #include "base/trace_event/trace_event.h"
 #include "base/trace_event/trace_event_impl.h"
 
 namespace base {
 
+class SequencedTaskRunner;
+
 namespace trace_event {
 
+class TraceSpoolWriter;
+
 // TraceBufferChunk is the basic unit of TraceBuffer.
 class BASE_EXPORT TraceBufferChunk {
  public:
@@ -61,6 +66,15 @@ class BASE_EXPORT TraceBuffer {
   virtual ~TraceBuffer() = default;
 
   virtual std::unique_ptr<TraceBufferChunk> GetChunk(size_t* index) = 0;
+  // Like GetChunk(), but returns |*spare_chunk|, an empty chunk which isn't in
+  // the buffer, rather than allocating a chunk or resetting a recycled one.
+  // The recycled chunk, if any, is moved to |*spare_chunk| unreset, so that
+  // the caller may reset it and allocate chunks without holding the TraceLog
+  // lock. Does the same as GetChunk() if |*spare_chunk| is null, or if the
+  // buffer doesn't override this.
+  virtual std::unique_ptr<TraceBufferChunk> GetChunkWithSpare(
+      size_t* index,
+      std::unique_ptr<TraceBufferChunk>* spare_chunk);
   virtual void ReturnChunk(size_t index,
                            std::unique_ptr<TraceBufferChunk> chunk) = 0;
 
@@ -72,6 +86,8 @@ class BASE_EXPORT TraceBuffer {
   // For iteration. Each TraceBuffer can only be iterated once.
   virtual const TraceBufferChunk* NextChunk() = 0;
 
+  // Returns the sequence on which the buffer must be iterated, if any.
+  virtual scoped_refptr<SequencedTaskRunner> GetIterationTaskRunner() const;
 
   // Computes an estimate of the size of the buffer, including all the retained
   // objects.
@@ -80,6 +96,12 @@ class BASE_EXPORT TraceBuffer {
 
   static TraceBuffer* CreateTraceBufferRingBuffer(size_t max_chunks);
   static TraceBuffer* CreateTraceBufferVectorOfSize(size_t max_chunks);
+  // Returns a ring buffer which hands the chunks that it would overwrite to
+  // |spool_writer|. The buffer is iterated on the writer's sequence, and its
+  // iteration writes its remaining chunks rather than returning them.
+  static TraceBuffer* CreateTraceBufferSpool(
+      size_t max_chunks,
+      std::unique_ptr<TraceSpoolWriter> spool_writer);
 };
 
 // TraceResultBuffer collects and converts trace fragments returned by TraceLog
@@ -26,6 +26,90 @@ bool AreStringListsEquivalent(const std::vector<std::string>& list1,
   std::unordered_set<std::string> set2(list2.begin(), list2.end());
   return set1 == set2;
 }
+
+bool IsDisabledByDefaultCategory(StringPiece category_name) {
+  return StartsWith(category_name, TRACE_DISABLED_BY_DEFAULT(""));
+}
+}
+
+TraceConfigCategoryFilter::PatternSet::Node::Node() = default;
+
+TraceConfigCategoryFilter::PatternSet::Node::Node(const Node& other) = default;
+
+TraceConfigCategoryFilter::PatternSet::Node::~Node() = default;
+
+TraceConfigCategoryFilter::PatternSet::Node&
+TraceConfigCategoryFilter::PatternSet::Node::operator=(const Node& rhs) =
+    default;
+
+TraceConfigCategoryFilter::PatternSet::PatternSet() : nodes_(1) {}
+
+TraceConfigCategoryFilter::PatternSet::PatternSet(const PatternSet& other) =
+    default;
+
+TraceConfigCategoryFilter::PatternSet::~PatternSet() = default;
+
+TraceConfigCategoryFilter::PatternSet&
+TraceConfigCategoryFilter::PatternSet::operator=(const PatternSet& rhs) =
+    default;
+
+void TraceConfigCategoryFilter::PatternSet::Compile(
+    const StringList& patterns) {
+  nodes_.assign(1, Node());
+  other_patterns_.clear();
+  for (const std::string& pattern : patterns) {
+    StringPiece name(pattern);
+    const bool is_prefix = !name.empty() && name.back() == '*';
+    if (is_prefix)
+      name.remove_suffix(1);
+    // Non-ASCII patterns are left to MatchPattern(), which compares code
+    // points rather than bytes.
+    if (!IsStringASCII(name) ||
+        name.find_first_of("*?\\") != StringPiece::npos) {
+      other_patterns_.push_back(pattern);
+      continue;
+    }
+
+    uint32_t node = 0;
+    for (char c : name) {
+      auto it = nodes_[node].children.find(c);
+      if (it != nodes_[node].children.end()) {
+        node = it->second;
+        continue;
+      }
+      const uint32_t child = static_cast<uint32_t>(nodes_.size());
+      nodes_[node].children.emplace(c, child);
+      nodes_.emplace_back();
+      node = child;
+    }
+    if (is_prefix)
+      nodes_[node].ends_prefix = true;
+    else
+      nodes_[node].ends_name = true;
+  }
+}
+
+bool TraceConfigCategoryFilter::PatternSet::Matches(
+    StringPiece category_name) const {
+  const Node* node = &nodes_[0];
+  for (char c : category_name) {
+    if (node->ends_prefix)
+      return true;
+    auto it = node->children.find(c);
+    if (it == node->children.end()) {
+      node = nullptr;
+      break;
+    }
+    node = &nodes_[it->second];
+  }
+  if (node && (node->ends_name || node->ends_prefix))
+    return true;
+
+  for (const std::string& pattern : other_patterns_) {
+    if (MatchPattern(category_name, pattern))
+      return true;
+  }
+  return false;
 }
 
 TraceConfigCategoryFilter::TraceConfigCategoryFilter() = default;
@@ -66,6 +150,7 @@ void TraceConfigCategoryFilter::InitializeFromString(
       included_categories_.emplace_back(category);
     }
   }
+  CompilePatterns();
 }
 
 void TraceConfigCategoryFilter::InitializeFromConfigDict(
@@ -78,6 +163,7 @@ void TraceConfigCategoryFilter::InitializeFromConfigDict(
       dict.FindList(kExcludedCategoriesParam);
   if (excluded_category_list)
     SetCategoriesFromExcludedList(*excluded_category_list);
+  CompilePatterns();
 }
 
 bool TraceConfigCategoryFilter::IsCategoryGroupEnabled(
@@ -94,7 +180,7 @@ bool TraceConfigCategoryFilter::IsCategoryGroupEnabled(
     if (IsCategoryEnabled(category_group_token))
       return true;
 
-    if (!MatchPattern(category_group_token, TRACE_DISABLED_BY_DEFAULT("*")))
+    if (!IsDisabledByDefaultCategory(category_group_token))
       had_enabled_by_default = true;
   }
   // Do a second pass to check for explicitly disabled categories
@@ -103,21 +189,18 @@ bool TraceConfigCategoryFilter::IsCategoryGroupEnabled(
   bool category_group_disabled = false;
   while (category_group_tokens.GetNext()) {
     StringPiece category_group_token = category_group_tokens.token_piece();
-    for (const std::string& category : excluded_categories_) {
-      if (MatchPattern(category_group_token, category)) {
-        // Current token of category_group_name is present in excluded_list.
-        // Flag the exclusion and proceed further to check if any of the
-        // remaining categories of category_group_name is not present in the
-        // excluded_ list.
-        category_group_disabled = true;
-        break;
-      }
+    if (excluded_patterns_.Matches(category_group_token)) {
+      // Current token of category_group_name is present in excluded_list.
+      // Flag the exclusion and proceed further to check if any of the
+      // remaining categories of category_group_name is not present in the
+      // excluded_ list.
+      category_group_disabled = true;
+    } else if (!IsDisabledByDefaultCategory(category_group_token)) {
       // One of the category of category_group_name is not present in
       // excluded_ list. So, if it's not a disabled-by-default category,
       // it has to be included_ list. Enable the category_group_name
       // for recording.
-      if (!MatchPattern(category_group_token, TRACE_DISABLED_BY_DEFAULT("*")))
-        category_group_disabled = false;
+      category_group_disabled = false;
     }
     // One of the categories present in category_group_name is not present in
     // excluded_ list. Implies this category_group_name group can be enabled
@@ -136,20 +219,13 @@ bool TraceConfigCategoryFilter::IsCategoryEnabled(
     const StringPiece& category_name) const {
   // Check the disabled- filters and the disabled-* wildcard first so that a
   // "*" filter does not include the disabled.
-  for (const std::string& category : disabled_categories_) {
-    if (MatchPattern(category_name, category))
-      return true;
-  }
+  if (disabled_patterns_.Matches(category_name))
+    return true;
 
-  if (MatchPattern(category_name, TRACE_DISABLED_BY_DEFAULT("*")))
+  if (IsDisabledByDefaultCategory(category_name))
     return false;
 
-  for (const std::string& category : included_categories_) {
-    if (MatchPattern(category_name, category))
-      return true;
-  }
-
-  return false;
+  return included_patterns_.Matches(category_name);
 }
 
 void TraceConfigCategoryFilter::Merge(const TraceConfigCategoryFilter& config) {
@@ -170,12 +246,14 @@ void TraceConfigCategoryFilter::Merge(const TraceConfigCategoryFilter& config) {
   excluded_categories_.insert(excluded_categories_.end(),
                               config.excluded_categories_.begin(),
                               config.excluded_categories_.end());
+  CompilePatterns();
 }
 
 void TraceConfigCategoryFilter::Clear() {
   included_categories_.clear();
   disabled_categories_.clear();
   excluded_categories_.clear();
+  CompilePatterns();
 }
 
 void TraceConfigCategoryFilter::ToDict(Value::Dict& dict) const {
@@ -194,6 +272,12 @@ std::string TraceConfigCategoryFilter::ToFilterString() const {
   return filter_string;
 }
 
+void TraceConfigCategoryFilter::CompilePatterns() {
+  included_patterns_.Compile(included_categories_);
+  disabled_patterns_.Compile(disabled_categories_);
+  excluded_patterns_.Compile(excluded_categories_);
+}
+
 void TraceConfigCategoryFilter::SetCategoriesFromIncludedList(
     const Value::List& included_list) {
   included_categories_.clear();
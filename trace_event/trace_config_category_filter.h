@@ -5,10 +5,13 @@
 #ifndef BASE_TRACE_EVENT_TRACE_CONFIG_CATEGORY_FILTER_H_
 #define BASE_TRACE_EVENT_TRACE_CONFIG_CATEGORY_FILTER_H_
 
+#include <stdint.h>
+
 #include <string>
 #include <vector>
 
 #include "base/base_export.h"
+#include "base/containers/flat_map.h"
 #include "base/strings/string_piece.h"
 #include "base/values.h"
 
@@ -40,7 +43,9 @@ class BASE_EXPORT TraceConfigCategoryFilter {
 
   // Returns true if at least one category in the list is enabled by this
   // trace config. This is used to determine if the category filters are
-  // enabled in the TRACE_* macros.
+  // enabled in the TRACE_* macros. Takes time proportional to the length of
+  // |category_group_name| rather than to the number of patterns, unless the
+  // patterns use wildcards other than a trailing '*'.
   bool IsCategoryGroupEnabled(const StringPiece& category_group_name) const;
 
   // Returns true if the category is enabled according to this trace config.
@@ -61,6 +66,46 @@ class BASE_EXPORT TraceConfigCategoryFilter {
   const StringList& disabled_categories() const { return disabled_categories_; }
 
  private:
+  // A list of category patterns, compiled so that a category is matched
+  // against all of them at once. Category names, with or without a trailing
+  // '*', are stored in a trie. The other patterns are matched one by one with
+  // MatchPattern().
+  class PatternSet {
+   public:
+    PatternSet();
+    PatternSet(const PatternSet& other);
+    ~PatternSet();
+
+    PatternSet& operator=(const PatternSet& rhs);
+
+    void Compile(const StringList& patterns);
+
+    // Returns true if |category_name| matches one of the patterns.
+    bool Matches(StringPiece category_name) const;
+
+   private:
+    struct Node {
+      Node();
+      Node(const Node& other);
+      ~Node();
+
+      Node& operator=(const Node& rhs);
+
+      flat_map<char, uint32_t> children;
+      // Whether a pattern is the name of this node.
+      bool ends_name = false;
+      // Whether a pattern is the name of this node followed by '*'.
+      bool ends_prefix = false;
+    };
+
+    // The root of the trie is the first node.
+    std::vector<Node> nodes_;
+    StringList other_patterns_;
+  };
+
+  // Compiles the category lists, after they change.
+  void CompilePatterns();
+
   void SetCategoriesFromIncludedList(const Value::List& included_list);
   void SetCategoriesFromExcludedList(const Value::List& excluded_list);
 
@@ -75,6 +120,10 @@ class BASE_EXPORT TraceConfigCategoryFilter {
   StringList included_categories_;
   StringList disabled_categories_;
   StringList excluded_categories_;
+
+  PatternSet included_patterns_;
+  PatternSet disabled_patterns_;
+  PatternSet excluded_patterns_;
 };
 
 }  // namespace base::trace_event
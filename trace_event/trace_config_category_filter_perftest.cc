@@ -0,0 +1,108 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_config_category_filter.h"
+
+#include <stddef.h>
+
+#include <iterator>
+#include <string>
+
+#include "base/time/time.h"
+#include "base/timer/lap_timer.h"
+#include "base/trace_event/builtin_categories.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace base::trace_event {
+
+namespace {
+
+constexpr char kMetricPrefixCategoryFilter[] = "TraceConfigCategoryFilter.";
+constexpr char kMetricNsPerCategoryGroup[] = "ns_per_category_group";
+
+// The category groups which TraceLog matches as a trace starts.
+constexpr const char* kCategoryGroups[] = {
+    INTERNAL_TRACE_LIST_BUILTIN_CATEGORIES(INTERNAL_TRACE_INIT_CATEGORY_NAME)
+        INTERNAL_TRACE_LIST_BUILTIN_CATEGORY_GROUPS(
+            INTERNAL_TRACE_INIT_CATEGORY_NAME)};
+
+// The filter of a DevTools performance recording.
+constexpr char kDevToolsFilter[] =
+    "-*,devtools.timeline,v8.execute,v8,blink.console,blink.user_timing,"
+    "latencyInfo,loading,toplevel,disabled-by-default-devtools.timeline,"
+    "disabled-by-default-devtools.timeline.frame,"
+    "disabled-by-default-devtools.timeline.stack,"
+    "disabled-by-default-devtools.timeline.invalidationTracking,"
+    "disabled-by-default-v8.cpu_profiler,disabled-by-default-lighthouse";
+
+// A filter with many patterns, as benchmarks which trace most categories
+// have.
+constexpr char kWildcardFilter[] =
+    "benchmark,blink*,cc*,gpu*,viz*,v8*,toplevel*,ipc,mojom,navigation,"
+    "renderer*,input*,latency*,loading,net,netlog,media,audio,base,browser,"
+    "startup,memory,rail,evdev,ui,views,disabled-by-default-cc.debug*,"
+    "disabled-by-default-gpu.*,disabled-by-default-viz.*,"
+    "disabled-by-default-v8.gc*,disabled-by-default-memory-infra*,"
+    "-*.debug,-*.verbose,-ipc.flow";
+
+class TraceConfigCategoryFilterPerfTest : public testing::Test {
+ protected:
+  TraceConfigCategoryFilterPerfTest()
+      : timer_(/*warmup_laps=*/10, Seconds(1), /*check_interval=*/10) {}
+
+  // Matches all the category groups against |filter|, as TraceLog does when
+  // the trace config changes.
+  void RunCategoryGroups(const TraceConfigCategoryFilter& filter,
+                         const std::string& story) {
+    do {
+      for (const char* category_group : kCategoryGroups) {
+        if (filter.IsCategoryGroupEnabled(category_group))
+          ++enabled_count_;
+      }
+      timer_.NextLap();
+    } while (!timer_.HasTimeLimitExpired());
+    EXPECT_GT(enabled_count_, 0u);
+
+    perf_test::PerfResultReporter reporter(kMetricPrefixCategoryFilter, story);
+    reporter.RegisterImportantMetric(kMetricNsPerCategoryGroup, "ns");
+    reporter.AddResult(kMetricNsPerCategoryGroup,
+                       timer_.TimePerLap().InMicrosecondsF() * 1000 /
+                           std::size(kCategoryGroups));
+  }
+
+  LapTimer timer_;
+  // Keeps the compiler from dropping the measured work.
+  size_t enabled_count_ = 0;
+};
+
+}  // namespace
+
+TEST_F(TraceConfigCategoryFilterPerfTest, DevToolsFilter) {
+  TraceConfigCategoryFilter filter;
+  filter.InitializeFromString(kDevToolsFilter);
+  RunCategoryGroups(filter, "devtools");
+}
+
+TEST_F(TraceConfigCategoryFilterPerfTest, WildcardFilter) {
+  TraceConfigCategoryFilter filter;
+  filter.InitializeFromString(kWildcardFilter);
+  RunCategoryGroups(filter, "wildcards");
+}
+
+// Includes every builtin category by name, so that the filter has hundreds of
+// patterns.
+TEST_F(TraceConfigCategoryFilterPerfTest, AllCategoriesFilter) {
+  std::string filter_string;
+  for (const char* category : kCategoryGroups) {
+    if (!filter_string.empty())
+      filter_string += ",";
+    filter_string += category;
+  }
+  TraceConfigCategoryFilter filter;
+  filter.InitializeFromString(filter_string);
+  RunCategoryGroups(filter, "all_categories");
+}
+
+}  // namespace base::trace_event
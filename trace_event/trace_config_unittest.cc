@@ -6,6 +6,7 @@
 
 #include "base/json/json_reader.h"
 #include "base/json/json_writer.h"
+#include "base/strings/pattern.h"
 #include "base/trace_event/memory_dump_manager.h"
 #include "base/trace_event/trace_config.h"
 #include "base/trace_event/trace_config_memory_test_util.h"
@@ -613,6 +614,52 @@ TEST(TraceConfigTest, IsCategoryGroupEnabled) {
   EXPECT_FALSE(tc.IsCategoryGroupEnabled("excluded,disabled-by-default-cc"));
 }
 
+TEST(TraceConfigTest, IsCategoryEnabledMatchesLikeMatchPattern) {
+  // Names and prefixes are matched with a trie, and the other patterns with
+  // MatchPattern().
+  const char* const kPatterns[] = {
+      "cc", "cc*",      "cc.debug*",    "*",        "*.debug",
+      "c?", "blink\\*", "v8.*.compile", "toplevel", "",
+  };
+  const char* const kCategories[] = {
+      "cc",               "c",        "ccc",           "cc.debug",
+      "cc.debug.picture", "blink",    "blink*",        "v8",
+      "v8.foo.compile",   "toplevel", "toplevel.flow", "gpu.debug",
+  };
+
+  for (const char* pattern : kPatterns) {
+    TraceConfigCategoryFilter filter;
+    filter.InitializeFromString(pattern);
+    for (const char* category : kCategories) {
+      // Empty patterns are ignored.
+      EXPECT_EQ(*pattern && MatchPattern(category, pattern),
+                filter.IsCategoryEnabled(category))
+          << pattern << " " << category;
+    }
+  }
+
+  TraceConfigCategoryFilter filter;
+  filter.InitializeFromString("toplevel,cc.debug*,c?,ipc");
+  EXPECT_TRUE(filter.IsCategoryEnabled("toplevel"));
+  EXPECT_TRUE(filter.IsCategoryEnabled("cc.debug.picture"));
+  EXPECT_TRUE(filter.IsCategoryEnabled("cc"));
+  EXPECT_TRUE(filter.IsCategoryEnabled("ipc"));
+  EXPECT_FALSE(filter.IsCategoryEnabled("top"));
+  EXPECT_FALSE(filter.IsCategoryEnabled("toplevel.flow"));
+  EXPECT_FALSE(filter.IsCategoryEnabled("ipc.flow"));
+  EXPECT_FALSE(filter.IsCategoryEnabled("gpu"));
+
+  // The patterns are compiled again as the filter changes.
+  TraceConfigCategoryFilter other_filter;
+  other_filter.InitializeFromString("gpu*");
+  filter.Merge(other_filter);
+  EXPECT_TRUE(filter.IsCategoryEnabled("gpu.debug"));
+  EXPECT_TRUE(filter.IsCategoryEnabled("toplevel"));
+  filter.Clear();
+  EXPECT_FALSE(filter.IsCategoryEnabled("toplevel"));
+  EXPECT_FALSE(filter.IsCategoryEnabled("gpu.debug"));
+}
+
 TEST(TraceConfigTest, IsCategoryNameAllowed) {
   // Test that IsCategoryNameAllowed actually catches categories that are
   // explicitly forbidden. This method is called in a DCHECK to assert that we
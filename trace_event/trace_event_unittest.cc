@@ -20,6 +20,10 @@
 #include "base/at_exit.h"
 #include "base/command_line.h"
 #include "base/containers/cxx20_erase_vector.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
 #include "base/functional/bind.h"
 #include "base/json/json_reader.h"
 #include "base/json/json_writer.h"
@@ -39,6 +43,7 @@
 #include "base/threading/thread.h"
 #include "base/time/time.h"
 #include "base/trace_event/trace_buffer.h"
+#include "base/trace_event/trace_spool.h"
 #include "base/values.h"
 #include "build/build_config.h"
 #include "testing/gmock/include/gmock/gmock.h"
@@ -2224,6 +2229,56 @@ TEST_F(TraceEventTestFixture, TraceBufferRingBufferFullIteration) {
   TraceLog::GetInstance()->SetDisabled();
 }
 
+TEST_F(TraceEventTestFixture, TraceBufferRingBufferGetChunkWithSpare) {
+  TraceLog::GetInstance()->SetEnabled(
+      TraceConfig(kRecordAllCategoryFilter, RECORD_CONTINUOUSLY),
+      TraceLog::RECORDING_MODE);
+  TraceBuffer* buffer = TraceLog::GetInstance()->trace_buffer();
+  size_t capacity = buffer->Capacity();
+  size_t num_chunks = capacity / TraceBufferChunk::kTraceBufferChunkSize;
+  uint32_t last_seq = 0;
+  size_t chunk_index;
+
+  // The spare chunks are used while the ring isn't full yet.
+  std::vector<TraceBufferChunk*> chunks(num_chunks);
+  for (size_t i = 0; i < num_chunks; ++i) {
+    auto spare_chunk = std::make_unique<TraceBufferChunk>(0);
+    TraceBufferChunk* spare_chunk_ptr = spare_chunk.get();
+    chunks[i] =
+        buffer->GetChunkWithSpare(&chunk_index, &spare_chunk).release();
+    EXPECT_EQ(spare_chunk_ptr, chunks[i]);
+    EXPECT_FALSE(spare_chunk);
+    EXPECT_EQ(i, chunk_index);
+    EXPECT_GT(chunks[i]->seq(), last_seq);
+    last_seq = chunks[i]->seq();
+    size_t event_index;
+    chunks[i]->AddTraceEvent(&event_index);
+  }
+  for (size_t i = 0; i < num_chunks; ++i)
+    buffer->ReturnChunk(i, std::unique_ptr<TraceBufferChunk>(chunks[i]));
+
+  // Then the oldest chunks are swapped for the spare ones, unreset, and can't
+  // be reached through their handles anymore.
+  for (size_t i = 0; i < num_chunks; ++i) {
+    TraceEventHandle handle = {chunks[i]->seq(), static_cast<unsigned>(i), 0};
+    ASSERT_TRUE(buffer->GetEventByHandle(handle));
+    auto spare_chunk = std::make_unique<TraceBufferChunk>(0);
+    TraceBufferChunk* spare_chunk_ptr = spare_chunk.get();
+    std::unique_ptr<TraceBufferChunk> chunk =
+        buffer->GetChunkWithSpare(&chunk_index, &spare_chunk);
+    EXPECT_EQ(spare_chunk_ptr, chunk.get());
+    EXPECT_EQ(chunks[i], spare_chunk.get());
+    EXPECT_EQ(1u, spare_chunk->size());
+    EXPECT_EQ(i, chunk_index);
+    EXPECT_GT(chunk->seq(), last_seq);
+    last_seq = chunk->seq();
+    EXPECT_FALSE(buffer->GetEventByHandle(handle));
+    buffer->ReturnChunk(chunk_index, std::move(chunk));
+  }
+
+  TraceLog::GetInstance()->SetDisabled();
+}
+
 TEST_F(TraceEventTestFixture, TraceRecordAsMuchAsPossibleMode) {
   TraceLog::GetInstance()->SetEnabled(
     TraceConfig(kRecordAllCategoryFilter, RECORD_AS_MUCH_AS_POSSIBLE),
@@ -2242,6 +2297,38 @@ TEST_F(TraceEventTestFixture, ConfigTraceBufferLimit) {
   EXPECT_EQ(kLimit, buffer->Capacity());
   TraceLog::GetInstance()->SetDisabled();
 }
+
+TEST_F(TraceEventTestFixture, TraceSpool) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const FilePath path = temp_dir.GetPath().AppendASCII("spool");
+  TraceLog::GetInstance()->SetTraceSpoolFile(
+      File(path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE));
+
+  // More events than the spool keeps in memory.
+  const int kEventCount = 20000;
+  BeginTrace();
+  for (int i = 0; i < kEventCount; ++i)
+    TRACE_EVENT_INSTANT1("test_all", "spooled", TRACE_EVENT_SCOPE_THREAD,
+                         "index", i);
+  EndTraceAndFlush();
+  // The events were written to the spool rather than output.
+  EXPECT_TRUE(trace_parsed_.empty());
+
+  absl::optional<std::vector<uint8_t>> spool = ReadFileToBytes(path);
+  ASSERT_TRUE(spool);
+  std::string json;
+  ASSERT_TRUE(ConvertTraceSpoolToJSON(*spool, &json));
+  absl::optional<Value> root = JSONReader::Read(json);
+  ASSERT_TRUE(root && root->is_list());
+  int index = 0;
+  for (const Value& item : root->GetList()) {
+    const std::string* name = item.GetDict().FindString("name");
+    if (name && *name == "spooled")
+      EXPECT_EQ(index++, item.GetDict().FindIntByDottedPath("args.index"));
+  }
+  EXPECT_EQ(kEventCount, index);
+}
 #endif  // BUILDFLAG(USE_PERFETTO_CLIENT_LIBRARY)
 
 void BlockUntilStopped(WaitableEvent* task_start_event,
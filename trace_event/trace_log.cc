@@ -48,6 +48,7 @@
 #include "base/trace_event/process_memory_dump.h"
 #include "base/trace_event/trace_buffer.h"
 #include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_spool.h"
 #include "build/build_config.h"
 
 #if BUILDFLAG(USE_PERFETTO_CLIENT_LIBRARY)
@@ -98,6 +99,10 @@ const size_t kTraceEventRingBufferChunks = kTraceEventVectorBufferChunks / 4;
 
 // ECHO_TO_CONSOLE needs a small buffer to hold the unfinished COMPLETE events.
 const size_t kEchoToConsoleTraceEventBufferChunks = 256;
+// The chunks of a spool kept in memory, e.g. for their durations to be
+// updated, and the most chunks waiting to be written.
+const size_t kTraceSpoolChunks = 256;
+const size_t kTraceSpoolMaxPendingChunks = 1024;
 
 const size_t kTraceEventBufferSizeInBytes = 100 * 1024;
 
@@ -499,6 +504,10 @@ class TraceLog::ThreadLocalEventBuffer
   raw_ptr<TraceLog> trace_log_;
   std::unique_ptr<TraceBufferChunk> chunk_;
   size_t chunk_index_ = 0;
+  // An empty chunk for TraceBuffer::GetChunkWithSpare(), which is allocated
+  // and reset without holding the TraceLog lock. This way, the lock is only
+  // held to swap a full chunk for a new one.
+  std::unique_ptr<TraceBufferChunk> spare_chunk_;
   int generation_;
 };
 
@@ -535,15 +544,25 @@ TraceEvent* TraceLog::ThreadLocalEventBuffer::AddTraceEvent(
     TraceEventHandle* handle) {
   CheckThisIsCurrentBuffer();
 
-  if (chunk_ && chunk_->IsFull()) {
-    AutoLock lock(trace_log_->lock_);
-    FlushWhileLocked();
-    chunk_.reset();
-  }
-  if (!chunk_) {
-    AutoLock lock(trace_log_->lock_);
-    chunk_ = trace_log_->logged_events_->GetChunk(&chunk_index_);
-    trace_log_->CheckIfBufferIsFullWhileLocked();
+  if (!chunk_ || chunk_->IsFull()) {
+    // The chunks are tracing's own memory, which the heap profiler ignores.
+    HEAP_PROFILER_SCOPED_IGNORE;
+    if (!spare_chunk_)
+      spare_chunk_ = std::make_unique<TraceBufferChunk>(0);
+    // Holds the full chunk if it is from a previous generation, so that it is
+    // deleted after the lock is released.
+    std::unique_ptr<TraceBufferChunk> stale_chunk;
+    {
+      AutoLock lock(trace_log_->lock_);
+      FlushWhileLocked();
+      stale_chunk = std::move(chunk_);
+      chunk_ = trace_log_->logged_events_->GetChunkWithSpare(&chunk_index_,
+                                                             &spare_chunk_);
+      trace_log_->CheckIfBufferIsFullWhileLocked();
+    }
+    // The buffer may have swapped the spare chunk for a recycled one.
+    if (spare_chunk_)
+      spare_chunk_->Reset(0);
   }
   if (!chunk_)
     return nullptr;
@@ -562,12 +581,15 @@ void TraceLog::ThreadLocalEventBuffer::WillDestroyCurrentMessageLoop() {
 
 bool TraceLog::ThreadLocalEventBuffer::OnMemoryDump(const MemoryDumpArgs& args,
                                                     ProcessMemoryDump* pmd) {
-  if (!chunk_)
+  if (!chunk_ && !spare_chunk_)
     return true;
   std::string dump_base_name =
       "tracing/thread_" + NumberToString(PlatformThread::CurrentId());
   TraceEventMemoryOverhead overhead;
-  chunk_->EstimateTraceMemoryOverhead(&overhead);
+  if (chunk_)
+    chunk_->EstimateTraceMemoryOverhead(&overhead);
+  if (spare_chunk_)
+    spare_chunk_->EstimateTraceMemoryOverhead(&overhead);
   overhead.DumpInto(dump_base_name.c_str(), pmd);
   return true;
 }
@@ -915,7 +937,8 @@ void TraceLog::SetEnabled(const TraceConfig& trace_config,
   // size is not supported while already recording, so only replace trace
   // buffer if we were not already recording.
   if (new_options != old_options ||
-      (trace_config_.GetTraceBufferSizeInEvents() && !already_recording)) {
+      (trace_config_.GetTraceBufferSizeInEvents() && !already_recording) ||
+      spool_writer_) {
     trace_options_.store(new_options, std::memory_order_relaxed);
     UseNextTraceBuffer();
   }
@@ -1459,16 +1482,8 @@ void TraceLog::FinishFlush(int generation, bool discard_events) {
     flush_output_callback = flush_output_callback_;
     flush_output_callback_.Reset();
 
-    if (trace_options() & kInternalEnableArgumentFilter) {
-      // If argument filtering is activated and there is no filtering predicate,
-      // use the safe default filtering predicate.
-      if (argument_filter_predicate_.is_null()) {
-        argument_filter_predicate =
-            base::BindRepeating(&DefaultIsTraceEventArgsAllowlisted);
-      } else {
-        argument_filter_predicate = argument_filter_predicate_;
-      }
-    }
+    argument_filter_predicate =
+        GetArgumentFilterPredicateForOptionsWhileLocked();
   }
 
   if (discard_events) {
@@ -1479,6 +1494,17 @@ void TraceLog::FinishFlush(int generation, bool discard_events) {
     return;
   }
 
+  // A spool is iterated on the sequence which writes it, so that its remaining
+  // events are written after the spooled ones.
+  if (scoped_refptr<SequencedTaskRunner> task_runner =
+          previous_logged_events->GetIterationTaskRunner()) {
+    task_runner->PostTask(
+        FROM_HERE, BindOnce(&TraceLog::ConvertTraceEventsToTraceFormat,
+                            std::move(previous_logged_events),
+                            flush_output_callback, argument_filter_predicate));
+    return;
+  }
+
   if (use_worker_thread_) {
     base::ThreadPool::PostTask(
         FROM_HERE,
@@ -2129,6 +2155,16 @@ void TraceLog::SetThreadSortIndex(PlatformThreadId thread_id, int sort_index) {
 void TraceLog::SetTimeOffset(TimeDelta offset) {
   time_offset_ = offset;
 }
+
+void TraceLog::SetTraceSpoolFile(File spool_file) {
+  DCHECK(spool_file.IsValid());
+  // The writer posts a task, which can't be done with the lock held.
+  auto spool_writer = std::make_unique<TraceSpoolWriter>(
+      std::move(spool_file), process_id(), kTraceSpoolMaxPendingChunks);
+  AutoLock lock(lock_);
+  DCHECK(!enabled_);
+  spool_writer_ = std::move(spool_writer);
+}
 #endif  // !BUILDFLAG(USE_PERFETTO_CLIENT_LIBRARY)
 
 size_t TraceLog::GetObserverCountForTest() const {
@@ -2144,6 +2180,12 @@ void TraceLog::SetCurrentThreadBlocksMessageLoop() {
 
 TraceBuffer* TraceLog::CreateTraceBuffer() {
   HEAP_PROFILER_SCOPED_IGNORE;
+  if (spool_writer_) {
+    spool_writer_->SetArgumentFilterPredicate(
+        GetArgumentFilterPredicateForOptionsWhileLocked());
+    return TraceBuffer::CreateTraceBufferSpool(kTraceSpoolChunks,
+                                               std::move(spool_writer_));
+  }
   InternalTraceOptions options = trace_options();
   const size_t config_buffer_chunks =
       trace_config_.GetTraceBufferSizeInEvents() / kTraceBufferChunkSize;
@@ -2167,6 +2209,17 @@ TraceBuffer* TraceLog::CreateTraceBuffer() {
                                : kTraceEventVectorBufferChunks);
 }
 
+ArgumentFilterPredicate
+TraceLog::GetArgumentFilterPredicateForOptionsWhileLocked() const {
+  if (!(trace_options() & kInternalEnableArgumentFilter))
+    return ArgumentFilterPredicate();
+  // If argument filtering is activated and there is no filtering predicate,
+  // use the safe default filtering predicate.
+  if (argument_filter_predicate_.is_null())
+    return base::BindRepeating(&DefaultIsTraceEventArgsAllowlisted);
+  return argument_filter_predicate_;
+}
+
 #if BUILDFLAG(IS_WIN)
 void TraceLog::UpdateETWCategoryGroupEnabledFlags() {
   // Go through each category and set/clear the ETW bit depending on whether the
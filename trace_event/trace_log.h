@@ -17,6 +17,7 @@
 
 #include "base/base_export.h"
 #include "base/containers/stack.h"
+#include "base/files/file.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/scoped_refptr.h"
 #include "base/no_destructor.h"
@@ -51,6 +52,7 @@ class TraceBuffer;
 class TraceBufferChunk;
 class TraceEvent;
 class TraceEventMemoryOverhead;
+class TraceSpoolWriter;
 class JsonStringOutputWriter;
 
 struct BASE_EXPORT TraceLogStatus {
@@ -400,6 +402,14 @@ class BASE_EXPORT TraceLog :
   // Allow setting an offset between the current TimeTicks time and the time
   // that should be reported.
   void SetTimeOffset(TimeDelta offset);
+
+  // Makes the next trace stream its events to |spool_file| while it is
+  // recorded, rather than keep them in memory until Flush(), so that long
+  // traces neither lose their oldest events nor use unbounded memory. Flush()
+  // then writes the remaining events to the spool and outputs none of them,
+  // and ConvertTraceSpoolToJSON() converts the spool to JSON offline. Must be
+  // called while tracing is disabled.
+  void SetTraceSpoolFile(File spool_file);
 #endif  // !BUILDFLAG(USE_PERFETTO_CLIENT_LIBRARY)
 
   size_t GetObserverCountForTest() const;
@@ -456,6 +466,8 @@ class BASE_EXPORT TraceLog :
                            TraceBufferRingBufferHalfIteration);
   FRIEND_TEST_ALL_PREFIXES(TraceEventTestFixture,
                            TraceBufferRingBufferFullIteration);
+  FRIEND_TEST_ALL_PREFIXES(TraceEventTestFixture,
+                           TraceBufferRingBufferGetChunkWithSpare);
   FRIEND_TEST_ALL_PREFIXES(TraceEventTestFixture, TraceBufferVectorReportFull);
   FRIEND_TEST_ALL_PREFIXES(TraceEventTestFixture,
                            ConvertTraceConfigToInternalOptions);
@@ -498,6 +510,8 @@ class BASE_EXPORT TraceLog :
 
   TraceBuffer* trace_buffer() const { return logged_events_.get(); }
   TraceBuffer* CreateTraceBuffer();
+  ArgumentFilterPredicate GetArgumentFilterPredicateForOptionsWhileLocked()
+      const;
 
   std::string EventToConsoleMessage(char phase,
                                     const TimeTicks& timestamp,
@@ -564,6 +578,8 @@ class BASE_EXPORT TraceLog :
   int num_traces_recorded_{0};
   std::unique_ptr<TraceBuffer> logged_events_;
   std::vector<std::unique_ptr<TraceEvent>> metadata_events_;
+  // Set by SetTraceSpoolFile() until the trace buffer takes it.
+  std::unique_ptr<TraceSpoolWriter> spool_writer_;
 
   // The lock protects observers access.
   mutable Lock observers_lock_;
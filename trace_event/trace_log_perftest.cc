@@ -0,0 +1,107 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_log.h"
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/functional/bind.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "base/timer/lap_timer.h"
+#include "base/trace_event/trace_config.h"
+#include "base/trace_event/trace_event.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+constexpr char kMetricPrefixTraceLog[] = "TraceLog.";
+constexpr char kMetricNsPerEvent[] = "ns_per_event";
+
+// Enough for each thread to fill a few hundred chunks per lap.
+constexpr size_t kEventsPerThreadPerLap = 10000;
+
+void AddEvents(WaitableEvent* done) {
+  for (size_t i = 0; i < kEventsPerThreadPerLap; ++i) {
+    TRACE_EVENT0("test_all", "TraceLogPerfTest");
+  }
+  done->Signal();
+}
+
+class TraceLogPerfTest : public testing::Test {
+ protected:
+  TraceLogPerfTest()
+      : timer_(/*warmup_laps=*/10, Seconds(1), /*check_interval=*/10) {}
+
+  // Records TRACE_EVENTs on |thread_count| threads at once, each of which
+  // has a thread-local event buffer, so that the threads contend for the
+  // chunks of the trace buffer. The ring buffer of a continuous trace
+  // overwrites the oldest chunks once it is full. Reports the wall time per
+  // event across all threads, i.e. the inverse of the throughput.
+  void RunEvents(size_t thread_count, const std::string& story) {
+    TraceLog::GetInstance()->SetEnabled(
+        TraceConfig("test_all", RECORD_CONTINUOUSLY),
+        TraceLog::RECORDING_MODE);
+
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+      threads.push_back(
+          std::make_unique<Thread>("TraceLogPerfTest" + NumberToString(i)));
+      ASSERT_TRUE(threads.back()->Start());
+    }
+
+    std::vector<std::unique_ptr<WaitableEvent>> done_events;
+    for (size_t i = 0; i < thread_count; ++i)
+      done_events.push_back(std::make_unique<WaitableEvent>());
+
+    do {
+      for (size_t i = 0; i < thread_count; ++i) {
+        threads[i]->task_runner()->PostTask(
+            FROM_HERE, BindOnce(&AddEvents, Unretained(done_events[i].get())));
+      }
+      for (auto& done : done_events)
+        done->Wait();
+      timer_.NextLap();
+    } while (!timer_.HasTimeLimitExpired());
+
+    for (auto& thread : threads)
+      thread->Stop();
+    TraceLog::GetInstance()->SetDisabled();
+
+    perf_test::PerfResultReporter reporter(kMetricPrefixTraceLog, story);
+    reporter.RegisterImportantMetric(kMetricNsPerEvent, "ns");
+    reporter.AddResult(kMetricNsPerEvent,
+                       timer_.TimePerLap().InMicrosecondsF() * 1000 /
+                           (thread_count * kEventsPerThreadPerLap));
+  }
+
+  LapTimer timer_;
+};
+
+}  // namespace
+
+TEST_F(TraceLogPerfTest, AddTraceEventOneThread) {
+  RunEvents(1, "add_trace_event_1_thread");
+}
+
+TEST_F(TraceLogPerfTest, AddTraceEventFourThreads) {
+  RunEvents(4, "add_trace_event_4_threads");
+}
+
+TEST_F(TraceLogPerfTest, AddTraceEventSixteenThreads) {
+  RunEvents(16, "add_trace_event_16_threads");
+}
+
+}  // namespace trace_event
+}  // namespace base
@@ -0,0 +1,635 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_spool.h"
+
+#include <inttypes.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "base/big_endian.h"
+#include "base/check.h"
+#include "base/functional/bind.h"
+#include "base/json/string_escape.h"
+#include "base/location.h"
+#include "base/memory/ref_counted.h"
+#include "base/notreached.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/task/sequenced_task_runner.h"
+#include "base/task/thread_pool.h"
+#include "base/task/thread_pool/thread_pool_instance.h"
+#include "base/thread_annotations.h"
+#include "base/time/time.h"
+#include "base/trace_event/trace_buffer.h"
+#include "base/trace_event/trace_log.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+// A spool starts with this magic and the process ID, followed by entries:
+//   - string entries, with the ID and the characters of a string, and
+//   - event entries, which refer to the strings written before them by ID.
+// The integers are big-endian.
+constexpr char kMagic[] = {'C', 'r', 'T', 'r', 'S', 'p', 'o', 'l'};
+constexpr uint8_t kStringEntry = 'S';
+constexpr uint8_t kEventEntry = 'E';
+
+// The argument count of an event whose arguments were all filtered out.
+constexpr uint8_t kStrippedArgs = 0xff;
+// The type of an argument filtered out by its name. Convertable and proto
+// arguments are written as TRACE_VALUE_TYPE_CONVERTABLE, with their JSON.
+constexpr uint8_t kStrippedArg = 0;
+
+// How often the spooled chunks are written in the background.
+constexpr TimeDelta kWriteInterval = Milliseconds(50);
+
+// The most chunks kept for reuse once they are written.
+constexpr size_t kMaxFreeChunks = 16;
+
+// The most strings remembered to be written only once. Further strings are
+// written with each event, so that unique names don't take up unbounded
+// memory.
+constexpr size_t kMaxInternedStrings = 64 * 1024;
+
+template <typename T>
+void AppendBigEndian(T value, std::string* output) {
+  char buffer[sizeof(T)];
+  WriteBigEndian(buffer, value);
+  output->append(buffer, sizeof(T));
+}
+
+void AppendString(StringPiece string, std::string* output) {
+  AppendBigEndian(static_cast<uint32_t>(string.size()), output);
+  output->append(string.data(), string.size());
+}
+
+bool ReadString(BigEndianReader* reader, StringPiece* string) {
+  uint32_t size;
+  return reader->ReadU32(&size) && reader->ReadPiece(string, size);
+}
+
+void AppendArgValue(unsigned char type,
+                    const TraceValue& value,
+                    std::string* output) {
+  switch (type) {
+    case TRACE_VALUE_TYPE_BOOL:
+      output->push_back(static_cast<char>(type));
+      AppendBigEndian<uint64_t>(value.as_bool, output);
+      return;
+    case TRACE_VALUE_TYPE_UINT:
+    case TRACE_VALUE_TYPE_INT:
+    case TRACE_VALUE_TYPE_DOUBLE:
+      output->push_back(static_cast<char>(type));
+      AppendBigEndian<uint64_t>(value.as_uint, output);
+      return;
+    case TRACE_VALUE_TYPE_POINTER:
+      output->push_back(static_cast<char>(type));
+      AppendBigEndian<uint64_t>(reinterpret_cast<uintptr_t>(value.as_pointer),
+                                output);
+      return;
+    case TRACE_VALUE_TYPE_STRING:
+    case TRACE_VALUE_TYPE_COPY_STRING:
+      output->push_back(static_cast<char>(type));
+      AppendString(value.as_string ? value.as_string : "NULL", output);
+      return;
+    case TRACE_VALUE_TYPE_CONVERTABLE:
+    case TRACE_VALUE_TYPE_PROTO: {
+      // These don't outlive their event, so they are written as JSON.
+      std::string json;
+      value.AppendAsJSON(type, &json);
+      output->push_back(static_cast<char>(TRACE_VALUE_TYPE_CONVERTABLE));
+      AppendString(json, output);
+      return;
+    }
+  }
+  NOTREACHED() << "Don't know how to spool this value";
+}
+
+// Reads an argument value and appends it to |out| as
+// TraceValue::AppendAsJSON() does. Returns false if it is malformed.
+bool AppendArgValueAsJSON(BigEndianReader* reader, std::string* out) {
+  uint8_t type;
+  if (!reader->ReadU8(&type)) {
+    return false;
+  }
+  switch (type) {
+    case kStrippedArg:
+      *out += "\"__stripped__\"";
+      return true;
+    case TRACE_VALUE_TYPE_BOOL:
+    case TRACE_VALUE_TYPE_UINT:
+    case TRACE_VALUE_TYPE_INT:
+    case TRACE_VALUE_TYPE_DOUBLE:
+    case TRACE_VALUE_TYPE_POINTER: {
+      uint64_t bits;
+      if (!reader->ReadU64(&bits)) {
+        return false;
+      }
+      TraceValue value;
+      if (type == TRACE_VALUE_TYPE_BOOL) {
+        value.as_bool = bits != 0;
+      } else if (type == TRACE_VALUE_TYPE_POINTER) {
+        value.as_pointer =
+            reinterpret_cast<const void*>(static_cast<uintptr_t>(bits));
+      } else {
+        value.as_uint = bits;
+      }
+      value.AppendAsJSON(type, out);
+      return true;
+    }
+    case TRACE_VALUE_TYPE_STRING:
+    case TRACE_VALUE_TYPE_COPY_STRING: {
+      StringPiece string;
+      if (!ReadString(reader, &string)) {
+        return false;
+      }
+      EscapeJSONString(string, true, out);
+      return true;
+    }
+    case TRACE_VALUE_TYPE_CONVERTABLE: {
+      StringPiece json;
+      if (!ReadString(reader, &json)) {
+        return false;
+      }
+      out->append(json.data(), json.size());
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns in |string| the string with the ID |id|, as read from the spool.
+bool GetString(const std::vector<StringPiece>& strings,
+               uint32_t id,
+               StringPiece* string) {
+  if (id == 0 || id > strings.size()) {
+    return false;
+  }
+  *string = strings[id - 1];
+  return true;
+}
+
+// Reads an event entry and appends the event to |out| as
+// TraceEvent::AppendAsJSON() does. Returns false if it is malformed.
+bool AppendEventAsJSON(BigEndianReader* reader,
+                       const std::vector<StringPiece>& strings,
+                       uint32_t spool_process_id,
+                       std::string* out) {
+  uint8_t phase;
+  uint32_t flags;
+  uint32_t category_id;
+  uint32_t name_id;
+  uint32_t scope_id;
+  uint64_t timestamp;
+  uint64_t thread_timestamp;
+  uint64_t duration;
+  uint64_t thread_duration;
+  uint64_t id;
+  uint64_t bind_id;
+  uint32_t thread_or_process_id;
+  uint8_t arg_count;
+  StringPiece category_group_name;
+  StringPiece name;
+  StringPiece scope;
+  if (!reader->ReadU8(&phase) || !reader->ReadU32(&flags) ||
+      !reader->ReadU32(&category_id) || !reader->ReadU32(&name_id) ||
+      !reader->ReadU32(&scope_id) || !reader->ReadU64(&timestamp) ||
+      !reader->ReadU64(&thread_timestamp) || !reader->ReadU64(&duration) ||
+      !reader->ReadU64(&thread_duration) || !reader->ReadU64(&id) ||
+      !reader->ReadU64(&bind_id) || !reader->ReadU32(&thread_or_process_id) ||
+      !reader->ReadU8(&arg_count) ||
+      !GetString(strings, category_id, &category_group_name) ||
+      !GetString(strings, name_id, &name) ||
+      (scope_id && !GetString(strings, scope_id, &scope))) {
+    return false;
+  }
+
+  int process_id = static_cast<int>(spool_process_id);
+  int thread_id = static_cast<int>(thread_or_process_id);
+  if ((flags & TRACE_EVENT_FLAG_HAS_PROCESS_ID) &&
+      static_cast<ProcessId>(thread_or_process_id) != kNullProcessId) {
+    process_id = static_cast<int>(thread_or_process_id);
+    thread_id = -1;
+  }
+  StringAppendF(out,
+                "{\"pid\":%i,\"tid\":%i,\"ts\":%" PRId64
+                ",\"ph\":\"%c\",\"cat\":\"%.*s\",\"name\":",
+                process_id, thread_id, static_cast<int64_t>(timestamp),
+                static_cast<char>(phase),
+                static_cast<int>(category_group_name.size()),
+                category_group_name.data());
+  EscapeJSONString(name, true, out);
+  *out += ",\"args\":";
+
+  if (arg_count == kStrippedArgs) {
+    *out += "\"__stripped__\"";
+  } else {
+    *out += "{";
+    for (uint8_t i = 0; i < arg_count; ++i) {
+      uint32_t arg_name_id;
+      StringPiece arg_name;
+      if (!reader->ReadU32(&arg_name_id) ||
+          !GetString(strings, arg_name_id, &arg_name)) {
+        return false;
+      }
+      if (i > 0) {
+        *out += ",";
+      }
+      *out += "\"";
+      out->append(arg_name.data(), arg_name.size());
+      *out += "\":";
+      if (!AppendArgValueAsJSON(reader, out)) {
+        return false;
+      }
+    }
+    *out += "}";
+  }
+
+  if (phase == TRACE_EVENT_PHASE_COMPLETE) {
+    if (static_cast<int64_t>(duration) != -1) {
+      StringAppendF(out, ",\"dur\":%" PRId64, static_cast<int64_t>(duration));
+    }
+    if (thread_timestamp && static_cast<int64_t>(thread_duration) != -1) {
+      StringAppendF(out, ",\"tdur\":%" PRId64,
+                    static_cast<int64_t>(thread_duration));
+    }
+  }
+  if (thread_timestamp) {
+    StringAppendF(out, ",\"tts\":%" PRId64,
+                  static_cast<int64_t>(thread_timestamp));
+  }
+  if (flags & TRACE_EVENT_FLAG_ASYNC_TTS) {
+    StringAppendF(out, ", \"use_async_tts\":1");
+  }
+
+  const uint32_t id_flags =
+      flags & (TRACE_EVENT_FLAG_HAS_ID | TRACE_EVENT_FLAG_HAS_LOCAL_ID |
+               TRACE_EVENT_FLAG_HAS_GLOBAL_ID);
+  if (id_flags) {
+    if (scope_id) {
+      StringAppendF(out, ",\"scope\":\"%.*s\"", static_cast<int>(scope.size()),
+                    scope.data());
+    }
+    switch (id_flags) {
+      case TRACE_EVENT_FLAG_HAS_ID:
+        StringAppendF(out, ",\"id\":\"0x%" PRIx64 "\"", id);
+        break;
+      case TRACE_EVENT_FLAG_HAS_LOCAL_ID:
+        StringAppendF(out, ",\"id2\":{\"local\":\"0x%" PRIx64 "\"}", id);
+        break;
+      case TRACE_EVENT_FLAG_HAS_GLOBAL_ID:
+        StringAppendF(out, ",\"id2\":{\"global\":\"0x%" PRIx64 "\"}", id);
+        break;
+      default:
+        return false;
+    }
+  }
+
+  if (flags & TRACE_EVENT_FLAG_BIND_TO_ENCLOSING) {
+    StringAppendF(out, ",\"bp\":\"e\"");
+  }
+  if (flags & (TRACE_EVENT_FLAG_FLOW_OUT | TRACE_EVENT_FLAG_FLOW_IN)) {
+    StringAppendF(out, ",\"bind_id\":\"0x%" PRIx64 "\"", bind_id);
+  }
+  if (flags & TRACE_EVENT_FLAG_FLOW_IN) {
+    StringAppendF(out, ",\"flow_in\":true");
+  }
+  if (flags & TRACE_EVENT_FLAG_FLOW_OUT) {
+    StringAppendF(out, ",\"flow_out\":true");
+  }
+
+  if (phase == TRACE_EVENT_PHASE_INSTANT) {
+    char instant_scope = '?';
+    switch (flags & TRACE_EVENT_FLAG_SCOPE_MASK) {
+      case TRACE_EVENT_SCOPE_GLOBAL:
+        instant_scope = TRACE_EVENT_SCOPE_NAME_GLOBAL;
+        break;
+      case TRACE_EVENT_SCOPE_PROCESS:
+        instant_scope = TRACE_EVENT_SCOPE_NAME_PROCESS;
+        break;
+      case TRACE_EVENT_SCOPE_THREAD:
+        instant_scope = TRACE_EVENT_SCOPE_NAME_THREAD;
+        break;
+    }
+    StringAppendF(out, ",\"s\":\"%c\"", instant_scope);
+  }
+
+  *out += "}";
+  return true;
+}
+
+}  // namespace
+
+// The state shared with the tasks which write the chunks in the background.
+class TraceSpoolWriter::Core : public RefCountedThreadSafe<Core> {
+ public:
+  Core(File file, ProcessId process_id, size_t max_pending_chunks)
+      : max_pending_chunks_(max_pending_chunks),
+        file_(std::move(file)),
+        process_id_(process_id) {}
+
+  Core(const Core&) = delete;
+  Core& operator=(const Core&) = delete;
+
+  void SetArgumentFilterPredicate(
+      const ArgumentFilterPredicate& argument_filter_predicate) {
+    AutoLock lock(lock_);
+    argument_filter_predicate_ = argument_filter_predicate;
+  }
+
+  std::unique_ptr<TraceBufferChunk> Spool(
+      std::unique_ptr<TraceBufferChunk> chunk) {
+    AutoLock lock(lock_);
+    if (pending_chunks_.size() >= max_pending_chunks_) {
+      dropped_event_count_.fetch_add(chunk->size(), std::memory_order_relaxed);
+      return chunk;
+    }
+    pending_chunks_.push_back(std::move(chunk));
+    if (free_chunks_.empty()) {
+      return nullptr;
+    }
+    std::unique_ptr<TraceBufferChunk> free_chunk =
+        std::move(free_chunks_.back());
+    free_chunks_.pop_back();
+    return free_chunk;
+  }
+
+  void WritePendingChunks() {
+    std::vector<std::unique_ptr<TraceBufferChunk>> chunks;
+    ArgumentFilterPredicate argument_filter_predicate;
+    {
+      AutoLock lock(lock_);
+      chunks.swap(pending_chunks_);
+      argument_filter_predicate = argument_filter_predicate_;
+    }
+    std::string output;
+    AppendHeaderIfNeeded(&output);
+    for (const std::unique_ptr<TraceBufferChunk>& chunk : chunks) {
+      for (size_t i = 0; i < chunk->size(); ++i) {
+        AppendEvent(*chunk->GetEventAt(i), argument_filter_predicate, &output);
+      }
+    }
+    if (!output.empty() &&
+        !file_.WriteAtCurrentPosAndCheck(as_bytes(make_span(output)))) {
+      for (const std::unique_ptr<TraceBufferChunk>& chunk : chunks) {
+        dropped_event_count_.fetch_add(chunk->size(),
+                                       std::memory_order_relaxed);
+      }
+    }
+
+    AutoLock lock(lock_);
+    for (std::unique_ptr<TraceBufferChunk>& chunk : chunks) {
+      if (free_chunks_.size() == kMaxFreeChunks) {
+        break;
+      }
+      free_chunks_.push_back(std::move(chunk));
+    }
+  }
+
+  void WriteChunk(const TraceBufferChunk& chunk) {
+    WritePendingChunks();
+    ArgumentFilterPredicate argument_filter_predicate;
+    {
+      AutoLock lock(lock_);
+      argument_filter_predicate = argument_filter_predicate_;
+    }
+    std::string output;
+    for (size_t i = 0; i < chunk.size(); ++i) {
+      AppendEvent(*chunk.GetEventAt(i), argument_filter_predicate, &output);
+    }
+    if (!output.empty() &&
+        !file_.WriteAtCurrentPosAndCheck(as_bytes(make_span(output)))) {
+      dropped_event_count_.fetch_add(chunk.size(), std::memory_order_relaxed);
+    }
+  }
+
+  // Writes the pending chunks every kWriteInterval on |task_runner|, until
+  // Stop() is called.
+  void WritePendingChunksPeriodically(
+      scoped_refptr<SequencedTaskRunner> task_runner) {
+    if (stopped_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    WritePendingChunks();
+    task_runner->PostDelayedTask(
+        FROM_HERE,
+        BindOnce(&Core::WritePendingChunksPeriodically, this, task_runner),
+        kWriteInterval);
+  }
+
+  void Stop() { stopped_.store(true, std::memory_order_relaxed); }
+
+  uint64_t GetDroppedEventCount() const {
+    return dropped_event_count_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  friend class RefCountedThreadSafe<Core>;
+
+  ~Core() = default;
+
+  void AppendHeaderIfNeeded(std::string* output) {
+    if (header_written_) {
+      return;
+    }
+    header_written_ = true;
+    output->append(kMagic, sizeof(kMagic));
+    AppendBigEndian(static_cast<uint32_t>(process_id_), output);
+  }
+
+  // Returns the ID of |string|, after appending a string entry for it to
+  // |output| if it wasn't written yet.
+  uint32_t InternString(StringPiece string, std::string* output) {
+    const auto it = string_ids_.find(string);
+    if (it != string_ids_.end()) {
+      return it->second;
+    }
+    const uint32_t id = next_string_id_++;
+    if (string_ids_.size() < kMaxInternedStrings) {
+      string_ids_.emplace(string, id);
+    }
+    output->push_back(static_cast<char>(kStringEntry));
+    AppendBigEndian(id, output);
+    AppendString(string, output);
+    return id;
+  }
+
+  // Appends an event entry for |event| to |output|, after the string entries
+  // which it refers to.
+  void AppendEvent(const TraceEvent& event,
+                   const ArgumentFilterPredicate& argument_filter_predicate,
+                   std::string* output) {
+    const char* category_group_name =
+        TraceLog::GetCategoryGroupName(event.category_group_enabled());
+    const uint32_t category_id = InternString(category_group_name, output);
+    const uint32_t name_id = InternString(event.name(), output);
+    const uint32_t scope_id =
+        event.scope() ? InternString(event.scope(), output) : 0;
+
+    // The arguments are appended to |args_| first, so that the string entries
+    // of their names precede the event.
+    args_.clear();
+    ArgumentNameFilterPredicate argument_name_filter_predicate;
+    const bool strip_args =
+        event.arg_size() > 0 && event.arg_name(0) &&
+        !argument_filter_predicate.is_null() &&
+        !argument_filter_predicate.Run(category_group_name, event.name(),
+                                       &argument_name_filter_predicate);
+    if (strip_args) {
+      args_.push_back(static_cast<char>(kStrippedArgs));
+    } else {
+      size_t arg_count = 0;
+      while (arg_count < event.arg_size() && event.arg_name(arg_count)) {
+        ++arg_count;
+      }
+      args_.push_back(static_cast<char>(arg_count));
+      for (size_t i = 0; i < arg_count; ++i) {
+        AppendBigEndian(InternString(event.arg_name(i), output), &args_);
+        if (argument_name_filter_predicate.is_null() ||
+            argument_name_filter_predicate.Run(event.arg_name(i))) {
+          AppendArgValue(event.arg_type(i), event.arg_value(i), &args_);
+        } else {
+          args_.push_back(static_cast<char>(kStrippedArg));
+        }
+      }
+    }
+
+    const bool has_process_id = event.flags() & TRACE_EVENT_FLAG_HAS_PROCESS_ID;
+    output->push_back(static_cast<char>(kEventEntry));
+    output->push_back(event.phase());
+    AppendBigEndian<uint32_t>(event.flags(), output);
+    AppendBigEndian(category_id, output);
+    AppendBigEndian(name_id, output);
+    AppendBigEndian(scope_id, output);
+    AppendBigEndian(event.timestamp().ToInternalValue(), output);
+    AppendBigEndian(event.thread_timestamp().ToInternalValue(), output);
+    AppendBigEndian(event.duration().ToInternalValue(), output);
+    AppendBigEndian(event.thread_duration().ToInternalValue(), output);
+    AppendBigEndian<uint64_t>(event.id(), output);
+    AppendBigEndian<uint64_t>(event.bind_id(), output);
+    AppendBigEndian(has_process_id
+                        ? static_cast<uint32_t>(event.process_id())
+                        : static_cast<uint32_t>(event.thread_id()),
+                    output);
+    output->append(args_);
+  }
+
+  const size_t max_pending_chunks_;
+  std::atomic<bool> stopped_{false};
+  std::atomic<uint64_t> dropped_event_count_{0};
+
+  Lock lock_;
+  ArgumentFilterPredicate argument_filter_predicate_ GUARDED_BY(lock_);
+  std::vector<std::unique_ptr<TraceBufferChunk>> pending_chunks_
+      GUARDED_BY(lock_);
+  std::vector<std::unique_ptr<TraceBufferChunk>> free_chunks_
+      GUARDED_BY(lock_);
+
+  // Only used by the sequence which writes the chunks.
+  File file_;
+  const ProcessId process_id_;
+  bool header_written_ = false;
+  std::map<std::string, uint32_t, std::less<>> string_ids_;
+  uint32_t next_string_id_ = 1;
+  std::string args_;
+};
+
+TraceSpoolWriter::TraceSpoolWriter(File file,
+                                   ProcessId process_id,
+                                   size_t max_pending_chunks)
+    : core_(MakeRefCounted<Core>(std::move(file),
+                                 process_id,
+                                 max_pending_chunks)) {
+  if (!ThreadPoolInstance::Get()) {
+    return;
+  }
+  // The chunks are written at a higher priority than the trace is converted
+  // when flushed, so that they don't pile up while the process is busy.
+  task_runner_ = ThreadPool::CreateSequencedTaskRunner(
+      {MayBlock(), TaskPriority::USER_VISIBLE,
+       TaskShutdownBehavior::CONTINUE_ON_SHUTDOWN});
+  task_runner_->PostDelayedTask(
+      FROM_HERE,
+      BindOnce(&Core::WritePendingChunksPeriodically, core_, task_runner_),
+      kWriteInterval);
+}
+
+TraceSpoolWriter::~TraceSpoolWriter() {
+  // This may be called with the TraceLog lock held, so the periodic task
+  // notices that it should stop rather than being told to.
+  core_->Stop();
+}
+
+void TraceSpoolWriter::SetArgumentFilterPredicate(
+    const ArgumentFilterPredicate& argument_filter_predicate) {
+  core_->SetArgumentFilterPredicate(argument_filter_predicate);
+}
+
+std::unique_ptr<TraceBufferChunk> TraceSpoolWriter::Spool(
+    std::unique_ptr<TraceBufferChunk> chunk) {
+  return core_->Spool(std::move(chunk));
+}
+
+void TraceSpoolWriter::WritePendingChunks() {
+  DCHECK(!task_runner_ || task_runner_->RunsTasksInCurrentSequence());
+  core_->WritePendingChunks();
+}
+
+void TraceSpoolWriter::WriteChunk(const TraceBufferChunk& chunk) {
+  DCHECK(!task_runner_ || task_runner_->RunsTasksInCurrentSequence());
+  core_->WriteChunk(chunk);
+}
+
+uint64_t TraceSpoolWriter::GetDroppedEventCount() const {
+  return core_->GetDroppedEventCount();
+}
+
+bool ConvertTraceSpoolToJSON(span<const uint8_t> spool, std::string* json) {
+  *json = "[";
+  BigEndianReader reader(spool);
+  StringPiece magic;
+  uint32_t process_id;
+  bool ok = reader.ReadPiece(&magic, sizeof(kMagic)) &&
+            magic == StringPiece(kMagic, sizeof(kMagic)) &&
+            reader.ReadU32(&process_id);
+  std::vector<StringPiece> strings;
+  std::string event;
+  while (ok && reader.remaining()) {
+    uint8_t entry;
+    reader.ReadU8(&entry);
+    if (entry == kStringEntry) {
+      uint32_t id;
+      StringPiece string;
+      ok = reader.ReadU32(&id) && id == strings.size() + 1 &&
+           ReadString(&reader, &string);
+      if (ok) {
+        strings.push_back(string);
+      }
+    } else if (entry == kEventEntry) {
+      event.clear();
+      ok = AppendEventAsJSON(&reader, strings, process_id, &event);
+      if (ok) {
+        if (json->size() > 1) {
+          *json += ",\n";
+        }
+        *json += event;
+      }
+    } else {
+      ok = false;
+    }
+  }
+  *json += "]";
+  return ok;
+}
+
+}  // namespace trace_event
+}  // namespace base
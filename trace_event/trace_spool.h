@@ -0,0 +1,95 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TRACE_EVENT_TRACE_SPOOL_H_
+#define BASE_TRACE_EVENT_TRACE_SPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "base/base_export.h"
+#include "base/containers/span.h"
+#include "base/files/file.h"
+#include "base/memory/scoped_refptr.h"
+#include "base/process/process_handle.h"
+#include "base/trace_event/trace_event_impl.h"
+
+namespace base {
+
+class SequencedTaskRunner;
+
+namespace trace_event {
+
+class TraceBufferChunk;
+
+// TraceSpoolWriter streams the events of a trace to a file while the trace is
+// recorded, so that long traces neither lose their oldest events nor keep all
+// of them in memory. The TraceBuffer returned by
+// TraceBuffer::CreateTraceBufferSpool() hands it the chunks which it would
+// otherwise overwrite, and they are written in a compact binary form, in the
+// background. ConvertTraceSpoolToJSON() converts the spool to the JSON trace
+// format later, offline.
+class BASE_EXPORT TraceSpoolWriter {
+ public:
+  // Writes the events recorded by the process |process_id| to |file|. Up to
+  // |max_pending_chunks| chunks wait to be written, after which more chunks
+  // are dropped, so that the memory used by the trace stays bounded. The
+  // chunks are written every few milliseconds if the thread pool is running,
+  // and only when the trace is flushed otherwise.
+  TraceSpoolWriter(File file, ProcessId process_id, size_t max_pending_chunks);
+
+  TraceSpoolWriter(const TraceSpoolWriter&) = delete;
+  TraceSpoolWriter& operator=(const TraceSpoolWriter&) = delete;
+
+  ~TraceSpoolWriter();
+
+  // Filters the arguments of the events as TraceEvent::AppendAsJSON() does.
+  // Must be called before the first chunk is spooled.
+  void SetArgumentFilterPredicate(
+      const ArgumentFilterPredicate& argument_filter_predicate);
+
+  // Takes |chunk| to write it. Returns a chunk which was already written, to be
+  // reused, or null. Returns |chunk| itself if it was dropped. This doesn't
+  // post tasks, so that it may be called with the TraceLog lock held.
+  std::unique_ptr<TraceBufferChunk> Spool(
+      std::unique_ptr<TraceBufferChunk> chunk);
+
+  // Writes the chunks spooled so far. Must be called on task_runner(), if
+  // there is one.
+  void WritePendingChunks();
+
+  // Writes |chunk| after the chunks spooled so far, e.g. as the trace is
+  // flushed. Must be called on task_runner(), if there is one.
+  void WriteChunk(const TraceBufferChunk& chunk);
+
+  // The sequence on which the chunks are written, or null if the thread pool
+  // wasn't running when the writer was created.
+  const scoped_refptr<SequencedTaskRunner>& task_runner() const {
+    return task_runner_;
+  }
+
+  // Returns the number of events which were dropped or couldn't be written.
+  uint64_t GetDroppedEventCount() const;
+
+ private:
+  class Core;
+
+  const scoped_refptr<Core> core_;
+  scoped_refptr<SequencedTaskRunner> task_runner_;
+};
+
+// Converts |spool|, as written by TraceSpoolWriter, to the JSON trace format:
+// an array of the events, as TraceLog::Flush() would have output them. Returns
+// false if |spool| is malformed or truncated, in which case |json| has the
+// events before the error.
+BASE_EXPORT bool ConvertTraceSpoolToJSON(span<const uint8_t> spool,
+                                         std::string* json);
+
+}  // namespace trace_event
+}  // namespace base
+
+#endif  // BASE_TRACE_EVENT_TRACE_SPOOL_H_
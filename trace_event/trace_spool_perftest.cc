@@ -0,0 +1,97 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_spool.h"
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/time/time.h"
+#include "base/timer/lap_timer.h"
+#include "base/trace_event/trace_buffer.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_log.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+constexpr char kMetricPrefixTraceSpool[] = "TraceSpool.";
+constexpr char kMetricNsPerEvent[] = "ns_per_event";
+
+class TraceSpoolPerfTest : public testing::Test {
+ protected:
+  TraceSpoolPerfTest()
+      : timer_(/*warmup_laps=*/10, Seconds(1), /*check_interval=*/10) {}
+
+  void SetUp() override {
+    const unsigned char* category_group_enabled =
+        TraceLog::GetCategoryGroupEnabled("spool_perf_test");
+    // Events as a typical TRACE_EVENT1() records them.
+    for (size_t i = 0; i < TraceBufferChunk::kTraceBufferChunkSize; ++i) {
+      size_t event_index;
+      TraceArguments args("url", "https://example.com/resource");
+      chunk_.AddTraceEvent(&event_index)
+          ->Reset(/*thread_id=*/1, TimeTicks::Now(), ThreadTicks(),
+                  TRACE_EVENT_PHASE_COMPLETE, category_group_enabled,
+                  "ResourceLoader::OnReceivedResponse",
+                  trace_event_internal::kGlobalScope,
+                  trace_event_internal::kNoId, trace_event_internal::kNoId,
+                  &args, TRACE_EVENT_FLAG_NONE);
+    }
+  }
+
+  void ReportResult(const std::string& story) {
+    perf_test::PerfResultReporter reporter(kMetricPrefixTraceSpool, story);
+    reporter.RegisterImportantMetric(kMetricNsPerEvent, "ns");
+    reporter.AddResult(kMetricNsPerEvent,
+                       timer_.TimePerLap().InMicrosecondsF() * 1000 /
+                           TraceBufferChunk::kTraceBufferChunkSize);
+  }
+
+  TraceBufferChunk chunk_{1};
+  LapTimer timer_;
+};
+
+}  // namespace
+
+// Converts the events to JSON, as TraceLog::Flush() does.
+TEST_F(TraceSpoolPerfTest, AppendAsJSON) {
+  std::string json;
+  do {
+    json.clear();
+    for (size_t i = 0; i < chunk_.size(); ++i) {
+      chunk_.GetEventAt(i)->AppendAsJSON(&json, ArgumentFilterPredicate());
+    }
+    timer_.NextLap();
+  } while (!timer_.HasTimeLimitExpired());
+  ReportResult("append_as_json");
+}
+
+// Writes the events to a spool, as a trace streamed to a file does.
+TEST_F(TraceSpoolPerfTest, WriteChunk) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  TraceSpoolWriter writer(
+      File(temp_dir.GetPath().AppendASCII("spool"),
+           File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE),
+      TraceLog::GetInstance()->process_id(), /*max_pending_chunks=*/1);
+  do {
+    writer.WriteChunk(chunk_);
+    timer_.NextLap();
+  } while (!timer_.HasTimeLimitExpired());
+  EXPECT_EQ(0u, writer.GetDroppedEventCount());
+  ReportResult("write_chunk");
+}
+
+}  // namespace trace_event
+}  // namespace base
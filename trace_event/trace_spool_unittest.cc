@@ -0,0 +1,285 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_spool.h"
+
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/functional/bind.h"
+#include "base/json/json_reader.h"
+#include "base/location.h"
+#include "base/task/sequenced_task_runner.h"
+#include "base/test/task_environment.h"
+#include "base/time/time.h"
+#include "base/trace_event/trace_buffer.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_log.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+class JsonConvertable : public ConvertableToTraceFormat {
+ public:
+  void AppendAsTraceFormat(std::string* out) const override {
+    *out += "{\"nested\":[1,2]}";
+  }
+};
+
+bool IsArgNameAllowlisted(const char* arg_name) {
+  return strcmp(arg_name, "allowed") == 0;
+}
+
+bool IsTraceEventArgsAllowlisted(
+    const char* category_group_name,
+    const char* event_name,
+    ArgumentNameFilterPredicate* arg_name_filter) {
+  if (strcmp(event_name, "stripped") == 0) {
+    return false;
+  }
+  if (strcmp(event_name, "filtered_by_name") == 0) {
+    *arg_name_filter = BindRepeating(&IsArgNameAllowlisted);
+  }
+  return true;
+}
+
+class TraceSpoolTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.GetPath().AppendASCII("spool");
+  }
+
+  std::unique_ptr<TraceSpoolWriter> CreateWriter(size_t max_pending_chunks) {
+    return std::make_unique<TraceSpoolWriter>(
+        File(path_, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE),
+        TraceLog::GetInstance()->process_id(), max_pending_chunks);
+  }
+
+  TraceEvent* AddEvent(TraceBufferChunk* chunk,
+                       char phase,
+                       const char* name,
+                       TraceArguments args,
+                       unsigned int flags) {
+    size_t event_index;
+    TraceEvent* event = chunk->AddTraceEvent(&event_index);
+    event->Reset(/*thread_id=*/7, TimeTicks() + Microseconds(++event_count_),
+                 ThreadTicks() + Microseconds(event_count_), phase,
+                 category_group_enabled_, name, "test_scope", /*id=*/0x1234,
+                 /*bind_id=*/0x5678, &args, flags);
+    return event;
+  }
+
+  // Returns the events of |chunks| as TraceLog::Flush() would have output
+  // them, in an array.
+  static std::string ToJSON(
+      const std::vector<const TraceBufferChunk*>& chunks,
+      const ArgumentFilterPredicate& argument_filter_predicate =
+          ArgumentFilterPredicate()) {
+    std::string json = "[";
+    for (const TraceBufferChunk* chunk : chunks) {
+      for (size_t i = 0; i < chunk->size(); ++i) {
+        if (json.size() > 1) {
+          json += ",\n";
+        }
+        chunk->GetEventAt(i)->AppendAsJSON(&json, argument_filter_predicate);
+      }
+    }
+    return json + "]";
+  }
+
+  std::string ReadSpoolAsJSON() {
+    absl::optional<std::vector<uint8_t>> spool = ReadFileToBytes(path_);
+    EXPECT_TRUE(spool);
+    std::string json;
+    EXPECT_TRUE(
+        ConvertTraceSpoolToJSON(spool.value_or(std::vector<uint8_t>()), &json));
+    return json;
+  }
+
+  // Returns the names of the events of |json|.
+  static std::vector<std::string> GetEventNames(const std::string& json) {
+    std::vector<std::string> names;
+    absl::optional<Value> root = JSONReader::Read(json);
+    EXPECT_TRUE(root && root->is_list());
+    if (root && root->is_list()) {
+      for (const Value& event : root->GetList()) {
+        names.push_back(*event.GetDict().FindString("name"));
+      }
+    }
+    return names;
+  }
+
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+  const unsigned char* const category_group_enabled_ =
+      TraceLog::GetCategoryGroupEnabled("spool_test");
+  int event_count_ = 0;
+};
+
+}  // namespace
+
+TEST_F(TraceSpoolTest, ConvertsLikeAppendAsJSON) {
+  auto chunk = std::make_unique<TraceBufferChunk>(1);
+  AddEvent(chunk.get(), TRACE_EVENT_PHASE_BEGIN, "begin",
+           TraceArguments("int", -42, "string", "value"),
+           TRACE_EVENT_FLAG_NONE);
+  AddEvent(chunk.get(), TRACE_EVENT_PHASE_INSTANT, "instant",
+           TraceArguments("double", 0.5, "bool", true),
+           TRACE_EVENT_SCOPE_PROCESS);
+  TraceEvent* complete =
+      AddEvent(chunk.get(), TRACE_EVENT_PHASE_COMPLETE, "complete",
+               TraceArguments("pointer", static_cast<void*>(&event_count_),
+                              "convertable",
+                              std::unique_ptr<ConvertableToTraceFormat>(
+                                  std::make_unique<JsonConvertable>())),
+               TRACE_EVENT_FLAG_NONE);
+  complete->UpdateDuration(TimeTicks() + Milliseconds(1),
+                           ThreadTicks() + Milliseconds(1));
+  AddEvent(chunk.get(), TRACE_EVENT_PHASE_ASYNC_BEGIN, "async",
+           TraceArguments("uint", 42u),
+           TRACE_EVENT_FLAG_HAS_ID | TRACE_EVENT_FLAG_FLOW_OUT |
+               TRACE_EVENT_FLAG_BIND_TO_ENCLOSING);
+  AddEvent(chunk.get(), TRACE_EVENT_PHASE_INSTANT, "copied",
+           TraceArguments("string", std::string("\"quoted\"\n")),
+           TRACE_EVENT_FLAG_COPY | TRACE_EVENT_SCOPE_THREAD);
+  AddEvent(chunk.get(), TRACE_EVENT_PHASE_INSTANT, "other_process",
+           TraceArguments(), TRACE_EVENT_FLAG_HAS_PROCESS_ID);
+  const std::string expected_json = ToJSON({chunk.get()});
+
+  std::unique_ptr<TraceSpoolWriter> writer = CreateWriter(16);
+  EXPECT_FALSE(writer->Spool(std::move(chunk)));
+  writer->WritePendingChunks();
+
+  const std::string json = ReadSpoolAsJSON();
+  EXPECT_EQ(expected_json, json);
+  EXPECT_EQ(6u, GetEventNames(json).size());
+  EXPECT_EQ(0u, writer->GetDroppedEventCount());
+}
+
+TEST_F(TraceSpoolTest, FiltersArguments) {
+  auto chunk = std::make_unique<TraceBufferChunk>(1);
+  for (const char* name : {"stripped", "filtered_by_name", "kept"}) {
+    AddEvent(chunk.get(), TRACE_EVENT_PHASE_INSTANT, name,
+             TraceArguments("allowed", 1, "other", 2),
+             TRACE_EVENT_SCOPE_THREAD);
+  }
+  const ArgumentFilterPredicate predicate =
+      BindRepeating(&IsTraceEventArgsAllowlisted);
+  const std::string expected_json = ToJSON({chunk.get()}, predicate);
+
+  std::unique_ptr<TraceSpoolWriter> writer = CreateWriter(16);
+  writer->SetArgumentFilterPredicate(predicate);
+  writer->WriteChunk(*chunk);
+
+  EXPECT_EQ(expected_json, ReadSpoolAsJSON());
+}
+
+TEST_F(TraceSpoolTest, DropsChunksWhenTooManyArePending) {
+  std::unique_ptr<TraceSpoolWriter> writer = CreateWriter(1);
+  auto chunk = std::make_unique<TraceBufferChunk>(1);
+  AddEvent(chunk.get(), TRACE_EVENT_PHASE_INSTANT, "written", TraceArguments(),
+           TRACE_EVENT_SCOPE_THREAD);
+  TraceBufferChunk* const written_chunk = chunk.get();
+  EXPECT_FALSE(writer->Spool(std::move(chunk)));
+
+  chunk = std::make_unique<TraceBufferChunk>(2);
+  AddEvent(chunk.get(), TRACE_EVENT_PHASE_INSTANT, "dropped", TraceArguments(),
+           TRACE_EVENT_SCOPE_THREAD);
+  TraceBufferChunk* const dropped_chunk = chunk.get();
+  EXPECT_EQ(dropped_chunk, writer->Spool(std::move(chunk)).get());
+  EXPECT_EQ(1u, writer->GetDroppedEventCount());
+
+  // Once written, the chunks are reused.
+  writer->WritePendingChunks();
+  chunk = std::make_unique<TraceBufferChunk>(3);
+  EXPECT_EQ(written_chunk, writer->Spool(std::move(chunk)).get());
+
+  EXPECT_EQ(std::vector<std::string>({"written"}),
+            GetEventNames(ReadSpoolAsJSON()));
+}
+
+TEST_F(TraceSpoolTest, SpoolBufferWritesOverwrittenChunks) {
+  std::unique_ptr<TraceBuffer> buffer(
+      TraceBuffer::CreateTraceBufferSpool(2, CreateWriter(16)));
+  EXPECT_FALSE(buffer->GetIterationTaskRunner());
+
+  const char* const kNames[] = {"event0", "event1", "event2", "event3",
+                                "event4"};
+  for (const char* name : kNames) {
+    size_t index;
+    std::unique_ptr<TraceBufferChunk> chunk = buffer->GetChunk(&index);
+    AddEvent(chunk.get(), TRACE_EVENT_PHASE_INSTANT, name, TraceArguments(),
+             TRACE_EVENT_SCOPE_THREAD);
+    buffer->ReturnChunk(index, std::move(chunk));
+  }
+  // The iteration writes the chunks still in the ring buffer.
+  EXPECT_FALSE(buffer->NextChunk());
+
+  EXPECT_EQ(std::vector<std::string>(std::begin(kNames), std::end(kNames)),
+            GetEventNames(ReadSpoolAsJSON()));
+}
+
+TEST_F(TraceSpoolTest, WritesInTheBackground) {
+  test::TaskEnvironment task_environment(
+      test::TaskEnvironment::TimeSource::MOCK_TIME);
+  std::unique_ptr<TraceBuffer> buffer(
+      TraceBuffer::CreateTraceBufferSpool(1, CreateWriter(16)));
+  const scoped_refptr<SequencedTaskRunner> task_runner =
+      buffer->GetIterationTaskRunner();
+  ASSERT_TRUE(task_runner);
+
+  for (const char* name : {"event0", "event1"}) {
+    size_t index;
+    std::unique_ptr<TraceBufferChunk> chunk = buffer->GetChunk(&index);
+    AddEvent(chunk.get(), TRACE_EVENT_PHASE_INSTANT, name, TraceArguments(),
+             TRACE_EVENT_SCOPE_THREAD);
+    buffer->ReturnChunk(index, std::move(chunk));
+  }
+  task_environment.FastForwardBy(Seconds(1));
+  EXPECT_EQ(std::vector<std::string>({"event0"}),
+            GetEventNames(ReadSpoolAsJSON()));
+
+  task_runner->PostTask(
+      FROM_HERE,
+      BindOnce([](TraceBuffer* buffer) { EXPECT_FALSE(buffer->NextChunk()); },
+               Unretained(buffer.get())));
+  task_environment.RunUntilIdle();
+  EXPECT_EQ(std::vector<std::string>({"event0", "event1"}),
+            GetEventNames(ReadSpoolAsJSON()));
+}
+
+TEST_F(TraceSpoolTest, RejectsMalformedSpools) {
+  auto chunk = std::make_unique<TraceBufferChunk>(1);
+  AddEvent(chunk.get(), TRACE_EVENT_PHASE_INSTANT, "event",
+           TraceArguments("string", "value"), TRACE_EVENT_SCOPE_THREAD);
+  CreateWriter(16)->WriteChunk(*chunk);
+  absl::optional<std::vector<uint8_t>> spool = ReadFileToBytes(path_);
+  ASSERT_TRUE(spool);
+
+  std::string json;
+  EXPECT_FALSE(ConvertTraceSpoolToJSON({}, &json));
+  EXPECT_EQ("[]", json);
+  spool->pop_back();
+  EXPECT_FALSE(ConvertTraceSpoolToJSON(*spool, &json));
+  EXPECT_EQ("[]", json);
+  (*spool)[0] = 'X';
+  EXPECT_FALSE(ConvertTraceSpoolToJSON(*spool, &json));
+}
+
+}  // namespace trace_event
+}  // namespace base
@@ -110,6 +110,7 @@ int VlogInfo::GetVlogLevel(base::StringPiece file) const {
 void VlogInfo::SetMaxVlogLevel(int level) {
   // Log severity is the negative verbosity.
   *min_log_level_ = -level;
+  InvalidateCachedVlogLevels();
 }
 
 int VlogInfo::GetMaxVlogLevel() const {
@@ -0,0 +1,86 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+
+#include <string>
+
+#include "base/logging.h"
+#include "base/test/scoped_logging_settings.h"
+#include "base/time/time.h"
+#include "base/timer/lap_timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_result_reporter.h"
+
+namespace logging {
+
+namespace {
+
+constexpr char kMetricPrefixVlog[] = "Vlog.";
+constexpr char kMetricNsPerCheck[] = "ns_per_check";
+
+constexpr size_t kChecksPerLap = 10000;
+
+// Typical --vmodule patterns, none of which matches this file.
+constexpr char kVmoduleSwitch[] =
+    "*/net/*=2,*/chrome/browser/sync/*=1,render_frame_host_impl=1,"
+    "*/components/*/ui/*=1,network_service=3,gpu_*=1,*/media/*=2";
+
+class VlogPerfTest : public testing::Test {
+ protected:
+  VlogPerfTest()
+      : timer_(/*warmup_laps=*/10, base::Seconds(1), /*check_interval=*/10) {}
+
+  void SetUp() override {
+    SetMinLogLevel(LOGGING_INFO);
+    scoped_vmodule_switches_.InitWithSwitches(kVmoduleSwitch);
+  }
+
+  void ReportResult(const std::string& story) {
+    perf_test::PerfResultReporter reporter(kMetricPrefixVlog, story);
+    reporter.RegisterImportantMetric(kMetricNsPerCheck, "ns");
+    reporter.AddResult(
+        kMetricNsPerCheck,
+        timer_.TimePerLap().InMicrosecondsF() * 1000 / kChecksPerLap);
+  }
+
+  ScopedLoggingSettings scoped_logging_settings_;
+  ScopedVmoduleSwitches scoped_vmodule_switches_;
+  base::LapTimer timer_;
+  // Keeps the compiler from dropping the measured work.
+  size_t enabled_count_ = 0;
+};
+
+}  // namespace
+
+// Checks a disabled VLOG(1), which uses the level cached by its call site.
+TEST_F(VlogPerfTest, DisabledVlogIsOn) {
+  do {
+    for (size_t i = 0; i < kChecksPerLap; ++i) {
+      if (VLOG_IS_ON(1)) {
+        ++enabled_count_;
+      }
+    }
+    timer_.NextLap();
+  } while (!timer_.HasTimeLimitExpired());
+  EXPECT_EQ(0u, enabled_count_);
+  ReportResult("disabled_vlog_is_on");
+}
+
+// Matches this file against the --vmodule patterns for each check, as
+// VLOG_IS_ON() did before caching the levels.
+TEST_F(VlogPerfTest, DisabledVlogLevelLookup) {
+  do {
+    for (size_t i = 0; i < kChecksPerLap; ++i) {
+      if (1 <= GetVlogLevel(__FILE__)) {
+        ++enabled_count_;
+      }
+    }
+    timer_.NextLap();
+  } while (!timer_.HasTimeLimitExpired());
+  EXPECT_EQ(0u, enabled_count_);
+  ReportResult("disabled_vlog_level_lookup");
+}
+
+}  // namespace logging